@@ -518,6 +518,42 @@ public:
     {
         return false;
     }
+    /**
+     * Returns whether this tool wants to receive trace entries during parallel
+     * operation in spans via parallel_shard_memref_batch() rather than one at a time
+     * via parallel_shard_memref().  Delivering a span costs one virtual call instead of
+     * one per entry, which matters for tools whose per-entry work is small.  The
+     * scheduler still produces entries one at a time: the analyzer copies them into a
+     * span, so this saves per-entry dispatch but not a per-entry copy.
+     */
+    virtual bool
+    parallel_shard_batch_supported()
+    {
+        return false;
+    }
+    /**
+     * Used in place of parallel_shard_memref() when parallel_shard_batch_supported()
+     * returns true.  Operates on \p num_entries consecutive trace entries starting at
+     * \p entries, all from the shard represented by \p shard_data.  A span never
+     * crosses a shard change or an interval boundary: any
+     * generate_shard_interval_snapshot() or parallel_shard_exit() call for the shard is
+     * made only after all prior entries have been delivered.  However, queries on the
+     * shard's #dynamorio::drmemtrace::memtrace_stream_t reflect the last entry of the
+     * span rather than each entry, so tools that need per-entry stream state (such as
+     * record or instruction ordinals) should use parallel_shard_memref() instead.
+     * The return value and error reporting are as for parallel_shard_memref().
+     * The default implementation calls parallel_shard_memref() on each entry.
+     */
+    virtual bool
+    parallel_shard_memref_batch(void *shard_data, const RecordType *entries,
+                                size_t num_entries)
+    {
+        for (size_t i = 0; i < num_entries; ++i) {
+            if (!parallel_shard_memref(shard_data, entries[i]))
+                return false;
+        }
+        return true;
+    }
     /** Returns a description of the last error for this shard. */
     virtual std::string
     parallel_shard_error(void *shard_data)
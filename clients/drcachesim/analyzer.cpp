@@ -573,6 +573,31 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_serial(analyzer_worker_data_t &
     }
 }
 
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::process_batch(analyzer_worker_data_t *worker)
+{
+    if (worker->batch.empty())
+        return true;
+    analyzer_shard_data_t &shard = worker->shard_data[worker->batch_shard_index];
+    for (int i = 0; i < num_tools_; ++i) {
+        if (!tool_uses_batch_[i])
+            continue;
+        if (!tools_[i]->parallel_shard_memref_batch(shard.tool_data[i].shard_data,
+                                                    worker->batch.data(),
+                                                    worker->batch.size())) {
+            worker->error =
+                tools_[i]->parallel_shard_error(shard.tool_data[i].shard_data);
+            VPRINT(this, 1, "Worker %d hit shard memref error %s on trace shard %s\n",
+                   worker->index, worker->error.c_str(),
+                   worker->stream->get_stream_name().c_str());
+            return false;
+        }
+    }
+    worker->batch.clear();
+    return true;
+}
+
 template <typename RecordType, typename ReaderType>
 bool
 analyzer_tmpl_t<RecordType, ReaderType>::process_shard_exit(
@@ -619,6 +644,8 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks_internal(
 
     for (int i = 0; i < num_tools_; ++i)
         user_worker_data[i] = tools_[i]->parallel_worker_init(worker->index);
+    if (any_tool_uses_batch_)
+        worker->batch.reserve(MAX_BATCH_RECORDS);
 
     RecordType record;
     // The current time is used for time quanta; for instr quanta, it's ignored and
@@ -652,6 +679,9 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks_internal(
             return false;
         }
         int shard_index = worker->stream->get_shard_index();
+        // A span holds records from just one shard.
+        if (shard_index != worker->batch_shard_index && !process_batch(worker))
+            return false;
         if (worker->shard_data.find(shard_index) == worker->shard_data.end()) {
             VPRINT(this, 1, "Worker %d starting on trace shard %d stream is %p\n",
                    worker->index, shard_index, worker->stream);
@@ -677,12 +707,19 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks_internal(
         if ((record_is_timestamp(record) || record_is_instr(record)) &&
             advance_interval_id(worker->stream, &worker->shard_data[shard_index],
                                 prev_interval_index, prev_interval_init_instr_count,
-                                record_is_instr(record)) &&
-            !process_interval(prev_interval_index, prev_interval_init_instr_count, worker,
-                              /*parallel=*/true, record_is_instr(record), shard_index)) {
-            return false;
+                                record_is_instr(record))) {
+            // The records of the interval just ended must reach every tool before
+            // its snapshot is taken.
+            if (!process_batch(worker) ||
+                !process_interval(prev_interval_index, prev_interval_init_instr_count,
+                                  worker,
+                                  /*parallel=*/true, record_is_instr(record),
+                                  shard_index))
+                return false;
         }
         for (int i = 0; i < num_tools_; ++i) {
+            if (tool_uses_batch_[i])
+                continue;
             if (!tools_[i]->parallel_shard_memref(
                     worker->shard_data[shard_index].tool_data[i].shard_data, record)) {
                 worker->error = tools_[i]->parallel_shard_error(
@@ -693,12 +730,26 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks_internal(
                 return false;
             }
         }
-        if (record_is_thread_final(record) && shard_type_ != SHARD_BY_CORE) {
+        bool shard_exit =
+            record_is_thread_final(record) && shard_type_ != SHARD_BY_CORE;
+        if (any_tool_uses_batch_) {
+            worker->batch.push_back(record);
+            worker->batch_shard_index = shard_index;
+            // We also deliver at waits and idles rather than holding records back
+            // while this worker has nothing else to do.
+            if ((worker->batch.size() >= MAX_BATCH_RECORDS || shard_exit ||
+                 status != sched_type_t::STATUS_OK) &&
+                !process_batch(worker))
+                return false;
+        }
+        if (shard_exit) {
             if (!process_shard_exit(worker, shard_index)) {
                 return false;
             }
         }
     }
+    if (!process_batch(worker))
+        return false;
     if (shard_type_ == SHARD_BY_CORE) {
         if (worker->shard_data.find(worker->index) != worker->shard_data.end()) {
             if (!process_shard_exit(worker, worker->index)) {
@@ -986,6 +1037,14 @@ analyzer_tmpl_t<RecordType, ReaderType>::run()
             if (!error_string_.empty())
                 return false;
         }
+        tool_uses_batch_.assign(num_tools_, false);
+        any_tool_uses_batch_ = false;
+        for (int i = 0; i < num_tools_; ++i) {
+            if (tools_[i]->parallel_shard_batch_supported()) {
+                tool_uses_batch_[i] = true;
+                any_tool_uses_batch_ = true;
+            }
+        }
         std::vector<std::thread> threads;
         VPRINT(this, 1, "Creating %d worker threads\n", worker_count_);
         threads.reserve(worker_count_);
@@ -201,12 +201,18 @@ protected:
             stream = src.stream;
             shard_data = std::move(src.shard_data);
             error = std::move(src.error);
+            batch = std::move(src.batch);
+            batch_shard_index = src.batch_shard_index;
         }
 
         int index;
         typename scheduler_tmpl_t<RecordType, ReaderType>::stream_t *stream;
         std::string error;
         std::unordered_map<int, analyzer_shard_data_t> shard_data;
+        // Records not yet delivered to the tools using parallel_shard_memref_batch(),
+        // all from the shard batch_shard_index.
+        std::vector<RecordType> batch;
+        int batch_shard_index = -1;
 
     private:
         // Delete copy constructor and assignment operator to avoid overhead of
@@ -245,6 +251,12 @@ protected:
     bool
     process_tasks_internal(analyzer_worker_data_t *worker);
 
+    // Helper for process_tasks() which delivers the worker's pending span of records
+    // to each tool using parallel_shard_memref_batch().
+    // Returns false if there was an error and the caller should return early.
+    bool
+    process_batch(analyzer_worker_data_t *worker);
+
     // Helper for process_tasks() which calls parallel_shard_exit() in each tool.
     // Returns false if there was an error and the caller should return early.
     bool
@@ -369,6 +381,11 @@ protected:
     std::vector<analyzer_worker_data_t> worker_data_;
     int num_tools_;
     analysis_tool_tmpl_t<RecordType> **tools_;
+    // Which tools receive records in spans via parallel_shard_memref_batch().
+    std::vector<bool> tool_uses_batch_;
+    bool any_tool_uses_batch_ = false;
+    // The maximum number of records in one span.
+    static constexpr size_t MAX_BATCH_RECORDS = 256;
     // Stores the interval state snapshots, merged across shards. These are
     // produced when timestamp intervals are enabled using interval_microseconds_.
     //
@@ -50,6 +50,10 @@
 #    include "common/zipfile_istream.h"
 #endif
 #include "reader/ipc_reader.h"
+#ifdef LINUX
+#    include "reader/shm_reader.h"
+#endif
+#include "simulator/cache_simulator.h"
 #include "simulator/cache_simulator_create.h"
 #include "simulator/tlb_simulator_create.h"
 #include "tools/basic_counts_create.h"
@@ -83,6 +87,18 @@ template <>
 std::unique_ptr<reader_t>
 analyzer_multi_t::create_ipc_reader(const char *name, int verbose)
 {
+#ifdef LINUX
+    if (op_ipc_shm.get_value()) {
+        return std::unique_ptr<reader_t>(
+            new shm_reader_t(name, op_ipc_shm_rings.get_value(),
+                             op_ipc_shm_ring_size.get_value(), verbose));
+    }
+#else
+    if (op_ipc_shm.get_value()) {
+        this->error_string_ = "-ipc_shm is only supported on Linux";
+        return nullptr;
+    }
+#endif
     return std::unique_ptr<reader_t>(new ipc_reader_t(name, verbose));
 }
 
@@ -90,6 +106,10 @@ template <>
 std::unique_ptr<reader_t>
 analyzer_multi_t::create_ipc_reader_end()
 {
+#ifdef LINUX
+    if (op_ipc_shm.get_value())
+        return std::unique_ptr<reader_t>(new shm_reader_t());
+#endif
     return std::unique_ptr<reader_t>(new ipc_reader_t());
 }
 
@@ -185,8 +205,26 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
 {
     if (tool == CPU_CACHE || tool == CPU_CACHE_ALT || tool == CPU_CACHE_LEGACY) {
         const std::string &config_file = op_config_file.get_value();
-        if (!config_file.empty()) {
-            return cache_simulator_create(config_file);
+        if (config_file.find(OP_CONFIG_FILE_SEP) != std::string::npos) {
+            return multi_cache_simulator_create(
+                split_by(config_file, OP_CONFIG_FILE_SEP), op_config_threads.get_value());
+        } else if (!config_file.empty()) {
+            analysis_tool_t *sim = cache_simulator_create(config_file);
+            if (sim == nullptr || !*sim)
+                return sim;
+            // Lockstep simulation waits for a worker for every simulated core,
+            // so it would hang if there were fewer workers than cores.
+            const cache_simulator_knobs_t &knobs =
+                static_cast<cache_simulator_t *>(sim)->get_knobs();
+            if (knobs.parallel && knobs.parallel_lockstep &&
+                knobs.num_cores != op_num_cores.get_value()) {
+                ERRMSG("Usage error: sim_lockstep requires the config file's "
+                       "num_cores (%u) to match -cores (%u).\n",
+                       knobs.num_cores, op_num_cores.get_value());
+                delete sim;
+                return nullptr;
+            }
+            return sim;
         } else {
             cache_simulator_knobs_t *knobs = get_cache_simulator_knobs();
             return cache_simulator_create(*knobs);
@@ -227,11 +265,19 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
         knobs.skip_list_distance = op_reuse_skip_dist.get_value();
         knobs.distance_limit = op_reuse_distance_limit.get_value();
         knobs.verify_skip = op_reuse_verify_skip.get_value();
+        knobs.use_fenwick_tree = op_reuse_fenwick_tree.get_value();
         knobs.histogram_bin_multiplier = op_reuse_histogram_bin_multiplier.get_value();
         if (knobs.histogram_bin_multiplier < 1.0) {
             ERRMSG("Usage error: reuse_histogram_bin_multiplier must be >= 1.0\n");
             return nullptr;
         }
+        knobs.report_miss_ratio_curve = op_reuse_miss_ratio_curve.get_value();
+        knobs.sample_rate = op_reuse_sample_rate.get_value();
+        knobs.sample_max_lines = op_reuse_sample_max_lines.get_value();
+        if (knobs.sample_rate <= 0.0 || knobs.sample_rate > 1.0) {
+            ERRMSG("Usage error: reuse_sample_rate must be > 0.0 and <= 1.0\n");
+            return nullptr;
+        }
         knobs.verbose = op_verbose.get_value();
         return reuse_distance_tool_create(knobs);
     } else if (tool == REUSE_TIME) {
@@ -423,6 +469,7 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::analyzer_multi_tmpl_t()
                 op_alt_module_dir.get_value(), op_chunk_instr_count.get_value(),
                 dir.in_kfiles_map_, dir.kcoredir_, dir.kallsymsdir_,
                 std::move(dir.syscall_template_file_reader_));
+            raw2trace.set_thread_file_sizes(dir.in_file_sizes_);
             std::string error = raw2trace.do_conversion();
             if (!error.empty()) {
                 this->success_ = false;
@@ -525,6 +572,10 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::init_dynamic_schedule()
     sched_ops.block_time_max = op_sched_block_max_us.get_value();
     sched_ops.randomize_next_input = op_sched_randomize.get_value();
     sched_ops.honor_direct_switches = !op_sched_disable_direct_switches.get_value();
+    sched_ops.per_output_ready_queues = op_sched_per_output_queues.get_value();
+    sched_ops.rebalance_period_us = op_sched_rebalance_period_us.get_value();
+    sched_ops.read_ahead_threads = op_sched_read_ahead_threads.get_value();
+    sched_ops.read_ahead_blocks = op_sched_read_ahead_blocks.get_value();
 #ifdef HAS_ZIP
     if (!op_record_file.get_value().empty()) {
         record_schedule_zip_.reset(new zipfile_ostream_t(op_record_file.get_value()));
@@ -697,6 +748,8 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::get_cache_simulator_knobs()
     knobs->verbose = op_verbose.get_value();
     knobs->cpu_scheduling = op_cpu_scheduling.get_value();
     knobs->use_physical = op_use_physical.get_value();
+    knobs->parallel = op_sim_parallel.get_value();
+    knobs->parallel_lockstep = op_sim_lockstep.get_value();
     return knobs;
 }
 
@@ -0,0 +1,675 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* instr_table: a compact encoding of the trace_entry_t records of an archive
+ * which stores each distinct instruction once and each data address as a delta.
+ *
+ * Every distinct combination of an instruction's pc, trace type, length, and
+ * encoding is assigned an index in an instruction table, in order of first
+ * appearance.  The table is stored in its own archive component, named
+ * INSTR_TABLE_COMPONENT_NAME, after all of the trace components:
+ *
+ *   varint INSTR_TABLE_VERSION
+ *   varint number of entries
+ *   For each entry:
+ *     svarint pc minus the prior entry's pc (or 0 for the first entry)
+ *     varint  trace type
+ *     varint  length
+ *     varint  encoding length
+ *     char[]  encoding
+ *
+ * Each trace component is a sequence of blocks.  Each block holds two columns:
+ * the operations and the data addresses those operations refer to, which are
+ * kept apart so that the general-purpose compressor sees similar bytes together:
+ *
+ *   varint  size of the operation column
+ *   varint  size of the address column
+ *   char[]  operation column
+ *   char[]  address column
+ *
+ * Each operation starts with a tag byte:
+ *
+ *   0x80-0xff INSTR_TABLE_OP_SHORT_INSTR: an instruction fetch whose index minus
+ *             the index expected next (the prior fetch's index plus one) is the
+ *             low 7 bits minus INSTR_TABLE_SHORT_DELTA_BIAS.
+ *   0x00      INSTR_TABLE_OP_INSTR: an instruction fetch.  An svarint follows with
+ *             the index minus the index expected next.
+ *   0x01      INSTR_TABLE_OP_ENCODING: the TRACE_TYPE_ENCODING records for an entry,
+ *             split into as many records as needed with any unused bytes zeroed.
+ *             An svarint follows with the index minus the index expected next.
+ *   0x02      INSTR_TABLE_OP_MARKER: a marker.  Two varints follow: the marker
+ *             type and the marker value.
+ *   0x03      INSTR_TABLE_OP_RECORD: any other record.  Two varints follow with its
+ *             type and size.  Its address is the next svarint in the address
+ *             column, added to the predicted address described below.
+ *   0x04      INSTR_TABLE_OP_DATA: a data record with the same type and size as the
+ *             one at the same position after the prior execution of the current
+ *             instruction.  Its address is as for INSTR_TABLE_OP_RECORD.
+ *
+ * The predicted address of a data record (see type_is_data()) is the address of
+ * the data record at the same position after the prior execution of the same
+ * table entry, so a strided access costs one small delta.  For anything else,
+ * including the first execution of each entry, it is the address of the prior
+ * INSTR_TABLE_OP_RECORD or INSTR_TABLE_OP_DATA.
+ *
+ * A varint is an unsigned LEB128 value; an svarint is a zigzag-encoded signed
+ * value stored as a varint.  All of this state starts over in each component, so
+ * that each component can be decoded on its own after a skip.  Decoding
+ * reproduces the original records exactly: encoding records which are not in the
+ * canonical split used by raw2trace are kept as INSTR_TABLE_OP_RECORD operations.
+ */
+
+#ifndef _INSTR_TABLE_H_
+#define _INSTR_TABLE_H_ 1
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#define INSTR_TABLE_COMPONENT_NAME "instr_table"
+// Version 1 had no address column and was never released.
+#define INSTR_TABLE_VERSION 2
+
+#define INSTR_TABLE_OP_INSTR 0x00
+#define INSTR_TABLE_OP_ENCODING 0x01
+#define INSTR_TABLE_OP_MARKER 0x02
+#define INSTR_TABLE_OP_RECORD 0x03
+#define INSTR_TABLE_OP_DATA 0x04
+#define INSTR_TABLE_OP_SHORT_INSTR 0x80
+#define INSTR_TABLE_SHORT_DELTA_BIAS 64
+
+// The state shared by instr_table_encoder_t and instr_table_decoder_t.
+class instr_table_t {
+public:
+    size_t
+    num_entries() const
+    {
+        return entries_.size();
+    }
+
+protected:
+    struct entry_t {
+        addr_t pc;
+        unsigned short type;
+        unsigned short size;
+        std::string encoding;
+    };
+    // A data record from the most recent execution of an entry.
+    struct data_slot_t {
+        addr_t addr;
+        unsigned short type;
+        unsigned short size;
+    };
+
+    static void
+    append_varint(std::string &dst, uint64_t val)
+    {
+        while (val >= 0x80) {
+            dst += static_cast<char>((val & 0x7f) | 0x80);
+            val >>= 7;
+        }
+        dst += static_cast<char>(val);
+    }
+    static void
+    append_svarint(std::string &dst, int64_t val)
+    {
+        // Zigzag encoding keeps small negative values small.
+        append_varint(dst, (static_cast<uint64_t>(val) << 1) ^
+                               static_cast<uint64_t>(val >> 63));
+    }
+    static bool
+    read_varint(const unsigned char *&pos, const unsigned char *end, uint64_t &val)
+    {
+        val = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= end)
+                return false;
+            unsigned char byte = *pos++;
+            val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+    static bool
+    read_svarint(const unsigned char *&pos, const unsigned char *end, int64_t &val)
+    {
+        uint64_t raw;
+        if (!read_varint(pos, end, raw))
+            return false;
+        val = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+
+    void
+    reset_component_state()
+    {
+        next_index_ = 0;
+        prev_addr_ = 0;
+        cur_index_ = -1;
+        cur_ordinal_ = 0;
+        data_slots_.clear();
+    }
+    // Returns the data records of the prior execution of the current instruction
+    // if a record of "type" is predicted from them, or nullptr otherwise.
+    std::vector<data_slot_t> *
+    find_data_slots(unsigned short type)
+    {
+        if (cur_index_ < 0 || !type_is_data(static_cast<trace_type_t>(type)))
+            return nullptr;
+        if (data_slots_.size() <= static_cast<size_t>(cur_index_))
+            data_slots_.resize(cur_index_ + 1);
+        return &data_slots_[cur_index_];
+    }
+    // Returns the predicted address for a record of "type".
+    addr_t
+    predict_addr(const std::vector<data_slot_t> *slots) const
+    {
+        if (slots != nullptr && cur_ordinal_ < slots->size())
+            return (*slots)[cur_ordinal_].addr;
+        return prev_addr_;
+    }
+    // Updates the predictions with "record", which is not an instruction, marker,
+    // or canonical encoding.
+    void
+    remember_record(std::vector<data_slot_t> *slots, const trace_entry_t &record)
+    {
+        if (slots != nullptr) {
+            data_slot_t slot = { record.addr, record.type, record.size };
+            if (cur_ordinal_ < slots->size())
+                (*slots)[cur_ordinal_] = slot;
+            else
+                slots->push_back(slot);
+            ++cur_ordinal_;
+        }
+        prev_addr_ = record.addr;
+    }
+
+    std::vector<entry_t> entries_;
+    // The index expected for the next instruction fetch in the current component.
+    uint64_t next_index_ = 0;
+    // The address of the prior non-instruction record in the current component.
+    addr_t prev_addr_ = 0;
+    // The index of the prior instruction in the current component, or -1.
+    int64_t cur_index_ = -1;
+    // The number of data records seen since that instruction.
+    size_t cur_ordinal_ = 0;
+    // The data records of each entry's most recent execution in the current
+    // component, indexed by entry.
+    std::vector<std::vector<data_slot_t>> data_slots_;
+};
+
+// Converts trace_entry_t records into the instr_table format.
+class instr_table_encoder_t : public instr_table_t {
+public:
+    // Ends the current component, appending any buffered records to "out", and
+    // resets the state carried between records for the next component.
+    void
+    start_component(std::string &out)
+    {
+        flush();
+        append_block(out);
+        reset_component_state();
+    }
+    // Encodes "entry", appending a block to "out" whenever one fills up.  Encoding
+    // records, and any markers following them, are buffered until the
+    // instruction they precede.
+    void
+    add(const trace_entry_t &entry, std::string &out)
+    {
+        add(entry);
+        if (ops_.size() + addrs_.size() >= BLOCK_SIZE)
+            append_block(out);
+    }
+    // Appends the instruction table to "out".
+    void
+    write_table(std::string &out) const
+    {
+        append_varint(out, INSTR_TABLE_VERSION);
+        append_varint(out, entries_.size());
+        addr_t prev_pc = 0;
+        for (const entry_t &entry : entries_) {
+            append_svarint(out, static_cast<int64_t>(entry.pc - prev_pc));
+            append_varint(out, entry.type);
+            append_varint(out, entry.size);
+            append_varint(out, entry.encoding.size());
+            out += entry.encoding;
+            prev_pc = entry.pc;
+        }
+    }
+
+private:
+    // The column bytes at which a block is ended.
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    void
+    add(const trace_entry_t &entry)
+    {
+        if (entry.type == TRACE_TYPE_ENCODING) {
+            // Encodings following a marker were not for the same instruction.
+            if (pending_.size() > num_pending_encodings_)
+                flush();
+            pending_.push_back(entry);
+            ++num_pending_encodings_;
+            return;
+        }
+        if (entry.type == TRACE_TYPE_MARKER && !pending_.empty()) {
+            pending_.push_back(entry);
+            return;
+        }
+        if (!is_any_instr_type(static_cast<trace_type_t>(entry.type))) {
+            flush();
+            append_record(entry);
+            return;
+        }
+        std::string encoding;
+        bool canonical = true;
+        for (size_t i = 0; i < num_pending_encodings_; ++i) {
+            const trace_entry_t &enc = pending_[i];
+            bool last = i == num_pending_encodings_ - 1;
+            if (enc.size == 0 || enc.size > sizeof(enc.encoding) ||
+                (!last && enc.size != sizeof(enc.encoding)))
+                canonical = false;
+            size_t size = std::min(static_cast<size_t>(enc.size), sizeof(enc.encoding));
+            encoding.append(reinterpret_cast<const char *>(enc.encoding), size);
+            for (size_t j = size; j < sizeof(enc.encoding); ++j) {
+                if (enc.encoding[j] != 0)
+                    canonical = false;
+            }
+        }
+        if (encoding.size() > MAX_ENCODING_LENGTH)
+            canonical = false;
+        uint64_t index = find_entry(entry, encoding);
+        if (num_pending_encodings_ > 0 && canonical) {
+            ops_ += static_cast<char>(INSTR_TABLE_OP_ENCODING);
+            append_svarint(ops_, static_cast<int64_t>(index - next_index_));
+        } else {
+            for (size_t i = 0; i < num_pending_encodings_; ++i)
+                append_record(pending_[i]);
+        }
+        for (size_t i = num_pending_encodings_; i < pending_.size(); ++i)
+            append_record(pending_[i]);
+        pending_.clear();
+        num_pending_encodings_ = 0;
+        int64_t delta = static_cast<int64_t>(index - next_index_);
+        if (delta >= -INSTR_TABLE_SHORT_DELTA_BIAS &&
+            delta < INSTR_TABLE_SHORT_DELTA_BIAS) {
+            ops_ += static_cast<char>(INSTR_TABLE_OP_SHORT_INSTR |
+                                      (delta + INSTR_TABLE_SHORT_DELTA_BIAS));
+        } else {
+            ops_ += static_cast<char>(INSTR_TABLE_OP_INSTR);
+            append_svarint(ops_, delta);
+        }
+        next_index_ = index + 1;
+        cur_index_ = static_cast<int64_t>(index);
+        cur_ordinal_ = 0;
+    }
+    // Encodes any buffered records.
+    void
+    flush()
+    {
+        for (const trace_entry_t &entry : pending_)
+            append_record(entry);
+        pending_.clear();
+        num_pending_encodings_ = 0;
+    }
+    // Appends the columns accumulated so far to "out" as a block.
+    void
+    append_block(std::string &out)
+    {
+        if (ops_.empty())
+            return;
+        append_varint(out, ops_.size());
+        append_varint(out, addrs_.size());
+        out += ops_;
+        out += addrs_;
+        ops_.clear();
+        addrs_.clear();
+    }
+    // Returns the index for the instruction "entry" with "encoding", which is
+    // empty if no encoding records preceded it, adding a new entry if necessary.
+    uint64_t
+    find_entry(const trace_entry_t &entry, const std::string &encoding)
+    {
+        const addr_t pc = entry.addr;
+        auto it = pc2index_.find(pc);
+        if (encoding.empty() && it != pc2index_.end()) {
+            // The common case: the same instruction seen recently.
+            const entry_t &prior = entries_[it->second];
+            if (prior.type == entry.type && prior.size == entry.size)
+                return it->second;
+        }
+        // Without encoding records, the instruction has the most recent encoding
+        // seen at its pc.
+        const std::string &key_encoding = !encoding.empty() || it == pc2index_.end()
+            ? encoding
+            : entries_[it->second].encoding;
+        std::string key(reinterpret_cast<const char *>(&pc), sizeof(pc));
+        key.append(reinterpret_cast<const char *>(&entry.type), sizeof(entry.type));
+        key.append(reinterpret_cast<const char *>(&entry.size), sizeof(entry.size));
+        key += key_encoding;
+        auto inserted = key2index_.emplace(key, entries_.size());
+        if (inserted.second)
+            entries_.push_back({ pc, entry.type, entry.size, key_encoding });
+        pc2index_[pc] = inserted.first->second;
+        return inserted.first->second;
+    }
+    void
+    append_record(const trace_entry_t &entry)
+    {
+        if (entry.type == TRACE_TYPE_MARKER) {
+            ops_ += static_cast<char>(INSTR_TABLE_OP_MARKER);
+            append_varint(ops_, entry.size);
+            append_varint(ops_, entry.addr);
+            return;
+        }
+        std::vector<data_slot_t> *slots = find_data_slots(entry.type);
+        if (slots != nullptr && cur_ordinal_ < slots->size() &&
+            (*slots)[cur_ordinal_].type == entry.type &&
+            (*slots)[cur_ordinal_].size == entry.size) {
+            ops_ += static_cast<char>(INSTR_TABLE_OP_DATA);
+        } else {
+            ops_ += static_cast<char>(INSTR_TABLE_OP_RECORD);
+            append_varint(ops_, entry.type);
+            append_varint(ops_, entry.size);
+        }
+        append_svarint(addrs_, static_cast<int64_t>(entry.addr - predict_addr(slots)));
+        remember_record(slots, entry);
+    }
+
+    // The most recent entry for each pc.
+    std::unordered_map<addr_t, uint64_t> pc2index_;
+    // The entry for each combination of pc, type, length, and encoding.
+    std::unordered_map<std::string, uint64_t> key2index_;
+    // Buffered encoding records, followed by any buffered markers.
+    std::vector<trace_entry_t> pending_;
+    size_t num_pending_encodings_ = 0;
+    // The columns of the current block.
+    std::string ops_;
+    std::string addrs_;
+};
+
+// Converts the instr_table format back into trace_entry_t records.
+class instr_table_decoder_t : public instr_table_t {
+public:
+    // Returns the number of bytes of the current component for "dst", 0 at the end
+    // of the component, or a negative value on an error.
+    typedef std::function<int64_t(void *dst, size_t size)> read_func_t;
+
+    // The most records produced by one operation.
+    static constexpr size_t MAX_RECORDS_PER_OP =
+        (MAX_ENCODING_LENGTH + sizeof(addr_t) - 1) / sizeof(addr_t);
+
+    // Parses a table written by instr_table_encoder_t::write_table().
+    bool
+    init(const std::string &table)
+    {
+        const unsigned char *pos = reinterpret_cast<const unsigned char *>(table.data());
+        const unsigned char *end = pos + table.size();
+        uint64_t version, count;
+        if (!read_varint(pos, end, version) || version != INSTR_TABLE_VERSION ||
+            !read_varint(pos, end, count) ||
+            count > table.size() /* Each entry takes several bytes. */)
+            return false;
+        entries_.clear();
+        entries_.reserve(count);
+        addr_t pc = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            int64_t pc_delta;
+            uint64_t type, size, encoding_size;
+            if (!read_svarint(pos, end, pc_delta) || !read_varint(pos, end, type) ||
+                !read_varint(pos, end, size) || !read_varint(pos, end, encoding_size) ||
+                type > USHRT_MAX || size > USHRT_MAX ||
+                encoding_size > static_cast<uint64_t>(end - pos))
+                return false;
+            pc += static_cast<addr_t>(pc_delta);
+            entries_.push_back({ pc, static_cast<unsigned short>(type),
+                                 static_cast<unsigned short>(size),
+                                 std::string(reinterpret_cast<const char *>(pos),
+                                             static_cast<size_t>(encoding_size)) });
+            pos += encoding_size;
+        }
+        start_component();
+        return pos == end;
+    }
+    // Discards any state from the prior component.  Must be called whenever the
+    // underlying archive moves to a different component.
+    void
+    start_component()
+    {
+        reset_component_state();
+        in_pos_ = 0;
+        in_end_ = 0;
+        in_done_ = false;
+        ops_pos_ = ops_end_ = addrs_pos_ = addrs_end_ = nullptr;
+    }
+    // Decodes up to "max_out", which must be at least MAX_RECORDS_PER_OP, records
+    // of the current component into "out", reading its bytes through "read".
+    // Returns the number of records, 0 at the end of the component, or -1 on an
+    // error.
+    int64_t
+    decode(trace_entry_t *out, size_t max_out, const read_func_t &read)
+    {
+        size_t count = 0;
+        while (count + MAX_RECORDS_PER_OP <= max_out) {
+            if (ops_pos_ == ops_end_) {
+                // Every address must have been consumed by the block's operations.
+                if (addrs_pos_ != addrs_end_)
+                    return -1;
+                int res = next_block(read);
+                if (res < 0)
+                    return -1;
+                if (res == 0)
+                    break;
+            }
+            if (!decode_op(out, count))
+                return -1;
+        }
+        return static_cast<int64_t>(count);
+    }
+
+private:
+    // The largest block header: two 64-bit varints.
+    static constexpr size_t MAX_HEADER_SIZE = 2 * 10;
+    // A sanity limit on the size of a block, to catch corrupted headers.
+    static constexpr uint64_t MAX_BLOCK_SIZE = 1ULL << 30;
+    static constexpr size_t MIN_BUFFER_SIZE = 128 * 1024;
+
+    // Discards the bytes before in_pos_ and reads until at least "size" bytes
+    // are buffered or the component ends.
+    bool
+    fill(size_t size, const read_func_t &read)
+    {
+        if (in_pos_ > 0) {
+            memmove(&in_[0], &in_[0] + in_pos_, in_end_ - in_pos_);
+            in_end_ -= in_pos_;
+            in_pos_ = 0;
+        }
+        size_t capacity = size < MIN_BUFFER_SIZE ? MIN_BUFFER_SIZE : size;
+        if (in_.size() < capacity)
+            in_.resize(capacity);
+        while (in_end_ < size && !in_done_) {
+            int64_t num_read = read(&in_[0] + in_end_, in_.size() - in_end_);
+            if (num_read < 0)
+                return false;
+            if (num_read == 0)
+                in_done_ = true;
+            in_end_ += static_cast<size_t>(num_read);
+        }
+        return true;
+    }
+    // Points the column cursors at the next block.  Returns 1 on success, 0 at the
+    // end of the component, and -1 on an error.
+    int
+    next_block(const read_func_t &read)
+    {
+        if (addrs_end_ != nullptr) {
+            // Consume the prior block.
+            in_pos_ = addrs_end_ - &in_[0];
+            ops_pos_ = ops_end_ = addrs_pos_ = addrs_end_ = nullptr;
+        }
+        if (!fill(MAX_HEADER_SIZE, read))
+            return -1;
+        if (in_pos_ == in_end_)
+            return 0;
+        const unsigned char *pos = &in_[0] + in_pos_;
+        uint64_t ops_size, addrs_size;
+        if (!read_varint(pos, &in_[0] + in_end_, ops_size) ||
+            !read_varint(pos, &in_[0] + in_end_, addrs_size) || ops_size == 0 ||
+            ops_size > MAX_BLOCK_SIZE || addrs_size > MAX_BLOCK_SIZE)
+            return -1;
+        size_t header_size = pos - (&in_[0] + in_pos_);
+        size_t block_size = header_size + static_cast<size_t>(ops_size + addrs_size);
+        if (!fill(block_size, read) || in_end_ < block_size)
+            return -1;
+        ops_pos_ = &in_[0] + header_size;
+        ops_end_ = ops_pos_ + ops_size;
+        addrs_pos_ = ops_end_;
+        addrs_end_ = addrs_pos_ + addrs_size;
+        return 1;
+    }
+    bool
+    find_index(int64_t delta, uint64_t &index) const
+    {
+        index = next_index_ + static_cast<uint64_t>(delta);
+        return index < entries_.size();
+    }
+    bool
+    decode_op(trace_entry_t *out, size_t &count)
+    {
+        const unsigned char *&pos = ops_pos_;
+        const unsigned char *end = ops_end_;
+        unsigned char tag = *pos++;
+        int64_t delta;
+        uint64_t index, type, size, value;
+        if ((tag & INSTR_TABLE_OP_SHORT_INSTR) != 0 || tag == INSTR_TABLE_OP_INSTR) {
+            if ((tag & INSTR_TABLE_OP_SHORT_INSTR) != 0) {
+                delta = static_cast<int64_t>(tag & ~INSTR_TABLE_OP_SHORT_INSTR) -
+                    INSTR_TABLE_SHORT_DELTA_BIAS;
+            } else if (!read_svarint(pos, end, delta))
+                return false;
+            if (!find_index(delta, index))
+                return false;
+            const entry_t &entry = entries_[index];
+            trace_entry_t &instr = out[count++];
+            instr.type = entry.type;
+            instr.size = entry.size;
+            instr.addr = entry.pc;
+            next_index_ = index + 1;
+            cur_index_ = static_cast<int64_t>(index);
+            cur_ordinal_ = 0;
+            return true;
+        }
+        switch (tag) {
+        case INSTR_TABLE_OP_ENCODING: {
+            if (!read_svarint(pos, end, delta) || !find_index(delta, index))
+                return false;
+            const std::string &encoding = entries_[index].encoding;
+            if (encoding.empty() || encoding.size() > MAX_ENCODING_LENGTH)
+                return false;
+            for (size_t offs = 0; offs < encoding.size(); offs += sizeof(addr_t)) {
+                trace_entry_t &enc = out[count++];
+                enc.type = TRACE_TYPE_ENCODING;
+                enc.size = static_cast<unsigned short>(
+                    std::min(encoding.size() - offs, sizeof(enc.encoding)));
+                memset(enc.encoding, 0, sizeof(enc.encoding));
+                memcpy(enc.encoding, encoding.data() + offs, enc.size);
+            }
+            return true;
+        }
+        case INSTR_TABLE_OP_MARKER: {
+            if (!read_varint(pos, end, size) || !read_varint(pos, end, value) ||
+                size > USHRT_MAX)
+                return false;
+            trace_entry_t &marker = out[count++];
+            marker.type = TRACE_TYPE_MARKER;
+            marker.size = static_cast<unsigned short>(size);
+            marker.addr = static_cast<addr_t>(value);
+            return true;
+        }
+        case INSTR_TABLE_OP_RECORD:
+        case INSTR_TABLE_OP_DATA: {
+            trace_entry_t &record = out[count];
+            std::vector<data_slot_t> *slots;
+            if (tag == INSTR_TABLE_OP_RECORD) {
+                if (!read_varint(pos, end, type) || !read_varint(pos, end, size) ||
+                    type > USHRT_MAX || size > USHRT_MAX)
+                    return false;
+                record.type = static_cast<unsigned short>(type);
+                record.size = static_cast<unsigned short>(size);
+                slots = find_data_slots(record.type);
+            } else {
+                if (cur_index_ < 0 ||
+                    static_cast<size_t>(cur_index_) >= data_slots_.size() ||
+                    cur_ordinal_ >= data_slots_[cur_index_].size())
+                    return false;
+                slots = &data_slots_[cur_index_];
+                record.type = (*slots)[cur_ordinal_].type;
+                record.size = (*slots)[cur_ordinal_].size;
+            }
+            if (!read_svarint(addrs_pos_, addrs_end_, delta))
+                return false;
+            record.addr = predict_addr(slots) + static_cast<addr_t>(delta);
+            remember_record(slots, record);
+            ++count;
+            return true;
+        }
+        default: return false;
+        }
+    }
+
+    std::vector<unsigned char> in_;
+    size_t in_pos_ = 0;
+    size_t in_end_ = 0;
+    bool in_done_ = false;
+    // Cursors into the columns of the current block, which lies within in_.
+    const unsigned char *ops_pos_ = nullptr;
+    const unsigned char *ops_end_ = nullptr;
+    const unsigned char *addrs_pos_ = nullptr;
+    const unsigned char *addrs_end_ = nullptr;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _INSTR_TABLE_H_ */
@@ -0,0 +1,193 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+// instr_table_ostream_t: an instance of archive_ostream_t which converts the
+// trace_entry_t records written to it into the instr_table format (see
+// instr_table.h) before passing them to another archive_ostream_t.
+
+#ifndef _INSTR_TABLE_OSTREAM_H_
+#define _INSTR_TABLE_OSTREAM_H_ 1
+
+#include <iostream>
+#include <string>
+#include "archive_ostream.h"
+#include "instr_table.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// The stream buffer encodes each complete trace_entry_t once it is flushed,
+// carrying any partial record over to the next flush.
+class instr_table_streambuf_t
+    : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    explicit instr_table_streambuf_t(archive_ostream_t *out)
+        : out_(out)
+    {
+        // We leave an extra slot for extra_char on overflow.
+        setp(buf_, buf_ + buffer_size_ - 1);
+    }
+    ~instr_table_streambuf_t() override
+    {
+        sync();
+        encoder_.start_component(encoded_);
+        if (!write_encoded() || partial_size_ != 0 ||
+            !out_->open_new_component(INSTR_TABLE_COMPONENT_NAME).empty()) {
+            failed_ = true;
+        } else {
+            encoder_.write_table(encoded_);
+            write_encoded();
+        }
+        if (failed_) {
+#ifdef DEBUG
+            // Let's at least have something visible in debug build.
+            std::cerr << "instr_table_ostream failed to write instruction table\n";
+#endif
+        }
+    }
+    int
+    overflow(int extra_char) override
+    {
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int res = traits_type::not_eof(extra_char);
+        const char *pos = pbase();
+        const char *end = pptr();
+        if (pos < end && !in_component_)
+            res = traits_type::eof();
+        else {
+            if (partial_size_ > 0) {
+                size_t copy = std::min(sizeof(partial_) - partial_size_,
+                                       static_cast<size_t>(end - pos));
+                memcpy(reinterpret_cast<char *>(&partial_) + partial_size_, pos, copy);
+                partial_size_ += copy;
+                pos += copy;
+                if (partial_size_ == sizeof(partial_)) {
+                    encoder_.add(partial_, encoded_);
+                    partial_size_ = 0;
+                }
+            }
+            for (; end - pos >= static_cast<ptrdiff_t>(sizeof(trace_entry_t));
+                 pos += sizeof(trace_entry_t)) {
+                trace_entry_t entry;
+                memcpy(&entry, pos, sizeof(entry));
+                encoder_.add(entry, encoded_);
+            }
+            if (pos < end) {
+                partial_size_ = end - pos;
+                memcpy(&partial_, pos, partial_size_);
+            }
+            if (!write_encoded())
+                res = traits_type::eof();
+        }
+        setp(buf_, buf_ + buffer_size_ - 1);
+        return res;
+    }
+    int
+    sync() override
+    {
+        return overflow(traits_type::eof());
+    }
+    std::string
+    open_new_component(const std::string &name)
+    {
+        sync();
+        if (partial_size_ != 0)
+            return "Partial record at end of component";
+        encoder_.start_component(encoded_);
+        if (!write_encoded())
+            return "Failed to write prior component";
+        in_component_ = true;
+        return out_->open_new_component(name);
+    }
+
+private:
+    bool
+    write_encoded()
+    {
+        if (!encoded_.empty()) {
+            out_->write(encoded_.data(), encoded_.size());
+            encoded_.clear();
+        }
+        if (!*out_)
+            failed_ = true;
+        return !failed_;
+    }
+
+    static const int buffer_size_ = 4096 * sizeof(trace_entry_t);
+    archive_ostream_t *out_;
+    char buf_[buffer_size_];
+    instr_table_encoder_t encoder_;
+    std::string encoded_;
+    trace_entry_t partial_;
+    size_t partial_size_ = 0;
+    bool in_component_ = false;
+    bool failed_ = false;
+};
+
+// open_new_component() should be called to create an initial component before
+// doing any writing.  Takes ownership of "out", which must not yet have had
+// any component opened.
+class instr_table_ostream_t : public archive_ostream_t {
+public:
+    explicit instr_table_ostream_t(archive_ostream_t *out)
+        : archive_ostream_t(new instr_table_streambuf_t(out))
+        , out_(out)
+    {
+        if (!rdbuf() || !*out_)
+            setstate(std::ios::badbit);
+    }
+    ~instr_table_ostream_t() override
+    {
+        // The table is written to out_ when the stream buffer is destroyed.
+        delete rdbuf();
+        delete out_;
+    }
+    std::string
+    open_new_component(const std::string &name) override
+    {
+        instr_table_streambuf_t *tbuf =
+            reinterpret_cast<instr_table_streambuf_t *>(rdbuf());
+        return tbuf->open_new_component(name);
+    }
+
+private:
+    archive_ostream_t *out_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _INSTR_TABLE_OSTREAM_H_ */
@@ -58,6 +58,49 @@
 namespace dynamorio {  /**< General DynamoRIO namespace. */
 namespace drmemtrace { /**< DrMemtrace tracing + simulation infrastructure namespace. */
 
+/**
+ * Statistics on the behavior of a dynamic scheduler for one output stream, as
+ * returned by memtrace_stream_t::get_schedule_statistic().  The values are
+ * cumulative over the lifetime of the output stream and must be summed across
+ * all output streams to obtain totals.
+ */
+enum schedule_statistic_t {
+    /**
+     * Count of inputs selected to run on this output whose prior execution was on
+     * a different output.
+     */
+    SCHED_STAT_MIGRATIONS,
+    /** Count of inputs this output took from another output's ready queue. */
+    SCHED_STAT_RUNQUEUE_STEALS,
+    /** Count of passes this output made to even out the lengths of all ready queues. */
+    SCHED_STAT_RUNQUEUE_REBALANCES,
+    /** Count of acquisitions by this output of the global scheduling lock. */
+    SCHED_STAT_SCHED_LOCK_ACQUISITIONS,
+    /** Total time in nanoseconds this output held the global scheduling lock. */
+    SCHED_STAT_SCHED_LOCK_HOLD_NANOS,
+    /** Count of acquisitions by this output of per-output ready queue locks. */
+    SCHED_STAT_RUNQUEUE_LOCK_ACQUISITIONS,
+    /** Total time in nanoseconds this output held per-output ready queue locks. */
+    SCHED_STAT_RUNQUEUE_LOCK_HOLD_NANOS,
+    /**
+     * Count of blocks of records that had already been decoded by a read-ahead
+     * thread when needed by this output.
+     */
+    SCHED_STAT_READ_AHEAD_HITS,
+    /**
+     * Count of blocks of records that had not yet been started by a read-ahead thread
+     * when needed by this output, and so were decoded by this output itself.
+     */
+    SCHED_STAT_READ_AHEAD_MISSES,
+    /**
+     * Count of times this output waited for a read-ahead thread to finish decoding
+     * the block of records it needed.
+     */
+    SCHED_STAT_READ_AHEAD_WAITS,
+    /** Count of statistic types. */
+    SCHED_STAT_TYPE_COUNT,
+};
+
 /**
  * This is an interface for obtaining information from analysis tools
  * on the full stream of memory reference records.
@@ -240,6 +283,17 @@ public:
     {
         return false;
     }
+
+    /**
+     * Returns the value of the specified statistic for this output stream.
+     * The values for all output streams must be summed to obtain global counts.
+     * Returns -1 if statistics are not supported for this stream.
+     */
+    virtual double
+    get_schedule_statistic(schedule_statistic_t stat) const
+    {
+        return -1;
+    }
 };
 
 /**
@@ -69,6 +69,29 @@ droption_t<std::string> op_ipc_name(
     "for each instance of the simulator being run at any one time.  On Windows, the name "
     "is limited to 247 characters.");
 
+droption_t<bool> op_ipc_shm(
+    DROPTION_SCOPE_ALL, "ipc_shm", false, "Use shared memory for online traces",
+    "For online tracing and simulation on Linux, transfers trace data through ring "
+    "buffers in a shared memory file named by -ipc_name (under /dev/shm unless it is "
+    "an absolute path) instead of through a named pipe.  Each application thread "
+    "writes whole trace buffers into its ring and the simulator reads them in place, "
+    "avoiding the small atomic writes and kernel copies of a pipe.  See "
+    "-ipc_shm_rings and -ipc_shm_ring_size.");
+
+droption_t<unsigned int> op_ipc_shm_rings(
+    DROPTION_SCOPE_FRONTEND, "ipc_shm_rings", 64, "Number of -ipc_shm ring buffers",
+    "The number of ring buffers used with -ipc_shm.  Application threads are assigned "
+    "rings round-robin as they start, across all traced processes; threads beyond this "
+    "count share rings with others, which serializes their writes.");
+
+droption_t<bytesize_t> op_ipc_shm_ring_size(
+    DROPTION_SCOPE_FRONTEND, "ipc_shm_ring_size", 2 * 1024 * 1024,
+    "Size of each -ipc_shm ring buffer",
+    "The capacity of each ring buffer used with -ipc_shm.  An application thread "
+    "blocks when its ring is full until the simulator catches up.  The memory is only "
+    "committed as the rings are used.  This must be at least twice the tracer's "
+    "per-thread buffer size.");
+
 droption_t<std::string> op_outdir(
     DROPTION_SCOPE_ALL, "outdir", ".", "Target directory for offline trace files",
     "For the offline analysis mode (when -offline is requested), specifies the path "
@@ -104,9 +127,8 @@ droption_t<int> op_jobs(
     "By default, both post-processing of offline raw trace files and analysis of trace "
     "files is parallelized.  This option controls the number of concurrent jobs.  0 "
     "disables concurrency and uses a single thread to perform all operations.  A "
-    "negative value sets the job count to the number of hardware threads, "
-    "with a cap of 16.  This is ignored for -core_sharded where -cores sets the "
-    "parallelism.");
+    "negative value sets the job count to the number of hardware threads.  This is "
+    "ignored for -core_sharded where -cores sets the parallelism.");
 
 droption_t<std::string> op_module_file(
     DROPTION_SCOPE_ALL, "module_file", "", "Path to modules.log for opcode_mix tool",
@@ -286,6 +308,18 @@ droption_t<unsigned int> op_virt2phys_freq(
     "The units are the number of memory accesses per forced access.  A value of 0 "
     "uses the cached values for the entire application execution.");
 
+droption_t<unsigned int> op_virt2phys_cache_size(
+    DROPTION_SCOPE_CLIENT, "virt2phys_cache_size", 4096,
+    "Entries in each thread's physical mapping cache",
+    "This option only applies if -use_physical is enabled.  Each thread keeps a "
+    "direct-mapped cache of this many virtual to physical page translations (rounded up "
+    "to a power of 2) in front of its table of all translations seen.  A lookup that "
+    "reaches the kernel reads the translations for the surrounding 16 pages with one "
+    "system call and adds them to this cache, while accesses show enough locality for "
+    "that to pay off.  Runs of 512 pages (2MB for 4K pages) found to be physically "
+    "contiguous, such as huge pages, are cached as a single entry in a separate cache "
+    "with 1/8 as many entries.");
+
 droption_t<bool> op_cpu_scheduling(
     DROPTION_SCOPE_CLIENT, "cpu_scheduling", false,
     "Map threads to cores matching recorded cpu execution",
@@ -373,6 +407,23 @@ droption_t<bytesize_t> op_exit_after_tracing(
     "exited with an exit code of 0.  The reference count is approximate. "
     "Use -max_global_trace_refs instead to avoid terminating the process.");
 
+droption_t<bool> op_buffer_guard(
+    DROPTION_SCOPE_CLIENT, "buffer_guard", false,
+    "Detect full trace buffers with a guard page",
+    "By default, each traced block ends with an inline load and branch that checks "
+    "whether the thread's trace buffer has reached its redzone, calling out to write "
+    "the buffer if so.  This option instead places an inaccessible guard region after "
+    "the redzone and ends each block with a single load that faults into the guard "
+    "region only once the buffer is full, followed by a jump over the call that writes "
+    "the buffer out; the fault handler resumes at that call.  This removes the "
+    "conditional branch from every block and the re-zeroing of each written-out "
+    "buffer, at the cost of a fault for each full buffer.  With the current fixed "
+    "buffer size (see i#1703) the faults cost more than the branches they remove, so "
+    "today this option is a pessimization; it is only expected to pay off with much "
+    "larger buffers.  It is currently only supported on x86, and is ignored with "
+    "-trace_for_instrs, -retrace_every_instrs, -L0_filter_until_instrs, or a buffer "
+    "handoff callback.");
+
 droption_t<std::string> op_raw_compress(
     DROPTION_SCOPE_CLIENT, "raw_compress",
 #if defined(HAS_LZ4) && !defined(DRMEMTRACE_STATIC)
@@ -385,21 +436,56 @@ droption_t<std::string> op_raw_compress(
     // All other choices are slowdowns for an SSD so we turn them off by default.
     "none",
 #endif
-    "Raw compression: \"snappy\",\"snappy_nocrc\",\"gzip\",\"zlib\",\"lz4\",\"none\"",
+    "Raw compression: \"snappy\",\"snappy_nocrc\",\"gzip\",\"zlib\",\"lz4\",\"zstd\","
+    "\"none\"",
     "Specifies the compression type to use for raw offline files: \"snappy\", "
     "\"snappy_nocrc\" (snappy without checksums, which is much faster), \"gzip\", "
-    "\"zlib\", \"lz4\", or \"none\".  Whether this reduces overhead depends on the "
-    "storage type: "
+    "\"zlib\", \"lz4\", \"zstd\", or \"none\".  Whether this reduces overhead "
+    "depends on the storage type: "
     "for an SSD, zlib and gzip typically add overhead and would only be used if space is "
-    "at a premium; snappy_nocrc and lz4 are nearly always performance wins.");
+    "at a premium; snappy_nocrc and lz4 are nearly always performance wins.  zstd (at "
+    "its fastest level) compresses much better than lz4 for a modest extra cost, which "
+    "suits slower or shared storage.");
+
+droption_t<unsigned int> op_raw_async_writers(
+    DROPTION_SCOPE_CLIENT, "raw_async_writers", 0,
+    "Number of background threads compressing and writing raw files",
+    "By default, each full trace buffer is compressed (see -raw_compress) and written "
+    "to its raw offline file by the application thread that filled it.  When this is "
+    "non-zero, full buffers are instead copied into a bounded queue and compressed and "
+    "written by this many background threads, removing that latency from the "
+    "application.  Each traced thread's buffers are always handled by the same "
+    "background thread so they remain in order.  This only applies to -offline without "
+    "a custom buffer handoff callback.  The queue length is set by "
+    "-raw_async_queue_size.");
+
+droption_t<unsigned int> op_raw_async_queue_size(
+    DROPTION_SCOPE_CLIENT, "raw_async_queue_size", 16,
+    "Buffers each -raw_async_writers thread may have pending",
+    "The number of full trace buffers (rounded up to a power of 2, with a minimum of 2) "
+    "that may wait for each -raw_async_writers background thread.  Each takes as much "
+    "memory as one trace buffer.  When an application thread finds its queue full, it "
+    "applies back-pressure by writing out queued buffers itself until there is space, "
+    "and the time spent doing so is reported as stall time at exit with -verbose 1.");
 
 droption_t<std::string> op_trace_compress(
     DROPTION_SCOPE_FRONTEND, "compress", DEFAULT_TRACE_COMPRESSION_TYPE,
-    "Trace compression: \"zip\",\"gzip\",\"zlib\",\"lz4\",\"none\"",
-    "Specifies the compression type to use for trace files: \"zip\", "
-    "\"gzip\", \"zlib\", \"lz4\", or \"none\". "
+    "Trace compression: \"zip\",\"zstd\",\"zstd_itable\",\"gzip\",\"zlib\",\"lz4\","
+    "\"none\"",
+    "Specifies the compression type to use for trace files: \"zip\", \"zstd\", "
+    "\"zstd_itable\", \"gzip\", \"zlib\", \"lz4\", or \"none\". "
     "In most cases where fast skipping by instruction count is not needed "
     "lz4 compression generally improves performance and is recommended. "
+    "Like zip, zstd stores each chunk (see -chunk_instr_count) separately and so "
+    "supports fast skipping, while compressing better than zip and decompressing "
+    "several times faster. "
+    "\"zstd_itable\" is zstd with each distinct instruction (its address, length, "
+    "type, and encoding) stored once in a table in the archive, with each "
+    "instruction fetch in the trace written as a small delta-encoded index into "
+    "that table, and with each data address written in a separate column as the "
+    "difference from the prior execution of the same instruction.  This usually "
+    "produces much smaller traces than plain zstd and is transparent to trace "
+    "readers. "
     "When it comes to storage types, the impact on overhead varies: "
     "for SSDs, zip and gzip often increase overhead and should only be chosen "
     "if space is limited.");
@@ -615,6 +701,27 @@ droption_t<bytesize_t>
                 "The simulated references come after the skipped and warmup references, "
                 "and the references following the simulated ones are dropped.");
 
+droption_t<bool> op_sim_parallel(
+    DROPTION_SCOPE_FRONTEND, "sim_parallel", false,
+    "Simulate each core's caches on its own thread",
+    "By default the cache simulator processes every record on a single thread.  "
+    "When this option is enabled along with -core_sharded, each core's records are "
+    "instead simulated on the analysis worker thread for that core.  Hits in the "
+    "private first-level caches proceed in parallel while all other cache operations "
+    "are serialized, so results can vary slightly from run to run according to how "
+    "the threads interleave; see -sim_lockstep for reproducible results.  When "
+    "coherence is modeled or an inclusive cache is present every operation is "
+    "serialized.  This option is not supported with -skip_refs, -warmup_refs, "
+    "-warmup_fraction, -sim_refs, -cpu_scheduling, or -use_physical.");
+
+droption_t<bool> op_sim_lockstep(
+    DROPTION_SCOPE_FRONTEND, "sim_lockstep", false,
+    "Order -sim_parallel accesses deterministically",
+    "Only applies when -sim_parallel is enabled.  The simulator threads take turns in "
+    "a fixed order determined by how many records each core has processed, so that "
+    "the results match every time for the same per-core record sequences.  This "
+    "requires the simulated core count to match the -cores analysis worker count.");
+
 droption_t<std::string>
     op_view_syntax(DROPTION_SCOPE_FRONTEND, "view_syntax", "att/arm/dr/riscv",
                    "Syntax to use for disassembly.",
@@ -627,10 +734,22 @@ droption_t<std::string>
                    "\"att\" for x86, \"arm\" for ARM (32-bit), \"dr\" for AArch64, "
                    "and \"riscv\" for RISC-V.");
 
-droption_t<std::string>
-    op_config_file(DROPTION_SCOPE_FRONTEND, "config_file", "",
-                   "Cache hierarchy configuration file",
-                   "The full path to the cache hierarchy configuration file.");
+droption_t<std::string> op_config_file(
+    DROPTION_SCOPE_FRONTEND, "config_file", DROPTION_FLAG_ACCUMULATE,
+    OP_CONFIG_FILE_SEP, "", "Cache hierarchy configuration file",
+    "The full path to the cache hierarchy configuration file.  This option can be "
+    "repeated to simulate several hierarchies in a single pass through the trace, "
+    "in which case each hierarchy's results are printed in turn followed by a table "
+    "of the miss rates of each cache name across all of the hierarchies.  Repeated "
+    "configuration files may not enable sim_parallel.  See -config_threads.");
+
+droption_t<unsigned int> op_config_threads(
+    DROPTION_SCOPE_FRONTEND, "config_threads", 0,
+    "Worker threads for simulating multiple configurations",
+    "When -config_file is specified more than once, the hierarchies are divided among "
+    "up to this many worker threads, which are handed the trace in batches of records "
+    "while the analyzer reads ahead.  The default of 0 simulates every hierarchy on "
+    "the thread reading the trace.");
 
 // XXX: if we separate histogram + reuse_distance we should move this with them.
 droption_t<unsigned int>
@@ -669,6 +788,15 @@ droption_t<bool> op_reuse_verify_skip(
     "Verifies every skip list-calculated reuse distance with a full list walk. "
     "This incurs significant additional overhead.  This option is only available "
     "in debug builds.");
+droption_t<bool> op_reuse_fenwick_tree(
+    DROPTION_SCOPE_FRONTEND, "reuse_fenwick_tree", false,
+    "Compute reuse distances with a Fenwick tree instead of a skip list.",
+    "Computes each reuse distance with a Fenwick tree over access times, which takes "
+    "time logarithmic in the number of distinct cache lines, rather than with the "
+    "skip list, whose cost grows linearly with the distance (see -reuse_skip_dist).  "
+    "This is faster for traces with a large footprint and many far reuses, at the "
+    "cost of extra memory per cache line.  The results are identical.  "
+    "-reuse_verify_skip verifies the tree results as well.");
 droption_t<double> op_reuse_histogram_bin_multiplier(
     DROPTION_SCOPE_FRONTEND, "reuse_histogram_bin_multiplier", 1.00,
     "When reporting histograms, grow bins geometrically by this multiplier.",
@@ -680,6 +808,35 @@ droption_t<double> op_reuse_histogram_bin_multiplier(
     "bins.  Note that this option only affects the printing of histograms via "
     "the -reuse_distance_histogram option; the raw histogram data is always "
     "collected at full precision.");
+droption_t<bool> op_reuse_miss_ratio_curve(
+    DROPTION_SCOPE_FRONTEND, "reuse_miss_ratio_curve", false,
+    "Report the miss ratio curve derived from the reuse distances.",
+    "Reports the miss ratio of a fully associative LRU cache of each power-of-two "
+    "size, in cache lines of -line_size bytes, up to the largest reuse distance seen. "
+    "These all come from the single reuse distance histogram, so this replaces a "
+    "sweep of separate cache simulations when associativity effects are not of "
+    "interest.  This is always reported when sampling via -reuse_sample_rate or "
+    "-reuse_sample_max_lines.");
+droption_t<double> op_reuse_sample_rate(
+    DROPTION_SCOPE_FRONTEND, "reuse_sample_rate", 1.0,
+    "Track only this fraction of cache lines, chosen by address hash.",
+    "If below 1.0, the reuse_distance tool tracks only the cache lines whose address "
+    "hash falls in this fraction of the hash space, and scales the distances it "
+    "measures among them by the inverse of the rate to estimate the full "
+    "distances.  Time and memory shrink roughly in proportion, and rates of 0.01 or "
+    "even 0.001 give accurate miss ratio curves on traces with large footprints.  "
+    "The reported distance statistics and histogram become estimates, and the "
+    "miss ratios of caches smaller than several times the inverse of the rate, in "
+    "lines, are not meaningful.");
+droption_t<unsigned int> op_reuse_sample_max_lines(
+    DROPTION_SCOPE_FRONTEND, "reuse_sample_max_lines", 0,
+    "If nonzero, bounds the number of cache lines tracked when sampling.",
+    "If nonzero, the reuse_distance tool samples cache lines as for "
+    "-reuse_sample_rate, starting at that rate, but lowers the rate whenever more "
+    "than this many lines would be tracked in one shard, which bounds memory "
+    "regardless of the trace footprint.  Counts gathered at a higher rate are "
+    "rescaled when the rate drops.  This uses the data structure of "
+    "-reuse_fenwick_tree.");
 
 #define OP_RECORD_FUNC_ITEM_SEP "&"
 // XXX i#3048: replace function return address with function callstack
@@ -948,6 +1105,38 @@ droption_t<bool> op_sched_disable_direct_switches(
     "switch being determined by latency and the next input in the queue.  The "
     "TRACE_MARKER_TYPE_DIRECT_THREAD_SWITCH markers are not removed from the trace.");
 
+droption_t<bool> op_sched_per_output_queues(
+    DROPTION_SCOPE_FRONTEND, "sched_per_output_queues", false,
+    "Use a separate ready queue per core",
+    "Applies to -core_sharded and -core_serial.  Replaces the single global ready "
+    "queue with one queue per core, each with its own lock.  A core whose queue has "
+    "nothing runnable steals from the other cores' queues, and the queue lengths are "
+    "evened out every -sched_rebalance_period_us.  This reduces lock contention "
+    "among many simulated cores at the cost of less precise global priority and "
+    "timestamp ordering.");
+
+droption_t<uint64_t> op_sched_rebalance_period_us(
+    DROPTION_SCOPE_ALL, "sched_rebalance_period_us", 50000,
+    "Period for rebalancing per-core ready queues",
+    "Applies to -sched_per_output_queues.  The period in simulated microseconds "
+    "(see -sched_time) at which the per-core ready queues are rebalanced.  "
+    "A value of 0 disables rebalancing, leaving only work stealing.");
+
+droption_t<int> op_sched_read_ahead_threads(
+    DROPTION_SCOPE_FRONTEND, "sched_read_ahead_threads", 0,
+    "Threads decompressing trace records ahead of the cores",
+    "Applies to -core_sharded and -core_serial.  If non-zero, this many background "
+    "threads decompress records of gzip and zip inputs ahead of their use, favoring "
+    "inputs waiting to run next over inputs currently running.  This hides "
+    "decompression time when there are spare hardware threads.  The resulting "
+    "hit, miss, and wait counts are included in the schedule statistics.");
+
+droption_t<int> op_sched_read_ahead_blocks(
+    DROPTION_SCOPE_FRONTEND, "sched_read_ahead_blocks", 4,
+    "Blocks of records decompressed ahead per input",
+    "Applies to -sched_read_ahead_threads.  The maximum number of blocks of several "
+    "thousand records each to decompress ahead of each input.");
+
 // Schedule_stats options.
 droption_t<uint64_t>
     op_schedule_stats_print_every(DROPTION_SCOPE_ALL, "schedule_stats_print_every",
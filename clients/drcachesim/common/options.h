@@ -90,6 +90,10 @@ namespace drmemtrace {
 
 extern dynamorio::droption::droption_t<bool> op_offline;
 extern dynamorio::droption::droption_t<std::string> op_ipc_name;
+extern dynamorio::droption::droption_t<bool> op_ipc_shm;
+extern dynamorio::droption::droption_t<unsigned int> op_ipc_shm_rings;
+extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
+    op_ipc_shm_ring_size;
 extern dynamorio::droption::droption_t<std::string> op_outdir;
 extern dynamorio::droption::droption_t<std::string> op_subdir_prefix;
 extern dynamorio::droption::droption_t<std::string> op_infile;
@@ -120,6 +124,7 @@ extern dynamorio::droption::droption_t<bool> op_instr_only_trace;
 extern dynamorio::droption::droption_t<bool> op_coherence;
 extern dynamorio::droption::droption_t<bool> op_use_physical;
 extern dynamorio::droption::droption_t<unsigned int> op_virt2phys_freq;
+extern dynamorio::droption::droption_t<unsigned int> op_virt2phys_cache_size;
 extern dynamorio::droption::droption_t<bool> op_cpu_scheduling;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_max_trace_size;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
@@ -134,7 +139,10 @@ extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
 extern dynamorio::droption::droption_t<bool> op_split_windows;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_exit_after_tracing;
+extern dynamorio::droption::droption_t<bool> op_buffer_guard;
 extern dynamorio::droption::droption_t<std::string> op_raw_compress;
+extern dynamorio::droption::droption_t<unsigned int> op_raw_async_writers;
+extern dynamorio::droption::droption_t<unsigned int> op_raw_async_queue_size;
 extern dynamorio::droption::droption_t<std::string> op_trace_compress;
 extern dynamorio::droption::droption_t<bool> op_online_instr_types;
 extern dynamorio::droption::droption_t<std::string> op_replace_policy;
@@ -171,14 +179,22 @@ extern dynamorio::droption::droption_t<uint64_t> op_skip_to_timestamp;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_warmup_refs;
 extern dynamorio::droption::droption_t<double> op_warmup_fraction;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_sim_refs;
+extern dynamorio::droption::droption_t<bool> op_sim_parallel;
+extern dynamorio::droption::droption_t<bool> op_sim_lockstep;
+#define OP_CONFIG_FILE_SEP "|"
 extern dynamorio::droption::droption_t<std::string> op_config_file;
+extern dynamorio::droption::droption_t<unsigned int> op_config_threads;
 extern dynamorio::droption::droption_t<unsigned int> op_report_top;
 extern dynamorio::droption::droption_t<unsigned int> op_reuse_distance_threshold;
 extern dynamorio::droption::droption_t<bool> op_reuse_distance_histogram;
 extern dynamorio::droption::droption_t<unsigned int> op_reuse_skip_dist;
 extern dynamorio::droption::droption_t<unsigned int> op_reuse_distance_limit;
 extern dynamorio::droption::droption_t<bool> op_reuse_verify_skip;
+extern dynamorio::droption::droption_t<bool> op_reuse_fenwick_tree;
 extern dynamorio::droption::droption_t<double> op_reuse_histogram_bin_multiplier;
+extern dynamorio::droption::droption_t<bool> op_reuse_miss_ratio_curve;
+extern dynamorio::droption::droption_t<double> op_reuse_sample_rate;
+extern dynamorio::droption::droption_t<unsigned int> op_reuse_sample_max_lines;
 extern dynamorio::droption::droption_t<std::string> op_view_syntax;
 extern dynamorio::droption::droption_t<std::string> op_record_function;
 extern dynamorio::droption::droption_t<bool> op_record_heap;
@@ -210,6 +226,10 @@ extern dynamorio::droption::droption_t<std::string> op_cpu_schedule_file;
 extern dynamorio::droption::droption_t<std::string> op_sched_switch_file;
 extern dynamorio::droption::droption_t<bool> op_sched_randomize;
 extern dynamorio::droption::droption_t<bool> op_sched_disable_direct_switches;
+extern dynamorio::droption::droption_t<bool> op_sched_per_output_queues;
+extern dynamorio::droption::droption_t<uint64_t> op_sched_rebalance_period_us;
+extern dynamorio::droption::droption_t<int> op_sched_read_ahead_threads;
+extern dynamorio::droption::droption_t<int> op_sched_read_ahead_blocks;
 extern dynamorio::droption::droption_t<uint64_t> op_schedule_stats_print_every;
 extern dynamorio::droption::droption_t<std::string> op_syscall_template_file;
 extern dynamorio::droption::droption_t<uint64_t> op_filter_stop_timestamp;
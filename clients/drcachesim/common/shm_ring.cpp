@@ -0,0 +1,505 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <string>
+
+#include "shm_ring.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+constexpr uint64_t SHM_MAGIC = 0x676e697272646d64ULL; // "dmdrring"
+constexpr uint32_t SHM_VERSION = 1;
+constexpr size_t CACHE_LINE = 64;
+constexpr size_t CHUNK_ALIGN = 8;
+constexpr uint32_t CHUNK_FLAG_PAD = 1;
+// How long either side sleeps before checking whether the other side died.
+constexpr long POLL_NS = 100 * 1000 * 1000;
+
+struct chunk_header_t {
+    uint32_t size;
+    uint32_t flags;
+};
+static_assert(sizeof(chunk_header_t) == CHUNK_ALIGN, "chunk header must be aligned");
+
+size_t
+align_forward(size_t x, size_t alignment)
+{
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+// Returns false if the wait timed out.
+bool
+futex_wait(std::atomic<uint32_t> *addr, uint32_t val, long timeout_ns)
+{
+    struct timespec timeout = { 0, timeout_ns };
+    long res = syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT, val,
+                       timeout_ns > 0 ? &timeout : nullptr, nullptr, 0);
+    return res == 0 || errno != ETIMEDOUT;
+}
+
+bool
+process_exists(int pid)
+{
+    // EPERM means it exists but belongs to another user.
+    if (kill(pid, 0) != 0 && errno == ESRCH)
+        return false;
+    // Traced applications are often our own children (e.g., from drrun), which
+    // linger as zombies until we reap them after the trace ends.
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return true;
+    char buf[256];
+    ssize_t len = ::read(fd, buf, sizeof(buf) - 1);
+    ::close(fd);
+    if (len <= 0)
+        return true;
+    buf[len] = '\0';
+    // The state follows the parenthesized command name, which may itself
+    // contain parentheses.
+    const char *state = strrchr(buf, ')');
+    return state == nullptr || state[1] == '\0' || state[2] != 'Z';
+}
+
+void
+futex_wake(std::atomic<uint32_t> *addr, int count)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE, count, nullptr,
+            nullptr, 0);
+}
+
+} // namespace
+
+struct shm_ring_t::file_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t num_rings;
+    uint64_t ring_size;
+    uint64_t data_offset;
+    int32_t reader_pid;
+    std::atomic<uint32_t> next_ring;
+    // Futex words for the reader: set once any writer attaches, and bumped
+    // on each new chunk or detach.
+    std::atomic<uint32_t> attached;
+    std::atomic<uint32_t> data_seq;
+    std::atomic<uint32_t> reader_waiting;
+    std::atomic<int32_t> pids[MAX_PROCESSES];
+};
+
+// The writer and reader fields are on separate cache lines.
+struct shm_ring_t::ring_header_t {
+    alignas(CACHE_LINE) std::atomic<uint64_t> head;
+    // 0 is unlocked, 1 is locked, and 2 is locked with waiters.
+    std::atomic<uint32_t> lock;
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> space_seq;
+    std::atomic<uint32_t> writer_waiting;
+};
+
+static const char *
+shm_dir()
+{
+    return "/dev/shm";
+}
+
+shm_ring_t::shm_ring_t()
+{
+    // Empty.
+}
+
+shm_ring_t::shm_ring_t(const char *name)
+{
+    set_name(name);
+}
+
+shm_ring_t::~shm_ring_t()
+{
+    if (map_base_ != nullptr && is_creator_)
+        munmap(map_base_, map_size_);
+}
+
+bool
+shm_ring_t::set_name(const char *name)
+{
+    if (map_base_ != nullptr)
+        return false;
+    name_ = name;
+    if (name[0] == '/')
+        path_ = name;
+    else
+        path_ = std::string(shm_dir()) + "/" + name;
+    return true;
+}
+
+std::string
+shm_ring_t::get_name() const
+{
+    return name_;
+}
+
+const std::string &
+shm_ring_t::get_path() const
+{
+    return path_;
+}
+
+shm_ring_t::ring_header_t *
+shm_ring_t::get_ring(uint32_t index) const
+{
+    return reinterpret_cast<ring_header_t *>(
+               map_base_ + align_forward(sizeof(file_header_t), CACHE_LINE)) +
+        index;
+}
+
+char *
+shm_ring_t::get_ring_data(uint32_t index) const
+{
+    return map_base_ + header_->data_offset + index * header_->ring_size;
+}
+
+bool
+shm_ring_t::create(uint32_t num_rings, size_t ring_size)
+{
+    if (map_base_ != nullptr || num_rings == 0)
+        return false;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    ring_size = align_forward(ring_size, page_size);
+    size_t data_offset =
+        align_forward(align_forward(sizeof(file_header_t), CACHE_LINE) +
+                          num_rings * sizeof(ring_header_t),
+                      page_size);
+    size_t map_size = data_offset + num_rings * ring_size;
+    int fd = ::open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0)
+        return false;
+    // Writers may run as other users, as with named_pipe_t.
+    fchmod(fd, 0666);
+    if (ftruncate(fd, map_size) != 0) {
+        ::close(fd);
+        unlink(path_.c_str());
+        return false;
+    }
+    void *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        unlink(path_.c_str());
+        return false;
+    }
+    // The file starts out zeroed, which is the initial state for everything
+    // but the layout fields.
+    map_base_ = static_cast<char *>(map);
+    map_size_ = map_size;
+    is_creator_ = true;
+    header_ = reinterpret_cast<file_header_t *>(map_base_);
+    header_->num_rings = num_rings;
+    header_->ring_size = ring_size;
+    header_->data_offset = data_offset;
+    header_->version = SHM_VERSION;
+    header_->reader_pid = getpid();
+    header_->magic = SHM_MAGIC;
+    return true;
+}
+
+bool
+shm_ring_t::destroy()
+{
+    if (map_base_ != nullptr && is_creator_) {
+        munmap(map_base_, map_size_);
+        map_base_ = nullptr;
+        header_ = nullptr;
+    }
+    return unlink(path_.c_str()) == 0;
+}
+
+bool
+shm_ring_t::wait_for_writer()
+{
+    if (header_ == nullptr)
+        return false;
+    while (header_->attached.load() == 0)
+        futex_wait(&header_->attached, 0, 0);
+    return true;
+}
+
+bool
+shm_ring_t::rings_empty() const
+{
+    for (uint32_t i = 0; i < header_->num_rings; ++i) {
+        ring_header_t *ring = get_ring(i);
+        if (ring->tail.load(std::memory_order_relaxed) != ring->head.load())
+            return false;
+    }
+    return true;
+}
+
+bool
+shm_ring_t::any_writer_attached() const
+{
+    for (int i = 0; i < MAX_PROCESSES; ++i) {
+        if (header_->pids[i].load() != 0)
+            return true;
+    }
+    return false;
+}
+
+void
+shm_ring_t::reap_dead_writers()
+{
+    for (int i = 0; i < MAX_PROCESSES; ++i) {
+        int32_t pid = header_->pids[i].load();
+        if (pid != 0 && !process_exists(pid))
+            header_->pids[i].compare_exchange_strong(pid, 0);
+    }
+}
+
+const void *
+shm_ring_t::next_chunk(size_t *size DR_PARAM_OUT)
+{
+    if (header_ == nullptr)
+        return nullptr;
+    if (held_ring_ != nullptr)
+        release_chunk();
+    uint32_t num_rings = header_->num_rings;
+    while (true) {
+        // Visit the rings round-robin so one busy thread cannot starve the rest.
+        for (uint32_t i = 0; i < num_rings; ++i) {
+            uint32_t index = (next_ring_ + i) % num_rings;
+            ring_header_t *ring = get_ring(index);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            while (tail != ring->head.load(std::memory_order_acquire)) {
+                size_t offs = tail % header_->ring_size;
+                chunk_header_t *chunk =
+                    reinterpret_cast<chunk_header_t *>(get_ring_data(index) + offs);
+                if ((chunk->flags & CHUNK_FLAG_PAD) != 0) {
+                    tail += header_->ring_size - offs;
+                    ring->tail.store(tail);
+                    continue;
+                }
+                held_ring_ = ring;
+                held_size_ = sizeof(*chunk) + align_forward(chunk->size, CHUNK_ALIGN);
+                next_ring_ = (index + 1) % num_rings;
+                *size = chunk->size;
+                return chunk + 1;
+            }
+        }
+        // Everything is drained: sleep until a writer publishes or detaches.
+        // Writers only bump data_seq if they see reader_waiting after
+        // publishing, so we must re-scan after setting it.
+        header_->reader_waiting.store(1);
+        uint32_t seq = header_->data_seq.load();
+        if (rings_empty()) {
+            if (!any_writer_attached()) {
+                header_->reader_waiting.store(0);
+                // A detach comes after the process's final chunk.
+                if (rings_empty())
+                    return nullptr;
+                continue;
+            }
+            if (!futex_wait(&header_->data_seq, seq, POLL_NS))
+                reap_dead_writers();
+        }
+        header_->reader_waiting.store(0);
+    }
+}
+
+void
+shm_ring_t::release_chunk()
+{
+    if (held_ring_ == nullptr)
+        return;
+    ring_header_t *ring = held_ring_;
+    held_ring_ = nullptr;
+    ring->tail.store(ring->tail.load(std::memory_order_relaxed) + held_size_);
+    if (ring->writer_waiting.load() != 0) {
+        ring->space_seq.fetch_add(1);
+        futex_wake(&ring->space_seq, INT_MAX);
+    }
+}
+
+bool
+shm_ring_t::attach(void *map_base, size_t map_size, int pid)
+{
+    file_header_t *header = static_cast<file_header_t *>(map_base);
+    if (map_size < sizeof(*header) || header->magic != SHM_MAGIC ||
+        header->version != SHM_VERSION ||
+        header->data_offset + header->num_rings * header->ring_size > map_size)
+        return false;
+    map_base_ = static_cast<char *>(map_base);
+    map_size_ = map_size;
+    header_ = header;
+    return attach(pid);
+}
+
+bool
+shm_ring_t::attach(int pid)
+{
+    if (header_ == nullptr || pid_ == pid)
+        return header_ != nullptr;
+    for (int i = 0; i < MAX_PROCESSES; ++i) {
+        int32_t expect = 0;
+        if (header_->pids[i].compare_exchange_strong(expect, pid)) {
+            pid_ = pid;
+            if (header_->attached.exchange(1) == 0)
+                futex_wake(&header_->attached, INT_MAX);
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+shm_ring_t::detach()
+{
+    if (header_ == nullptr || pid_ == 0)
+        return;
+    for (int i = 0; i < MAX_PROCESSES; ++i) {
+        int32_t expect = pid_;
+        if (header_->pids[i].compare_exchange_strong(expect, 0))
+            break;
+    }
+    pid_ = 0;
+    header_->data_seq.fetch_add(1);
+    futex_wake(&header_->data_seq, 1);
+}
+
+uint32_t
+shm_ring_t::assign_ring()
+{
+    return header_->next_ring.fetch_add(1, std::memory_order_relaxed) %
+        header_->num_rings;
+}
+
+size_t
+shm_ring_t::get_max_chunk_size() const
+{
+    // Leave room for a padding chunk so a maximal chunk always fits once the
+    // ring drains.
+    return header_ == nullptr ? 0 : header_->ring_size / 2 - sizeof(chunk_header_t);
+}
+
+void
+shm_ring_t::lock_ring(ring_header_t *ring)
+{
+    // A standard three-state futex mutex.
+    uint32_t state = 0;
+    if (ring->lock.compare_exchange_strong(state, 1))
+        return;
+    if (state != 2)
+        state = ring->lock.exchange(2);
+    while (state != 0) {
+        futex_wait(&ring->lock, 2, 0);
+        state = ring->lock.exchange(2);
+    }
+}
+
+void
+shm_ring_t::unlock_ring(ring_header_t *ring)
+{
+    if (ring->lock.exchange(0) == 2)
+        futex_wake(&ring->lock, 1);
+}
+
+bool
+shm_ring_t::write(uint32_t index, const void *buf DR_PARAM_IN, size_t size)
+{
+    if (header_ == nullptr || size > get_max_chunk_size() || index >= header_->num_rings)
+        return false;
+    if (size == 0)
+        return true;
+    ring_header_t *ring = get_ring(index);
+    const uint64_t ring_size = header_->ring_size;
+    const uint64_t need = sizeof(chunk_header_t) + align_forward(size, CHUNK_ALIGN);
+    lock_ring(ring);
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t offs = head % ring_size;
+    // If the chunk would straddle the end, pad out the rest of the ring.
+    uint64_t pad = ring_size - offs < need ? ring_size - offs : 0;
+    while (head + pad + need - ring->tail.load() > ring_size) {
+        // As with the reader, we re-check after announcing that we are waiting.
+        ring->writer_waiting.store(1);
+        uint32_t seq = ring->space_seq.load();
+        if (head + pad + need - ring->tail.load() <= ring_size)
+            break;
+        if (!futex_wait(&ring->space_seq, seq, POLL_NS) &&
+            !process_exists(header_->reader_pid)) {
+            ring->writer_waiting.store(0);
+            unlock_ring(ring);
+            return false;
+        }
+    }
+    ring->writer_waiting.store(0);
+    char *data = get_ring_data(index);
+    if (pad > 0) {
+        chunk_header_t *chunk = reinterpret_cast<chunk_header_t *>(data + offs);
+        chunk->size = 0;
+        chunk->flags = CHUNK_FLAG_PAD;
+        head += pad;
+        offs = 0;
+    }
+    chunk_header_t *chunk = reinterpret_cast<chunk_header_t *>(data + offs);
+    chunk->size = static_cast<uint32_t>(size);
+    chunk->flags = 0;
+    memcpy(chunk + 1, buf, size);
+    // This store and the reader_waiting load must not be reordered, so we
+    // leave both sequentially consistent.
+    ring->head.store(head + need);
+    unlock_ring(ring);
+    if (header_->reader_waiting.load() != 0) {
+        header_->data_seq.fetch_add(1);
+        futex_wake(&header_->data_seq, 1);
+    }
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
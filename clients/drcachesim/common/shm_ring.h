@@ -0,0 +1,164 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* shm_ring: a shared-memory alternative to named_pipe_t for online traces,
+ * made up of a set of ring buffers which application threads write into and a
+ * single analyzer thread reads from in place.  Linux-only.
+ */
+
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#ifndef DR_PARAM_OUT
+#    define DR_PARAM_OUT // nothing
+#endif
+#ifndef DR_PARAM_IN
+#    define DR_PARAM_IN // nothing
+#endif
+
+// The shared file holds a header, one control block per ring, and then the
+// data for each ring.  Each thread is assigned a ring when it starts and
+// writes each of its buffers there as one chunk: an 8-byte chunk header
+// followed by the data, padded to 8 bytes.  A chunk never wraps around the
+// end of a ring; the writer instead fills the rest of the ring with a padding
+// chunk.  This lets the reader hand out pointers straight into the ring.
+//
+// Threads in excess of the ring count share rings, so writers serialize on a
+// per-ring lock; with no more threads than rings the lock is uncontended and
+// each ring has a single producer.  Writers block on a futex when their ring
+// is full and the reader blocks on a futex when every ring is empty.
+//
+// Usage is as follows:
+// + The reader calls create() up front (and at the end destroy()), then
+//   wait_for_writer() and next_chunk()/release_chunk() to consume.
+// + Each writer process maps the file at get_path() shared and read-write
+//   with its own allocator, passes the mapping to attach() (and calls detach()
+//   when done), and then calls assign_ring() for each thread and write() for
+//   each chunk.
+// The trace ends once every attached process has detached (or died) and the
+// rings are drained.
+class shm_ring_t {
+public:
+    shm_ring_t();
+    explicit shm_ring_t(const char *name);
+    ~shm_ring_t();
+    bool
+    set_name(const char *name);
+    std::string
+    get_name() const;
+    const std::string &
+    get_path() const;
+
+    // Reader interface.
+    bool
+    create(uint32_t num_rings, size_t ring_size);
+    bool
+    destroy();
+    // Blocks until the first writer process attaches.
+    bool
+    wait_for_writer();
+    // Blocks until a chunk is available and returns a pointer to its data,
+    // which remains valid until release_chunk() is called.  Returns nullptr
+    // once all writers are gone and there is no more data.
+    const void *
+    next_chunk(size_t *size DR_PARAM_OUT);
+    void
+    release_chunk();
+
+    // Writer interface.
+    bool
+    attach(void *map_base, size_t map_size, int pid);
+    // Registers another process sharing an existing mapping, such as a
+    // forked child.
+    bool
+    attach(int pid);
+    void
+    detach();
+    // Returns the ring index for a new thread.
+    uint32_t
+    assign_ring();
+    // Copies the data into the given ring as one chunk, blocking while the
+    // ring is full.  Returns false if the chunk is larger than
+    // get_max_chunk_size() or if the reader went away while we were blocked.
+    bool
+    write(uint32_t ring, const void *buf DR_PARAM_IN, size_t size);
+    size_t
+    get_max_chunk_size() const;
+
+    // The largest number of writer processes which can be attached at once.
+    static constexpr int MAX_PROCESSES = 256;
+
+private:
+    struct file_header_t;
+    struct ring_header_t;
+
+    ring_header_t *
+    get_ring(uint32_t index) const;
+    char *
+    get_ring_data(uint32_t index) const;
+    bool
+    rings_empty() const;
+    bool
+    any_writer_attached() const;
+    void
+    reap_dead_writers();
+    void
+    lock_ring(ring_header_t *ring);
+    void
+    unlock_ring(ring_header_t *ring);
+
+    std::string name_;
+    std::string path_;
+    char *map_base_ = nullptr;
+    size_t map_size_ = 0;
+    bool is_creator_ = false;
+    int pid_ = 0;
+    file_header_t *header_ = nullptr;
+    // Reader state: the ring to look at first and the chunk being consumed.
+    uint32_t next_ring_ = 0;
+    ring_header_t *held_ring_ = nullptr;
+    uint64_t held_size_ = 0;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _SHM_RING_H_ */
@@ -0,0 +1,310 @@
+/* **********************************************************
+ * Copyright (c) 2024 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* zstd_archive_reader_t: reads the components of a zstd archive file.
+ *
+ * A zstd archive is a sequence of standard zstd frames, one per component, followed
+ * by a zstd skippable frame holding an index of the components:
+ *
+ *   uint32_t ZSTD_ARCHIVE_INDEX_MAGIC (a zstd skippable frame magic number)
+ *   uint32_t size of the rest of the frame
+ *   For each component:
+ *     uint64_t compressed size of the component's frame
+ *     uint32_t length of the component's name
+ *     char[]   name, not NUL-terminated
+ *   uint32_t number of components
+ *   uint32_t size of the whole index frame, including the two header fields
+ *   uint32_t ZSTD_ARCHIVE_TRAILER_MAGIC
+ *
+ * All integers are little-endian.  The fixed-size trailer at the very end of the
+ * file lets a reader find the index and seek directly to any component, while the
+ * standard zstd tools simply ignore the skippable frame and decompress an archive
+ * into the concatenation of its components.
+ *
+ * A plain zstd file with no index (such as a raw file written by the tracer) can
+ * also be read, sequentially only, with each frame treated as one unnamed component.
+ */
+
+#ifndef _ZSTD_ARCHIVE_H_
+#define _ZSTD_ARCHIVE_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <zstd.h>
+#include <string>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// The last of the 16 skippable frame magic numbers reserved by the zstd format
+// (ZSTD_MAGIC_SKIPPABLE_START + 0xd), chosen to stay clear of the index used by the
+// zstd "seekable" contrib format.
+#define ZSTD_ARCHIVE_INDEX_MAGIC 0x184D2A5D
+// "DRZA" in little-endian byte order.
+#define ZSTD_ARCHIVE_TRAILER_MAGIC 0x415A5244
+#define ZSTD_ARCHIVE_HEADER_SIZE 8
+#define ZSTD_ARCHIVE_TRAILER_SIZE 12
+
+class zstd_archive_reader_t {
+public:
+    explicit zstd_archive_reader_t(const std::string &path)
+    {
+        file_ = fopen(path.c_str(), "rb");
+        if (file_ == nullptr)
+            return;
+        dctx_ = ZSTD_createDCtx();
+        if (dctx_ == nullptr) {
+            fclose(file_);
+            file_ = nullptr;
+            return;
+        }
+        in_capacity_ = ZSTD_DStreamInSize();
+        in_buf_ = new char[in_capacity_];
+        in_ = { in_buf_, 0, 0 };
+        // A missing or malformed index just means no random access.
+        if (!read_index())
+            index_.clear();
+        if (fseeko(file_, 0, SEEK_SET) != 0) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+    }
+    ~zstd_archive_reader_t()
+    {
+        if (file_ != nullptr)
+            fclose(file_);
+        ZSTD_freeDCtx(dctx_);
+        delete[] in_buf_;
+    }
+    bool
+    is_open() const
+    {
+        return file_ != nullptr;
+    }
+    bool
+    has_index() const
+    {
+        return !index_.empty();
+    }
+    size_t
+    num_components() const
+    {
+        return index_.size();
+    }
+    // Returns the name of the index-th component, which must be < num_components().
+    const std::string &
+    component_name(size_t index) const
+    {
+        return index_[index].name;
+    }
+    // Returns the ordinal of the component being read.
+    size_t
+    cur_component() const
+    {
+        return cur_;
+    }
+    // Returns the ordinal of the component named "name", or -1 if there is none.
+    int64_t
+    find_component(const std::string &name) const
+    {
+        for (size_t i = 0; i < index_.size(); ++i) {
+            if (index_[i].name == name)
+                return static_cast<int64_t>(i);
+        }
+        return -1;
+    }
+    // Decompresses up to "size" bytes of the current component into "dst".
+    // Never returns data from more than one component: returns 0 at the end of the
+    // current component, after which next_component() must be called to continue.
+    // Returns -1 on an error, including a truncated component.
+    int64_t
+    read(void *dst, size_t size)
+    {
+        if (file_ == nullptr)
+            return -1;
+        if (component_done_)
+            return 0;
+        ZSTD_outBuffer out = { dst, size, 0 };
+        while (out.pos < out.size) {
+            if (in_.pos == in_.size) {
+                in_.size = fread(in_buf_, 1, in_capacity_, file_);
+                in_.pos = 0;
+                if (in_.size == 0) {
+                    if (ferror(file_) || mid_frame_)
+                        return -1;
+                    component_done_ = true;
+                    at_eof_ = true;
+                    break;
+                }
+            }
+            size_t res = ZSTD_decompressStream(dctx_, &out, &in_);
+            if (ZSTD_isError(res))
+                return -1;
+            if (res == 0) {
+                // The frame is fully decoded and flushed.  We stop here so
+                // that callers see the component boundary.
+                mid_frame_ = false;
+                component_done_ = true;
+                break;
+            }
+            mid_frame_ = true;
+        }
+        return static_cast<int64_t>(out.pos);
+    }
+    // Moves to the start of the next component, skipping whatever remains of the
+    // current one.  Returns false at the end of the archive or on an error.
+    bool
+    next_component()
+    {
+        if (file_ == nullptr)
+            return false;
+        if (has_index()) {
+            if (cur_ + 1 >= index_.size())
+                return false;
+            if (!component_done_)
+                return open_component(cur_ + 1);
+        } else {
+            char discard[4096];
+            while (!component_done_) {
+                if (read(discard, sizeof(discard)) < 0)
+                    return false;
+            }
+            if (at_eof_)
+                return false;
+        }
+        ++cur_;
+        component_done_ = false;
+        return true;
+    }
+    // Seeks to the start of the index-th component.  Requires an index.
+    bool
+    open_component(size_t index)
+    {
+        if (file_ == nullptr || index >= index_.size())
+            return false;
+        if (fseeko(file_, index_[index].offset, SEEK_SET) != 0)
+            return false;
+        if (ZSTD_isError(ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only)))
+            return false;
+        in_.pos = 0;
+        in_.size = 0;
+        cur_ = index;
+        component_done_ = false;
+        mid_frame_ = false;
+        at_eof_ = false;
+        return true;
+    }
+
+private:
+    struct component_t {
+        std::string name;
+        off_t offset;
+    };
+
+    static uint32_t
+    get_le32(const unsigned char *src)
+    {
+        return static_cast<uint32_t>(src[0]) | (static_cast<uint32_t>(src[1]) << 8) |
+            (static_cast<uint32_t>(src[2]) << 16) | (static_cast<uint32_t>(src[3]) << 24);
+    }
+    static uint64_t
+    get_le64(const unsigned char *src)
+    {
+        return static_cast<uint64_t>(get_le32(src)) |
+            (static_cast<uint64_t>(get_le32(src + 4)) << 32);
+    }
+
+    bool
+    read_index()
+    {
+        unsigned char trailer[ZSTD_ARCHIVE_TRAILER_SIZE];
+        if (fseeko(file_, 0, SEEK_END) != 0)
+            return false;
+        off_t file_size = ftello(file_);
+        if (file_size < ZSTD_ARCHIVE_HEADER_SIZE + ZSTD_ARCHIVE_TRAILER_SIZE ||
+            fseeko(file_, file_size - ZSTD_ARCHIVE_TRAILER_SIZE, SEEK_SET) != 0 ||
+            fread(trailer, sizeof(trailer), 1, file_) != 1 ||
+            get_le32(trailer + 8) != ZSTD_ARCHIVE_TRAILER_MAGIC)
+            return false;
+        uint32_t count = get_le32(trailer);
+        off_t index_size = get_le32(trailer + 4);
+        if (index_size < ZSTD_ARCHIVE_HEADER_SIZE + ZSTD_ARCHIVE_TRAILER_SIZE ||
+            index_size > file_size)
+            return false;
+        std::vector<unsigned char> index(index_size);
+        if (fseeko(file_, file_size - index_size, SEEK_SET) != 0 ||
+            fread(index.data(), index.size(), 1, file_) != 1 ||
+            get_le32(index.data()) != ZSTD_ARCHIVE_INDEX_MAGIC ||
+            get_le32(index.data() + 4) != index_size - ZSTD_ARCHIVE_HEADER_SIZE)
+            return false;
+        const unsigned char *pos = index.data() + ZSTD_ARCHIVE_HEADER_SIZE;
+        const unsigned char *end = index.data() + index_size - ZSTD_ARCHIVE_TRAILER_SIZE;
+        off_t offset = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (end - pos < 12)
+                return false;
+            uint64_t frame_size = get_le64(pos);
+            uint32_t name_len = get_le32(pos + 8);
+            pos += 12;
+            if (static_cast<uint64_t>(end - pos) < name_len)
+                return false;
+            index_.push_back(
+                { std::string(reinterpret_cast<const char *>(pos), name_len), offset });
+            pos += name_len;
+            offset += static_cast<off_t>(frame_size);
+        }
+        // The frames must exactly fill the space before the index.
+        return pos == end && offset == file_size - index_size;
+    }
+
+    FILE *file_ = nullptr;
+    ZSTD_DCtx *dctx_ = nullptr;
+    char *in_buf_ = nullptr;
+    size_t in_capacity_ = 0;
+    ZSTD_inBuffer in_ = {};
+    std::vector<component_t> index_;
+    size_t cur_ = 0;
+    bool component_done_ = false;
+    bool mid_frame_ = false;
+    bool at_eof_ = false;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ZSTD_ARCHIVE_H_ */
@@ -0,0 +1,145 @@
+/* **********************************************************
+ * Copyright (c) 2024 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* zstd_istream_t: provides a std::istream interface for reading a zstd file.
+ * For a zstd archive (see zstd_archive.h) it provides a continuous stream that
+ * cycles through all components and supports jumping to a named component.
+ * A plain zstd file such as a raw file written by the tracer is read as one
+ * stream.  Supports only limited seeking within the current internal buffer.
+ */
+
+#ifndef _ZSTD_ISTREAM_H_
+#define _ZSTD_ISTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+#include <fstream>
+#include <iostream>
+#include "archive_istream.h"
+#include "zstd_archive.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/* We need to override the stream buffer class which is where the file
+ * reads happen.  The stream buffer base class reads from eback()..egptr()
+ * with the next to read at gptr().
+ */
+class zstd_istreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    zstd_istreambuf_t(const std::string &path)
+        : archive_(path)
+    {
+        if (archive_.is_open())
+            buf_ = new char[buffer_size_];
+    }
+    ~zstd_istreambuf_t() override
+    {
+        delete[] buf_;
+    }
+    int
+    underflow() override
+    {
+        if (buf_ == nullptr)
+            return traits_type::eof();
+        if (gptr() == egptr()) {
+            int64_t len = archive_.read(buf_, buffer_size_);
+            while (len == 0 && archive_.next_component())
+                len = archive_.read(buf_, buffer_size_);
+            if (len <= 0)
+                return traits_type::eof();
+            setg(buf_, buf_, buf_ + len);
+        }
+        return *gptr();
+    }
+    std::iostream::pos_type
+    seekoff(std::iostream::off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override
+    {
+        if (dir == std::ios_base::cur &&
+            ((off >= 0 && gptr() + off < egptr()) ||
+             (off < 0 && gptr() + off >= eback())))
+            gbump(static_cast<int>(off));
+        else {
+            // Unsupported!
+            return -1;
+        }
+        return gptr() - eback();
+    }
+    std::string
+    open_component(const std::string &name)
+    {
+        if (!archive_.has_index())
+            return "Failed to find a zstd archive index";
+        int64_t index = archive_.find_component(name);
+        if (index < 0)
+            return "Failed to locate zstd archive component " + name;
+        if (!archive_.open_component(static_cast<size_t>(index)))
+            return "Failed to open zstd archive component " + name;
+        // Discard buffered data from the prior component.
+        setg(buf_, buf_, buf_);
+        return "";
+    }
+
+private:
+    // The largest block zstd produces, so each read typically decodes one block.
+    static const int buffer_size_ = 128 * 1024;
+    zstd_archive_reader_t archive_;
+    char *buf_ = nullptr;
+};
+
+class zstd_istream_t : public archive_istream_t {
+public:
+    explicit zstd_istream_t(const std::string &path)
+        : archive_istream_t(new zstd_istreambuf_t(path))
+    {
+        if (!rdbuf())
+            setstate(std::ios::badbit);
+    }
+    ~zstd_istream_t() override
+    {
+        delete rdbuf();
+    }
+    std::string
+    open_component(const std::string &name) override
+    {
+        zstd_istreambuf_t *zbuf = reinterpret_cast<zstd_istreambuf_t *>(rdbuf());
+        return zbuf->open_component(name);
+    }
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ZSTD_ISTREAM_H_ */
@@ -0,0 +1,245 @@
+/* **********************************************************
+ * Copyright (c) 2024 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+// zstd_ostream_t: an instance of archive_ostream_t producing a zstd archive,
+// with one zstd frame per component followed by an index of the components.
+// See zstd_archive.h for the format.
+
+#ifndef _ZSTD_OSTREAM_H_
+#define _ZSTD_OSTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "archive_ostream.h"
+#include "zstd_archive.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// We need to override the stream buffer class which is where the file
+// writes happen.  We go ahead and use a simple buffer.  The stream
+// buffer base class writes to pbase()..epptr() with the next slot at
+// pptr().
+class zstd_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    zstd_streambuf_t(const std::string &path, int level)
+    {
+        file_ = fopen(path.c_str(), "wb");
+        if (file_ == nullptr)
+            return;
+        cctx_ = ZSTD_createCCtx();
+        if (cctx_ == nullptr ||
+            ZSTD_isError(
+                ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level)) ||
+            // The checksum lets readers detect a corrupted component.
+            ZSTD_isError(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 1))) {
+            fclose(file_);
+            file_ = nullptr;
+            return;
+        }
+        out_capacity_ = ZSTD_CStreamOutSize();
+        out_buf_ = new char[out_capacity_];
+        buf_ = new char[buffer_size_];
+        // We call setp() to set pbase() and epptr() (the buffer bounds).
+        // We leave an extra slot for extra_char on overflow.
+        setp(buf_, buf_ + buffer_size_ - 1);
+        // Caller should invoke open_new_component() for first component.
+    }
+    ~zstd_streambuf_t() override
+    {
+        sync();
+        if (file_ != nullptr) {
+            if ((in_component_ && !end_component()) || !write_index() ||
+                fclose(file_) != 0) {
+#ifdef DEBUG
+                // Let's at least have something visible in debug build.
+                std::cerr << "zstd_ostream failed to close archive\n";
+#endif
+            }
+        }
+        ZSTD_freeCCtx(cctx_);
+        delete[] buf_;
+        delete[] out_buf_;
+    }
+    int
+    overflow(int extra_char) override
+    {
+        if (file_ == nullptr)
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int res = traits_type::not_eof(extra_char);
+        if (pptr() > pbase()) {
+            if (!in_component_ ||
+                !compress(pbase(), pptr() - pbase(), ZSTD_e_continue))
+                res = traits_type::eof();
+        }
+        setp(buf_, buf_ + buffer_size_ - 1);
+        return res;
+    }
+    int
+    sync() override
+    {
+        return overflow(traits_type::eof());
+    }
+    std::string
+    open_new_component(const std::string &name)
+    {
+        if (file_ == nullptr)
+            return "Failed to open zstd archive";
+        sync();
+        if (in_component_ && !end_component())
+            return "Failed to close prior component";
+        names_.push_back(name);
+        frame_start_ = bytes_written_;
+        in_component_ = true;
+        return "";
+    }
+
+private:
+    bool
+    write(const void *data, size_t size)
+    {
+        if (size > 0 && fwrite(data, size, 1, file_) != 1)
+            return false;
+        bytes_written_ += size;
+        return true;
+    }
+    bool
+    compress(const char *data, size_t size, ZSTD_EndDirective mode)
+    {
+        ZSTD_inBuffer in = { data, size, 0 };
+        bool done;
+        do {
+            ZSTD_outBuffer out = { out_buf_, out_capacity_, 0 };
+            size_t remaining = ZSTD_compressStream2(cctx_, &out, &in, mode);
+            if (ZSTD_isError(remaining) || !write(out_buf_, out.pos))
+                return false;
+            done = (mode == ZSTD_e_end) ? remaining == 0 : in.pos == in.size;
+        } while (!done);
+        return true;
+    }
+    // Completes the current component's frame.
+    bool
+    end_component()
+    {
+        in_component_ = false;
+        if (!compress(nullptr, 0, ZSTD_e_end))
+            return false;
+        frame_sizes_.push_back(bytes_written_ - frame_start_);
+        return true;
+    }
+    static void
+    append_le32(std::string &dst, uint32_t val)
+    {
+        for (int i = 0; i < 4; ++i)
+            dst += static_cast<char>((val >> (8 * i)) & 0xff);
+    }
+    static void
+    append_le64(std::string &dst, uint64_t val)
+    {
+        append_le32(dst, static_cast<uint32_t>(val));
+        append_le32(dst, static_cast<uint32_t>(val >> 32));
+    }
+    bool
+    write_index()
+    {
+        if (frame_sizes_.size() != names_.size())
+            return false;
+        std::string index;
+        append_le32(index, ZSTD_ARCHIVE_INDEX_MAGIC);
+        // Filled in below once the size is known.
+        append_le32(index, 0);
+        for (size_t i = 0; i < names_.size(); ++i) {
+            append_le64(index, frame_sizes_[i]);
+            append_le32(index, static_cast<uint32_t>(names_[i].size()));
+            index += names_[i];
+        }
+        append_le32(index, static_cast<uint32_t>(names_.size()));
+        uint32_t index_size = static_cast<uint32_t>(index.size() + 8);
+        append_le32(index, index_size);
+        append_le32(index, ZSTD_ARCHIVE_TRAILER_MAGIC);
+        std::string frame_size;
+        append_le32(frame_size, index_size - ZSTD_ARCHIVE_HEADER_SIZE);
+        index.replace(4, 4, frame_size);
+        return write(index.data(), index.size());
+    }
+
+    static const int buffer_size_ = 4096;
+    FILE *file_ = nullptr;
+    ZSTD_CCtx *cctx_ = nullptr;
+    char *buf_ = nullptr;
+    char *out_buf_ = nullptr;
+    size_t out_capacity_ = 0;
+    bool in_component_ = false;
+    uint64_t bytes_written_ = 0;
+    uint64_t frame_start_ = 0;
+    std::vector<std::string> names_;
+    std::vector<uint64_t> frame_sizes_;
+};
+
+// open_new_component() should be called to create an initial component before
+// doing any writing.
+class zstd_ostream_t : public archive_ostream_t {
+public:
+    explicit zstd_ostream_t(const std::string &path,
+                            int level = ZSTD_CLEVEL_DEFAULT)
+        : archive_ostream_t(new zstd_streambuf_t(path, level))
+    {
+        if (!rdbuf())
+            setstate(std::ios::badbit);
+    }
+    ~zstd_ostream_t() override
+    {
+        delete rdbuf();
+    }
+    std::string
+    open_new_component(const std::string &name) override
+    {
+        zstd_streambuf_t *zbuf = reinterpret_cast<zstd_streambuf_t *>(rdbuf());
+        return zbuf->open_new_component(name);
+    }
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ZSTD_OSTREAM_H_ */
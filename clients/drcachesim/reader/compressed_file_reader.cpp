@@ -56,20 +56,39 @@ open_single_file_common(const std::string &path, gzFile &out)
     return out != nullptr;
 }
 
+// Reads up to "count" records into "buf", returning how many were read, or 0
+// at the end of the file or on an error, setting "eof" only for the former.
+size_t
+read_records_common(gzFile file, trace_entry_t *buf, size_t count, bool *eof)
+{
+    int len = gzread(file, buf, static_cast<unsigned int>(count * sizeof(*buf)));
+    // Returns less than asked-for if at end of file, or –1 for error.
+    // We should always get a multiple of the record size.
+    if (len < static_cast<int>(sizeof(trace_entry_t)) ||
+        len % static_cast<int>(sizeof(trace_entry_t)) != 0) {
+        *eof = (len >= 0);
+        return 0;
+    }
+    return len / sizeof(*buf);
+}
+
 trace_entry_t *
 read_next_entry_common(gzip_reader_t *gzip, bool *eof)
 {
     if (gzip->cur_buf >= gzip->max_buf) {
-        int len = gzread(gzip->file, gzip->buf, sizeof(gzip->buf));
-        // Returns less than asked-for if at end of file, or –1 for error.
-        // We should always get a multiple of the record size.
-        if (len < static_cast<int>(sizeof(trace_entry_t)) ||
-            len % static_cast<int>(sizeof(trace_entry_t)) != 0) {
-            *eof = (len >= 0);
-            return nullptr;
+        if (gzip->read_ahead) {
+            if (!gzip->read_ahead->next_block(gzip->block, *eof))
+                return nullptr;
+            gzip->cur_buf = gzip->block.entries.data();
+            gzip->max_buf = gzip->cur_buf + gzip->block.entries.size();
+        } else {
+            size_t count = read_records_common(
+                gzip->file, gzip->buf, sizeof(gzip->buf) / sizeof(*gzip->buf), eof);
+            if (count == 0)
+                return nullptr;
+            gzip->cur_buf = gzip->buf;
+            gzip->max_buf = gzip->buf + count;
         }
-        gzip->cur_buf = gzip->buf;
-        gzip->max_buf = gzip->buf + (len / sizeof(*gzip->max_buf));
     }
     trace_entry_t *res = gzip->cur_buf;
     ++gzip->cur_buf;
@@ -93,6 +112,8 @@ template <>
 /* clang-format on */
 file_reader_t<gzip_reader_t>::~file_reader_t()
 {
+    // Stop any decompression ahead before closing the file.
+    input_file_.read_ahead.reset();
     if (input_file_.file != nullptr) {
         gzclose(input_file_.file);
         input_file_.file = nullptr;
@@ -107,7 +128,10 @@ file_reader_t<gzip_reader_t>::open_single_file(const std::string &path)
     if (!open_single_file_common(path, file))
         return false;
     VPRINT(this, 1, "Opened input file %s\n", path.c_str());
-    input_file_ = gzip_reader_t(file);
+    // We set the fields in place as gzip_reader_t is no longer cheap to copy.
+    input_file_.file = file;
+    input_file_.cur_buf = input_file_.buf;
+    input_file_.max_buf = input_file_.buf;
     return true;
 }
 
@@ -127,6 +151,26 @@ file_reader_t<gzip_reader_t>::read_next_entry()
     return &entry_copy_;
 }
 
+template <>
+read_ahead_source_t *
+file_reader_t<gzip_reader_t>::enable_read_ahead(read_ahead_pool_t *pool)
+{
+    if (input_file_.file == nullptr)
+        return nullptr;
+    if (!input_file_.read_ahead) {
+        gzip_reader_t *gzip = &input_file_;
+        input_file_.read_ahead.reset(new read_ahead_source_t(
+            pool, [gzip](read_ahead_block_t &block, bool &at_eof) {
+                block.entries.resize(sizeof(gzip->buf) / sizeof(*gzip->buf));
+                size_t count = read_records_common(gzip->file, block.entries.data(),
+                                                   block.entries.size(), &at_eof);
+                block.entries.resize(count);
+                return count > 0;
+            }));
+    }
+    return input_file_.read_ahead.get();
+}
+
 /*********************************************************
  * gzip_reader_t specializations for record_file_reader_t.
  */
@@ -37,7 +37,10 @@
 
 #include <zlib.h>
 
+#include <memory>
+
 #include "file_reader.h"
+#include "read_ahead_pool.h"
 #include "record_file_reader.h"
 #include "trace_entry.h"
 
@@ -60,12 +63,23 @@ struct gzip_reader_t {
     trace_entry_t buf[4096];
     trace_entry_t *cur_buf = buf;
     trace_entry_t *max_buf = buf;
+    // Set if records are decompressed ahead by a read_ahead_pool_t, in which
+    // case cur_buf and max_buf point into "block" rather than "buf".
+    std::unique_ptr<read_ahead_source_t> read_ahead;
+    read_ahead_block_t block;
 };
 
 typedef file_reader_t<gzip_reader_t> compressed_file_reader_t;
 typedef dynamorio::drmemtrace::record_file_reader_t<gzip_reader_t>
     compressed_record_file_reader_t;
 
+/* Declare this so the compiler knows not to use the default implementation in the
+ * class declaration.
+ */
+template <>
+read_ahead_source_t *
+file_reader_t<gzip_reader_t>::enable_read_ahead(read_ahead_pool_t *pool);
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
@@ -171,6 +171,22 @@ config_reader_t::configure(std::istream *config_file, cache_simulator_knobs_t &k
             } else {
                 knobs.use_physical = false;
             }
+        } else if (param == "sim_parallel") {
+            // Whether to simulate each core on its own thread.
+            std::string bool_val;
+            if (!(*fin_ >> bool_val)) {
+                ERRMSG("Error reading sim_parallel from the configuration file\n");
+                return false;
+            }
+            knobs.parallel = is_true(bool_val);
+        } else if (param == "sim_lockstep") {
+            // Whether parallel simulation should be deterministic.
+            std::string bool_val;
+            if (!(*fin_ >> bool_val)) {
+                ERRMSG("Error reading sim_lockstep from the configuration file\n");
+                return false;
+            }
+            knobs.parallel_lockstep = is_true(bool_val);
         } else {
             // A cache unit.
             cache_params_t cache;
@@ -102,6 +102,13 @@ public:
         return input_path_.substr(ind + 1);
     }
 
+    // Provided so that instantiations can specialize.
+    read_ahead_source_t *
+    enable_read_ahead(read_ahead_pool_t *pool) override
+    {
+        return reader_t::enable_read_ahead(pool);
+    }
+
 protected:
     trace_entry_t *
     read_next_entry() override;
@@ -0,0 +1,416 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "mmap_file_reader.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**************************************************************************
+ * Common logic used in the mmap_reader_t specializations for file_reader_t
+ * and record_file_reader_t.
+ */
+
+namespace {
+
+#ifdef DEBUG
+// We use the VPRINT from reader.h for member function code.
+// For common routines we need a separate variant taking verbosity in directly.
+#    define MPRINT(verbosity, level, ...)     \
+        do {                                  \
+            if (verbosity >= (level)) {       \
+                fprintf(stderr, __VA_ARGS__); \
+            }                                 \
+        } while (0)
+#else
+#    define MPRINT(verbosity, level, ...) /* nothing */
+#endif
+
+// MADV_SEQUENTIAL alone leaves the kernel's read-ahead window small, so we
+// also ask for this much of the file ahead of the reader.
+constexpr size_t READAHEAD_BYTES = 16 * 1024 * 1024;
+constexpr size_t READAHEAD_ENTRIES = READAHEAD_BYTES / sizeof(trace_entry_t);
+
+bool
+open_single_file_common(const std::string &path, mmap_reader_t &mread)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        static_cast<uint64_t>(st.st_size) < sizeof(trace_entry_t) ||
+        static_cast<uint64_t>(st.st_size) > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    // A private mapping lets reader_t rewrite a record's type in place, as it
+    // does for TRACE_TYPE_INSTR_MAYBE_FETCH, without touching the file.
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    // This is only a hint: we ignore failure.
+    madvise(map, size, MADV_SEQUENTIAL);
+    mread.map = map;
+    mread.map_size = size;
+    mread.cur = static_cast<trace_entry_t *>(map);
+    mread.end = mread.cur + size / sizeof(trace_entry_t);
+    mread.advised = mread.cur;
+    mread.path = path;
+    return true;
+}
+
+void
+close_common(mmap_reader_t &mread)
+{
+    if (mread.map != nullptr) {
+        munmap(mread.map, mread.map_size);
+        mread.map = nullptr;
+    }
+}
+
+// Once the reader is halfway through the range last read ahead, asks for the
+// next range.
+void
+read_ahead(mmap_reader_t &mread)
+{
+    if (mread.advised == mread.end ||
+        mread.cur + READAHEAD_ENTRIES / 2 < mread.advised)
+        return;
+    trace_entry_t *from = std::max(mread.cur, mread.advised);
+    trace_entry_t *to =
+        mread.end - from <= static_cast<ptrdiff_t>(READAHEAD_ENTRIES)
+        ? mread.end
+        : from + READAHEAD_ENTRIES;
+    static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = reinterpret_cast<uintptr_t>(from) & ~(page_size - 1);
+    madvise(reinterpret_cast<void *>(start), reinterpret_cast<uintptr_t>(to) - start,
+            MADV_WILLNEED);
+    mread.advised = to;
+}
+
+// Returns the next record in the mapping, or nullptr at the end, where at_eof
+// is set unless the file ends in a partial record.
+trace_entry_t *
+next_entry_common(mmap_reader_t &mread, bool &at_eof)
+{
+    if (mread.cur >= mread.end) {
+        at_eof = mread.map_size % sizeof(trace_entry_t) == 0;
+        if (!at_eof) {
+            MPRINT(mread.verbosity, 1, "Truncated final record in %s\n",
+                   mread.path.c_str());
+        }
+        return nullptr;
+    }
+    read_ahead(mread);
+    return mread.cur++;
+}
+
+// Where a skip can resume its linear walk: a timestamp, with the instructions
+// and records before it in the mapping.
+struct skip_target_t {
+    trace_entry_t *timestamp = nullptr;
+    uint64_t instrs = 0;
+    uint64_t records = 0;
+    uint64_t first_timestamp = 0;
+    uint64_t last_cpuid = 0;
+    // Encodings of instructions before the timestamp, as each instruction's
+    // address and the range of its encoding records.
+    std::vector<std::pair<addr_t, std::pair<trace_entry_t *, trace_entry_t *>>> encodings;
+};
+
+// Scans forward from mread.cur for the last timestamp before the instruction
+// reached by stop_count - cur_instrs more instructions, counting what reader_t
+// would count in walking up to it.  To keep that count exact the scan stops at
+// the first record whose effect on reader_t it does not model, such as a
+// thread switch or a chunk boundary, and lands on the last timestamp before
+// that.  Timestamps in kernel traces or between an encoding and its
+// instruction are not landing points.  The scan must start outside of any
+// kernel trace.
+skip_target_t
+find_skip_target(const mmap_reader_t &mread, uint64_t cur_instrs, uint64_t stop_count)
+{
+    skip_target_t target;
+    bool in_kernel = false;
+    uint64_t instrs = 0, records = 0, first_timestamp = 0, last_cpuid = 0;
+    trace_entry_t *encoding_start = nullptr;
+    size_t encoding_size = 0, num_encodings = 0;
+    decltype(target.encodings) encodings;
+    for (trace_entry_t *entry = mread.cur; entry < mread.end; ++entry) {
+        trace_type_t type = static_cast<trace_type_t>(entry->type);
+        if (type == TRACE_TYPE_ENCODING) {
+            if (encoding_start == nullptr)
+                encoding_start = entry;
+            encoding_size += entry->size;
+            if (encoding_size > MAX_ENCODING_LENGTH)
+                break;
+            continue;
+        }
+        if (type_is_instr(type) || type == TRACE_TYPE_INSTR_NO_FETCH) {
+            if (entry->size == 0)
+                continue;
+            if (type != TRACE_TYPE_INSTR_NO_FETCH) {
+                if (cur_instrs + instrs + 1 == stop_count)
+                    break;
+                ++instrs;
+            }
+            ++records;
+            if (encoding_start != nullptr) {
+                encodings.emplace_back(static_cast<addr_t>(entry->addr),
+                                       std::make_pair(encoding_start, entry));
+                encoding_start = nullptr;
+                encoding_size = 0;
+            }
+            continue;
+        }
+        if (encoding_start != nullptr)
+            break;
+        if ((type == TRACE_TYPE_READ || type == TRACE_TYPE_WRITE ||
+             type_is_prefetch(type)) &&
+            type != TRACE_TYPE_HARDWARE_PREFETCH) {
+            ++records;
+            continue;
+        }
+        if (type != TRACE_TYPE_MARKER)
+            break;
+        bool stop = false;
+        switch (entry->size) {
+        case TRACE_MARKER_TYPE_TIMESTAMP:
+            if (!in_kernel) {
+                target.timestamp = entry;
+                target.instrs = instrs;
+                target.records = records;
+                target.first_timestamp = first_timestamp;
+                target.last_cpuid = last_cpuid;
+                num_encodings = encodings.size();
+            }
+            if (first_timestamp == 0)
+                first_timestamp = entry->addr;
+            break;
+        case TRACE_MARKER_TYPE_CPU_ID: last_cpuid = entry->addr; break;
+        case TRACE_MARKER_TYPE_SYSCALL_TRACE_START:
+        case TRACE_MARKER_TYPE_CONTEXT_SWITCH_START: in_kernel = true; break;
+        case TRACE_MARKER_TYPE_SYSCALL_TRACE_END:
+        case TRACE_MARKER_TYPE_CONTEXT_SWITCH_END: in_kernel = false; break;
+        case TRACE_MARKER_TYPE_BRANCH_TARGET:
+            // Not a visible record, and only applies to the next instruction.
+            continue;
+        case TRACE_MARKER_TYPE_RECORD_ORDINAL:
+        case TRACE_MARKER_TYPE_CHUNK_FOOTER:
+        case TRACE_MARKER_TYPE_CHUNK_INSTR_COUNT:
+        case TRACE_MARKER_TYPE_VERSION:
+        case TRACE_MARKER_TYPE_FILETYPE:
+        case TRACE_MARKER_TYPE_CACHE_LINE_SIZE:
+        case TRACE_MARKER_TYPE_PAGE_SIZE: stop = true; break;
+        default: break;
+        }
+        if (stop)
+            break;
+        ++records;
+    }
+    encodings.resize(num_encodings);
+    target.encodings = std::move(encodings);
+    return target;
+}
+
+} // namespace
+
+bool
+is_mmap_trace_file(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    trace_entry_t header;
+    bool res = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+        // Leave files too large for the address space to the stream readers.
+        static_cast<uint64_t>(st.st_size) <= SIZE_MAX / 4 &&
+        read(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)) &&
+        header.type == TRACE_TYPE_HEADER && header.addr <= TRACE_ENTRY_VERSION;
+    close(fd);
+    return res;
+}
+
+/**************************************************
+ * mmap_reader_t specializations for file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<mmap_reader_t>::file_reader_t()
+{
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<mmap_reader_t>::~file_reader_t()
+{
+    close_common(input_file_);
+}
+
+template <>
+bool
+file_reader_t<mmap_reader_t>::open_single_file(const std::string &path)
+{
+    if (!open_single_file_common(path, input_file_))
+        return false;
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_.verbosity = verbosity_;
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<mmap_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = read_queued_entry();
+    if (entry != nullptr)
+        return entry;
+    // We return the record in place, with no copy.
+    entry = next_entry_common(input_file_, at_eof_);
+    if (entry == nullptr)
+        return nullptr;
+    VPRINT(this, 5, "Read %s: type=%s (%d), size=%d, addr=%zu\n",
+           input_file_.path.c_str(), trace_type_names[entry->type], entry->type,
+           entry->size, entry->addr);
+    return entry;
+}
+
+template <>
+reader_t &
+file_reader_t<mmap_reader_t>::skip_instructions(uint64_t instruction_count)
+{
+    if (instruction_count == 0)
+        return *this;
+    VPRINT(this, 2, "Skipping %" PRIu64 " instrs in %s\n", instruction_count,
+           input_file_.path.c_str());
+    if (!pre_skip_instructions())
+        return *this;
+    uint64_t stop_count = cur_instr_count_ + instruction_count + 1;
+    // With the whole file mapped we can find the last timestamp before the
+    // target without handing each record to process_input_entry(), and jump
+    // there.  This needs reader_t to be between records and outside of kernel
+    // traces, whose state we cannot update.
+    if (queue_.empty() && suppress_ref_count_ < 0 && !is_record_kernel()) {
+        skip_target_t target =
+            find_skip_target(input_file_, cur_instr_count_, stop_count);
+        if (target.timestamp != nullptr && target.timestamp > input_file_.cur) {
+            for (const auto &enc : target.encodings) {
+                encoding_info_t info;
+                for (trace_entry_t *entry = enc.second.first; entry < enc.second.second;
+                     ++entry) {
+                    memcpy(info.bits + info.size, entry->encoding, entry->size);
+                    info.size += entry->size;
+                }
+                encodings_[enc.first] = info;
+            }
+            cur_instr_count_ += target.instrs;
+            cur_ref_count_ += target.records;
+            if (first_timestamp_ == 0)
+                first_timestamp_ = target.first_timestamp;
+            if (target.last_cpuid != 0)
+                last_cpuid_ = target.last_cpuid;
+            input_file_.cur = target.timestamp;
+            input_file_.advised = input_file_.cur;
+            VPRINT(this, 2,
+                   "Jumped to %" PRIu64 " instrs, %" PRIu64 " records at offset %zu\n",
+                   cur_instr_count_, cur_ref_count_,
+                   (input_file_.cur - static_cast<trace_entry_t *>(input_file_.map)) *
+                       sizeof(trace_entry_t));
+        }
+    }
+    // Walk the rest of the way from the timestamp, which the walk duplicates
+    // ahead of the target instruction.
+    return skip_instructions_with_timestamp(stop_count - 1);
+}
+
+/*********************************************************
+ * mmap_reader_t specializations for record_file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+record_file_reader_t<mmap_reader_t>::~record_file_reader_t()
+{
+    if (input_file_ != nullptr)
+        close_common(*input_file_);
+}
+
+template <>
+bool
+record_file_reader_t<mmap_reader_t>::open_single_file(const std::string &path)
+{
+    auto mread = std::unique_ptr<mmap_reader_t>(new mmap_reader_t());
+    if (!open_single_file_common(path, *mread))
+        return false;
+    input_file_ = std::move(mread);
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_->verbosity = verbosity_;
+    return true;
+}
+
+template <>
+bool
+record_file_reader_t<mmap_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = next_entry_common(*input_file_, eof_);
+    if (entry == nullptr)
+        return false;
+    cur_entry_ = *entry;
+    VPRINT(this, 5, "Read %s: type=%s (%d), size=%d, addr=%zu\n",
+           input_file_->path.c_str(), trace_type_names[cur_entry_.type], cur_entry_.type,
+           cur_entry_.size, cur_entry_.addr);
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
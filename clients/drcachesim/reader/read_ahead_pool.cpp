@@ -0,0 +1,238 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "read_ahead_pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**************************************************************************
+ * read_ahead_source_t
+ */
+
+read_ahead_source_t::read_ahead_source_t(read_ahead_pool_t *pool, fill_func_t fill)
+    : pool_(pool)
+    , fill_(std::move(fill))
+{
+    if (pool_ != nullptr)
+        pool_->add_source(this);
+}
+
+read_ahead_source_t::~read_ahead_source_t()
+{
+    if (pool_ != nullptr)
+        pool_->remove_source(this);
+}
+
+bool
+read_ahead_source_t::next_block(read_ahead_block_t &block, bool &at_eof)
+{
+    std::unique_lock<std::mutex> lock;
+    if (pool_ != nullptr)
+        lock = std::unique_lock<std::mutex>(pool_->lock_);
+    bool waited = false;
+    while (blocks_.empty() && busy_) {
+        waited = true;
+        pool_->done_cond_.wait(lock);
+    }
+    if (!blocks_.empty()) {
+        if (waited)
+            ++stats_.waits;
+        else
+            ++stats_.hits;
+        block = std::move(blocks_.front());
+        blocks_.pop_front();
+        if (pool_ != nullptr)
+            pool_->work_cond_.notify_one();
+        return true;
+    }
+    if (done_) {
+        at_eof = done_at_eof_;
+        return false;
+    }
+    ++stats_.misses;
+    busy_ = true;
+    if (lock.owns_lock())
+        lock.unlock();
+    bool res = fill_(block, at_eof);
+    if (pool_ != nullptr)
+        lock.lock();
+    busy_ = false;
+    if (!res) {
+        done_ = true;
+        done_at_eof_ = at_eof;
+    }
+    if (pool_ != nullptr) {
+        pool_->done_cond_.notify_all();
+        // We have room again to decode ahead.
+        pool_->work_cond_.notify_one();
+    }
+    return res;
+}
+
+void
+read_ahead_source_t::pause()
+{
+    std::unique_lock<std::mutex> lock;
+    if (pool_ != nullptr)
+        lock = std::unique_lock<std::mutex>(pool_->lock_);
+    paused_ = true;
+    while (busy_)
+        pool_->done_cond_.wait(lock);
+}
+
+void
+read_ahead_source_t::resume()
+{
+    std::unique_lock<std::mutex> lock;
+    if (pool_ != nullptr)
+        lock = std::unique_lock<std::mutex>(pool_->lock_);
+    paused_ = false;
+    if (pool_ != nullptr)
+        pool_->work_cond_.notify_one();
+}
+
+void
+read_ahead_source_t::set_priority(priority_t priority)
+{
+    std::unique_lock<std::mutex> lock;
+    if (pool_ != nullptr)
+        lock = std::unique_lock<std::mutex>(pool_->lock_);
+    priority_ = priority;
+}
+
+read_ahead_source_t::stats_t
+read_ahead_source_t::get_stats() const
+{
+    std::unique_lock<std::mutex> lock;
+    if (pool_ != nullptr)
+        lock = std::unique_lock<std::mutex>(pool_->lock_);
+    return stats_;
+}
+
+/**************************************************************************
+ * read_ahead_pool_t
+ */
+
+read_ahead_pool_t::read_ahead_pool_t(int num_threads, int max_blocks)
+    : max_blocks_(max_blocks)
+{
+    threads_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i)
+        threads_.emplace_back(&read_ahead_pool_t::thread_loop, this);
+}
+
+read_ahead_pool_t::~read_ahead_pool_t()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        exiting_ = true;
+    }
+    work_cond_.notify_all();
+    for (std::thread &thread : threads_)
+        thread.join();
+    // No thread is decoding now, and the sources carry on by themselves.
+    for (read_ahead_source_t *source : sources_)
+        source->pool_ = nullptr;
+}
+
+void
+read_ahead_pool_t::add_source(read_ahead_source_t *source)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        sources_.push_back(source);
+    }
+    work_cond_.notify_one();
+}
+
+void
+read_ahead_pool_t::remove_source(read_ahead_source_t *source)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    while (source->busy_)
+        done_cond_.wait(lock);
+    sources_.erase(std::remove(sources_.begin(), sources_.end(), source),
+                   sources_.end());
+}
+
+void
+read_ahead_pool_t::fill_block(read_ahead_source_t *source,
+                              std::unique_lock<std::mutex> &lock)
+{
+    read_ahead_block_t block;
+    bool at_eof = false;
+    lock.unlock();
+    bool res = source->fill_(block, at_eof);
+    lock.lock();
+    source->busy_ = false;
+    if (res)
+        source->blocks_.push_back(std::move(block));
+    else {
+        source->done_ = true;
+        source->done_at_eof_ = at_eof;
+    }
+    done_cond_.notify_all();
+}
+
+void
+read_ahead_pool_t::thread_loop()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    while (!exiting_) {
+        read_ahead_source_t *best = nullptr;
+        for (read_ahead_source_t *source : sources_) {
+            if (!source->wants_block(max_blocks_))
+                continue;
+            if (best == nullptr || source->priority_ > best->priority_ ||
+                (source->priority_ == best->priority_ &&
+                 source->blocks_.size() < best->blocks_.size()))
+                best = source;
+        }
+        if (best == nullptr) {
+            work_cond_.wait(lock);
+            continue;
+        }
+        best->busy_ = true;
+        fill_block(best, lock);
+    }
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,186 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* read_ahead_pool: threads which decompress trace records ahead of the
+ * readers that will consume them.
+ */
+
+#ifndef _READ_AHEAD_POOL_H_
+#define _READ_AHEAD_POOL_H_ 1
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class read_ahead_pool_t;
+
+// A block of consecutive records as decoded from a file.
+struct read_ahead_block_t {
+    std::vector<trace_entry_t> entries;
+    // A format-specific position of the records, such as the index of the
+    // archive component they came from.
+    uint64_t chunk = 0;
+};
+
+// The source of blocks for one reader.  Blocks are decoded by the threads of a
+// read_ahead_pool_t, up to the pool's limit per source, and are handed out in
+// order by next_block().  If none is ready when the reader asks, the reader
+// decodes the block itself unless a pool thread is already doing so, in which
+// case it waits for that block.
+//
+// All state is protected by the pool's lock.  The fill function is never
+// called concurrently for one source.
+class read_ahead_source_t {
+public:
+    // Fills "block" with the next records of the file.  Returns false at the
+    // end of the file or on an error, setting "at_eof" only for the former.
+    typedef std::function<bool(read_ahead_block_t &block, bool &at_eof)> fill_func_t;
+
+    // Registers with "pool".
+    read_ahead_source_t(read_ahead_pool_t *pool, fill_func_t fill);
+    // Waits for any block being decoded for this source and unregisters.
+    ~read_ahead_source_t();
+
+    // Hands the next block to the reader, swapping it into "block".  Returns
+    // false at the end of the file or on an error, setting "at_eof" only for the
+    // former.
+    bool
+    next_block(read_ahead_block_t &block, bool &at_eof);
+
+    // Stops decoding ahead, waiting for any block in progress, so that the
+    // reader can reposition the underlying file.  Blocks already decoded stay
+    // queued for the reader to drop or keep: see queued_blocks().
+    void
+    pause();
+    void
+    resume();
+    // May only be called while paused.
+    std::deque<read_ahead_block_t> &
+    queued_blocks()
+    {
+        return blocks_;
+    }
+
+    // Sources with a higher priority are decoded ahead first.
+    enum priority_t {
+        PRIORITY_IDLE,
+        PRIORITY_RUNNING,
+        PRIORITY_READY,
+    };
+    void
+    set_priority(priority_t priority);
+
+    // Counts of next_block() calls which found a block ready (hits), which
+    // decoded the block inline (misses), and which waited for a pool thread to
+    // finish decoding it (waits).
+    struct stats_t {
+        int64_t hits = 0;
+        int64_t misses = 0;
+        int64_t waits = 0;
+    };
+    stats_t
+    get_stats() const;
+
+private:
+    friend class read_ahead_pool_t;
+
+    // The pool's lock must be held.
+    bool
+    wants_block(int max_blocks) const
+    {
+        return !paused_ && !busy_ && !done_ && blocks_.size() < size_t(max_blocks);
+    }
+
+    read_ahead_pool_t *pool_;
+    fill_func_t fill_;
+    std::deque<read_ahead_block_t> blocks_;
+    // Whether fill_ is being called, by a pool thread or by the reader.
+    bool busy_ = false;
+    bool paused_ = false;
+    // Whether fill_ returned false, whose result is in done_at_eof_.
+    bool done_ = false;
+    bool done_at_eof_ = false;
+    priority_t priority_ = PRIORITY_IDLE;
+    stats_t stats_;
+};
+
+// A set of threads decoding blocks for all registered sources.  The threads
+// pick the source with the highest priority and, among those, the fewest
+// blocks queued.
+class read_ahead_pool_t {
+public:
+    // Each source has up to "max_blocks" blocks decoded ahead.
+    read_ahead_pool_t(int num_threads, int max_blocks);
+    // Stops the threads.  Sources may outlive the pool, after which they
+    // decode every block inline.
+    ~read_ahead_pool_t();
+
+private:
+    friend class read_ahead_source_t;
+
+    void
+    add_source(read_ahead_source_t *source);
+    void
+    remove_source(read_ahead_source_t *source);
+    void
+    thread_loop();
+    // Decodes one block for "source", whose busy_ flag the caller has set, with
+    // the lock released during the decoding.
+    void
+    fill_block(read_ahead_source_t *source, std::unique_lock<std::mutex> &lock);
+
+    const int max_blocks_;
+    std::mutex lock_;
+    // Signaled when a source may want a block or when exiting.
+    std::condition_variable work_cond_;
+    // Signaled when a block has been decoded or a source becomes idle.
+    std::condition_variable done_cond_;
+    std::vector<read_ahead_source_t *> sources_;
+    std::vector<std::thread> threads_;
+    bool exiting_ = false;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _READ_AHEAD_POOL_H_ */
@@ -59,6 +59,9 @@ namespace drmemtrace {
 #    define DR_PARAM_OUT /* just a marker */
 #endif
 
+class read_ahead_pool_t;
+class read_ahead_source_t;
+
 #ifdef DEBUG
 #    define VPRINT(reader, level, ...)                            \
         do {                                                      \
@@ -131,6 +134,16 @@ public:
     virtual reader_t &
     skip_instructions(uint64_t instruction_count);
 
+    // Starts decoding records ahead of this reader on the threads of "pool", if the
+    // file format supports it.  Returns the source of the decoded records, which
+    // remains owned by the reader, or nullptr if the format does not support it.
+    // Must be called after init() and before iterating from any other thread.
+    virtual read_ahead_source_t *
+    enable_read_ahead(read_ahead_pool_t *pool)
+    {
+        return nullptr;
+    }
+
     // Supplied for subclasses that may fail in their constructors.
     virtual bool
     operator!()
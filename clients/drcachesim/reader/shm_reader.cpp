@@ -0,0 +1,132 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "shm_reader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "reader.h"
+#include "../common/memref.h"
+#include "../common/shm_ring.h"
+#include "../common/trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+shm_reader_t::shm_reader_t()
+    : creation_success_(false)
+{
+    /* Empty. */
+}
+
+shm_reader_t::shm_reader_t(const char *shm_name, uint32_t num_rings, size_t ring_size,
+                           int verbosity)
+    : reader_t(verbosity, "SHM")
+    , ring_(shm_name)
+{
+    // As with ipc_reader_t, we create the rings here so the user can launch the
+    // writers *before* calling the blocking analyzer_t::run().
+    creation_success_ = ring_.create(num_rings, ring_size);
+}
+
+// Work around clang-format bug: no newline after return type for single-char operator.
+// clang-format off
+bool
+shm_reader_t::operator!()
+// clang-format on
+{
+    return !creation_success_;
+}
+
+std::string
+shm_reader_t::get_stream_name() const
+{
+    return ring_.get_path();
+}
+
+bool
+shm_reader_t::init()
+{
+    at_eof_ = false;
+    if (!creation_success_ || !ring_.wait_for_writer())
+        return false;
+    cur_buf_ = nullptr;
+    end_buf_ = nullptr;
+    ++*this;
+    return true;
+}
+
+shm_reader_t::~shm_reader_t()
+{
+    if (creation_success_)
+        ring_.destroy();
+}
+
+trace_entry_t *
+shm_reader_t::read_next_entry()
+{
+    trace_entry_t *from_queue = read_queued_entry();
+    if (from_queue != nullptr)
+        return from_queue;
+    if (cur_buf_ != nullptr)
+        ++cur_buf_;
+    while (cur_buf_ >= end_buf_) {
+        // Moving on from a chunk hands its space back to the writer.
+        size_t size;
+        const void *chunk = ring_.next_chunk(&size);
+        if (chunk == nullptr || size % sizeof(trace_entry_t) != 0) {
+            // If called again at eof, do not return the footer: return an error.
+            if (at_eof_)
+                return nullptr;
+            // As for pipes, we cannot tell truncation from a clean end.
+            footer_.type = TRACE_TYPE_FOOTER;
+            footer_.size = 0;
+            footer_.addr = 0;
+            cur_buf_ = &footer_;
+            end_buf_ = cur_buf_ + 1;
+            at_eof_ = true;
+            return cur_buf_;
+        }
+        cur_buf_ = static_cast<trace_entry_t *>(const_cast<void *>(chunk));
+        end_buf_ = cur_buf_ + size / sizeof(trace_entry_t);
+    }
+    if (cur_buf_->type == TRACE_TYPE_FOOTER)
+        at_eof_ = true;
+    return cur_buf_;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
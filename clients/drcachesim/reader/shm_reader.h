@@ -0,0 +1,87 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* shm_reader: obtains memory streams from DR clients running in application
+ * processes through the shared-memory rings of shm_ring_t and presents them via
+ * an iterator interface.  Entries are handed out in place from the rings.
+ */
+
+#ifndef _SHM_READER_H_
+#define _SHM_READER_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "reader.h"
+#include "../common/memref.h"
+#include "../common/shm_ring.h"
+#include "../common/trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class shm_reader_t : public reader_t {
+public:
+    shm_reader_t();
+    shm_reader_t(const char *shm_name, uint32_t num_rings, size_t ring_size,
+                 int verbosity);
+    virtual ~shm_reader_t();
+    bool
+    operator!() override;
+    // This potentially blocks.
+    bool
+    init() override;
+    std::string
+    get_stream_name() const override;
+
+protected:
+    trace_entry_t *
+    read_next_entry() override;
+
+private:
+    shm_ring_t ring_;
+    bool creation_success_;
+
+    // The current chunk, which lives in the shared ring.
+    trace_entry_t *cur_buf_ = nullptr;
+    trace_entry_t *end_buf_ = nullptr;
+    // Synthesized at the end of the trace.
+    trace_entry_t footer_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _SHM_READER_H_ */
@@ -72,60 +72,118 @@ open_single_file_common(const std::string &path, zipfile_reader_t &zread)
     return true;
 }
 
-bool
-read_if_at_end_of_buffer(zipfile_reader_t &zipfile, bool &at_eof,
-                         trace_entry_t last_entry)
+// Reads the next records of the file into "buf", moving on to the next
+// component at the end of the current one.  Returns the number of bytes read,
+// or 0 at the end of the file or on an error, setting at_eof only for the former.
+int
+read_records(zipfile_reader_t &zipfile, void *buf, unsigned int size, bool &at_eof)
 {
-    if (zipfile.cur_buf >= zipfile.max_buf) {
-        int num_read = unzReadCurrentFile(zipfile.file, zipfile.buf, sizeof(zipfile.buf));
-        if (num_read == 0) {
+    int num_read = unzReadCurrentFile(zipfile.file, buf, size);
+    if (num_read == 0) {
 #ifdef DEBUG
-            if (zipfile.verbosity >= 3) {
-                zipfile.name[0] = '\0'; /* Just in case. */
-                // This call is expensive if we do it every time.
-                unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
-                                        sizeof(zipfile.name), nullptr, 0, nullptr, 0);
-                ZPRINT(zipfile.verbosity, 3,
-                       "Hit end of component %s; opening next component in %s\n",
-                       zipfile.name, zipfile.path.c_str());
-            }
+        if (zipfile.verbosity >= 3) {
+            zipfile.name[0] = '\0'; /* Just in case. */
+            // This call is expensive if we do it every time.
+            unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
+                                    sizeof(zipfile.name), nullptr, 0, nullptr, 0);
+            ZPRINT(zipfile.verbosity, 3,
+                   "Hit end of component %s; opening next component in %s\n",
+                   zipfile.name, zipfile.path.c_str());
+        }
 #endif
-            if ((last_entry.type != TRACE_TYPE_MARKER ||
-                 last_entry.size != TRACE_MARKER_TYPE_CHUNK_FOOTER) &&
-                last_entry.type != TRACE_TYPE_FOOTER) {
-                zipfile.name[0] = '\0'; /* Just in case. */
-                unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
-                                        sizeof(zipfile.name), nullptr, 0, nullptr, 0);
-                ZPRINT(zipfile.verbosity, 1,
-                       "Chunk is missing footer: truncation detected in %s %s\n",
-                       zipfile.path.c_str(), zipfile.name);
-                return false;
-            }
-            if (unzCloseCurrentFile(zipfile.file) != UNZ_OK)
-                return false;
-            int res = unzGoToNextFile(zipfile.file);
-            if (res != UNZ_OK) {
-                if (res == UNZ_END_OF_LIST_OF_FILE) {
-                    ZPRINT(zipfile.verbosity, 2, "Hit EOF in %s\n", zipfile.path.c_str());
-                    at_eof = true;
-                }
-                return false;
+        if ((zipfile.last_read.type != TRACE_TYPE_MARKER ||
+             zipfile.last_read.size != TRACE_MARKER_TYPE_CHUNK_FOOTER) &&
+            zipfile.last_read.type != TRACE_TYPE_FOOTER) {
+            zipfile.name[0] = '\0'; /* Just in case. */
+            unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
+                                    sizeof(zipfile.name), nullptr, 0, nullptr, 0);
+            ZPRINT(zipfile.verbosity, 1,
+                   "Chunk is missing footer: truncation detected in %s %s\n",
+                   zipfile.path.c_str(), zipfile.name);
+            return 0;
+        }
+        if (unzCloseCurrentFile(zipfile.file) != UNZ_OK)
+            return 0;
+        int res = unzGoToNextFile(zipfile.file);
+        if (res != UNZ_OK) {
+            if (res == UNZ_END_OF_LIST_OF_FILE) {
+                ZPRINT(zipfile.verbosity, 2, "Hit EOF in %s\n", zipfile.path.c_str());
+                at_eof = true;
             }
-            if (unzOpenCurrentFile(zipfile.file) != UNZ_OK)
+            return 0;
+        }
+        if (unzOpenCurrentFile(zipfile.file) != UNZ_OK)
+            return 0;
+        ++zipfile.component;
+        num_read = unzReadCurrentFile(zipfile.file, buf, size);
+    }
+    if (num_read < static_cast<int>(sizeof(trace_entry_t))) {
+        ZPRINT(zipfile.verbosity, 1, "Failed to read: returned %d in %s\n", num_read,
+               zipfile.path.c_str());
+        return 0;
+    }
+    zipfile.last_read =
+        static_cast<trace_entry_t *>(buf)[num_read / sizeof(trace_entry_t) - 1];
+    return num_read;
+}
+
+bool
+read_if_at_end_of_buffer(zipfile_reader_t &zipfile, bool &at_eof)
+{
+    if (zipfile.cur_buf >= zipfile.max_buf) {
+        if (zipfile.read_ahead) {
+            if (!zipfile.read_ahead->next_block(zipfile.block, at_eof))
                 return false;
-            num_read = unzReadCurrentFile(zipfile.file, zipfile.buf, sizeof(zipfile.buf));
+            zipfile.cur_buf = zipfile.block.entries.data();
+            zipfile.max_buf = zipfile.cur_buf + zipfile.block.entries.size();
+            return true;
         }
-        if (num_read < static_cast<int>(sizeof(trace_entry_t))) {
-            ZPRINT(zipfile.verbosity, 1, "Failed to read: returned %d in %s\n", num_read,
-                   zipfile.path.c_str());
+        int num_read = read_records(zipfile, zipfile.buf, sizeof(zipfile.buf), at_eof);
+        if (num_read == 0)
             return false;
-        }
         zipfile.cur_buf = zipfile.buf;
         zipfile.max_buf = zipfile.buf + (num_read / sizeof(*zipfile.max_buf));
     }
     return true;
 }
 
+// For a skip with decompression ahead, moves the records to be handed out on
+// to the next component, dropping those queued from the current one.  Returns
+// whether blocks from the next component were already queued; if not, the
+// caller must move the file itself to the next component.  The read-ahead
+// source must be paused.
+bool
+skip_queued_component(zipfile_reader_t &zipfile)
+{
+    if (!zipfile.read_ahead)
+        return false;
+    std::deque<read_ahead_block_t> &blocks = zipfile.read_ahead->queued_blocks();
+    uint64_t next = zipfile.block.chunk + 1;
+    while (!blocks.empty() && blocks.front().chunk < next)
+        blocks.pop_front();
+    zipfile.block.chunk = next;
+    return !blocks.empty();
+}
+
+// Pauses decompression ahead, if any, for the lifetime of this object.
+class read_ahead_pause_t {
+public:
+    explicit read_ahead_pause_t(read_ahead_source_t *source)
+        : source_(source)
+    {
+        if (source_ != nullptr)
+            source_->pause();
+    }
+    ~read_ahead_pause_t()
+    {
+        if (source_ != nullptr)
+            source_->resume();
+    }
+
+private:
+    read_ahead_source_t *source_;
+};
+
 } // namespace
 
 /**************************************************
@@ -145,6 +203,8 @@ template <>
 /* clang-format on */
 file_reader_t<zipfile_reader_t>::~file_reader_t()
 {
+    // Stop any decompression ahead before closing the file.
+    input_file_.read_ahead.reset();
     if (input_file_.file != nullptr) {
         unzClose(input_file_.file);
         input_file_.file = nullptr;
@@ -169,7 +229,7 @@ file_reader_t<zipfile_reader_t>::read_next_entry()
     trace_entry_t *from_queue = read_queued_entry();
     if (from_queue != nullptr)
         return from_queue;
-    if (!read_if_at_end_of_buffer(input_file_, at_eof_, entry_copy_))
+    if (!read_if_at_end_of_buffer(input_file_, at_eof_))
         return nullptr;
     entry_copy_ = *input_file_.cur_buf;
     ++input_file_.cur_buf;
@@ -195,6 +255,7 @@ file_reader_t<zipfile_reader_t>::skip_instructions(uint64_t instruction_count)
         return *this;
     }
     zipfile_reader_t *zipfile = &input_file_;
+    read_ahead_pause_t pause(zipfile->read_ahead.get());
     // We assume our unzGoToNextFile loop is plenty performant and we don't need to
     // know the chunk names to use with a single unzLocateFile.
     uint64_t stop_count = cur_instr_count_ + instruction_count + 1;
@@ -207,24 +268,29 @@ file_reader_t<zipfile_reader_t>::skip_instructions(uint64_t instruction_count)
     while (cur_instr_count_ +
                (chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_)) <
            stop_count) {
-        if (unzCloseCurrentFile(zipfile->file) != UNZ_OK) {
-            VPRINT(this, 1, "Failed to close zip subfile\n");
-            at_eof_ = true;
-            return *this;
-        }
-        int res = unzGoToNextFile(zipfile->file);
-        if (res != UNZ_OK) {
-            if (res == UNZ_END_OF_LIST_OF_FILE)
-                VPRINT(this, 2, "Hit EOF\n");
-            else
-                VPRINT(this, 2, "Failed to go to next zip subfile\n");
-            at_eof_ = true;
-            return *this;
-        }
-        if (unzOpenCurrentFile(zipfile->file) != UNZ_OK) {
-            VPRINT(this, 1, "Failed to open zip subfile\n");
-            at_eof_ = true;
-            return *this;
+        if (skip_queued_component(*zipfile)) {
+            VPRINT(this, 3, "Next chunk was already decompressed\n");
+        } else {
+            if (unzCloseCurrentFile(zipfile->file) != UNZ_OK) {
+                VPRINT(this, 1, "Failed to close zip subfile\n");
+                at_eof_ = true;
+                return *this;
+            }
+            int res = unzGoToNextFile(zipfile->file);
+            if (res != UNZ_OK) {
+                if (res == UNZ_END_OF_LIST_OF_FILE)
+                    VPRINT(this, 2, "Hit EOF\n");
+                else
+                    VPRINT(this, 2, "Failed to go to next zip subfile\n");
+                at_eof_ = true;
+                return *this;
+            }
+            if (unzOpenCurrentFile(zipfile->file) != UNZ_OK) {
+                VPRINT(this, 1, "Failed to open zip subfile\n");
+                at_eof_ = true;
+                return *this;
+            }
+            ++zipfile->component;
         }
         cur_instr_count_ += chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_);
         VPRINT(this, 2, "At %" PRIu64 " instrs at start of new chunk\n",
@@ -245,6 +311,30 @@ file_reader_t<zipfile_reader_t>::skip_instructions(uint64_t instruction_count)
     return skip_instructions_with_timestamp(stop_count - 1);
 }
 
+template <>
+read_ahead_source_t *
+file_reader_t<zipfile_reader_t>::enable_read_ahead(read_ahead_pool_t *pool)
+{
+    if (input_file_.file == nullptr)
+        return nullptr;
+    if (!input_file_.read_ahead) {
+        zipfile_reader_t *zipfile = &input_file_;
+        // Any records already in zipfile->buf are handed out first.
+        zipfile->block.chunk = zipfile->component;
+        zipfile->read_ahead.reset(new read_ahead_source_t(
+            pool, [zipfile](read_ahead_block_t &block, bool &at_eof) {
+                block.entries.resize(sizeof(zipfile->buf) / sizeof(*zipfile->buf));
+                int num_read =
+                    read_records(*zipfile, block.entries.data(),
+                                 static_cast<unsigned int>(sizeof(zipfile->buf)), at_eof);
+                block.entries.resize(num_read / sizeof(trace_entry_t));
+                block.chunk = zipfile->component;
+                return num_read > 0;
+            }));
+    }
+    return input_file_.read_ahead.get();
+}
+
 /*********************************************************
  * zipfile_reader_t specializations for record_file_reader_t.
  */
@@ -254,12 +344,12 @@ template <>
 /* clang-format on */
 record_file_reader_t<zipfile_reader_t>::record_file_reader_t()
 {
-    input_file_->file = nullptr;
 }
 
 template <> record_file_reader_t<zipfile_reader_t>::~record_file_reader_t()
 {
-    if (input_file_->file != nullptr) {
+    // input_file_ is null for the end-of-trace sentinel.
+    if (input_file_ != nullptr && input_file_->file != nullptr) {
         unzClose(input_file_->file);
         input_file_->file = nullptr;
     }
@@ -272,7 +362,8 @@ record_file_reader_t<zipfile_reader_t>::open_single_file(const std::string &path
     zipfile_reader_t zread;
     if (!open_single_file_common(path, zread))
         return false;
-    input_file_ = std::unique_ptr<zipfile_reader_t>(new zipfile_reader_t(zread));
+    input_file_ =
+        std::unique_ptr<zipfile_reader_t>(new zipfile_reader_t(std::move(zread)));
     VPRINT(this, 1, "Opened input file %s\n", path.c_str());
     input_file_->verbosity = verbosity_;
     return true;
@@ -282,7 +373,7 @@ template <>
 bool
 record_file_reader_t<zipfile_reader_t>::read_next_entry()
 {
-    if (!read_if_at_end_of_buffer(*input_file_, eof_, cur_entry_))
+    if (!read_if_at_end_of_buffer(*input_file_, eof_))
         return false;
     cur_entry_ = *input_file_->cur_buf;
     ++input_file_->cur_buf;
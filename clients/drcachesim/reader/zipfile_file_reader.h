@@ -36,8 +36,13 @@
 #define _ZIPFILE_FILE_READER_H_ 1
 
 #include <zlib.h>
+
+#include <memory>
+#include <string>
+
 #include "minizip/unzip.h"
 #include "file_reader.h"
+#include "read_ahead_pool.h"
 #include "record_file_reader.h"
 
 namespace dynamorio {
@@ -64,6 +69,17 @@ struct zipfile_reader_t {
     trace_entry_t buf[4096];
     trace_entry_t *cur_buf = buf;
     trace_entry_t *max_buf = buf;
+    // The index of the component the file is positioned in.
+    uint64_t component = 0;
+    // The last record read from the file, to check that each component ends in
+    // a footer.
+    trace_entry_t last_read = {};
+    // Set if records are decompressed ahead by a read_ahead_pool_t, in which
+    // case cur_buf and max_buf point into "block" rather than "buf" and
+    // "component" is ahead of the component of the records being handed out,
+    // which is block.chunk.
+    std::unique_ptr<read_ahead_source_t> read_ahead;
+    read_ahead_block_t block;
     // Store the path and component names for debug messages.
     std::string path;
     char name[128];
@@ -79,6 +95,9 @@ typedef record_file_reader_t<zipfile_reader_t> zipfile_record_file_reader_t;
 template <>
 reader_t &
 file_reader_t<zipfile_reader_t>::skip_instructions(uint64_t instruction_count);
+template <>
+read_ahead_source_t *
+file_reader_t<zipfile_reader_t>::enable_read_ahead(read_ahead_pool_t *pool);
 
 } // namespace drmemtrace
 } // namespace dynamorio
@@ -0,0 +1,316 @@
+/* **********************************************************
+ * Copyright (c) 2024 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "zstd_file_reader.h"
+#include <inttypes.h>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**************************************************************************
+ * Common logic used in the zstd_reader_t specializations for file_reader_t
+ * and record_file_reader_t.
+ */
+
+namespace {
+
+#ifdef DEBUG
+// We use the VPRINT from reader.h for member function code.
+// For common routines we need a separate variant taking verbosity in directly.
+#    define ZPRINT(verbosity, level, ...)     \
+        do {                                  \
+            if (verbosity >= (level)) {       \
+                fprintf(stderr, __VA_ARGS__); \
+            }                                 \
+        } while (0)
+#else
+#    define ZPRINT(verbosity, level, ...) /* nothing */
+#endif
+
+bool
+open_single_file_common(const std::string &path, zstd_reader_t &zread)
+{
+    zstd_archive_reader_t *file = new zstd_archive_reader_t(path);
+    if (!file->is_open()) {
+        delete file;
+        return false;
+    }
+    zread.file = file;
+    zread.path = path;
+    int64_t table_component = file->find_component(INSTR_TABLE_COMPONENT_NAME);
+    if (table_component < 0)
+        return true;
+    // Load the whole table up front; the trace components refer to its entries
+    // by index.
+    std::string table;
+    bool ok = file->open_component(static_cast<size_t>(table_component));
+    char buf[4096];
+    int64_t num_read = 0;
+    while (ok && (num_read = file->read(buf, sizeof(buf))) > 0)
+        table.append(buf, static_cast<size_t>(num_read));
+    zread.table = new instr_table_decoder_t;
+    zread.table_component = static_cast<size_t>(table_component);
+    if (!ok || num_read < 0 || !zread.table->init(table) || table_component == 0 ||
+        !file->open_component(0)) {
+        ZPRINT(zread.verbosity, 1, "Failed to read instruction table in %s\n",
+               path.c_str());
+        delete zread.table;
+        zread.table = nullptr;
+        delete file;
+        zread.file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+// Fills "dst" with up to "size" bytes of trace records from the current component,
+// decoding them if the archive has an instruction table.  Returns 0 at the end of
+// the component and -1 on an error.
+int64_t
+read_records(zstd_reader_t &zstd, trace_entry_t *dst, size_t size)
+{
+    if (zstd.table == nullptr)
+        return zstd.file->read(dst, size);
+    int64_t count =
+        zstd.table->decode(dst, size / sizeof(*dst), [&zstd](void *buf, size_t len) {
+            return zstd.file->read(buf, len);
+        });
+    if (count < 0)
+        return -1;
+    return count * sizeof(*dst);
+}
+
+bool
+read_if_at_end_of_buffer(zstd_reader_t &zstd, bool &at_eof, trace_entry_t last_entry)
+{
+    if (zstd.cur_buf >= zstd.max_buf) {
+        int64_t num_read = read_records(zstd, zstd.buf, sizeof(zstd.buf));
+        if (num_read == 0) {
+            ZPRINT(zstd.verbosity, 3,
+                   "Hit end of component #%zu; opening next component in %s\n",
+                   zstd.file->cur_component(), zstd.path.c_str());
+            // Only archives written by raw2trace are known to be split at chunk
+            // boundaries; a plain zstd file may have arbitrary frames.
+            if (zstd.file->has_index() &&
+                (last_entry.type != TRACE_TYPE_MARKER ||
+                 last_entry.size != TRACE_MARKER_TYPE_CHUNK_FOOTER) &&
+                last_entry.type != TRACE_TYPE_FOOTER) {
+                ZPRINT(zstd.verbosity, 1,
+                       "Chunk is missing footer: truncation detected in %s %s\n",
+                       zstd.path.c_str(),
+                       zstd.file->component_name(zstd.file->cur_component()).c_str());
+                return false;
+            }
+            if (!zstd.file->next_component() ||
+                (zstd.table != nullptr &&
+                 zstd.file->cur_component() == zstd.table_component)) {
+                ZPRINT(zstd.verbosity, 2, "Hit EOF in %s\n", zstd.path.c_str());
+                at_eof = true;
+                return false;
+            }
+            if (zstd.table != nullptr)
+                zstd.table->start_component();
+            num_read = read_records(zstd, zstd.buf, sizeof(zstd.buf));
+        }
+        if (num_read < static_cast<int64_t>(sizeof(trace_entry_t)) ||
+            num_read % sizeof(trace_entry_t) != 0) {
+            ZPRINT(zstd.verbosity, 1, "Failed to read: returned %" PRId64 " in %s\n",
+                   num_read, zstd.path.c_str());
+            return false;
+        }
+        zstd.cur_buf = zstd.buf;
+        zstd.max_buf = zstd.buf + (num_read / sizeof(*zstd.max_buf));
+    }
+    return true;
+}
+
+} // namespace
+
+/**************************************************
+ * zstd_reader_t specializations for file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<zstd_reader_t>::file_reader_t()
+{
+    input_file_.file = nullptr;
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<zstd_reader_t>::~file_reader_t()
+{
+    if (input_file_.file != nullptr) {
+        delete input_file_.file;
+        input_file_.file = nullptr;
+    }
+    delete input_file_.table;
+    input_file_.table = nullptr;
+}
+
+template <>
+bool
+file_reader_t<zstd_reader_t>::open_single_file(const std::string &path)
+{
+    if (!open_single_file_common(path, input_file_))
+        return false;
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_.verbosity = verbosity_;
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<zstd_reader_t>::read_next_entry()
+{
+    trace_entry_t *from_queue = read_queued_entry();
+    if (from_queue != nullptr)
+        return from_queue;
+    if (!read_if_at_end_of_buffer(input_file_, at_eof_, entry_copy_))
+        return nullptr;
+    entry_copy_ = *input_file_.cur_buf;
+    ++input_file_.cur_buf;
+    VPRINT(this, 5, "Read %s: type=%s (%d), size=%d, addr=%zu\n",
+           input_file_.path.c_str(), trace_type_names[entry_copy_.type], entry_copy_.type,
+           entry_copy_.size, entry_copy_.addr);
+    return &entry_copy_;
+}
+
+template <>
+reader_t &
+file_reader_t<zstd_reader_t>::skip_instructions(uint64_t instruction_count)
+{
+    if (instruction_count == 0)
+        return *this;
+    VPRINT(this, 2, "Skipping %" PRIu64 " instrs in %s\n", instruction_count,
+           input_file_.path.c_str());
+    if (!pre_skip_instructions())
+        return *this;
+    if (chunk_instr_count_ == 0) {
+        VPRINT(this, 1, "Failed to record chunk instr count\n");
+        at_eof_ = true;
+        return *this;
+    }
+    zstd_archive_reader_t *file = input_file_.file;
+    uint64_t stop_count = cur_instr_count_ + instruction_count + 1;
+    // First, find how many whole chunks lie before the chunk containing the target.
+    uint64_t skip_chunks = 0;
+    while (cur_instr_count_ +
+               (chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_)) <
+           stop_count) {
+        cur_instr_count_ += chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_);
+        ++skip_chunks;
+    }
+    if (skip_chunks > 0) {
+        // With the archive index we seek straight to the target chunk's frame,
+        // without decompressing anything in between.
+        bool ok;
+        if (input_file_.table != nullptr &&
+            file->cur_component() + skip_chunks >= input_file_.table_component)
+            ok = false;
+        else if (file->has_index())
+            ok = file->open_component(file->cur_component() + skip_chunks);
+        else {
+            ok = true;
+            for (uint64_t i = 0; ok && i < skip_chunks; ++i)
+                ok = file->next_component();
+        }
+        if (!ok) {
+            VPRINT(this, 2, "Hit EOF\n");
+            at_eof_ = true;
+            return *this;
+        }
+        VPRINT(this, 2,
+               "Skipped %" PRIu64 " chunks to %" PRIu64 " instrs in component #%zu\n",
+               skip_chunks, cur_instr_count_, file->cur_component());
+        // Clear cached data from the prior chunk.
+        input_file_.cur_buf = input_file_.max_buf;
+        if (input_file_.table != nullptr)
+            input_file_.table->start_component();
+    }
+    // Now do a linear walk the rest of the way, remembering timestamps (we have
+    // duplicated timestamps at the start of the chunk to cover any skipped in
+    // the fast chunk jump we just did).
+    // Subtract 1 to pass the target instr itself.
+    return skip_instructions_with_timestamp(stop_count - 1);
+}
+
+/*********************************************************
+ * zstd_reader_t specializations for record_file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+record_file_reader_t<zstd_reader_t>::~record_file_reader_t()
+{
+    if (input_file_ != nullptr) {
+        delete input_file_->file;
+        input_file_->file = nullptr;
+        delete input_file_->table;
+        input_file_->table = nullptr;
+    }
+}
+
+template <>
+bool
+record_file_reader_t<zstd_reader_t>::open_single_file(const std::string &path)
+{
+    zstd_reader_t zread;
+    if (!open_single_file_common(path, zread))
+        return false;
+    input_file_ = std::unique_ptr<zstd_reader_t>(new zstd_reader_t(zread));
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_->verbosity = verbosity_;
+    return true;
+}
+
+template <>
+bool
+record_file_reader_t<zstd_reader_t>::read_next_entry()
+{
+    if (!read_if_at_end_of_buffer(*input_file_, eof_, cur_entry_))
+        return false;
+    cur_entry_ = *input_file_->cur_buf;
+    ++input_file_->cur_buf;
+    VPRINT(this, 5, "Read %s: type=%s (%d), size=%d, addr=%zu\n",
+           input_file_->path.c_str(), trace_type_names[cur_entry_.type], cur_entry_.type,
+           cur_entry_.size, cur_entry_.addr);
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
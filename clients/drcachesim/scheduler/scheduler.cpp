@@ -59,6 +59,9 @@
 #ifdef HAS_LZ4
 #    include "lz4_file_reader.h"
 #endif
+#ifdef HAS_ZSTD
+#    include "zstd_file_reader.h"
+#endif
 #ifdef HAS_ZLIB
 #    include "compressed_file_reader.h"
 #endif
@@ -70,6 +73,9 @@
 #ifdef HAS_SNAPPY
 #    include "snappy_file_reader.h"
 #endif
+#ifdef UNIX
+#    include "mmap_file_reader.h"
+#endif
 #include "directory_iterator.h"
 #include "utils.h"
 
@@ -137,12 +143,16 @@ template <>
 std::unique_ptr<reader_t>
 scheduler_tmpl_t<memref_t, reader_t>::get_reader(const std::string &path, int verbosity)
 {
-#if defined(HAS_SNAPPY) || defined(HAS_ZIP) || defined(HAS_LZ4)
+#if defined(HAS_SNAPPY) || defined(HAS_ZIP) || defined(HAS_LZ4) || defined(HAS_ZSTD)
 #    ifdef HAS_LZ4
     if (ends_with(path, ".lz4")) {
         return std::unique_ptr<reader_t>(new lz4_file_reader_t(path, verbosity));
     }
 #    endif
+#    ifdef HAS_ZSTD
+    if (ends_with(path, ".zst"))
+        return std::unique_ptr<reader_t>(new zstd_file_reader_t(path, verbosity));
+#    endif
 #    ifdef HAS_SNAPPY
     if (ends_with(path, ".sz"))
         return std::unique_ptr<reader_t>(new snappy_file_reader_t(path, verbosity));
@@ -187,14 +197,32 @@ scheduler_tmpl_t<memref_t, reader_t>::get_reader(const std::string &path, int ve
             if (ends_with(path, ".lz4")) {
                 return std::unique_ptr<reader_t>(new lz4_file_reader_t(path, verbosity));
             }
+#    endif
+#    ifdef HAS_ZSTD
+            if (ends_with(*iter, ".zst")) {
+                return std::unique_ptr<reader_t>(
+                    new zstd_file_reader_t(path, verbosity));
+            }
 #    endif
         }
     }
+#endif
+#ifdef UNIX
+    // An uncompressed file is mapped rather than read through a stream.
+    if (!directory_iterator_t::is_directory(path) && is_mmap_trace_file(path))
+        return std::unique_ptr<reader_t>(new mmap_file_reader_t(path, verbosity));
 #endif
     // No snappy/zlib support, or didn't find a .sz/.zip file.
     return std::unique_ptr<reader_t>(new default_file_reader_t(path, verbosity));
 }
 
+template <>
+read_ahead_source_t *
+scheduler_tmpl_t<memref_t, reader_t>::enable_read_ahead(input_info_t &input)
+{
+    return input.reader->enable_read_ahead(read_ahead_pool_.get());
+}
+
 template <>
 bool
 scheduler_tmpl_t<memref_t, reader_t>::record_type_has_tid(memref_t record,
@@ -370,11 +398,31 @@ scheduler_tmpl_t<trace_entry_t, record_reader_t>::get_reader(const std::string &
         return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
             new zipfile_record_file_reader_t(path, verbosity));
     }
+#endif
+#ifdef HAS_ZSTD
+    if (ends_with(path, ".zst")) {
+        return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
+            new zstd_record_file_reader_t(path, verbosity));
+    }
+#endif
+#ifdef UNIX
+    if (!directory_iterator_t::is_directory(path) && is_mmap_trace_file(path)) {
+        return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
+            new mmap_record_file_reader_t(path, verbosity));
+    }
 #endif
     return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
         new default_record_file_reader_t(path, verbosity));
 }
 
+template <>
+read_ahead_source_t *
+scheduler_tmpl_t<trace_entry_t, record_reader_t>::enable_read_ahead(input_info_t &input)
+{
+    // TODO: Add read-ahead support to the record readers.
+    return nullptr;
+}
+
 template <>
 bool
 scheduler_tmpl_t<trace_entry_t, record_reader_t>::record_type_has_tid(
@@ -808,6 +856,13 @@ scheduler_tmpl_t<RecordType, ReaderType>::init(
             }
         }
     }
+    if (options_.mapping != MAP_TO_ANY_OUTPUT)
+        options_.per_output_ready_queues = false;
+    int num_queues = options_.per_output_ready_queues ? output_count : 1;
+    int rand_seed = static_cast<int>(get_time_micros());
+    ready_queues_.reserve(num_queues);
+    for (int i = 0; i < num_queues; ++i)
+        ready_queues_.emplace_back(new ready_queue_t(rand_seed + i));
     VPRINT(this, 1, "%zu inputs\n", inputs_.size());
     live_input_count_.store(static_cast<int>(inputs_.size()), std::memory_order_release);
 
@@ -815,6 +870,24 @@ scheduler_tmpl_t<RecordType, ReaderType>::init(
     if (res != sched_type_t::STATUS_SUCCESS)
         return STATUS_ERROR_INVALID_PARAMETER;
 
+    if (options_.read_ahead_threads > 0) {
+        if (options_.read_ahead_blocks <= 0)
+            return STATUS_ERROR_INVALID_PARAMETER;
+        read_ahead_pool_ = std::unique_ptr<read_ahead_pool_t>(new read_ahead_pool_t(
+            options_.read_ahead_threads, options_.read_ahead_blocks));
+        int num_enabled = 0;
+        for (auto &input : inputs_) {
+            // Readers supplied by the user are not initialized until first use.
+            if (input.needs_init)
+                continue;
+            input.read_ahead = enable_read_ahead(input);
+            if (input.read_ahead != nullptr)
+                ++num_enabled;
+        }
+        VPRINT(this, 1, "Reading ahead for %d of %zu inputs on %d threads\n",
+               num_enabled, inputs_.size(), options_.read_ahead_threads);
+    }
+
     return set_initial_schedule(workload2inputs);
 }
 
@@ -948,8 +1021,36 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_initial_schedule(
         // We need to honor output bindings and possibly time ordering, which our queue
         // does for us.  We want the rest of the inputs in the queue in any case so it is
         // simplest to insert all and remove the first N.
-        for (int i = 0; i < static_cast<input_ordinal_t>(inputs_.size()); ++i) {
-            add_to_ready_queue(&inputs_[i]);
+        if (options_.per_output_ready_queues) {
+            // Deal the inputs out to the per-output queues in priority order so each
+            // output starts with a similar mix.  We assign the FIFO counters up front
+            // in input order to break ties the same way a single queue would.
+            std::vector<input_info_t *> sorted;
+            sorted.reserve(inputs_.size());
+            for (int i = 0; i < static_cast<input_ordinal_t>(inputs_.size()); ++i) {
+                inputs_[i].queue_counter = ++ready_counter_;
+                sorted.push_back(&inputs_[i]);
+            }
+            std::stable_sort(sorted.begin(), sorted.end(),
+                             [](input_info_t *a, input_info_t *b) {
+                                 return InputTimestampComparator()(b, a);
+                             });
+            output_ordinal_t next_output = 0;
+            for (input_info_t *input : sorted) {
+                if (input->unscheduled && input->blocked_time == 0) {
+                    add_to_unscheduled_queue(input);
+                    continue;
+                }
+                output_ordinal_t target = choose_output_for_input(next_output, input);
+                if (target == next_output) {
+                    next_output = (next_output + 1) % static_cast<int>(outputs_.size());
+                }
+                add_to_ready_queue_hold_locks(target, input);
+            }
+        } else {
+            for (int i = 0; i < static_cast<input_ordinal_t>(inputs_.size()); ++i) {
+                add_to_ready_queue(0, &inputs_[i]);
+            }
         }
         for (int i = 0; i < static_cast<output_ordinal_t>(outputs_.size()); ++i) {
             input_info_t *queue_next;
@@ -2325,11 +2426,35 @@ scheduler_tmpl_t<RecordType, ReaderType>::close_schedule_segment(output_ordinal_
     return sched_type_t::STATUS_OK;
 }
 
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::stats_lock_t
+scheduler_tmpl_t<RecordType, ReaderType>::acquire_sched_lock(output_ordinal_t output)
+{
+    return stats_lock_t(sched_lock_, output < 0 ? nullptr : outputs_[output].stats,
+                        SCHED_STAT_SCHED_LOCK_ACQUISITIONS,
+                        SCHED_STAT_SCHED_LOCK_HOLD_NANOS);
+}
+
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::stats_lock_t
+scheduler_tmpl_t<RecordType, ReaderType>::acquire_ready_queue_lock(
+    output_ordinal_t queue_output, output_ordinal_t for_output)
+{
+    if (!options_.per_output_ready_queues)
+        return stats_lock_t();
+    return stats_lock_t(get_ready_queue(queue_output).lock,
+                        for_output < 0 ? nullptr : outputs_[for_output].stats,
+                        SCHED_STAT_RUNQUEUE_LOCK_ACQUISITIONS,
+                        SCHED_STAT_RUNQUEUE_LOCK_HOLD_NANOS);
+}
+
 template <typename RecordType, typename ReaderType>
 bool
-scheduler_tmpl_t<RecordType, ReaderType>::ready_queue_empty()
+scheduler_tmpl_t<RecordType, ReaderType>::ready_queue_empty(output_ordinal_t output)
 {
-    return ready_priority_.empty();
+    if (options_.per_output_ready_queues)
+        return get_ready_queue(output).approx_size.load(std::memory_order_acquire) == 0;
+    return get_ready_queue(output).queue.empty();
 }
 
 template <typename RecordType, typename ReaderType>
@@ -2346,42 +2471,205 @@ scheduler_tmpl_t<RecordType, ReaderType>::add_to_unscheduled_queue(input_info_t
 
 template <typename RecordType, typename ReaderType>
 void
-scheduler_tmpl_t<RecordType, ReaderType>::add_to_ready_queue(input_info_t *input)
+scheduler_tmpl_t<RecordType, ReaderType>::add_to_ready_queue(output_ordinal_t output,
+                                                             input_info_t *input)
 {
     if (input->unscheduled && input->blocked_time == 0) {
-        add_to_unscheduled_queue(input);
+        if (options_.per_output_ready_queues) {
+            auto lock = acquire_sched_lock(output);
+            add_to_unscheduled_queue(input);
+        } else
+            add_to_unscheduled_queue(input);
         return;
     }
+    output_ordinal_t queue_output = choose_output_for_input(output, input);
+    auto lock = acquire_ready_queue_lock(queue_output, output);
+    add_to_ready_queue_hold_locks(queue_output, input);
+}
+
+template <typename RecordType, typename ReaderType>
+void
+scheduler_tmpl_t<RecordType, ReaderType>::add_to_ready_queue_hold_locks(
+    output_ordinal_t queue_output, input_info_t *input)
+{
+    assert(!input->unscheduled ||
+           input->blocked_time > 0); // Else should be in unscheduled_priority_.
+    ready_queue_t &ready = get_ready_queue(queue_output);
     VPRINT(
         this, 4,
-        "add_to_ready_queue (pre-size %zu): input %d priority %d timestamp delta %" PRIu64
-        " block time %" PRIu64 " start time %" PRIu64 "\n",
-        ready_priority_.size(), input->index, input->priority,
+        "add_to_ready_queue[%d] (pre-size %zu): input %d priority %d timestamp delta "
+        "%" PRIu64 " block time %" PRIu64 " start time %" PRIu64 "\n",
+        queue_output, ready.queue.size(), input->index, input->priority,
         input->reader->get_last_timestamp() - input->base_timestamp, input->blocked_time,
         input->blocked_start_time);
     if (input->blocked_time > 0)
-        ++num_blocked_;
+        ++ready.num_blocked;
+    // A blocked input is not expected to run soon, so its records can wait.
+    set_read_ahead_priority(*input,
+                            input->blocked_time > 0
+                                ? read_ahead_source_t::PRIORITY_IDLE
+                                : read_ahead_source_t::PRIORITY_READY);
     input->queue_counter = ++ready_counter_;
-    ready_priority_.push(input);
+    ready.queue.push(input);
+    ready.update_approx_size();
 }
 
 template <typename RecordType, typename ReaderType>
-typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
-scheduler_tmpl_t<RecordType, ReaderType>::pop_from_ready_queue(
-    output_ordinal_t for_output, input_info_t *&new_input)
+typename scheduler_tmpl_t<RecordType, ReaderType>::output_ordinal_t
+scheduler_tmpl_t<RecordType, ReaderType>::choose_output_for_input(output_ordinal_t output,
+                                                                  input_info_t *input)
+{
+    if (!options_.per_output_ready_queues)
+        return 0;
+    auto allowed = [input](output_ordinal_t candidate) {
+        return input->binding.empty() ||
+            input->binding.find(candidate) != input->binding.end();
+    };
+    if (output != INVALID_OUTPUT_ORDINAL &&
+        outputs_[output].active->load(std::memory_order_acquire) && allowed(output))
+        return output;
+    // Pick the shortest queue, preferring active outputs.
+    output_ordinal_t best = INVALID_OUTPUT_ORDINAL;
+    bool best_active = false;
+    int best_size = 0;
+    for (output_ordinal_t i = 0; i < static_cast<output_ordinal_t>(outputs_.size());
+         ++i) {
+        if (!allowed(i))
+            continue;
+        bool active = outputs_[i].active->load(std::memory_order_acquire);
+        int size = get_ready_queue(i).approx_size.load(std::memory_order_acquire);
+        if (best == INVALID_OUTPUT_ORDINAL || (active && !best_active) ||
+            (active == best_active && size < best_size)) {
+            best = i;
+            best_active = active;
+            best_size = size;
+        }
+    }
+    if (best == INVALID_OUTPUT_ORDINAL) {
+        // The binding names no existing output.  Such an input can never be
+        // scheduled, just like with a single queue.
+        best = output == INVALID_OUTPUT_ORDINAL ? 0 : output;
+    }
+    return best;
+}
+
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::output_ordinal_t
+scheduler_tmpl_t<RecordType, ReaderType>::find_in_ready_queues(
+    input_info_t *input, output_ordinal_t for_output, stats_lock_t &queue_lock)
+{
+    for (output_ordinal_t i = 0; i < static_cast<output_ordinal_t>(ready_queues_.size());
+         ++i) {
+        auto lock = acquire_ready_queue_lock(i, for_output);
+        if (ready_queues_[i]->queue.find(input)) {
+            queue_lock = std::move(lock);
+            return i;
+        }
+    }
+    return INVALID_OUTPUT_ORDINAL;
+}
+
+template <typename RecordType, typename ReaderType>
+void
+scheduler_tmpl_t<RecordType, ReaderType>::requeue_displaced_inputs(
+    output_ordinal_t for_output, const std::vector<input_info_t *> &displaced)
+{
+    for (input_info_t *input : displaced) {
+        output_ordinal_t target = choose_output_for_input(INVALID_OUTPUT_ORDINAL, input);
+        VPRINT(this, 3, "requeue_displaced_inputs[%d]: input %d => output %d\n",
+               for_output, input->index, target);
+        auto lock = acquire_ready_queue_lock(target, for_output);
+        ready_queue_t &ready = get_ready_queue(target);
+        if (input->blocked_time > 0)
+            ++ready.num_blocked;
+        // Keep the prior counter to preserve FIFO order.
+        ready.queue.push(input);
+        ready.update_approx_size();
+    }
+}
+
+template <typename RecordType, typename ReaderType>
+void
+scheduler_tmpl_t<RecordType, ReaderType>::rebalance_queues_if_due(output_ordinal_t output)
 {
+    if (!options_.per_output_ready_queues || options_.rebalance_period_us == 0 ||
+        outputs_.size() < 2)
+        return;
+    uint64_t cur_time = get_output_time(output);
+    uint64_t next_time = next_rebalance_time_.load(std::memory_order_acquire);
+    if (next_time == 0) {
+        // The first call starts the clock.
+        next_rebalance_time_.compare_exchange_strong(
+            next_time, cur_time + options_.rebalance_period_us);
+        return;
+    }
+    // Only one output performs each rebalance.
+    if (cur_time < next_time ||
+        !next_rebalance_time_.compare_exchange_strong(
+            next_time, cur_time + options_.rebalance_period_us))
+        return;
+    ++outputs_[output].stats[SCHED_STAT_RUNQUEUE_REBALANCES];
+    // Moving inputs across queues requires sched_lock_.
+    auto scoped_lock = acquire_sched_lock(output);
+    int total = 0;
+    int num_active = 0;
+    for (output_ordinal_t i = 0; i < static_cast<output_ordinal_t>(outputs_.size());
+         ++i) {
+        total += get_ready_queue(i).approx_size.load(std::memory_order_acquire);
+        if (outputs_[i].active->load(std::memory_order_acquire))
+            ++num_active;
+    }
+    if (num_active == 0)
+        return;
+    int limit = (total + num_active - 1) / num_active;
+    std::vector<input_info_t *> displaced;
+    for (output_ordinal_t i = 0; i < static_cast<output_ordinal_t>(outputs_.size());
+         ++i) {
+        int max_size = outputs_[i].active->load(std::memory_order_acquire) ? limit : 0;
+        ready_queue_t &ready = get_ready_queue(i);
+        if (ready.approx_size.load(std::memory_order_acquire) <= max_size)
+            continue;
+        auto lock = acquire_ready_queue_lock(i, output);
+        std::vector<input_info_t *> kept;
+        while (static_cast<int>(ready.queue.size()) > max_size) {
+            input_info_t *input = ready.queue.top();
+            ready.queue.pop();
+            // Inputs bound to just this output have nowhere else to go.
+            if (input->binding.size() == 1 &&
+                input->binding.find(i) != input->binding.end()) {
+                kept.push_back(input);
+                continue;
+            }
+            if (input->blocked_time > 0)
+                --ready.num_blocked;
+            displaced.push_back(input);
+        }
+        for (input_info_t *input : kept)
+            ready.queue.push(input);
+        ready.update_approx_size();
+    }
+    VPRINT(this, 2, "rebalance_queues[%d]: limit %d; moving %zu inputs\n", output, limit,
+           displaced.size());
+    requeue_displaced_inputs(output, displaced);
+}
+
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::input_info_t *
+scheduler_tmpl_t<RecordType, ReaderType>::pop_from_ready_queue_hold_locks(
+    output_ordinal_t queue_output, output_ordinal_t for_output, bool &found_blocked)
+{
+    ready_queue_t &ready = get_ready_queue(queue_output);
     std::set<input_info_t *> skipped;
     std::set<input_info_t *> blocked;
     input_info_t *res = nullptr;
-    sched_type_t::stream_status_t status = STATUS_OK;
-    uint64_t cur_time = (num_blocked_ > 0) ? get_output_time(for_output) : 0;
-    while (!ready_priority_.empty()) {
+    uint64_t cur_time = (ready.num_blocked > 0) ? get_output_time(for_output) : 0;
+    while (!ready.queue.empty()) {
         if (options_.randomize_next_input) {
-            res = ready_priority_.get_random_entry();
-            ready_priority_.erase(res);
+            res = ready.queue.get_random_entry();
+            ready.queue.erase(res);
         } else {
-            res = ready_priority_.top();
-            ready_priority_.pop();
+            res = ready.queue.top();
+            ready.queue.pop();
         }
         assert(!res->unscheduled ||
                res->blocked_time > 0); // Should be in unscheduled_priority_.
@@ -2391,7 +2679,7 @@ scheduler_tmpl_t<RecordType, ReaderType>::pop_from_ready_queue(
             // would be chosen to run.  We thus keep blocked inputs in the ready queue.
             if (res->blocked_time > 0) {
                 assert(cur_time > 0);
-                --num_blocked_;
+                --ready.num_blocked;
             }
             if (res->blocked_time > 0 &&
                 cur_time - res->blocked_start_time < res->blocked_time) {
@@ -2408,38 +2696,72 @@ scheduler_tmpl_t<RecordType, ReaderType>::pop_from_ready_queue(
         }
         res = nullptr;
     }
-    if (res == nullptr && !blocked.empty()) {
-        // Do not hand out EOF thinking we're done: we still have inputs blocked
-        // on i/o, so just wait and retry.
-        status = STATUS_IDLE;
-    }
+    if (res == nullptr && !blocked.empty())
+        found_blocked = true;
     // Re-add the ones we skipped, but without changing their counters so we preserve
     // the prior FIFO order.
     for (input_info_t *save : skipped)
-        ready_priority_.push(save);
+        ready.queue.push(save);
     // Re-add the blocked ones to the back.
     for (input_info_t *save : blocked)
-        add_to_ready_queue(save);
-    VDO(this, 1, {
-        static int heartbeat;
-        // We are ok with races as the cadence is approximate.
-        if (++heartbeat % 500 == 0) {
-            VPRINT(this, 1,
-                   "heartbeat[%d] %zd in queue; %d blocked; %zd unscheduled => %d %d\n",
-                   for_output, ready_priority_.size(), num_blocked_,
-                   unscheduled_priority_.size(), res == nullptr ? -1 : res->index,
-                   status);
-        }
-    });
+        add_to_ready_queue_hold_locks(queue_output, save);
+    ready.update_approx_size();
     if (res != nullptr) {
         VPRINT(this, 4,
                "pop_from_ready_queue[%d] (post-size %zu): input %d priority %d timestamp "
                "delta %" PRIu64 "\n",
-               for_output, ready_priority_.size(), res->index, res->priority,
+               for_output, ready.queue.size(), res->index, res->priority,
                res->reader->get_last_timestamp() - res->base_timestamp);
         res->blocked_time = 0;
         res->unscheduled = false;
     }
+    return res;
+}
+
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
+scheduler_tmpl_t<RecordType, ReaderType>::pop_from_ready_queue(
+    output_ordinal_t for_output, input_info_t *&new_input)
+{
+    bool found_blocked = false;
+    input_info_t *res;
+    {
+        auto lock = acquire_ready_queue_lock(for_output, for_output);
+        res = pop_from_ready_queue_hold_locks(for_output, for_output, found_blocked);
+    }
+    if (res == nullptr && options_.per_output_ready_queues) {
+        // Nothing in our own queue can run here, so try to steal from the other
+        // queues, starting with our neighbor to spread out the thieves.
+        output_ordinal_t num_outputs = static_cast<output_ordinal_t>(outputs_.size());
+        for (output_ordinal_t i = 1; i < num_outputs && res == nullptr; ++i) {
+            output_ordinal_t victim = (for_output + i) % num_outputs;
+            if (ready_queue_empty(victim))
+                continue;
+            auto lock = acquire_ready_queue_lock(victim, for_output);
+            res = pop_from_ready_queue_hold_locks(victim, for_output, found_blocked);
+            if (res != nullptr) {
+                VPRINT(this, 3, "pop_from_ready_queue[%d]: stole input %d from %d\n",
+                       for_output, res->index, victim);
+                ++outputs_[for_output].stats[SCHED_STAT_RUNQUEUE_STEALS];
+            }
+        }
+    }
+    sched_type_t::stream_status_t status = STATUS_OK;
+    if (res == nullptr && found_blocked) {
+        // Do not hand out EOF thinking we're done: we still have inputs blocked
+        // on i/o, so just wait and retry.
+        status = STATUS_IDLE;
+    }
+    VDO(this, 1, {
+        // This is shared by all outputs, which no longer hold a common lock here.
+        static std::atomic<int> heartbeat;
+        if (++heartbeat % 500 == 0) {
+            const ready_queue_t &ready = get_ready_queue(for_output);
+            VPRINT(this, 1, "heartbeat[%d] %d in queue => %d %d\n", for_output,
+                   ready.approx_size.load(std::memory_order_acquire),
+                   res == nullptr ? -1 : res->index, status);
+        }
+    });
     new_input = res;
     return status;
 }
@@ -2496,7 +2818,7 @@ typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
 scheduler_tmpl_t<RecordType, ReaderType>::set_cur_input(output_ordinal_t output,
                                                         input_ordinal_t input)
 {
-    // XXX i#5843: Merge tracking of current inputs with ready_priority_ to better manage
+    // XXX i#5843: Merge tracking of current inputs with ready_queues_ to better manage
     // the possible 3 states of each input (a live cur_input for an output stream, in
     // the ready_queue_, or at EOF) (4 states once we add i/o wait times).
     assert(output >= 0 && output < static_cast<output_ordinal_t>(outputs_.size()));
@@ -2504,9 +2826,12 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_cur_input(output_ordinal_t output,
     assert(input < static_cast<input_ordinal_t>(inputs_.size()));
     int prev_input = outputs_[output].cur_input;
     if (prev_input >= 0) {
-        if (options_.mapping == MAP_TO_ANY_OUTPUT && prev_input != input &&
-            !inputs_[prev_input].at_eof) {
-            add_to_ready_queue(&inputs_[prev_input]);
+        if (prev_input != input && inputs_[prev_input].read_ahead != nullptr) {
+            input_info_t &prev_info = inputs_[prev_input];
+            std::lock_guard<std::mutex> lock(*prev_info.lock);
+            read_ahead_source_t::stats_t cur = prev_info.read_ahead->get_stats();
+            add_read_ahead_stats(outputs_[output].stats, prev_info.read_ahead_stats, cur);
+            prev_info.read_ahead_stats = cur;
         }
         if (prev_input != input && options_.schedule_record_ostream != nullptr) {
             input_info_t &prev_info = inputs_[prev_input];
@@ -2516,6 +2841,12 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_cur_input(output_ordinal_t output,
             if (status != sched_type_t::STATUS_OK)
                 return status;
         }
+        // With per_output_ready_queues another output can pick up the input as soon
+        // as it is queued, so we queue it only after we're done with it above.
+        if (options_.mapping == MAP_TO_ANY_OUTPUT && prev_input != input &&
+            !inputs_[prev_input].at_eof) {
+            add_to_ready_queue(output, &inputs_[prev_input]);
+        }
     } else if (options_.schedule_record_ostream != nullptr &&
                outputs_[output].record.back().type == schedule_record_t::IDLE) {
         input_info_t unused;
@@ -2539,6 +2870,12 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_cur_input(output_ordinal_t output,
 
     std::lock_guard<std::mutex> lock(*inputs_[input].lock);
 
+    if (inputs_[input].prev_output != INVALID_OUTPUT_ORDINAL &&
+        inputs_[input].prev_output != output)
+        ++outputs_[output].stats[SCHED_STAT_MIGRATIONS];
+    inputs_[input].prev_output = output;
+    set_read_ahead_priority(inputs_[input], read_ahead_source_t::PRIORITY_RUNNING);
+
     if (prev_input < 0 && outputs_[output].stream->version_ == 0) {
         // Set the version and filetype up front, to let the user query at init time
         // as documented.  Also set the other fields in case we did a skip for ROI.
@@ -2748,14 +3085,12 @@ scheduler_tmpl_t<RecordType, ReaderType>::need_sched_lock()
 }
 
 template <typename RecordType, typename ReaderType>
-std::unique_lock<std::mutex>
+typename scheduler_tmpl_t<RecordType, ReaderType>::stats_lock_t
 scheduler_tmpl_t<RecordType, ReaderType>::acquire_scoped_sched_lock_if_necessary(
-    bool &need_lock)
+    output_ordinal_t output, bool &need_lock)
 {
     need_lock = need_sched_lock();
-    auto scoped_lock = need_lock ? std::unique_lock<std::mutex>(sched_lock_)
-                                 : std::unique_lock<std::mutex>();
-    return scoped_lock;
+    return need_lock ? acquire_sched_lock(output) : stats_lock_t();
 }
 
 template <typename RecordType, typename ReaderType>
@@ -2764,8 +3099,12 @@ scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input(output_ordinal_t outpu
                                                           uint64_t blocked_time)
 {
     sched_type_t::stream_status_t res = sched_type_t::STATUS_OK;
-    bool need_lock;
-    auto scoped_lock = acquire_scoped_sched_lock_if_necessary(need_lock);
+    // With per-output ready queues we avoid the global lock here and instead
+    // acquire just the locks we need below.
+    if (options_.per_output_ready_queues)
+        rebalance_queues_if_due(output);
+    bool need_lock = need_sched_lock() && !options_.per_output_ready_queues;
+    auto scoped_lock = need_lock ? acquire_sched_lock(output) : stats_lock_t();
     input_ordinal_t prev_index = outputs_[output].cur_input;
     input_ordinal_t index = INVALID_INPUT_ORDINAL;
     int iters = 0;
@@ -2814,16 +3153,23 @@ scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input(output_ordinal_t outpu
                     inputs_[prev_index].switch_to_input != INVALID_INPUT_ORDINAL) {
                     input_info_t *target = &inputs_[inputs_[prev_index].switch_to_input];
                     inputs_[prev_index].switch_to_input = INVALID_INPUT_ORDINAL;
-                    std::lock_guard<std::mutex> lock(*target->lock);
+                    // Searching all the queues requires sched_lock_.
+                    auto switch_lock =
+                        need_lock ? stats_lock_t() : acquire_sched_lock(output);
+                    stats_lock_t queue_lock;
                     // XXX i#5843: Add an invariant check that the next timestamp of the
                     // target is later than the pre-switch-syscall timestamp?
-                    if (ready_priority_.find(target)) {
+                    output_ordinal_t queue_output =
+                        find_in_ready_queues(target, output, queue_lock);
+                    if (queue_output != INVALID_OUTPUT_ORDINAL) {
                         VPRINT(this, 2,
                                "next_record[%d]: direct switch from input %d to input %d "
                                "@%" PRIu64 "\n",
                                output, prev_index, target->index,
                                inputs_[prev_index].reader->get_last_timestamp());
-                        ready_priority_.erase(target);
+                        ready_queue_t &ready = get_ready_queue(queue_output);
+                        ready.queue.erase(target);
+                        ready.update_approx_size();
                         index = target->index;
                         // Erase any remaining wait time for the target.
                         if (target->blocked_time > 0) {
@@ -2831,7 +3177,7 @@ scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input(output_ordinal_t outpu
                                    "next_record[%d]: direct switch erasing blocked time "
                                    "for input %d\n",
                                    output, target->index);
-                            --num_blocked_;
+                            --ready.num_blocked;
                             target->blocked_time = 0;
                             target->unscheduled = false;
                         }
@@ -2861,21 +3207,25 @@ scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input(output_ordinal_t outpu
                         // We do ensure the missed target doesn't wait indefinitely.
                         // XXX i#6822: It's not clear this is always the right thing to
                         // do.
+                        std::lock_guard<std::mutex> lock(*target->lock);
                         target->skip_next_unscheduled = true;
                     }
                 }
-                if (index != INVALID_INPUT_ORDINAL) {
-                    // We found a direct switch target above.
-                } else if (ready_queue_empty() && blocked_time == 0) {
-                    if (prev_index == INVALID_INPUT_ORDINAL)
-                        return eof_or_idle(output, need_lock);
-                    auto lock = std::unique_lock<std::mutex>(*inputs_[prev_index].lock);
-                    if (inputs_[prev_index].at_eof) {
-                        lock.unlock();
+                bool use_queue = index == INVALID_INPUT_ORDINAL;
+                if (use_queue && ready_queue_empty(output) && blocked_time == 0) {
+                    if (prev_index != INVALID_INPUT_ORDINAL) {
+                        std::lock_guard<std::mutex> lock(*inputs_[prev_index].lock);
+                        if (!inputs_[prev_index].at_eof) {
+                            index = prev_index; // Go back to prior.
+                            use_queue = false;
+                        }
+                    }
+                    // With per-output queues an empty local queue does not mean there
+                    // is nothing to run, so we go try to steal.
+                    if (use_queue && !options_.per_output_ready_queues)
                         return eof_or_idle(output, need_lock);
-                    } else
-                        index = prev_index; // Go back to prior.
-                } else {
+                }
+                if (use_queue) {
                     // Give up the input before we go to the queue so we can add
                     // ourselves to the queue.  If we're the highest priority we
                     // shouldn't switch.  The queue preserves FIFO for same-priority
@@ -3073,17 +3423,24 @@ scheduler_tmpl_t<RecordType, ReaderType>::process_marker(input_info_t &input,
         // ordering convention to avoid deadlocks.
         input.lock->unlock();
         {
+            // This needs sched_lock_ even with per-output ready queues as the
+            // target could be in any queue.
             bool need_sched_lock;
             auto scoped_sched_lock =
-                acquire_scoped_sched_lock_if_necessary(need_sched_lock);
+                acquire_scoped_sched_lock_if_necessary(output, need_sched_lock);
             input_info_t *target = &inputs_[target_idx];
-            std::lock_guard<std::mutex> lock(*target->lock);
-            if (target->unscheduled) {
+            stats_lock_t queue_lock;
+            output_ordinal_t queue_output;
+            if (unscheduled_priority_.find(target)) {
                 target->unscheduled = false;
-                if (unscheduled_priority_.find(target)) {
-                    add_to_ready_queue(target);
-                    unscheduled_priority_.erase(target);
-                } else if (ready_priority_.find(target)) {
+                unscheduled_priority_.erase(target);
+                queue_output = choose_output_for_input(output, target);
+                queue_lock = acquire_ready_queue_lock(queue_output, output);
+                add_to_ready_queue_hold_locks(queue_output, target);
+            } else if ((queue_output = find_in_ready_queues(
+                            target, output, queue_lock)) != INVALID_OUTPUT_ORDINAL) {
+                if (target->unscheduled) {
+                    target->unscheduled = false;
                     // We assume blocked_time is from _ARG_TIMEOUT and is not from
                     // regularly-blocking i/o.  We assume i/o getting into the mix is
                     // rare enough or does not matter enough to try to have separate
@@ -3093,13 +3450,21 @@ scheduler_tmpl_t<RecordType, ReaderType>::process_marker(input_info_t &input,
                             this, 3,
                             "switchto::resume erasing blocked time for target input %d\n",
                             target->index);
-                        --num_blocked_;
+                        --get_ready_queue(queue_output).num_blocked;
                         target->blocked_time = 0;
                     }
+                } else {
+                    VPRINT(this, 3, "input %d will skip next unschedule\n", target_idx);
+                    target->skip_next_unscheduled = true;
                 }
             } else {
-                VPRINT(this, 3, "input %d will skip next unschedule\n", target_idx);
-                target->skip_next_unscheduled = true;
+                std::lock_guard<std::mutex> lock(*target->lock);
+                if (target->unscheduled)
+                    target->unscheduled = false;
+                else {
+                    VPRINT(this, 3, "input %d will skip next unschedule\n", target_idx);
+                    target->skip_next_unscheduled = true;
+                }
             }
         }
         input.lock->lock();
@@ -3127,7 +3492,7 @@ scheduler_tmpl_t<RecordType, ReaderType>::next_record(output_ordinal_t output,
         cur_time = get_time_micros();
     }
     outputs_[output].cur_time = cur_time; // Invalid values are checked below.
-    if (!outputs_[output].active)
+    if (!outputs_[output].active->load(std::memory_order_acquire))
         return sched_type_t::STATUS_IDLE;
     if (outputs_[output].waiting) {
         if (options_.mapping == MAP_AS_PREVIOUSLY &&
@@ -3537,6 +3902,26 @@ scheduler_tmpl_t<RecordType, ReaderType>::stop_speculation(output_ordinal_t outp
     return sched_type_t::STATUS_OK;
 }
 
+template <typename RecordType, typename ReaderType>
+void
+scheduler_tmpl_t<RecordType, ReaderType>::add_read_ahead_stats(
+    int64_t *stats, const read_ahead_source_t::stats_t &start,
+    const read_ahead_source_t::stats_t &end)
+{
+    stats[SCHED_STAT_READ_AHEAD_HITS] += end.hits - start.hits;
+    stats[SCHED_STAT_READ_AHEAD_MISSES] += end.misses - start.misses;
+    stats[SCHED_STAT_READ_AHEAD_WAITS] += end.waits - start.waits;
+}
+
+template <typename RecordType, typename ReaderType>
+void
+scheduler_tmpl_t<RecordType, ReaderType>::set_read_ahead_priority(
+    input_info_t &input, read_ahead_source_t::priority_t priority)
+{
+    if (input.read_ahead != nullptr)
+        input.read_ahead->set_priority(priority);
+}
+
 template <typename RecordType, typename ReaderType>
 void
 scheduler_tmpl_t<RecordType, ReaderType>::mark_input_eof(input_info_t &input)
@@ -3544,6 +3929,7 @@ scheduler_tmpl_t<RecordType, ReaderType>::mark_input_eof(input_info_t &input)
     if (input.at_eof)
         return;
     input.at_eof = true;
+    set_read_ahead_priority(input, read_ahead_source_t::PRIORITY_IDLE);
     assert(live_input_count_.load(std::memory_order_acquire) > 0);
     live_input_count_.fetch_add(-1, std::memory_order_release);
     VPRINT(this, 2, "input %d at eof; %d live inputs left\n", input.index,
@@ -3573,14 +3959,15 @@ scheduler_tmpl_t<RecordType, ReaderType>::eof_or_idle(output_ordinal_t output,
             // directives miss their targets (due to running with a subset of the
             // original threads, or other scenarios) and we end up with no scheduled
             // inputs but a set of unscheduled inputs who will never be scheduled.
-            auto scoped_lock = hold_sched_lock
-                ? std::unique_lock<std::mutex>()
-                : std::unique_lock<std::mutex>(sched_lock_);
-            VPRINT(this, 4,
-                   "eof_or_idle output=%d live=%d unsched=%zu runq=%zu blocked=%d\n",
+            auto scoped_lock =
+                hold_sched_lock ? stats_lock_t() : acquire_sched_lock(output);
+            int ready_count = 0;
+            for (const auto &ready : ready_queues_)
+                ready_count += ready->approx_size.load(std::memory_order_acquire);
+            VPRINT(this, 4, "eof_or_idle output=%d live=%d unsched=%zu runq=%d\n",
                    output, live_input_count_.load(std::memory_order_acquire),
-                   unscheduled_priority_.size(), ready_priority_.size(), num_blocked_);
-            if (ready_priority_.empty() && !unscheduled_priority_.empty()) {
+                   unscheduled_priority_.size(), ready_count);
+            if (ready_count == 0 && !unscheduled_priority_.empty()) {
                 if (outputs_[output].wait_start_time == 0) {
                     outputs_[output].wait_start_time = get_output_time(output);
                 } else {
@@ -3599,9 +3986,15 @@ scheduler_tmpl_t<RecordType, ReaderType>::eof_or_idle(output_ordinal_t output,
                                "queue\n");
                         while (!unscheduled_priority_.empty()) {
                             input_info_t *tomove = unscheduled_priority_.top();
+                            output_ordinal_t queue_output =
+                                choose_output_for_input(INVALID_OUTPUT_ORDINAL, tomove);
+                            auto queue_lock =
+                                acquire_ready_queue_lock(queue_output, output);
                             std::lock_guard<std::mutex> lock(*tomove->lock);
                             tomove->unscheduled = false;
-                            ready_priority_.push(tomove);
+                            ready_queue_t &ready = get_ready_queue(queue_output);
+                            ready.queue.push(tomove);
+                            ready.update_approx_size();
                             unscheduled_priority_.pop();
                         }
                         outputs_[output].wait_start_time = 0;
@@ -3627,6 +4020,28 @@ scheduler_tmpl_t<RecordType, ReaderType>::is_record_kernel(output_ordinal_t outp
     return inputs_[index].reader->is_record_kernel();
 }
 
+template <typename RecordType, typename ReaderType>
+double
+scheduler_tmpl_t<RecordType, ReaderType>::get_statistic(output_ordinal_t output,
+                                                        schedule_statistic_t stat) const
+{
+    if (output < 0 || output >= static_cast<output_ordinal_t>(outputs_.size()) ||
+        stat < 0 || stat >= SCHED_STAT_TYPE_COUNT)
+        return -1;
+    if (stat == SCHED_STAT_READ_AHEAD_HITS || stat == SCHED_STAT_READ_AHEAD_MISSES ||
+        stat == SCHED_STAT_READ_AHEAD_WAITS) {
+        // Include the activity of the current input since it was switched to.
+        int index = outputs_[output].cur_input;
+        if (index >= 0 && inputs_[index].read_ahead != nullptr) {
+            int64_t stats[SCHED_STAT_TYPE_COUNT] = {};
+            add_read_ahead_stats(stats, inputs_[index].read_ahead_stats,
+                                 inputs_[index].read_ahead->get_stats());
+            return static_cast<double>(outputs_[output].stats[stat] + stats[stat]);
+        }
+    }
+    return static_cast<double>(outputs_[output].stats[stat]);
+}
+
 template <typename RecordType, typename ReaderType>
 typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
 scheduler_tmpl_t<RecordType, ReaderType>::set_output_active(output_ordinal_t output,
@@ -3634,12 +4049,14 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_output_active(output_ordinal_t out
 {
     if (options_.mapping != MAP_TO_ANY_OUTPUT)
         return sched_type_t::STATUS_INVALID;
-    if (outputs_[output].active == active)
+    if (outputs_[output].active->load(std::memory_order_acquire) == active)
         return sched_type_t::STATUS_OK;
-    outputs_[output].active = active;
+    outputs_[output].active->store(active, std::memory_order_release);
     VPRINT(this, 2, "Output stream %d is now %s\n", output,
            active ? "active" : "inactive");
-    std::lock_guard<std::mutex> guard(sched_lock_);
+    // set_cur_input() acquires ready queue locks itself when using per-output queues.
+    auto scoped_lock =
+        options_.per_output_ready_queues ? stats_lock_t() : acquire_sched_lock(output);
     if (!active) {
         // Make the now-inactive output's input available for other cores.
         // This will reset its quantum too.
@@ -3648,6 +4065,24 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_output_active(output_ordinal_t out
         if (inputs_[outputs_[output].cur_input].queue.empty())
             inputs_[outputs_[output].cur_input].switching_pre_instruction = true;
         set_cur_input(output, INVALID_INPUT_ORDINAL);
+        if (options_.per_output_ready_queues) {
+            // Hand our queued inputs to the remaining active outputs.
+            scoped_lock = acquire_sched_lock(output);
+            std::vector<input_info_t *> displaced;
+            {
+                auto queue_lock = acquire_ready_queue_lock(output, output);
+                ready_queue_t &ready = get_ready_queue(output);
+                while (!ready.queue.empty()) {
+                    input_info_t *input = ready.queue.top();
+                    ready.queue.pop();
+                    if (input->blocked_time > 0)
+                        --ready.num_blocked;
+                    displaced.push_back(input);
+                }
+                ready.update_approx_size();
+            }
+            requeue_displaced_inputs(output, displaced);
+        }
     } else {
         outputs_[output].waiting = true;
     }
@@ -46,6 +46,7 @@
 #include <stdint.h>
 
 #include <atomic>
+#include <chrono>
 #include <deque>
 #include <limits>
 #include <map>
@@ -64,6 +65,7 @@
 #include "flexible_queue.h"
 #include "memref.h"
 #include "memtrace_stream.h"
+#include "read_ahead_pool.h"
 #include "reader.h"
 #include "record_file_reader.h"
 #include "speculator.h"
@@ -724,6 +726,47 @@ public:
          * (these markers remain: they are not removed from the trace).
          */
         bool honor_direct_switches = true;
+        /**
+         * Applies only to #MAP_TO_ANY_OUTPUT.  If true, each output stream has its own
+         * queue of ready inputs protected by its own lock, in place of one global
+         * queue shared by all outputs under one global lock.  This reduces lock
+         * contention when there are many outputs.  An input leaving an output (due to
+         * its quantum expiring or blocking) is placed on that output's queue, keeping
+         * affinity for the output.  Priorities, timestamp ordering, and FIFO order are
+         * honored within each queue.  An output whose own queue has no input ready to
+         * run takes ("steals") the best candidate from another output's queue before
+         * going idle, and queue lengths are periodically evened out as controlled by
+         * #rebalance_period_us.  The counts of steals, rebalances, and resulting
+         * migrations along with lock acquisition and hold time statistics are
+         * available from the get_schedule_statistic() stream query.
+         */
+        bool per_output_ready_queues = false;
+        /**
+         * Applies only when #per_output_ready_queues is true.  The period between
+         * attempts to even out the lengths of the per-output ready queues, in the
+         * units used for #block_time_max: either #QUANTUM_TIME simulator time or
+         * wall-clock microseconds for #QUANTUM_INSTRUCTIONS.  A value of 0 disables
+         * periodic rebalancing, leaving only stealing by otherwise-idle outputs.
+         */
+        uint64_t rebalance_period_us = 50000;
+        /**
+         * If non-zero, this many background threads decompress records ahead of
+         * the output streams for inputs whose file format supports it (currently
+         * gzip and zip files).  Inputs waiting in a ready queue are favored over
+         * inputs currently running on an output, which are in turn favored over
+         * inputs not expected to run soon, so that an input switched to
+         * typically finds its next records already decoded.  The counts of
+         * blocks of records found ready, not ready, and in progress are available
+         * from the get_schedule_statistic() stream query.  Applies only to
+         * #scheduler_tmpl_t instantiations over #memref_t.
+         */
+        int read_ahead_threads = 0;
+        /**
+         * Applies only when #read_ahead_threads is non-zero.  The maximum number of
+         * blocks of decoded records queued ahead of each input.  Each block holds
+         * several thousand records.
+         */
+        int read_ahead_blocks = 4;
     };
 
     /**
@@ -1114,6 +1157,18 @@ public:
             return scheduler_->is_record_kernel(ordinal_);
         }
 
+        /**
+         * Returns the value of the specified statistic for this output stream.
+         * The values for all output streams must be summed to obtain global counts.
+         * The statistics are updated by the thread advancing this output stream, so
+         * this should be called from that thread or after it finishes.
+         */
+        double
+        get_schedule_statistic(schedule_statistic_t stat) const override
+        {
+            return scheduler_->get_statistic(ordinal_, stat);
+        }
+
     protected:
         scheduler_tmpl_t<RecordType, ReaderType> *scheduler_ = nullptr;
         int ordinal_ = -1;
@@ -1139,7 +1194,6 @@ public:
 
     /** Default constructor. */
     scheduler_tmpl_t()
-        : ready_priority_(static_cast<int>(get_time_micros()))
     {
     }
     virtual ~scheduler_tmpl_t() = default;
@@ -1241,8 +1295,9 @@ protected:
         // While the scheduler only hands an input to one output at a time, during
         // scheduling decisions one thread may need to access another's fields.
         // We use a unique_ptr to make this moveable for vector storage.
-        // For inputs not actively assigned to a core but sitting in the ready_queue,
-        // sched_lock_ suffices to synchronize access.
+        // For inputs not actively assigned to a core but sitting in a ready queue,
+        // the lock for that queue suffices to synchronize access (which is sched_lock_
+        // unless per_output_ready_queues is set).
         std::unique_ptr<std::mutex> lock;
         // A tid can be duplicated across workloads so we need the pair of
         // workload index + tid to identify the original input.
@@ -1302,15 +1357,23 @@ protected:
         // The units are us for instr quanta and simuilation time for time quanta.
         uint64_t blocked_time = 0;
         uint64_t blocked_start_time = 0;
-        // An input can be "unscheduled" and not on the ready_priority_ run queue at all
+        // An input can be "unscheduled" and not on any ready queue at all
         // with an infinite timeout until directly targeted.  Such inputs are stored
         // in the unscheduled_priority_ queue.
         // This field is also set to true for inputs that are "unscheduled" but with
-        // a timeout, even though that is implemented by storing them in ready_priority_
+        // a timeout, even though that is implemented by storing them in a ready queue
         // (because that is our mechanism for measuring timeouts).
         bool unscheduled = false;
         // Causes the next unscheduled entry to abort.
         bool skip_next_unscheduled = false;
+        // The output this input last ran on, for counting migrations.
+        output_ordinal_t prev_output = INVALID_OUTPUT_ORDINAL;
+        // Decodes records ahead of the reader, if read_ahead_threads is set.  Owned
+        // by the reader.
+        read_ahead_source_t *read_ahead = nullptr;
+        // The read_ahead statistics when this input last left an output, so that
+        // later activity can be attributed to the next output it runs on.
+        read_ahead_source_t::stats_t read_ahead_stats;
     };
 
     // Format for recording a schedule to disk.  A separate sequence of these records
@@ -1387,6 +1450,7 @@ protected:
             , stream(&self_stream)
             , speculator(speculator_flags, verbosity)
             , last_record(last_record_init)
+            , active(new std::atomic<bool>(true))
         {
         }
         stream_t self_stream;
@@ -1413,11 +1477,14 @@ protected:
         addr_t prev_speculate_pc = 0;
         RecordType last_record; // Set to TRACE_TYPE_INVALID in constructor.
         // A list of schedule segments.  These are accessed only while holding
-        // sched_lock_.
+        // sched_lock_, or only by the owning thread prior to write_recorded_schedule()
+        // for per_output_ready_queues.
         std::vector<schedule_record_t> record;
         int record_index = 0;
         bool waiting = false; // Waiting or idling.
-        bool active = true;
+        // This is read by other outputs when picking a ready queue for an input.
+        // We use a unique_ptr to make this moveable for vector storage.
+        std::unique_ptr<std::atomic<bool>> active;
         bool in_kernel_code = false;
         bool in_context_switch_code = false;
         bool hit_switch_code_end = false;
@@ -1429,6 +1496,9 @@ protected:
         bool at_eof = false;
         // Used for replaying wait periods.
         uint64_t wait_start_time = 0;
+        // Statistics for get_schedule_statistic(), updated only by the thread
+        // advancing this output.
+        int64_t stats[SCHED_STAT_TYPE_COUNT] = {};
     };
 
     // Used for reading as-traced schedules.
@@ -1507,6 +1577,22 @@ protected:
     std::unique_ptr<ReaderType>
     get_reader(const std::string &path, int verbosity);
 
+    // Starts decoding records ahead of the reader for 'input' on read_ahead_pool_,
+    // returning nullptr if its reader does not support that.
+    read_ahead_source_t *
+    enable_read_ahead(input_info_t &input);
+
+    // Sets the priority of the read-ahead for 'input', if any.  The caller must hold
+    // the input's lock.
+    void
+    set_read_ahead_priority(input_info_t &input,
+                            read_ahead_source_t::priority_t priority);
+
+    // Adds to 'stats' the read-ahead activity between 'start' and 'end'.
+    static void
+    add_read_ahead_stats(int64_t *stats, const read_ahead_source_t::stats_t &start,
+                         const read_ahead_source_t::stats_t &end);
+
     // Advances the 'output_ordinal'-th output stream.
     stream_status_t
     next_record(output_ordinal_t output, RecordType &record, input_info_t *&input,
@@ -1604,7 +1690,9 @@ protected:
     std::string
     recorded_schedule_component_name(output_ordinal_t output);
 
-    // The sched_lock_ must be held when this is called.
+    // The sched_lock_ must be held when this is called, unless
+    // per_output_ready_queues is set in which case sched_lock_ must *not* be held
+    // for MAP_TO_ANY_OUTPUT as it may be acquired here.
     stream_status_t
     set_cur_input(output_ordinal_t output, input_ordinal_t input);
 
@@ -1762,6 +1850,9 @@ protected:
     // to kernel execution.
     bool
     is_record_kernel(output_ordinal_t output);
+
+    double
+    get_statistic(output_ordinal_t output, schedule_statistic_t stat) const;
     ///////////////////////////////////////////////////////////////////////////
     // Support for ready queues for who to schedule next:
 
@@ -1786,26 +1877,182 @@ protected:
         }
     };
 
+    // A queue of inputs ready to be scheduled.  Without per_output_ready_queues there
+    // is a single such queue protected by sched_lock_; with it there is one per output
+    // each protected by its own lock.
+    struct ready_queue_t {
+        explicit ready_queue_t(int rand_seed)
+            : queue(rand_seed)
+        {
+        }
+        // Inputs sorted by priority and then timestamp if timestamp dependencies are
+        // requested.  We use the timestamp delta from the first observed timestamp in
+        // each workload in order to mix inputs from different workloads in the same
+        // queue.  FIFO ordering is used for same-priority entries.
+        flexible_queue_t<input_info_t *, InputTimestampComparator> queue;
+        // Count of blocked inputs in this queue.
+        int num_blocked = 0;
+        // A copy of queue.size() which other outputs can read without holding the lock
+        // when looking for inputs to steal or for the least-loaded queue.
+        std::atomic<int> approx_size { 0 };
+        // Only used with per_output_ready_queues.  This cannot be acquired while
+        // holding an input lock; if sched_lock_ is also needed it must be acquired
+        // first.  At most one ready queue lock can be held at a time.
+        std::mutex lock;
+        // Must be called after each change to "queue" while holding the lock.
+        void
+        update_approx_size()
+        {
+            approx_size.store(static_cast<int>(queue.size()), std::memory_order_release);
+        }
+    };
+
+    // A scoped lock which accumulates into one output's statistics the count of
+    // acquisitions of the lock and the time it was held.
+    class stats_lock_t {
+    public:
+        stats_lock_t() = default;
+        // If "stats" is nullptr no statistics are recorded.
+        stats_lock_t(std::mutex &mutex, int64_t *stats, schedule_statistic_t acquire_stat,
+                     schedule_statistic_t hold_stat)
+            : lock_(mutex, std::defer_lock)
+            , stats_(stats)
+            , acquire_stat_(acquire_stat)
+            , hold_stat_(hold_stat)
+        {
+            lock();
+        }
+        stats_lock_t(stats_lock_t &&other)
+            : lock_(std::move(other.lock_))
+            , stats_(other.stats_)
+            , acquire_stat_(other.acquire_stat_)
+            , hold_stat_(other.hold_stat_)
+            , start_(other.start_)
+        {
+        }
+        stats_lock_t &
+        operator=(stats_lock_t &&other)
+        {
+            unlock();
+            lock_ = std::move(other.lock_);
+            stats_ = other.stats_;
+            acquire_stat_ = other.acquire_stat_;
+            hold_stat_ = other.hold_stat_;
+            start_ = other.start_;
+            return *this;
+        }
+        ~stats_lock_t()
+        {
+            unlock();
+        }
+        void
+        lock()
+        {
+            lock_.lock();
+            if (stats_ != nullptr) {
+                ++stats_[acquire_stat_];
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+        void
+        unlock()
+        {
+            if (!lock_.owns_lock())
+                return;
+            if (stats_ != nullptr) {
+                auto held = std::chrono::steady_clock::now() - start_;
+                stats_[hold_stat_] +=
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(held).count();
+            }
+            lock_.unlock();
+        }
+        bool
+        owns_lock() const
+        {
+            return lock_.owns_lock();
+        }
+
+    private:
+        std::unique_lock<std::mutex> lock_;
+        int64_t *stats_ = nullptr;
+        schedule_statistic_t acquire_stat_ = SCHED_STAT_TYPE_COUNT;
+        schedule_statistic_t hold_stat_ = SCHED_STAT_TYPE_COUNT;
+        std::chrono::steady_clock::time_point start_;
+    };
+
     bool
     need_sched_lock();
 
-    std::unique_lock<std::mutex>
-    acquire_scoped_sched_lock_if_necessary(bool &need_lock);
+    // Acquires sched_lock_ if need_sched_lock() says so, attributing the acquisition
+    // to "output"'s statistics.
+    stats_lock_t
+    acquire_scoped_sched_lock_if_necessary(output_ordinal_t output, bool &need_lock);
 
-    // sched_lock_ must be held by the caller.
+    // Acquires sched_lock_, attributing the acquisition to "output"'s statistics.
+    stats_lock_t
+    acquire_sched_lock(output_ordinal_t output);
+
+    // Returns the ready queue used by "output".
+    ready_queue_t &
+    get_ready_queue(output_ordinal_t output)
+    {
+        return *ready_queues_[options_.per_output_ready_queues ? output : 0];
+    }
+
+    // Acquires the lock for the ready queue of "queue_output" if it has its own lock;
+    // else, returns an empty lock as sched_lock_ is assumed to already be held.
+    // The acquisition is attributed to "for_output"'s statistics.
+    stats_lock_t
+    acquire_ready_queue_lock(output_ordinal_t queue_output, output_ordinal_t for_output);
+
+    // Without per_output_ready_queues, sched_lock_ must be held by the caller.
+    // With per_output_ready_queues, no lock is needed and the result is approximate.
     bool
-    ready_queue_empty();
+    ready_queue_empty(output_ordinal_t output);
+
+    // Adds "input", which is leaving "output" (or which "output" is otherwise
+    // placing), to the most suitable ready queue: the one for "output" if
+    // per_output_ready_queues is set and the input can still run there, or else the
+    // least-loaded allowed one.  If input->unscheduled is true and input->blocked_time
+    // is 0, input is placed on the unscheduled_priority_ queue instead.
+    // Without per_output_ready_queues, sched_lock_ must be held by the caller.
+    // With per_output_ready_queues, neither sched_lock_ nor any ready queue lock
+    // can be held by the caller.
+    void
+    add_to_ready_queue(output_ordinal_t output, input_info_t *input);
 
-    // sched_lock_ must be held by the caller.
-    // If input->unscheduled is true and input->blocked_time is 0, input
-    // is placed on the unscheduled_priority_ queue instead.
+    // The lock for the ready queue of "queue_output" must be held by the caller.
     void
-    add_to_ready_queue(input_info_t *input);
+    add_to_ready_queue_hold_locks(output_ordinal_t queue_output, input_info_t *input);
 
     // sched_lock_ must be held by the caller.
     void
     add_to_unscheduled_queue(input_info_t *input);
 
+    // Returns the output whose ready queue should receive "input", preferring
+    // "output" and otherwise picking the active output allowed by the input's
+    // bindings with the shortest queue.  No locks are needed as queue lengths are
+    // only approximate.
+    output_ordinal_t
+    choose_output_for_input(output_ordinal_t output, input_info_t *input);
+
+    // Looks for "input" in each ready queue.  If found, returns the queue's output
+    // ordinal with that queue's lock held in "queue_lock"; else, returns
+    // INVALID_OUTPUT_ORDINAL.  The caller must hold sched_lock_, which prevents inputs
+    // from moving directly between queues.  The acquisition is attributed to
+    // "for_output"'s statistics.
+    output_ordinal_t
+    find_in_ready_queues(input_info_t *input, output_ordinal_t for_output,
+                         stats_lock_t &queue_lock);
+
+    // Places each of "displaced", which were removed from their ready queues while
+    // sched_lock_ was held, onto the least-loaded suitable ready queue while
+    // preserving their FIFO order.  sched_lock_ must be held by the caller, but no
+    // ready queue lock.
+    void
+    requeue_displaced_inputs(output_ordinal_t for_output,
+                             const std::vector<input_info_t *> &displaced);
+
     uint64_t
     scale_blocked_time(uint64_t blocked_time) const;
 
@@ -1814,12 +2061,28 @@ protected:
     bool
     syscall_incurs_switch(input_info_t *input, uint64_t &blocked_time);
 
-    // sched_lock_ must be held by the caller.
     // "for_output" is which output stream is looking for a new input; only an
     // input which is able to run on that output will be selected.
+    // Without per_output_ready_queues, sched_lock_ must be held by the caller.
+    // With per_output_ready_queues, neither sched_lock_ nor any ready queue lock can
+    // be held by the caller; if the output's own queue has no runnable input, one
+    // is stolen from another output's queue.
     stream_status_t
     pop_from_ready_queue(output_ordinal_t for_output, input_info_t *&new_input);
 
+    // Helper for pop_from_ready_queue() which looks in the ready queue of
+    // "queue_output" only.  The lock for that queue must be held by the caller.
+    // Sets "found_blocked" if a blocked input suitable for "for_output" was skipped.
+    input_info_t *
+    pop_from_ready_queue_hold_locks(output_ordinal_t queue_output,
+                                    output_ordinal_t for_output, bool &found_blocked);
+
+    // For per_output_ready_queues, evens out the lengths of the ready queues if
+    // rebalance_period_us has passed since the last time.  No locks can be held by
+    // the caller.
+    void
+    rebalance_queues_if_due(output_ordinal_t output);
+
     ///
     ///////////////////////////////////////////////////////////////////////////
 
@@ -1830,28 +2093,36 @@ protected:
     scheduler_options_t options_;
     // Each vector element has a mutex which should be held when accessing its fields.
     std::vector<input_info_t> inputs_;
+    // Threads decoding records ahead of the inputs' readers.  This is declared after
+    // inputs_ so that its threads are stopped before the readers are destroyed.
+    std::unique_ptr<read_ahead_pool_t> read_ahead_pool_;
     // Each vector element is accessed only by its owning thread, except the
     // record and record_index fields which are accessed under sched_lock_.
     std::vector<output_info_t> outputs_;
     // We use a central lock for global scheduling.  We assume the synchronization
     // cost is outweighed by the simulator's overhead.  This protects concurrent
-    // access to inputs_.size(), outputs_.size(), ready_priority_,
-    // ready_counter_, unscheduled_priority_, and unscheduled_counter_.
-    // This cannot be acquired while holding an input lock: it must
-    // be acquired first, to avoid deadlocks.
+    // access to inputs_.size(), outputs_.size(), unscheduled_priority_, and
+    // unscheduled_counter_, as well as the single ready queue if
+    // per_output_ready_queues is not set.  With per_output_ready_queues, this is
+    // only needed for the less common operations that span queues; moving an input
+    // directly from one ready queue to another requires holding this lock.
+    // This cannot be acquired while holding an input lock or a ready queue lock:
+    // it must be acquired first, to avoid deadlocks.
     std::mutex sched_lock_;
-    // Inputs ready to be scheduled, sorted by priority and then timestamp if timestamp
-    // dependencies are requested.  We use the timestamp delta from the first observed
-    // timestamp in each workload in order to mix inputs from different workloads in the
-    // same queue.  FIFO ordering is used for same-priority entries.
-    flexible_queue_t<input_info_t *, InputTimestampComparator> ready_priority_;
+    // Inputs ready to be scheduled: a single queue shared by all outputs, or one per
+    // output for per_output_ready_queues.  We use unique_ptr as the queues contain
+    // locks and atomics.
+    std::vector<std::unique_ptr<ready_queue_t>> ready_queues_;
     // Inputs that are unscheduled indefinitely unless directly targeted.
     flexible_queue_t<input_info_t *, InputTimestampComparator> unscheduled_priority_;
-    // Trackes the count of blocked inputs.  Protected by sched_lock_.
-    int num_blocked_ = 0;
     // Global queue counters used to provide FIFO for same-priority inputs.
-    uint64_t ready_counter_ = 0;
+    // The ready counter is shared across the per-output queues to keep FIFO order
+    // meaningful when inputs move between them.
+    std::atomic<uint64_t> ready_counter_ { 0 };
     uint64_t unscheduled_counter_ = 0;
+    // For per_output_ready_queues, the output time at which queue lengths should
+    // next be evened out.
+    std::atomic<uint64_t> next_rebalance_time_ { 0 };
     // Count of inputs not yet at eof.
     std::atomic<int> live_input_count_;
     // In replay mode, count of outputs not yet at the end of the replay sequence.
@@ -35,10 +35,14 @@
 #include <stddef.h>
 #include <stdint.h> /* for supporting 64-bit integers*/
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -187,6 +191,7 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs)
         success_ = false;
         return;
     }
+    init_parallel();
 }
 
 cache_simulator_t::cache_simulator_t(std::istream *config_file)
@@ -393,6 +398,7 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file)
             cache.second->set_hashtable_use(true);
         }
     }
+    init_parallel();
 }
 
 cache_simulator_t::~cache_simulator_t()
@@ -418,6 +424,46 @@ cache_simulator_t::~cache_simulator_t()
     }
 }
 
+void
+cache_simulator_t::init_parallel()
+{
+    if (!knobs_.parallel)
+        return;
+    // These all rely on a single global order of records.
+    if (knobs_.skip_refs > 0 || knobs_.warmup_refs > 0 || knobs_.warmup_fraction > 0.0 ||
+        knobs_.sim_refs != cache_simulator_knobs_t().sim_refs ||
+        knobs_.cpu_scheduling || knobs_.use_physical) {
+        error_string_ = "Usage error: parallel cache simulation does not support "
+                        "skipping, warmup, a simulation limit, -cpu_scheduling, or "
+                        "-use_physical";
+        success_ = false;
+        return;
+    }
+    // Coherence invalidations and inclusive back-invalidations write to one
+    // core's private caches on behalf of another core, so with either of those
+    // every access must be serialized.
+    local_hits_ok_ = !knobs_.model_coherence;
+    for (auto &cache_it : all_caches_) {
+        if (cache_it.second->is_inclusive())
+            local_hits_ok_ = false;
+    }
+    if (knobs_.parallel_lockstep) {
+        lockstep_clock_.reset(new std::atomic<uint64_t>[knobs_.num_cores]);
+        for (unsigned int i = 0; i < knobs_.num_cores; ++i)
+            lockstep_clock_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::string
+cache_simulator_t::initialize_shard_type(shard_type_t shard_type)
+{
+    // The analyzer only omits the serial stream when it is going to use our
+    // parallel interface.
+    if (knobs_.parallel && serial_stream_ == nullptr && shard_type != SHARD_BY_CORE)
+        return "Usage error: parallel cache simulation requires -core_sharded";
+    return simulator_t::initialize_shard_type(shard_type);
+}
+
 uint64_t
 cache_simulator_t::remaining_sim_refs() const
 {
@@ -485,55 +531,13 @@ cache_simulator_t::process_memref(const memref_t &memref)
         simref = &phys_memref;
     }
 
-    if (type_is_instr(simref->instr.type) ||
-        simref->instr.type == TRACE_TYPE_PREFETCH_INSTR) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->instr.addr << " instr x"
-                      << simref->instr.size << "\n";
-        }
-        l1_icaches_[core_index]->request(*simref);
-    } else if (simref->data.type == TRACE_TYPE_READ ||
-               simref->data.type == TRACE_TYPE_WRITE ||
-               // We may potentially handle prefetches differently.
-               // TRACE_TYPE_PREFETCH_INSTR is handled above.
-               type_is_prefetch(simref->data.type)) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " "
-                      << trace_type_names[simref->data.type] << " "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_dcaches_[core_index]->request(*simref);
-    } else if (simref->flush.type == TRACE_TYPE_INSTR_FLUSH) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " iflush "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_icaches_[core_index]->flush(*simref);
-    } else if (simref->flush.type == TRACE_TYPE_DATA_FLUSH) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " dflush "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_dcaches_[core_index]->flush(*simref);
-    } else if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
+    if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
         handle_thread_exit(simref->exit.tid);
         last_thread_ = 0;
     } else if (memref.marker.type == TRACE_TYPE_MARKER &&
                memref.marker.marker_type == TRACE_MARKER_TYPE_CPU_ID) {
         last_thread_ = 0;
-    } else if (simref->marker.type == TRACE_TYPE_INSTR_NO_FETCH) {
-        // Just ignore.
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->instr.addr << " non-fetched instr x"
-                      << simref->instr.size << "\n";
-        }
-    } else {
-        error_string_ = "Unhandled memref type " + std::to_string(simref->data.type);
+    } else if (!access_caches(core_index, *simref, error_string_)) {
         return false;
     }
 
@@ -553,6 +557,195 @@ cache_simulator_t::process_memref(const memref_t &memref)
     return true;
 }
 
+bool
+cache_simulator_t::access_caches(int core_index, const memref_t &simref,
+                                 std::string &error)
+{
+    if (type_is_instr(simref.instr.type) ||
+        simref.instr.type == TRACE_TYPE_PREFETCH_INSTR) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.instr.addr << " instr x"
+                      << simref.instr.size << "\n";
+        }
+        l1_icaches_[core_index]->request(simref);
+    } else if (simref.data.type == TRACE_TYPE_READ ||
+               simref.data.type == TRACE_TYPE_WRITE ||
+               // We may potentially handle prefetches differently.
+               // TRACE_TYPE_PREFETCH_INSTR is handled above.
+               type_is_prefetch(simref.data.type)) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " "
+                      << trace_type_names[simref.data.type] << " "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_dcaches_[core_index]->request(simref);
+    } else if (simref.flush.type == TRACE_TYPE_INSTR_FLUSH) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " iflush "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_icaches_[core_index]->flush(simref);
+    } else if (simref.flush.type == TRACE_TYPE_DATA_FLUSH) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " dflush "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_dcaches_[core_index]->flush(simref);
+    } else if (simref.marker.type == TRACE_TYPE_INSTR_NO_FETCH) {
+        // Just ignore.
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.instr.addr << " non-fetched instr x"
+                      << simref.instr.size << "\n";
+        }
+    } else {
+        error = "Unhandled memref type " + std::to_string(simref.data.type);
+        return false;
+    }
+    return true;
+}
+
+bool
+cache_simulator_t::parallel_shard_supported()
+{
+    return knobs_.parallel;
+}
+
+void *
+cache_simulator_t::parallel_worker_init(int worker_index)
+{
+    // Lockstep mode cannot start until every core has a worker, as a late
+    // arrival would change the order.
+    if (knobs_.parallel_lockstep && worker_index >= 0 &&
+        worker_index < static_cast<int>(knobs_.num_cores))
+        lockstep_workers_.fetch_add(1, std::memory_order_release);
+    return reinterpret_cast<void *>(static_cast<intptr_t>(worker_index));
+}
+
+std::string
+cache_simulator_t::parallel_worker_exit(void *worker_data)
+{
+    int worker_index = static_cast<int>(reinterpret_cast<intptr_t>(worker_data));
+    if (knobs_.parallel_lockstep && worker_index >= 0 &&
+        worker_index < static_cast<int>(knobs_.num_cores))
+        lockstep_finish(worker_index);
+    return "";
+}
+
+void *
+cache_simulator_t::parallel_shard_init_stream(int shard_index, void *worker_data,
+                                              memtrace_stream_t *shard_stream)
+{
+    shard_data_t *shard = new shard_data_t;
+    // We require core-sharded operation, where the shard index is the core.
+    shard->core = shard_index;
+    if (shard->core < 0 || shard->core >= static_cast<int>(knobs_.num_cores)) {
+        shard->error = "Too-small core count " + std::to_string(knobs_.num_cores) +
+            " for trace core #" + std::to_string(shard->core);
+    }
+    return shard;
+}
+
+bool
+cache_simulator_t::parallel_shard_exit(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    if (shard->error.empty()) {
+        std::lock_guard<std::mutex> guard(shared_lock_);
+        l1_icaches_[shard->core]->flush_pending_child_hits();
+        if (l1_dcaches_[shard->core] != l1_icaches_[shard->core])
+            l1_dcaches_[shard->core]->flush_pending_child_hits();
+    }
+    delete shard;
+    return true;
+}
+
+bool
+cache_simulator_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    if (!shard->error.empty())
+        return false;
+    // Markers (including the analyzer's idle and wait records) and thread
+    // exits do not touch the caches, but in lockstep mode they still count
+    // toward each core's position in the order.
+    bool is_access = memref.marker.type != TRACE_TYPE_MARKER &&
+        memref.exit.type != TRACE_TYPE_THREAD_EXIT;
+    if (knobs_.parallel_lockstep) {
+        bool res = true;
+        lockstep_wait(shard->core);
+        if (is_access)
+            res = access_caches(shard->core, memref, shard->error);
+        if (res)
+            lockstep_advance(shard->core);
+        else {
+            // The analyzer will not call parallel_worker_exit() for us.
+            lockstep_finish(shard->core);
+        }
+        return res;
+    }
+    if (!is_access)
+        return true;
+    if (local_hits_ok_) {
+        cache_t *l1 = nullptr;
+        if (type_is_instr(memref.instr.type) ||
+            memref.instr.type == TRACE_TYPE_PREFETCH_INSTR)
+            l1 = l1_icaches_[shard->core];
+        else if (memref.data.type == TRACE_TYPE_READ ||
+                 memref.data.type == TRACE_TYPE_WRITE ||
+                 type_is_prefetch(memref.data.type))
+            l1 = l1_dcaches_[shard->core];
+        if (l1 != nullptr && l1->request_local_hit(memref))
+            return true;
+    }
+    std::lock_guard<std::mutex> guard(shared_lock_);
+    return access_caches(shard->core, memref, shard->error);
+}
+
+std::string
+cache_simulator_t::parallel_shard_error(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    return shard->error;
+}
+
+void
+cache_simulator_t::lockstep_wait(int core)
+{
+    while (lockstep_workers_.load(std::memory_order_acquire) < knobs_.num_cores)
+        std::this_thread::yield();
+    uint64_t clock = lockstep_clock_[core].load(std::memory_order_relaxed);
+    // Clocks only move forward, so each other core need only be checked until
+    // it is past us.  Ties go to the lower core index.
+    for (int i = 0; i < static_cast<int>(knobs_.num_cores); ++i) {
+        if (i == core)
+            continue;
+        while (true) {
+            uint64_t other = lockstep_clock_[i].load(std::memory_order_acquire);
+            if (other > clock || (other == clock && i > core))
+                break;
+            std::this_thread::yield();
+        }
+    }
+}
+
+void
+cache_simulator_t::lockstep_advance(int core)
+{
+    uint64_t clock = lockstep_clock_[core].load(std::memory_order_relaxed);
+    lockstep_clock_[core].store(clock + 1, std::memory_order_release);
+}
+
+void
+cache_simulator_t::lockstep_finish(int core)
+{
+    lockstep_clock_[core].store(UINT64_MAX, std::memory_order_release);
+}
+
 // Return true if the number of warmup references have been executed or if
 // specified fraction of the llcaches_ has been loaded. Also return true if the
 // cache has already been warmed up. When there are multiple last level caches
@@ -673,6 +866,29 @@ cache_simulator_t::get_cache_metric(metric_name_t metric, unsigned level, unsign
     return stats->get_metric(metric);
 }
 
+int64_t
+cache_simulator_t::get_cache_metric(metric_name_t metric,
+                                    const std::string &cache_name) const
+{
+    const auto &cache_it = all_caches_.find(cache_name);
+    if (cache_it == all_caches_.end())
+        return STATS_ERROR_WRONG_CACHE_NAME;
+    caching_device_stats_t *stats = cache_it->second->get_stats();
+    if (stats == NULL)
+        return STATS_ERROR_NO_CACHE_STATS;
+    return stats->get_metric(metric);
+}
+
+std::vector<std::string>
+cache_simulator_t::get_cache_names() const
+{
+    std::vector<std::string> names;
+    for (const auto &cache_it : all_caches_)
+        names.push_back(cache_it.first);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
 const cache_simulator_knobs_t &
 cache_simulator_t::get_knobs() const
 {
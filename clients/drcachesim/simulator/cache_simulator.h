@@ -39,9 +39,13 @@
 #include <limits.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <istream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "cache.h"
 #include "cache_simulator_create.h"
@@ -63,6 +67,8 @@ typedef enum {
     STATS_ERROR_WRONG_CACHE_LEVEL,
     // Given cache doesn't support counting statistics.
     STATS_ERROR_NO_CACHE_STATS,
+    // No cache has the given name.
+    STATS_ERROR_WRONG_CACHE_NAME,
 } stats_error_t;
 
 class cache_simulator_t : public simulator_t {
@@ -77,14 +83,45 @@ public:
     cache_simulator_t(std::istream *config_file);
 
     virtual ~cache_simulator_t();
+    std::string
+    initialize_shard_type(shard_type_t shard_type) override;
     bool
     process_memref(const memref_t &memref) override;
     bool
     print_results() override;
 
+    // With the parallel knob set, each core's records are simulated on the
+    // analyzer worker thread for that core.  This requires core-sharded
+    // operation.  Hits in the private L1 caches proceed without
+    // synchronization while everything else is serialized with a lock, unless
+    // the lockstep knob is set, in which case the cores take turns in a
+    // deterministic order.
+    bool
+    parallel_shard_supported() override;
+    void *
+    parallel_worker_init(int worker_index) override;
+    std::string
+    parallel_worker_exit(void *worker_data) override;
+    void *
+    parallel_shard_init_stream(int shard_index, void *worker_data,
+                               memtrace_stream_t *shard_stream) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
+
     int64_t
     get_cache_metric(metric_name_t metric, unsigned level, unsigned core = 0,
                      cache_split_t split = cache_split_t::DATA) const;
+    // Looks up the cache by the name it was given in the configuration file, or
+    // "L1I<core>", "L1D<core>", or "LL" when configured by knobs.
+    int64_t
+    get_cache_metric(metric_name_t metric, const std::string &cache_name) const;
+    // Returns the names of all caches in sorted order.
+    std::vector<std::string>
+    get_cache_names() const;
 
     // Access snoop filter stats for coherent caches.
     // These are not per-cache metrics so it doesn't make sense to access them
@@ -108,10 +145,34 @@ public:
     get_knobs() const;
 
 protected:
+    struct shard_data_t {
+        int core = INVALID_CORE_INDEX;
+        std::string error;
+    };
+
     // Create a cache_t object with a specific replacement policy.
     virtual cache_t *
     create_cache(const std::string &name, const std::string &policy);
 
+    // Simulates a non-marker record on the given core.  Returns false and sets
+    // error on an unhandled record type.
+    bool
+    access_caches(int core_index, const memref_t &simref, std::string &error);
+
+    // Checks the knobs for features unavailable with parallel simulation and
+    // computes whether private hits can skip synchronization.
+    void
+    init_parallel();
+
+    // Lockstep mode: blocks until it is this core's turn, in the order of
+    // (records processed, core index) across all cores still running.
+    void
+    lockstep_wait(int core);
+    void
+    lockstep_advance(int core);
+    void
+    lockstep_finish(int core);
+
     cache_simulator_knobs_t knobs_;
 
     // Implement a set of ICaches and DCaches with pointer arrays.
@@ -132,6 +193,17 @@ protected:
     // Snoop filter tracks ownership of cache lines across private caches.
     snoop_filter_t *snoop_filter_ = nullptr;
 
+    // For parallel simulation.  In the non-lockstep mode, shared_lock_
+    // serializes all operations except for the private L1 hits which are
+    // handled by caching_device_t::request_local_hit() when local_hits_ok_
+    // is set.
+    std::mutex shared_lock_;
+    bool local_hits_ok_ = false;
+    // For the lockstep mode.  Each entry is the count of records processed by
+    // that core, or UINT64_MAX once the core is done.
+    std::unique_ptr<std::atomic<uint64_t>[]> lockstep_clock_;
+    std::atomic<unsigned int> lockstep_workers_ { 0 };
+
 private:
     bool is_warmed_up_;
 };
@@ -36,6 +36,7 @@
 #define _CACHE_SIMULATOR_CREATE_H_ 1
 
 #include <string>
+#include <vector>
 #include "analysis_tool.h"
 
 namespace dynamorio {
@@ -71,6 +72,8 @@ struct cache_simulator_knobs_t {
         , sim_refs(1ULL << 63)
         , cpu_scheduling(false)
         , use_physical(false)
+        , parallel(false)
+        , parallel_lockstep(false)
         , verbose(0)
     {
     }
@@ -92,6 +95,8 @@ struct cache_simulator_knobs_t {
     uint64_t sim_refs;
     bool cpu_scheduling;
     bool use_physical;
+    bool parallel;
+    bool parallel_lockstep;
     unsigned int verbose;
 };
 
@@ -106,6 +111,25 @@ cache_simulator_create(const cache_simulator_knobs_t &knobs);
 analysis_tool_t *
 cache_simulator_create(const std::string &config_file);
 
+/**
+ * Creates a tool that simulates each of the cache hierarchies defined in \p
+ * config_files over a single pass through the trace and reports their results
+ * side by side.  If \p num_threads is non-zero, the hierarchies are divided
+ * among up to that many worker threads which receive the trace in batches.
+ */
+analysis_tool_t *
+multi_cache_simulator_create(const std::vector<std::string> &config_files,
+                             unsigned int num_threads = 0);
+
+/**
+ * Creates a tool that simulates the 2-level hierarchy described by each entry
+ * in \p knobs over a single pass through the trace.  \p num_threads is as
+ * described for the config file variant above.
+ */
+analysis_tool_t *
+multi_cache_simulator_create(const std::vector<cache_simulator_knobs_t> &knobs,
+                             unsigned int num_threads = 0);
+
 /** Creates an instance of a cache miss analyzer. */
 analysis_tool_t *
 cache_miss_analyzer_create(const cache_simulator_knobs_t &knobs,
@@ -256,6 +256,52 @@ caching_device_t::request(const memref_t &memref_in)
     }
 }
 
+bool
+caching_device_t::request_local_hit(const memref_t &memref)
+{
+    addr_t tag = compute_tag(memref.data.addr);
+    if (tag != compute_tag(memref.data.addr + memref.data.size - 1))
+        return false;
+    // These cases all involve other devices on a hit: see request().
+    if (coherent_cache_ && memref.data.type == TRACE_TYPE_WRITE)
+        return false;
+    if (is_exclusive() && !children_.empty())
+        return false;
+    int block_idx;
+    int way;
+    if (tag == last_tag_) {
+        block_idx = last_block_idx_;
+        way = last_way_;
+    } else {
+        auto block_way = find_caching_device_block(tag);
+        if (block_way.first == nullptr)
+            return false;
+        block_idx = compute_block_idx(tag);
+        way = block_way.second;
+    }
+    caching_device_block_t *cache_block = &get_caching_device_block(block_idx, way);
+    assert(tag != TAG_INVALID && tag == cache_block->tag_);
+    stats_->access(memref, true /*hit*/, cache_block);
+    if (parent_ != nullptr)
+        ++pending_child_hits_;
+    access_update(block_idx, way);
+    last_tag_ = tag;
+    last_way_ = way;
+    last_block_idx_ = block_idx;
+    return true;
+}
+
+void
+caching_device_t::flush_pending_child_hits()
+{
+    if (pending_child_hits_ == 0)
+        return;
+    // Like record_access_stats(), hits count toward every ancestor.
+    for (caching_device_t *up = parent_; up != nullptr; up = up->parent_)
+        up->stats_->child_hits(pending_child_hits_);
+    pending_child_hits_ = 0;
+}
+
 void
 caching_device_t::access_update(int block_idx, int way)
 {
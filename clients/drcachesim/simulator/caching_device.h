@@ -55,8 +55,11 @@ namespace drmemtrace {
 // Different replacement policies are expected to be implemented by
 // subclassing caching_device_t.
 
-// We assume we're only invoked from a single thread of control and do
-// not need to synchronize data access.
+// We assume we're only invoked from a single thread of control at a time and do
+// not need to synchronize data access.  The one exception is
+// request_local_hit(), which only touches this device and its stats and so
+// may be invoked by the thread owning a private device while another thread
+// holds whatever lock the caller uses to serialize all other operations.
 
 class snoop_filter_t;
 class prefetcher_t;
@@ -78,6 +81,17 @@ public:
     virtual ~caching_device_t();
     virtual void
     request(const memref_t &memref);
+    // Handles a single-block hit which requires no notification of any other
+    // device, such as a snoop filter or an exclusive parent.  Returns false
+    // without any side effects if the request is not such a hit, in which case
+    // request() must be used instead.  The hit counts of ancestor devices are
+    // only updated by a later flush_pending_child_hits().  Together these let
+    // the owner of a private cache simulate its hits while other threads of
+    // control are operating on the shared levels of the hierarchy.
+    bool
+    request_local_hit(const memref_t &memref);
+    void
+    flush_pending_child_hits();
     virtual void
     invalidate(addr_t tag, invalidation_type_t invalidation_type_);
     bool
@@ -280,6 +294,8 @@ protected:
     addr_t last_tag_;
     int last_way_;
     int last_block_idx_;
+    // Hits from request_local_hit() not yet reported to our ancestors.
+    int64_t pending_child_hits_ = 0;
     // Optimization: keep a hashtable for quick lookup of {block,way}
     // given a tag, if using a large cache hierarchy where serial
     // walks over the associativity end up as bottlenecks.
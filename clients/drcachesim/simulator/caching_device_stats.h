@@ -183,6 +183,11 @@ public:
     virtual void
     child_access(const memref_t &memref, bool hit, caching_device_block_t *cache_block);
 
+    // Called with a count of child hits whose reporting was batched up by
+    // caching_device_t::request_local_hit().
+    virtual void
+    child_hits(int64_t count);
+
     virtual void
     print_stats(std::string prefix);
 
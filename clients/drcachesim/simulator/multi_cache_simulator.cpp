@@ -0,0 +1,362 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, LLC  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, LLC OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "multi_cache_simulator.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "cache_simulator.h"
+#include "cache_simulator_create.h"
+#include "cache_stats.h"
+#include "memref.h"
+#include "memtrace_stream.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+analysis_tool_t *
+multi_cache_simulator_create(const std::vector<std::string> &config_files,
+                             unsigned int num_threads)
+{
+    std::vector<std::string> names;
+    std::vector<cache_simulator_t *> sims;
+    for (const std::string &config_file : config_files) {
+        std::ifstream fin;
+        fin.open(config_file);
+        if (!fin.is_open()) {
+            ERRMSG("Failed to open the config file '%s'\n", config_file.c_str());
+            for (cache_simulator_t *sim : sims)
+                delete sim;
+            return nullptr;
+        }
+        // Label each configuration by its file name without the directory.
+        size_t sep = config_file.find_last_of("/\\");
+        names.push_back(sep == std::string::npos ? config_file
+                                                 : config_file.substr(sep + 1));
+        sims.push_back(new cache_simulator_t(&fin));
+        fin.close();
+    }
+    return new multi_cache_simulator_t(names, sims, num_threads);
+}
+
+analysis_tool_t *
+multi_cache_simulator_create(const std::vector<cache_simulator_knobs_t> &knobs,
+                             unsigned int num_threads)
+{
+    std::vector<std::string> names;
+    std::vector<cache_simulator_t *> sims;
+    for (size_t i = 0; i < knobs.size(); ++i) {
+        names.push_back("config" + std::to_string(i));
+        sims.push_back(new cache_simulator_t(knobs[i]));
+    }
+    return new multi_cache_simulator_t(names, sims, num_threads);
+}
+
+multi_cache_simulator_t::multi_cache_simulator_t(
+    const std::vector<std::string> &names, const std::vector<cache_simulator_t *> &sims,
+    unsigned int num_threads)
+    : names_(names)
+    , sims_(sims)
+    , num_threads_(num_threads)
+{
+    if (sims_.empty()) {
+        error_string_ = "No cache configurations were specified";
+        success_ = false;
+        return;
+    }
+    for (size_t i = 0; i < sims_.size(); ++i) {
+        if (!*sims_[i]) {
+            error_string_ = names_[i] + ": " + sims_[i]->get_error_string();
+            success_ = false;
+            return;
+        }
+        // The configurations are fed serially from one shard stream, so the
+        // per-core parallel mode cannot apply.
+        if (sims_[i]->get_knobs().parallel) {
+            error_string_ = names_[i] +
+                ": sim_parallel is not supported with multiple configurations";
+            success_ = false;
+            return;
+        }
+    }
+    if (num_threads_ == 0)
+        return;
+    size_t num_workers = std::min(static_cast<size_t>(num_threads_), sims_.size());
+    for (size_t i = 0; i < num_workers; ++i)
+        workers_.emplace_back(new worker_t);
+    for (size_t i = 0; i < sims_.size(); ++i)
+        workers_[i % num_workers]->sims.push_back(i);
+    for (auto &worker : workers_) {
+        for (size_t index : worker->sims)
+            sims_[index]->initialize_stream(&worker->stream);
+        worker->thread = std::thread(&multi_cache_simulator_t::worker_loop, this,
+                                     worker.get());
+    }
+    batches_[0].reserve(BATCH_RECORDS);
+    batches_[1].reserve(BATCH_RECORDS);
+}
+
+multi_cache_simulator_t::~multi_cache_simulator_t()
+{
+    stop_workers();
+    for (cache_simulator_t *sim : sims_)
+        delete sim;
+}
+
+std::string
+multi_cache_simulator_t::initialize_stream(memtrace_stream_t *serial_stream)
+{
+    serial_stream_ = serial_stream;
+    // With workers, each simulator was pointed at its worker's replay stream
+    // up front.
+    if (!workers_.empty())
+        return "";
+    for (size_t i = 0; i < sims_.size(); ++i) {
+        std::string error = sims_[i]->initialize_stream(serial_stream);
+        if (!error.empty())
+            return names_[i] + ": " + error;
+    }
+    return "";
+}
+
+std::string
+multi_cache_simulator_t::initialize_shard_type(shard_type_t shard_type)
+{
+    for (size_t i = 0; i < sims_.size(); ++i) {
+        std::string error = sims_[i]->initialize_shard_type(shard_type);
+        if (!error.empty())
+            return names_[i] + ": " + error;
+    }
+    return "";
+}
+
+bool
+multi_cache_simulator_t::process_memref(const memref_t &memref)
+{
+    if (workers_.empty()) {
+        for (size_t i = 0; i < sims_.size(); ++i) {
+            if (!sims_[i]->process_memref(memref)) {
+                error_string_ = names_[i] + ": " + sims_[i]->get_error_string();
+                return false;
+            }
+        }
+        return true;
+    }
+    if (finished_) {
+        error_string_ = "Record received after the simulation finished";
+        return false;
+    }
+    batch_entry_t entry;
+    entry.memref = memref;
+    entry.shard_index = serial_stream_ == nullptr ? 0 : serial_stream_->get_shard_index();
+    entry.output_cpuid =
+        serial_stream_ == nullptr ? -1 : serial_stream_->get_output_cpuid();
+    batches_[fill_index_].push_back(entry);
+    if (batches_[fill_index_].size() >= BATCH_RECORDS)
+        return dispatch_batch();
+    return true;
+}
+
+void
+multi_cache_simulator_t::worker_loop(worker_t *worker)
+{
+    uint64_t seen_generation = 0;
+    while (true) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            work_ready_.wait(
+                lock, [&]() { return generation_ != seen_generation || exiting_; });
+            if (generation_ == seen_generation)
+                return;
+            seen_generation = generation_;
+            index = published_index_;
+        }
+        // Once a simulator fails we stop feeding this worker's simulators and
+        // leave it to the analyzer thread to report the error.
+        if (worker->error.empty()) {
+            for (const batch_entry_t &entry : batches_[index]) {
+                worker->stream.set_shard_index(entry.shard_index);
+                worker->stream.set_output_cpuid(entry.output_cpuid);
+                for (size_t sim_index : worker->sims) {
+                    if (!sims_[sim_index]->process_memref(entry.memref)) {
+                        worker->error = names_[sim_index] + ": " +
+                            sims_[sim_index]->get_error_string();
+                        break;
+                    }
+                }
+                if (!worker->error.empty())
+                    break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(lock_);
+        if (--pending_workers_ == 0)
+            work_done_.notify_one();
+    }
+}
+
+bool
+multi_cache_simulator_t::wait_for_workers(std::unique_lock<std::mutex> &lock)
+{
+    work_done_.wait(lock, [this]() { return pending_workers_ == 0; });
+    for (const auto &worker : workers_) {
+        if (!worker->error.empty()) {
+            error_string_ = worker->error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+multi_cache_simulator_t::dispatch_batch()
+{
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        if (!wait_for_workers(lock))
+            return false;
+        published_index_ = fill_index_;
+        ++generation_;
+        pending_workers_ = static_cast<unsigned int>(workers_.size());
+    }
+    work_ready_.notify_all();
+    // The other buffer was consumed by the batch we just waited for.
+    fill_index_ ^= 1;
+    batches_[fill_index_].clear();
+    return true;
+}
+
+void
+multi_cache_simulator_t::stop_workers()
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        exiting_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto &worker : workers_) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+bool
+multi_cache_simulator_t::finish()
+{
+    if (finished_ || workers_.empty())
+        return error_string_.empty();
+    finished_ = true;
+    bool res = true;
+    if (!batches_[fill_index_].empty())
+        res = dispatch_batch();
+    if (res) {
+        std::unique_lock<std::mutex> lock(lock_);
+        res = wait_for_workers(lock);
+    }
+    stop_workers();
+    return res;
+}
+
+bool
+multi_cache_simulator_t::print_results()
+{
+    if (!finish())
+        return false;
+    for (size_t i = 0; i < sims_.size(); ++i) {
+        std::cerr << "Configuration " << names_[i] << ":\n";
+        if (!sims_[i]->print_results()) {
+            error_string_ = names_[i] + ": " + sims_[i]->get_error_string();
+            return false;
+        }
+        std::cerr << "\n";
+    }
+
+    // Summarize the local miss rate of every cache name found in any
+    // configuration, with one column per configuration.
+    std::set<std::string> cache_names;
+    size_t name_width = strlen("Cache");
+    for (cache_simulator_t *sim : sims_) {
+        for (const std::string &name : sim->get_cache_names()) {
+            cache_names.insert(name);
+            name_width = std::max(name_width, name.size());
+        }
+    }
+    std::vector<size_t> widths;
+    for (const std::string &name : names_)
+        widths.push_back(std::max(name.size(), static_cast<size_t>(8)));
+    std::cerr << "Miss rates by configuration:\n";
+    std::cerr << "  " << std::left << std::setw(name_width) << "Cache" << std::right;
+    for (size_t i = 0; i < names_.size(); ++i)
+        std::cerr << "  " << std::setw(widths[i]) << names_[i];
+    std::cerr << "\n";
+    for (const std::string &cache_name : cache_names) {
+        std::cerr << "  " << std::left << std::setw(name_width) << cache_name
+                  << std::right;
+        for (size_t i = 0; i < sims_.size(); ++i) {
+            int64_t hits = sims_[i]->get_cache_metric(metric_name_t::HITS, cache_name);
+            int64_t misses =
+                sims_[i]->get_cache_metric(metric_name_t::MISSES, cache_name);
+            std::string cell = "-";
+            if (hits >= 0 && misses >= 0) {
+                std::ostringstream rate;
+                rate << std::fixed << std::setprecision(2)
+                     << (hits + misses == 0
+                             ? 0.0
+                             : 100.0 * misses / static_cast<double>(hits + misses))
+                     << "%";
+                cell = rate.str();
+            }
+            std::cerr << "  " << std::setw(widths[i]) << cell;
+        }
+        std::cerr << "\n";
+    }
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
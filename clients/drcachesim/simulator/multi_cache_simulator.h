@@ -0,0 +1,144 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, LLC  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, LLC OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* multi_cache_simulator: simulates several cache hierarchies over a single
+ * pass of the trace.
+ */
+
+#ifndef _MULTI_CACHE_SIMULATOR_H_
+#define _MULTI_CACHE_SIMULATOR_H_ 1
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "cache_simulator.h"
+#include "memref.h"
+#include "memtrace_stream.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Feeds each record to a set of cache_simulator_t instances so that
+// alternative hierarchies can be compared without re-reading the trace.
+// With no worker threads the simulators are invoked in turn on the analyzer
+// thread.  Otherwise records are collected into batches which are handed to
+// the workers, each of which owns a fixed subset of the simulators and
+// replays the batch with the shard index and cpuid the simulators would have
+// seen from the analyzer's stream.  The batches are double-buffered so the
+// analyzer can fill one while the workers drain the other.
+class multi_cache_simulator_t : public analysis_tool_t {
+public:
+    // Takes ownership of the simulators.  The names label the results.
+    multi_cache_simulator_t(const std::vector<std::string> &names,
+                            const std::vector<cache_simulator_t *> &sims,
+                            unsigned int num_threads);
+    virtual ~multi_cache_simulator_t();
+    std::string
+    initialize_stream(memtrace_stream_t *serial_stream) override;
+    std::string
+    initialize_shard_type(shard_type_t shard_type) override;
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+
+    // Completes any batched simulation.  This is done by print_results() but
+    // is exposed so tests can query the simulators beforehand.
+    bool
+    finish();
+
+    const cache_simulator_t &
+    get_simulator(size_t index) const
+    {
+        return *sims_[index];
+    }
+
+protected:
+    struct batch_entry_t {
+        memref_t memref;
+        int shard_index;
+        int64_t output_cpuid;
+    };
+
+    struct worker_t {
+        std::vector<size_t> sims;
+        default_memtrace_stream_t stream;
+        std::thread thread;
+        std::string error;
+    };
+
+    static constexpr size_t BATCH_RECORDS = 4096;
+
+    void
+    worker_loop(worker_t *worker);
+    // Hands the batch being filled to the workers, after waiting for them to
+    // finish the prior batch.  Returns false if a worker hit an error.
+    bool
+    dispatch_batch();
+    // Waits until the workers are idle.  Returns false if a worker hit an
+    // error, which is then stored in error_string_.
+    bool
+    wait_for_workers(std::unique_lock<std::mutex> &lock);
+    void
+    stop_workers();
+
+    std::vector<std::string> names_;
+    std::vector<cache_simulator_t *> sims_;
+    unsigned int num_threads_;
+    memtrace_stream_t *serial_stream_ = nullptr;
+    bool finished_ = false;
+
+    std::vector<std::unique_ptr<worker_t>> workers_;
+    std::vector<batch_entry_t> batches_[2];
+    int fill_index_ = 0;
+    // The rest is protected by lock_.
+    std::mutex lock_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    int published_index_ = 0;
+    uint64_t generation_ = 0;
+    unsigned int pending_workers_ = 0;
+    bool exiting_ = false;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _MULTI_CACHE_SIMULATOR_H_ */
@@ -34,7 +34,10 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <memory>
 #include <regex>
+#include <thread>
+#include <vector>
 
 #undef NDEBUG
 #include <assert.h>
@@ -43,6 +46,7 @@
 #include "simulator/cache.h"
 #include "simulator/cache_lru.h"
 #include "simulator/cache_simulator.h"
+#include "simulator/multi_cache_simulator.h"
 #include "../common/memref.h"
 #include "../common/utils.h"
 
@@ -833,6 +837,208 @@ Core #1 \(traced CPU\(s\): #567800\)
     }
 }
 
+static void
+run_parallel_sim(cache_simulator_t &sim, const std::vector<std::vector<memref_t>> &refs)
+{
+    std::string error = sim.initialize_stream(nullptr);
+    assert(error.empty());
+    error = sim.initialize_shard_type(SHARD_BY_CORE);
+    assert(error.empty());
+    std::vector<std::thread> threads;
+    for (int core = 0; core < static_cast<int>(refs.size()); ++core) {
+        threads.emplace_back([&sim, &refs, core]() {
+            void *worker_data = sim.parallel_worker_init(core);
+            void *shard_data = sim.parallel_shard_init_stream(core, worker_data, nullptr);
+            for (const memref_t &ref : refs[core]) {
+                bool res = sim.parallel_shard_memref(shard_data, ref);
+                assert(res);
+            }
+            bool res = sim.parallel_shard_exit(shard_data);
+            assert(res);
+            std::string error = sim.parallel_worker_exit(worker_data);
+            assert(error.empty());
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void
+unit_test_parallel()
+{
+    {
+        // Parallel simulation cannot honor a global reference limit.
+        cache_simulator_knobs_t knobs = make_test_knobs();
+        knobs.parallel = true;
+        knobs.warmup_refs = 10;
+        cache_simulator_t sim(knobs);
+        assert(!sim);
+    }
+    {
+        // Parallel simulation requires core sharding.
+        cache_simulator_knobs_t knobs = make_test_knobs();
+        knobs.parallel = true;
+        cache_simulator_t sim(knobs);
+        assert(!!sim);
+        sim.initialize_stream(nullptr);
+        std::string error = sim.initialize_shard_type(SHARD_BY_THREAD);
+        assert(!error.empty());
+    }
+    // Each core touches some lines of its own and some shared with the other
+    // core, with enough distinct lines to cause LLC evictions.
+    constexpr int NUM_CORES = 2;
+    constexpr int NUM_REFS = 2000;
+    std::vector<std::vector<memref_t>> refs(NUM_CORES);
+    for (int core = 0; core < NUM_CORES; ++core) {
+        for (int i = 0; i < NUM_REFS; ++i) {
+            addr_t line = (i * 7 + core * 3) % (i % 3 == 0 ? 80 : 24);
+            trace_type_t type = i % 5 == 0
+                ? TRACE_TYPE_INSTR
+                : (i % 4 == 0 ? TRACE_TYPE_WRITE : TRACE_TYPE_READ);
+            refs[core].push_back(make_memref(line * 64 + core * 8, type));
+            if (core == 1 && i % 100 == 0) {
+                // The idle records synthesized by the analyzer.
+                memref_t idle = {};
+                idle.marker.type = TRACE_TYPE_MARKER;
+                idle.marker.marker_type = TRACE_MARKER_TYPE_CORE_IDLE;
+                refs[core].push_back(idle);
+            }
+        }
+    }
+    // The serial baseline, in the order lockstep mode uses: by each core's count
+    // of records processed, with ties going to the lower core.
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.num_cores = NUM_CORES;
+    cache_simulator_t serial(knobs);
+    default_memtrace_stream_t stream;
+    serial.initialize_stream(&stream);
+    std::string error = serial.initialize_shard_type(SHARD_BY_CORE);
+    assert(error.empty());
+    for (size_t i = 0; i < refs[1].size(); ++i) {
+        for (int core = 0; core < NUM_CORES; ++core) {
+            if (i >= refs[core].size())
+                continue;
+            stream.set_shard_index(core);
+            bool res = serial.process_memref(refs[core][i]);
+            assert(res);
+        }
+    }
+    knobs.parallel = true;
+    knobs.parallel_lockstep = true;
+    cache_simulator_t lockstep(knobs);
+    run_parallel_sim(lockstep, refs);
+    knobs.parallel_lockstep = false;
+    cache_simulator_t parallel(knobs);
+    run_parallel_sim(parallel, refs);
+    int64_t serial_llc_accesses = 0;
+    int64_t parallel_llc_accesses = 0;
+    for (unsigned core = 0; core < NUM_CORES; ++core) {
+        for (cache_split_t split : { cache_split_t::DATA, cache_split_t::INSTRUCTION }) {
+            for (metric_name_t metric : { metric_name_t::HITS, metric_name_t::MISSES }) {
+                // Lockstep should match exactly at every level.
+                for (unsigned level = 1; level <= 2; ++level) {
+                    TEST_EQ(lockstep.get_cache_metric(metric, level, core, split),
+                             serial.get_cache_metric(metric, level, core, split));
+                }
+                // Without lockstep the private caches are unaffected by the
+                // interleaving, though the shared LLC is.
+                TEST_EQ(parallel.get_cache_metric(metric, 1, core, split),
+                         serial.get_cache_metric(metric, 1, core, split));
+            }
+        }
+    }
+    for (metric_name_t metric : { metric_name_t::HITS, metric_name_t::MISSES }) {
+        serial_llc_accesses += serial.get_cache_metric(metric, 2);
+        parallel_llc_accesses += parallel.get_cache_metric(metric, 2);
+    }
+    TEST_EQ(parallel_llc_accesses, serial_llc_accesses);
+    TEST_EQ(lockstep.get_cache_metric(metric_name_t::CHILD_HITS, 2),
+             serial.get_cache_metric(metric_name_t::CHILD_HITS, 2));
+    TEST_EQ(parallel.get_cache_metric(metric_name_t::CHILD_HITS, 2),
+             serial.get_cache_metric(metric_name_t::CHILD_HITS, 2));
+}
+
+void
+unit_test_multi_config()
+{
+    // Hierarchies that differ in size and replacement policy, with one more than
+    // the number of worker threads so that a worker owns two of them.
+    constexpr int NUM_CORES = 2;
+    std::vector<cache_simulator_knobs_t> configs;
+    for (int i = 0; i < 3; ++i) {
+        cache_simulator_knobs_t knobs = make_test_knobs();
+        knobs.num_cores = NUM_CORES;
+        knobs.L1D_size = (8 * 64) << i;
+        knobs.L1D_assoc = 8;
+        knobs.replace_policy = i == 2 ? "FIFO" : "LRU";
+        configs.push_back(knobs);
+    }
+    // Enough records to cycle through both batch buffers several times.
+    std::vector<memref_t> refs;
+    for (int i = 0; i < 20000; ++i) {
+        addr_t line = (i * 13) % (i % 4 == 0 ? 200 : 40);
+        refs.push_back(make_memref(line * 64, i % 7 == 0 ? TRACE_TYPE_INSTR
+                                                         : TRACE_TYPE_READ));
+    }
+    auto run = [&refs](analysis_tool_t &tool) {
+        default_memtrace_stream_t stream;
+        std::string error = tool.initialize_stream(&stream);
+        assert(error.empty());
+        error = tool.initialize_shard_type(SHARD_BY_CORE);
+        assert(error.empty());
+        for (size_t i = 0; i < refs.size(); ++i) {
+            // Switch cores every so often, with cpuids that must be mapped.
+            int core = (i / 100) % NUM_CORES;
+            stream.set_shard_index(core);
+            stream.set_output_cpuid(1000 + core);
+            bool res = tool.process_memref(refs[i]);
+            assert(res);
+        }
+    };
+    std::vector<std::unique_ptr<cache_simulator_t>> singles;
+    for (const cache_simulator_knobs_t &knobs : configs) {
+        singles.emplace_back(new cache_simulator_t(knobs));
+        run(*singles.back());
+    }
+    for (unsigned int num_threads : { 0, 2 }) {
+        std::unique_ptr<analysis_tool_t> tool(
+            multi_cache_simulator_create(configs, num_threads));
+        assert(!!*tool);
+        run(*tool);
+        multi_cache_simulator_t *multi =
+            dynamic_cast<multi_cache_simulator_t *>(tool.get());
+        assert(multi != nullptr);
+        bool res = multi->finish();
+        assert(res);
+        for (size_t i = 0; i < configs.size(); ++i) {
+            const cache_simulator_t &sim = multi->get_simulator(i);
+            for (const std::string &name : singles[i]->get_cache_names()) {
+                for (metric_name_t metric :
+                     { metric_name_t::HITS, metric_name_t::MISSES }) {
+                    TEST_EQ(sim.get_cache_metric(metric, name),
+                             singles[i]->get_cache_metric(metric, name));
+                }
+            }
+        }
+        std::stringstream output;
+        std::streambuf *prev_buf = std::cerr.rdbuf(output.rdbuf());
+        res = tool->print_results();
+        std::cerr.rdbuf(prev_buf);
+        assert(res);
+        assert(output.str().find("Configuration config2:") != std::string::npos);
+        assert(std::regex_search(
+            output.str(), std::regex(R"DELIM(\n  L1D1 +[0-9.]+% +[0-9.]+%)DELIM")));
+    }
+    {
+        // A bad configuration makes the whole tool fail.
+        std::vector<cache_simulator_knobs_t> bad = configs;
+        bad[1].L1D_size = 3 * 64;
+        std::unique_ptr<analysis_tool_t> tool(multi_cache_simulator_create(bad, 2));
+        assert(!*tool);
+        assert(tool->get_error_string().find("config1") == 0);
+    }
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -854,6 +1060,8 @@ test_main(int argc, const char *argv[])
     unit_test_child_hits();
     unit_test_cache_replacement_policy();
     unit_test_core_sharded();
+    unit_test_parallel();
+    unit_test_multi_config();
     return 0;
 }
 
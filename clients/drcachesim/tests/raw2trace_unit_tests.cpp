@@ -101,12 +101,12 @@ class raw2trace_test_t : public raw2trace_t {
 public:
     raw2trace_test_t(const std::vector<std::istream *> &input,
                      const std::vector<std::ostream *> &output, instrlist_t &instrs,
-                     void *drcontext)
+                     void *drcontext, int worker_count = -1)
         : raw2trace_t(nullptr, input, output, {}, INVALID_FILE, nullptr, nullptr,
                       drcontext,
                       // The sequences are small so we print everything for easier
                       // debugging and viewing of what's going on.
-                      4)
+                      4, worker_count)
     {
         module_mapper_ = std::unique_ptr<module_mapper_t>(
             new test_module_mapper_t(&instrs, drcontext));
@@ -3156,6 +3156,185 @@ test_ifiltered(void *drcontext)
 #endif
 }
 
+bool
+test_shared_decode_cache(void *drcontext)
+{
+    std::cerr << "\n===============\nTesting shared decode cache\n";
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *move1 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG1), opnd_create_reg(REG2));
+    instr_t *store =
+        XINST_CREATE_store(drcontext, OPND_CREATE_MEMPTR(REG2, 0), opnd_create_reg(REG1));
+    instr_t *move2 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG2), opnd_create_reg(REG1));
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, move1);
+    instrlist_append(ilist, store);
+    instrlist_append(ilist, move2);
+    size_t offs_nop = 0;
+    size_t offs_move1 = offs_nop + instr_length(drcontext, nop);
+    size_t offs_move2 = offs_move1 + instr_length(drcontext, move1) +
+        instr_length(drcontext, store);
+
+    // Many threads all executing the same blocks, converted by multiple workers
+    // which race to fill in the one shared decode cache.
+    constexpr int NUM_THREADS = 16;
+    constexpr int NUM_ITERS = 200;
+    std::vector<std::string> raw_data;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        std::vector<offline_entry_t> raw;
+        raw.push_back(make_header());
+        raw.push_back(make_tid(1 + i));
+        raw.push_back(make_pid());
+        raw.push_back(make_line_size());
+        raw.push_back(make_timestamp());
+        raw.push_back(make_core());
+        for (int j = 0; j < NUM_ITERS; ++j) {
+            raw.push_back(make_block(offs_move1, 2));
+            raw.push_back(make_memref(42));
+            raw.push_back(make_block(offs_move2, 1));
+        }
+        raw.push_back(make_exit());
+        std::string data;
+        for (const auto &entry : raw) {
+            data.append(reinterpret_cast<const char *>(&entry),
+                        reinterpret_cast<const char *>(&entry + 1));
+        }
+        raw_data.push_back(data);
+    }
+    std::vector<std::unique_ptr<std::istringstream>> raw_in;
+    std::vector<std::unique_ptr<std::ostringstream>> result;
+    std::vector<std::istream *> input;
+    std::vector<std::ostream *> output;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        raw_in.emplace_back(new std::istringstream(raw_data[i]));
+        input.push_back(raw_in.back().get());
+        result.emplace_back(new std::ostringstream);
+        output.push_back(result.back().get());
+    }
+    {
+        raw2trace_test_t raw2trace(input, output, *ilist, drcontext,
+                                   /*worker_count=*/8);
+        std::string error = raw2trace.do_conversion();
+        CHECK(error.empty(), error);
+    }
+    instrlist_clear_and_destroy(drcontext, ilist);
+
+    // Every thread should see the same instructions and addresses.
+    std::vector<trace_entry_t> first;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        std::string data = result[i]->str();
+        CHECK(!data.empty() && data.size() % sizeof(trace_entry_t) == 0,
+              "output is not a multiple of trace_entry_t");
+        const trace_entry_t *entries = reinterpret_cast<const trace_entry_t *>(&data[0]);
+        size_t count = data.size() / sizeof(trace_entry_t);
+        int instrs = 0;
+        std::vector<trace_entry_t> interesting;
+        for (size_t j = 0; j < count; ++j) {
+            if (type_is_instr(static_cast<trace_type_t>(entries[j].type)) ||
+                entries[j].type == TRACE_TYPE_WRITE) {
+                interesting.push_back(entries[j]);
+                if (type_is_instr(static_cast<trace_type_t>(entries[j].type)))
+                    ++instrs;
+            }
+        }
+        CHECK(instrs == 3 * NUM_ITERS, "wrong instruction count");
+        if (i == 0) {
+            first = interesting;
+            continue;
+        }
+        CHECK(interesting.size() == first.size(), "threads differ");
+        for (size_t j = 0; j < first.size(); ++j) {
+            CHECK(interesting[j].type == first[j].type &&
+                      interesting[j].size == first[j].size &&
+                      interesting[j].addr == first[j].addr,
+                  "threads differ");
+        }
+    }
+    return true;
+}
+
+bool
+test_work_queue(void *drcontext)
+{
+    std::cerr << "\n===============\nTesting dynamic work distribution\n";
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *move =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG1), opnd_create_reg(REG2));
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, move);
+    size_t offs_move = instr_length(drcontext, nop);
+
+    // Threads of very different lengths, more of them than workers, so that the
+    // workers must each pick up several from the shared queue.  The sizes are
+    // supplied explicitly for half of the threads to test the override.
+    constexpr int NUM_THREADS = 7;
+    constexpr int NUM_WORKERS = 3;
+    std::vector<std::string> raw_data;
+    std::vector<uint64_t> sizes;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        std::vector<offline_entry_t> raw;
+        raw.push_back(make_header());
+        raw.push_back(make_tid(1 + i));
+        raw.push_back(make_pid());
+        raw.push_back(make_line_size());
+        raw.push_back(make_timestamp());
+        raw.push_back(make_core());
+        for (int j = 0; j < (i % 3 + 1) * 50 * (i + 1); ++j)
+            raw.push_back(make_block(offs_move, 1));
+        raw.push_back(make_exit());
+        std::string data;
+        for (const auto &entry : raw) {
+            data.append(reinterpret_cast<const char *>(&entry),
+                        reinterpret_cast<const char *>(&entry + 1));
+        }
+        raw_data.push_back(data);
+        sizes.push_back(i % 2 == 0 ? 0 : data.size());
+    }
+    std::vector<std::unique_ptr<std::istringstream>> raw_in;
+    std::vector<std::unique_ptr<std::ostringstream>> result;
+    std::vector<std::istream *> input;
+    std::vector<std::ostream *> output;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        raw_in.emplace_back(new std::istringstream(raw_data[i]));
+        input.push_back(raw_in.back().get());
+        result.emplace_back(new std::ostringstream);
+        output.push_back(result.back().get());
+    }
+    {
+        raw2trace_test_t raw2trace(input, output, *ilist, drcontext, NUM_WORKERS);
+        raw2trace.set_thread_file_sizes(sizes);
+        std::string error = raw2trace.do_conversion();
+        CHECK(error.empty(), error);
+    }
+    instrlist_clear_and_destroy(drcontext, ilist);
+
+    // Each output must hold exactly its own input's instructions.
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        std::string data = result[i]->str();
+        CHECK(!data.empty() && data.size() % sizeof(trace_entry_t) == 0,
+              "output is not a multiple of trace_entry_t");
+        const trace_entry_t *entries = reinterpret_cast<const trace_entry_t *>(&data[0]);
+        size_t count = data.size() / sizeof(trace_entry_t);
+        int instrs = 0;
+        bool found_tid = false;
+        for (size_t j = 0; j < count; ++j) {
+            if (type_is_instr(static_cast<trace_type_t>(entries[j].type)))
+                ++instrs;
+            else if (entries[j].type == TRACE_TYPE_THREAD &&
+                     entries[j].addr == static_cast<addr_t>(1 + i))
+                found_tid = true;
+        }
+        CHECK(found_tid, "output has the wrong thread");
+        CHECK(instrs == (i % 3 + 1) * 50 * (i + 1), "wrong instruction count");
+    }
+    return true;
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -3177,7 +3356,8 @@ test_main(int argc, const char *argv[])
         !test_xfer_modoffs(drcontext) || !test_xfer_absolute(drcontext) ||
         !test_branch_decoration(drcontext) ||
         !test_stats_timestamp_instr_count(drcontext) ||
-        !test_is_maybe_blocking_syscall(drcontext) || !test_ifiltered(drcontext))
+        !test_is_maybe_blocking_syscall(drcontext) || !test_ifiltered(drcontext) ||
+        !test_shared_decode_cache(drcontext) || !test_work_queue(drcontext))
         return 1;
     return 0;
 }
@@ -84,6 +84,7 @@ public:
     };
 
     // Make these methods public for testing.
+    using reuse_distance_t::compute_miss_ratio_curve;
     using reuse_distance_t::get_aggregated_results;
     using reuse_distance_t::print_histogram;
 
@@ -507,6 +508,133 @@ data_histogram_test()
     }
 }
 
+// Test that the Fenwick tree computes the same results as the skip list.
+void
+fenwick_tree_test()
+{
+    std::cerr << "fenwick_tree_test()\n";
+
+    constexpr uint32_t LINE_SIZE = 64;
+    constexpr int NUM_LINES = 5000;
+    constexpr int NUM_REFS = 200000;
+
+    for (unsigned int distance_limit : { 0u, 1500u }) {
+        reuse_distance_knobs_t knobs;
+        knobs.line_size = LINE_SIZE;
+        knobs.skip_list_distance = 50;
+        knobs.distance_limit = distance_limit;
+        reuse_distance_test_t skip_list(knobs);
+        knobs.use_fenwick_tree = true;
+        reuse_distance_test_t tree(knobs);
+
+        // A fixed pseudo-random sequence mixing near and far reuses, long enough
+        // to make the tree renumber its slots many times.
+        uint32_t seed = 42;
+        for (int i = 0; i < NUM_REFS; ++i) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t rand = seed >> 8;
+            int line = (rand % 4 == 0) ? rand % NUM_LINES : rand % 64;
+            memref_t memref = generate_memref(0x10000 + line * LINE_SIZE,
+                                              i % 3 == 0 ? TRACE_TYPE_INSTR
+                                                         : TRACE_TYPE_READ);
+            bool success = skip_list.process_memref(memref) && tree.process_memref(memref);
+            assert(success);
+        }
+
+        auto *expect = skip_list.get_aggregated_results();
+        auto *shard = tree.get_aggregated_results();
+        assert(expect->dist_map.size() > 100);
+        assert(shard->dist_map == expect->dist_map);
+        assert(shard->dist_map_data == expect->dist_map_data);
+        assert(shard->pruned_address_count == expect->pruned_address_count);
+        assert(shard->pruned_address_hits == expect->pruned_address_hits);
+        assert(shard->cache_map.size() == expect->cache_map.size());
+        for (const auto &entry : expect->cache_map) {
+            const auto it = shard->cache_map.find(entry.first);
+            assert(it != shard->cache_map.end());
+            assert(it->second->total_refs == entry.second->total_refs);
+            assert(it->second->distant_refs == entry.second->distant_refs);
+        }
+    }
+}
+
+// Test the miss ratio curve, both exact and estimated by sampling.
+void
+miss_ratio_curve_test()
+{
+    std::cerr << "miss_ratio_curve_test()\n";
+
+    constexpr uint32_t LINE_SIZE = 64;
+    {
+        // Cycling through 100 lines misses in any LRU cache smaller than that and
+        // only on first touch in larger ones.
+        constexpr int NUM_LINES = 100;
+        constexpr int NUM_LOOPS = 20;
+        reuse_distance_knobs_t knobs;
+        knobs.line_size = LINE_SIZE;
+        reuse_distance_test_t reuse_distance(knobs);
+        for (int i = 0; i < NUM_LOOPS; ++i) {
+            for (int j = 0; j < NUM_LINES; ++j) {
+                bool success =
+                    reuse_distance.process_memref(generate_memref(j * LINE_SIZE));
+                assert(success);
+            }
+        }
+        auto curve =
+            reuse_distance.compute_miss_ratio_curve(reuse_distance.get_aggregated_results());
+        assert(curve.size() == 8); // 1 through 128 lines.
+        for (const auto &point : curve) {
+            if (point.first < NUM_LINES)
+                assert(point.second == 1.0);
+            else
+                assert(std::abs(point.second - 1.0 / NUM_LOOPS) < 1e-9);
+        }
+    }
+    {
+        // A mix of near and far reuses over a footprint much larger than the
+        // fixed-size sample.
+        constexpr int NUM_LINES = 20000;
+        constexpr int NUM_REFS = 400000;
+        constexpr double TOLERANCE = 0.03;
+        // Sampling at rate R cannot resolve caches of only a few times 1/R lines.
+        constexpr int64_t MIN_COMPARED_LINES = 512;
+        reuse_distance_knobs_t knobs;
+        knobs.line_size = LINE_SIZE;
+        knobs.use_fenwick_tree = true;
+        reuse_distance_test_t exact(knobs);
+        knobs.sample_rate = 0.1;
+        reuse_distance_test_t fixed_rate(knobs);
+        knobs.sample_rate = 1.0;
+        knobs.sample_max_lines = 1000;
+        reuse_distance_test_t fixed_size(knobs);
+        uint32_t seed = 7;
+        for (int i = 0; i < NUM_REFS; ++i) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t rand = seed >> 8;
+            int line = (rand % 2 == 0) ? rand % NUM_LINES : rand % 500;
+            memref_t memref = generate_memref(line * LINE_SIZE);
+            bool success = exact.process_memref(memref) &&
+                fixed_rate.process_memref(memref) && fixed_size.process_memref(memref);
+            assert(success);
+        }
+        auto *sampled = fixed_size.get_aggregated_results();
+        assert(sampled->cache_map.size() <= 1000);
+        auto expect = exact.compute_miss_ratio_curve(exact.get_aggregated_results());
+        for (auto *tool : { &fixed_rate, &fixed_size }) {
+            auto curve = tool->compute_miss_ratio_curve(tool->get_aggregated_results());
+            for (size_t i = 0; i < expect.size() && i < curve.size(); ++i) {
+                if (TEST_VERBOSE(1)) {
+                    std::cerr << expect[i].first << " lines: exact " << expect[i].second
+                              << " vs " << curve[i].second << "\n";
+                }
+                assert(curve[i].first == expect[i].first);
+                assert(curve[i].first < MIN_COMPARED_LINES ||
+                       std::abs(curve[i].second - expect[i].second) < TOLERANCE);
+            }
+        }
+    }
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -516,6 +644,8 @@ test_main(int argc, const char *argv[])
     simple_reuse_distance_test();
     reuse_distance_limit_test();
     data_histogram_test();
+    fenwick_tree_test();
+    miss_ratio_curve_test();
     return 0;
 }
 
@@ -32,6 +32,7 @@
 
 /* Standalone scheduler launcher and "simulator" for file traces. */
 
+#include <iomanip>
 #include <iostream>
 #include <thread>
 
@@ -53,6 +54,8 @@
 
 using ::dynamorio::drmemtrace::disable_popups;
 using ::dynamorio::drmemtrace::memref_t;
+using ::dynamorio::drmemtrace::SCHED_STAT_TYPE_COUNT;
+using ::dynamorio::drmemtrace::schedule_statistic_t;
 using ::dynamorio::drmemtrace::scheduler_t;
 using ::dynamorio::drmemtrace::TRACE_TYPE_MARKER;
 using ::dynamorio::drmemtrace::trace_type_names;
@@ -119,6 +122,26 @@ droption_t<std::string>
                          "Path with stored as-traced schedule for replay.");
 #endif
 
+droption_t<bool> op_per_output_queues(DROPTION_SCOPE_ALL, "per_output_queues", false,
+                                      "Use a ready queue per core",
+                                      "Use a ready queue per core with work stealing "
+                                      "instead of a single global queue.");
+
+droption_t<uint64_t> op_rebalance_period_us(
+    DROPTION_SCOPE_ALL, "rebalance_period_us", 50000,
+    "Period for rebalancing per-core queues",
+    "Period for rebalancing per-core queues; 0 disables rebalancing.");
+
+droption_t<int> op_read_ahead_threads(DROPTION_SCOPE_ALL, "read_ahead_threads", 0,
+                                      "Threads decompressing records ahead",
+                                      "Number of threads decompressing records "
+                                      "ahead of the cores; 0 disables read-ahead.");
+
+droption_t<int> op_read_ahead_blocks(DROPTION_SCOPE_ALL, "read_ahead_blocks", 4,
+                                     "Blocks decompressed ahead per input",
+                                     "Maximum blocks of records decompressed ahead of "
+                                     "each input.");
+
 droption_t<uint64_t> op_print_every(DROPTION_SCOPE_ALL, "print_every", 5000,
                                     "A letter is printed every N instrs",
                                     "A letter is printed every N instrs");
@@ -311,6 +334,10 @@ _tmain(int argc, const TCHAR *targv[])
     if (op_sched_time.get_value())
         sched_ops.quantum_unit = scheduler_t::QUANTUM_TIME;
     sched_ops.block_time_scale = op_block_time_scale.get_value();
+    sched_ops.per_output_ready_queues = op_per_output_queues.get_value();
+    sched_ops.rebalance_period_us = op_rebalance_period_us.get_value();
+    sched_ops.read_ahead_threads = op_read_ahead_threads.get_value();
+    sched_ops.read_ahead_blocks = op_read_ahead_blocks.get_value();
 #ifdef HAS_ZIP
     std::unique_ptr<zipfile_ostream_t> record_zip;
     std::unique_ptr<zipfile_istream_t> replay_zip;
@@ -350,6 +377,29 @@ _tmain(int argc, const TCHAR *targv[])
     for (int i = 0; i < op_num_cores.get_value(); ++i) {
         std::cerr << "Core #" << i << ": " << schedules[i] << "\n";
     }
+    static const char *const stat_names[] = {
+        "Migrations",
+        "Run queue steals",
+        "Run queue rebalances",
+        "Sched lock acquisitions",
+        "Sched lock hold ns",
+        "Run queue lock acquisitions",
+        "Run queue lock hold ns",
+        "Read-ahead hits",
+        "Read-ahead misses",
+        "Read-ahead waits",
+    };
+    static_assert(sizeof(stat_names) / sizeof(stat_names[0]) == SCHED_STAT_TYPE_COUNT,
+                  "stat_names is out of sync with schedule_statistic_t");
+    for (int stat = 0; stat < SCHED_STAT_TYPE_COUNT; ++stat) {
+        double sum = 0;
+        for (int i = 0; i < op_num_cores.get_value(); ++i) {
+            sum += scheduler.get_stream(i)->get_schedule_statistic(
+                static_cast<schedule_statistic_t>(stat));
+        }
+        std::cerr << std::setw(28) << std::left << stat_names[stat] << ": "
+                  << static_cast<int64_t>(sum) << "\n";
+    }
 
 #ifdef HAS_ZIP
     if (!op_record_file.get_value().empty()) {
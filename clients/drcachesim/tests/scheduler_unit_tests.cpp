@@ -2128,6 +2128,266 @@ test_synthetic_multi_threaded(const char *testdir)
 #endif
 }
 
+static int64_t
+sum_schedule_statistic(scheduler_t &scheduler, int num_outputs, schedule_statistic_t stat)
+{
+    int64_t sum = 0;
+    for (int i = 0; i < num_outputs; ++i) {
+        sum +=
+            static_cast<int64_t>(scheduler.get_stream(i)->get_schedule_statistic(stat));
+    }
+    return sum;
+}
+
+static void
+test_per_output_queues_lockstep()
+{
+    std::cerr << "\n----------------\nTesting per-output ready queues in lockstep\n";
+    static constexpr int NUM_INPUTS = 8;
+    static constexpr int NUM_OUTPUTS = 4;
+    static constexpr memref_tid_t TID_BASE = 100;
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    for (int input_idx = 0; input_idx < NUM_INPUTS; input_idx++) {
+        std::vector<scheduler_t::input_reader_t> readers;
+        memref_tid_t tid = TID_BASE + input_idx;
+        std::vector<trace_entry_t> inputs;
+        inputs.push_back(make_thread(tid));
+        inputs.push_back(make_pid(1));
+        inputs.push_back(make_timestamp(10));
+        // Vary the lengths so that some queues drain early and must steal.
+        for (int instr_idx = 0; instr_idx < (input_idx + 1) * 5; instr_idx++) {
+            inputs.push_back(make_instr(42 + instr_idx * 4));
+        }
+        inputs.push_back(make_exit(tid));
+        readers.emplace_back(std::unique_ptr<mock_reader_t>(new mock_reader_t(inputs)),
+                             std::unique_ptr<mock_reader_t>(new mock_reader_t()), tid);
+        sched_inputs.emplace_back(std::move(readers));
+        // Bind the 1st 2 inputs to core 0: they must never be stolen.
+        if (input_idx < 2) {
+            std::set<scheduler_t::output_ordinal_t> cores;
+            cores.insert(0);
+            scheduler_t::input_thread_info_t info(tid, cores);
+            sched_inputs.back().thread_modifiers.emplace_back(info);
+        }
+    }
+    scheduler_t::scheduler_options_t sched_ops(scheduler_t::MAP_TO_ANY_OUTPUT,
+                                               scheduler_t::DEPENDENCY_IGNORE,
+                                               scheduler_t::SCHEDULER_DEFAULTS,
+                                               /*verbosity=*/3);
+    sched_ops.quantum_duration = 3;
+    sched_ops.per_output_ready_queues = true;
+    scheduler_t scheduler;
+    if (scheduler.init(sched_inputs, NUM_OUTPUTS, std::move(sched_ops)) !=
+        scheduler_t::STATUS_SUCCESS)
+        assert(false);
+    std::vector<std::string> sched_as_string =
+        run_lockstep_simulation(scheduler, NUM_OUTPUTS, TID_BASE);
+    std::vector<int> instr_count(NUM_INPUTS, 0);
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        std::cerr << "cpu #" << i << " schedule: " << sched_as_string[i] << "\n";
+        for (char c : sched_as_string[i]) {
+            if (c < 'A' || c > 'Z')
+                continue;
+            ++instr_count[c - 'A'];
+            if (c == 'A' || c == 'B')
+                assert(i == 0);
+        }
+    }
+    for (int i = 0; i < NUM_INPUTS; i++)
+        assert(instr_count[i] == (i + 1) * 5);
+    assert(sum_schedule_statistic(scheduler, NUM_OUTPUTS, SCHED_STAT_RUNQUEUE_STEALS) >
+           0);
+    assert(sum_schedule_statistic(scheduler, NUM_OUTPUTS,
+                                  SCHED_STAT_RUNQUEUE_LOCK_ACQUISITIONS) > 0);
+}
+
+static void
+run_per_output_queues_threads(bool per_output, int64_t &sched_lock_acquisitions)
+{
+    static constexpr int NUM_INPUTS = 40;
+    static constexpr int NUM_OUTPUTS = 4;
+    static constexpr int NUM_INSTRS = 500;
+    static constexpr memref_tid_t TID_BASE = 100;
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    for (int input_idx = 0; input_idx < NUM_INPUTS; input_idx++) {
+        std::vector<scheduler_t::input_reader_t> readers;
+        memref_tid_t tid = TID_BASE + input_idx;
+        std::vector<trace_entry_t> inputs;
+        inputs.push_back(make_thread(tid));
+        inputs.push_back(make_pid(1));
+        inputs.push_back(make_timestamp(10));
+        for (int instr_idx = 0; instr_idx < NUM_INSTRS; instr_idx++) {
+            inputs.push_back(make_instr(42 + instr_idx * 4));
+        }
+        inputs.push_back(make_exit(tid));
+        readers.emplace_back(std::unique_ptr<mock_reader_t>(new mock_reader_t(inputs)),
+                             std::unique_ptr<mock_reader_t>(new mock_reader_t()), tid);
+        sched_inputs.emplace_back(std::move(readers));
+    }
+    scheduler_t::scheduler_options_t sched_ops(scheduler_t::MAP_TO_ANY_OUTPUT,
+                                               scheduler_t::DEPENDENCY_IGNORE,
+                                               scheduler_t::SCHEDULER_DEFAULTS,
+                                               /*verbosity=*/1);
+    sched_ops.quantum_duration = 10;
+    sched_ops.per_output_ready_queues = per_output;
+    scheduler_t scheduler;
+    if (scheduler.init(sched_inputs, NUM_OUTPUTS, std::move(sched_ops)) !=
+        scheduler_t::STATUS_SUCCESS)
+        assert(false);
+    std::vector<std::vector<int>> instr_count(NUM_OUTPUTS,
+                                              std::vector<int>(NUM_INPUTS, 0));
+    std::vector<std::thread> threads;
+    threads.reserve(NUM_OUTPUTS);
+    for (int i = 0; i < NUM_OUTPUTS; ++i) {
+        threads.emplace_back([&scheduler, &instr_count, i]() {
+            scheduler_t::stream_t *stream = scheduler.get_stream(i);
+            memref_t record;
+            for (scheduler_t::stream_status_t status = stream->next_record(record);
+                 status != scheduler_t::STATUS_EOF;
+                 status = stream->next_record(record)) {
+                if (status == scheduler_t::STATUS_WAIT ||
+                    status == scheduler_t::STATUS_IDLE) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                assert(status == scheduler_t::STATUS_OK);
+                if (type_is_instr(record.instr.type))
+                    ++instr_count[i][record.instr.tid - TID_BASE];
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    for (int input_idx = 0; input_idx < NUM_INPUTS; input_idx++) {
+        int total = 0;
+        for (int i = 0; i < NUM_OUTPUTS; ++i)
+            total += instr_count[i][input_idx];
+        assert(total == NUM_INSTRS);
+    }
+    sched_lock_acquisitions = sum_schedule_statistic(scheduler, NUM_OUTPUTS,
+                                                     SCHED_STAT_SCHED_LOCK_ACQUISITIONS);
+    std::cerr << (per_output ? "per-output" : "global")
+              << " queues: sched_lock_ acquisitions=" << sched_lock_acquisitions
+              << " hold ns="
+              << sum_schedule_statistic(scheduler, NUM_OUTPUTS,
+                                        SCHED_STAT_SCHED_LOCK_HOLD_NANOS)
+              << " runqueue lock acquisitions="
+              << sum_schedule_statistic(scheduler, NUM_OUTPUTS,
+                                        SCHED_STAT_RUNQUEUE_LOCK_ACQUISITIONS)
+              << " steals="
+              << sum_schedule_statistic(scheduler, NUM_OUTPUTS,
+                                        SCHED_STAT_RUNQUEUE_STEALS)
+              << " migrations="
+              << sum_schedule_statistic(scheduler, NUM_OUTPUTS, SCHED_STAT_MIGRATIONS)
+              << "\n";
+}
+
+static void
+test_per_output_queues_multi_threaded()
+{
+    std::cerr << "\n----------------\nTesting per-output ready queues multi-threaded\n";
+    int64_t global_acquisitions, per_output_acquisitions;
+    run_per_output_queues_threads(/*per_output=*/false, global_acquisitions);
+    run_per_output_queues_threads(/*per_output=*/true, per_output_acquisitions);
+    // Each switch takes the global lock with a single queue, but only the
+    // rare cross-queue operations need it with per-output queues.
+    assert(per_output_acquisitions < global_acquisitions);
+}
+
+static void
+test_per_output_queues()
+{
+    test_per_output_queues_lockstep();
+    test_per_output_queues_multi_threaded();
+}
+
+#if (defined(X86_64) || defined(ARM_64)) && defined(HAS_ZIP)
+// Returns a hash of each input's records, each combined with its ordinal within the
+// input, along with the sum of the read-ahead statistics across the outputs.
+static std::unordered_map<memref_tid_t, uint64_t>
+run_read_ahead_schedule(const char *testdir, int read_ahead_threads,
+                        int64_t &read_ahead_blocks)
+{
+    static constexpr int NUM_OUTPUTS = 4;
+    static constexpr int QUANTUM_DURATION = 2000;
+    std::string path = std::string(testdir) + "/drmemtrace.threadsig.x64.tracedir";
+    std::vector<scheduler_t::range_t> regions;
+    regions.emplace_back(1000, 3000);
+    regions.emplace_back(20000, 30000);
+    regions.emplace_back(80000, 0);
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    sched_inputs.emplace_back(path);
+    sched_inputs[0].thread_modifiers.push_back(scheduler_t::input_thread_info_t(regions));
+    scheduler_t::scheduler_options_t sched_ops(scheduler_t::MAP_TO_ANY_OUTPUT,
+                                               scheduler_t::DEPENDENCY_TIMESTAMPS,
+                                               scheduler_t::SCHEDULER_DEFAULTS,
+                                               /*verbosity=*/1);
+    sched_ops.quantum_duration = QUANTUM_DURATION;
+    sched_ops.read_ahead_threads = read_ahead_threads;
+    // Keep the queues short so that the decoding threads must keep up.
+    sched_ops.read_ahead_blocks = 2;
+    scheduler_t scheduler;
+    if (scheduler.init(sched_inputs, NUM_OUTPUTS, std::move(sched_ops)) !=
+        scheduler_t::STATUS_SUCCESS)
+        assert(false);
+    std::vector<std::unordered_map<memref_tid_t, uint64_t>> hashes(NUM_OUTPUTS);
+    std::vector<std::thread> threads;
+    threads.reserve(NUM_OUTPUTS);
+    for (int i = 0; i < NUM_OUTPUTS; ++i) {
+        threads.emplace_back([&scheduler, &hashes, i]() {
+            scheduler_t::stream_t *stream = scheduler.get_stream(i);
+            memref_t record;
+            for (scheduler_t::stream_status_t status = stream->next_record(record);
+                 status != scheduler_t::STATUS_EOF;
+                 status = stream->next_record(record)) {
+                if (status == scheduler_t::STATUS_WAIT ||
+                    status == scheduler_t::STATUS_IDLE) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                assert(status == scheduler_t::STATUS_OK);
+                // Inputs move between outputs, so we sum a hash of each record and
+                // its position to be independent of the schedule.
+                uint64_t hash = stream->get_input_interface()->get_record_ordinal();
+                hash = hash * 31 + record.data.type;
+                hash = hash * 31 + record.data.addr;
+                hashes[i][record.data.tid] += hash * 0x9e3779b97f4a7c15ULL;
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    std::unordered_map<memref_tid_t, uint64_t> result;
+    for (const auto &output_hashes : hashes) {
+        for (const auto &entry : output_hashes)
+            result[entry.first] += entry.second;
+    }
+    read_ahead_blocks =
+        sum_schedule_statistic(scheduler, NUM_OUTPUTS, SCHED_STAT_READ_AHEAD_HITS) +
+        sum_schedule_statistic(scheduler, NUM_OUTPUTS, SCHED_STAT_READ_AHEAD_MISSES) +
+        sum_schedule_statistic(scheduler, NUM_OUTPUTS, SCHED_STAT_READ_AHEAD_WAITS);
+    return result;
+}
+#endif
+
+static void
+test_read_ahead(const char *testdir)
+{
+    std::cerr << "\n----------------\nTesting read-ahead\n";
+#if (defined(X86_64) || defined(ARM_64)) && defined(HAS_ZIP)
+    int64_t blocks_without = 0;
+    std::unordered_map<memref_tid_t, uint64_t> without =
+        run_read_ahead_schedule(testdir, 0, blocks_without);
+    assert(blocks_without == 0);
+    int64_t blocks_with = 0;
+    std::unordered_map<memref_tid_t, uint64_t> with =
+        run_read_ahead_schedule(testdir, 2, blocks_with);
+    assert(blocks_with > 0);
+    // Each input's records, including across the skips, are the same either way.
+    assert(with == without);
+#endif
+}
+
 static void
 test_speculation()
 {
@@ -5220,6 +5480,8 @@ test_main(int argc, const char *argv[])
     test_synthetic_with_bindings();
     test_synthetic_with_syscalls();
     test_synthetic_multi_threaded(argv[1]);
+    test_per_output_queues();
+    test_read_ahead(argv[1]);
     test_speculation();
     test_replay();
     test_replay_multi_threaded(argv[1]);
@@ -0,0 +1,220 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Unit tests for shm_ring_t. */
+
+#include "common/shm_ring.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+namespace {
+
+constexpr int NUM_PROCESSES = 3;
+constexpr int THREADS_PER_PROCESS = 3;
+constexpr int CHUNKS_PER_THREAD = 3000;
+// Fewer rings than threads, and small ones, so that rings are shared, wrap
+// around, and fill up.
+constexpr uint32_t NUM_RINGS = 4;
+constexpr size_t RING_SIZE = 64 * 1024;
+
+// Each chunk holds the writer's id, its sequence number, and then a run of
+// words derived from both, with a length that varies by chunk.
+size_t
+chunk_words(uint32_t seq)
+{
+    return 2 + (seq * 37) % 1500;
+}
+
+void
+write_chunks(shm_ring_t *ring, uint32_t writer)
+{
+    uint32_t index = ring->assign_ring();
+    std::vector<uint32_t> buf;
+    for (uint32_t seq = 0; seq < CHUNKS_PER_THREAD; ++seq) {
+        buf.resize(chunk_words(seq));
+        buf[0] = writer;
+        buf[1] = seq;
+        for (size_t i = 2; i < buf.size(); ++i)
+            buf[i] = writer * 7919 + seq + static_cast<uint32_t>(i);
+        bool res = ring->write(index, buf.data(), buf.size() * sizeof(buf[0]));
+        assert(res);
+    }
+}
+
+void
+run_writer_process(const std::string &path, int process)
+{
+    int fd = open(path.c_str(), O_RDWR);
+    assert(fd >= 0);
+    struct stat st;
+    int res = fstat(fd, &st);
+    assert(res == 0);
+    void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(map != MAP_FAILED);
+    close(fd);
+    shm_ring_t ring;
+    bool ok = ring.attach(map, st.st_size, getpid());
+    assert(ok);
+    // Too large a chunk is refused.
+    std::vector<char> huge(ring.get_max_chunk_size() + 1);
+    assert(!ring.write(0, huge.data(), huge.size()));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS_PER_PROCESS; ++i) {
+        threads.emplace_back(write_chunks, &ring,
+                             static_cast<uint32_t>(process * THREADS_PER_PROCESS + i));
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    ring.detach();
+    munmap(map, st.st_size);
+}
+
+bool
+test_multi_process()
+{
+    std::string name = "drmemtrace_shm_ring_test." + std::to_string(getpid());
+    shm_ring_t reader(name.c_str());
+    bool ok = reader.create(NUM_RINGS, RING_SIZE);
+    assert(ok);
+    std::vector<pid_t> children;
+    for (int i = 0; i < NUM_PROCESSES; ++i) {
+        pid_t child = fork();
+        assert(child >= 0);
+        if (child == 0) {
+            run_writer_process(reader.get_path(), i);
+            _exit(0);
+        }
+        children.push_back(child);
+    }
+    ok = reader.wait_for_writer();
+    assert(ok);
+    std::vector<uint32_t> next_seq(NUM_PROCESSES * THREADS_PER_PROCESS, 0);
+    uint64_t num_chunks = 0;
+    while (true) {
+        size_t size;
+        const uint32_t *chunk = static_cast<const uint32_t *>(reader.next_chunk(&size));
+        if (chunk == nullptr)
+            break;
+        uint32_t writer = chunk[0];
+        uint32_t seq = chunk[1];
+        assert(writer < next_seq.size());
+        // Each writer's chunks arrive in order and intact.
+        assert(seq == next_seq[writer]);
+        assert(size == chunk_words(seq) * sizeof(uint32_t));
+        for (size_t i = 2; i < size / sizeof(uint32_t); ++i)
+            assert(chunk[i] == writer * 7919 + seq + static_cast<uint32_t>(i));
+        ++next_seq[writer];
+        ++num_chunks;
+        // Exercise both explicit and implicit release.
+        if (num_chunks % 2 == 0)
+            reader.release_chunk();
+    }
+    for (pid_t child : children) {
+        int status;
+        pid_t res = waitpid(child, &status, 0);
+        assert(res == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    for (uint32_t seq : next_seq)
+        assert(seq == CHUNKS_PER_THREAD);
+    assert(num_chunks == static_cast<uint64_t>(NUM_PROCESSES) * THREADS_PER_PROCESS *
+               CHUNKS_PER_THREAD);
+    ok = reader.destroy();
+    assert(ok);
+    return true;
+}
+
+bool
+test_dead_writer()
+{
+    // A writer which dies without detaching must not hang the reader.
+    std::string name = "drmemtrace_shm_ring_dead." + std::to_string(getpid());
+    shm_ring_t reader(name.c_str());
+    bool ok = reader.create(1, RING_SIZE);
+    assert(ok);
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        int fd = open(reader.get_path().c_str(), O_RDWR);
+        struct stat st;
+        fstat(fd, &st);
+        void *map =
+            mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        shm_ring_t ring;
+        if (!ring.attach(map, st.st_size, getpid()))
+            _exit(1);
+        uint32_t word = 42;
+        ring.write(ring.assign_ring(), &word, sizeof(word));
+        _exit(0);
+    }
+    ok = reader.wait_for_writer();
+    assert(ok);
+    size_t size;
+    const void *chunk = reader.next_chunk(&size);
+    assert(chunk != nullptr && size == sizeof(uint32_t));
+    assert(*static_cast<const uint32_t *>(chunk) == 42);
+    assert(reader.next_chunk(&size) == nullptr);
+    int status;
+    waitpid(child, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    reader.destroy();
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (!test_multi_process() || !test_dead_writer())
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
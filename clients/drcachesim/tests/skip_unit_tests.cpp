@@ -33,11 +33,24 @@
 /* Unit tests for the skip feature. */
 
 #include "droption.h"
+#include "read_ahead_pool.h"
 #include "zipfile_file_reader.h"
+#ifdef HAS_ZSTD
+#    include "instr_table_ostream.h"
+#    include "zstd_file_reader.h"
+#    include "zstd_ostream.h"
+#endif
+#ifdef UNIX
+#    include "mmap_file_reader.h"
+#endif
 #include "tools/view_create.h"
 
+#include <inttypes.h>
+
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -74,8 +87,9 @@ static droption_t<bool> op_verbose(DROPTION_SCOPE_FRONTEND, "verbose", false,
                                    "Whether to print diagnostics",
                                    "Whether to print diagnostics");
 
+template <typename reader_type>
 bool
-test_skip_initial()
+test_skip_initial(const std::string &path, read_ahead_pool_t *pool = nullptr)
 {
     int view_count = 10;
     // Our checked-in trace has a chunk size of 20, letting us test cross-chunk
@@ -90,12 +104,13 @@ test_skip_initial()
         std::stringstream capture;
         std::streambuf *prior = std::cerr.rdbuf(capture.rdbuf());
         // Open the trace.
-        std::unique_ptr<reader_t> iter = std::unique_ptr<reader_t>(
-            new zipfile_file_reader_t(op_trace_file.get_value()));
-        CHECK(!!iter, "failed to open zipfile");
+        std::unique_ptr<reader_t> iter =
+            std::unique_ptr<reader_t>(new reader_type(path));
+        CHECK(!!iter, "failed to open trace");
         CHECK(iter->init(), "failed to initialize reader");
-        std::unique_ptr<reader_t> iter_end =
-            std::unique_ptr<reader_t>(new zipfile_file_reader_t());
+        CHECK(pool == nullptr || iter->enable_read_ahead(pool) != nullptr,
+              "failed to enable read-ahead");
+        std::unique_ptr<reader_t> iter_end = std::unique_ptr<reader_t>(new reader_type());
         // Run the tool.
         std::unique_ptr<analysis_tool_t> tool = std::unique_ptr<analysis_tool_t>(
             view_tool_create("", /*skip_refs=*/0, /*sim_refs=*/view_count, "att"));
@@ -160,6 +175,109 @@ test_skip_initial()
     return true;
 }
 
+#ifdef HAS_ZSTD
+// Re-packs the zipfile's components, which are the trace chunks, into a zstd archive,
+// in the instr_table format if "instr_table" is set.
+bool
+convert_zip_to_zstd(const std::string &zip_path, const std::string &zstd_path,
+                    bool instr_table = false)
+{
+    unzFile zip = unzOpen(zip_path.c_str());
+    CHECK(zip != nullptr, "failed to open zipfile");
+    {
+        std::unique_ptr<archive_ostream_t> out_ptr(new zstd_ostream_t(zstd_path));
+        if (instr_table)
+            out_ptr.reset(new instr_table_ostream_t(out_ptr.release()));
+        archive_ostream_t &out = *out_ptr;
+        CHECK(out, "failed to create zstd archive");
+        std::vector<char> buf(4096);
+        for (int res = unzGoToFirstFile(zip); res == UNZ_OK; res = unzGoToNextFile(zip)) {
+            char name[128];
+            CHECK(unzGetCurrentFileInfo64(zip, nullptr, name, sizeof(name), nullptr, 0,
+                                          nullptr, 0) == UNZ_OK,
+                  "failed to get component name");
+            CHECK(out.open_new_component(name).empty(), "failed to add component");
+            CHECK(unzOpenCurrentFile(zip) == UNZ_OK, "failed to open component");
+            int len;
+            while ((len = unzReadCurrentFile(zip, buf.data(),
+                                             static_cast<unsigned>(buf.size()))) > 0)
+                out.write(buf.data(), len);
+            CHECK(len == 0 && unzCloseCurrentFile(zip) == UNZ_OK,
+                  "failed to read component");
+        }
+        CHECK(out, "failed to write zstd archive");
+    }
+    unzClose(zip);
+    return true;
+}
+
+// Checks that the records of the two traces are identical.
+template <typename reader_type1, typename reader_type2>
+bool
+test_same_records(const std::string &path1, const std::string &path2)
+{
+    reader_type1 reader1(path1), end1;
+    reader_type2 reader2(path2), end2;
+    CHECK(reader1.init() && reader2.init(), "failed to initialize record readers");
+    uint64_t count = 0;
+    for (; reader1 != end1; ++reader1, ++reader2, ++count) {
+        CHECK(reader2 != end2, "second trace is missing records");
+        const trace_entry_t &entry1 = *reader1;
+        const trace_entry_t &entry2 = *reader2;
+        if (entry1.type != entry2.type || entry1.size != entry2.size ||
+            entry1.addr != entry2.addr) {
+            fprintf(stderr, "Record #%" PRIu64 " differs: %d %d %zx vs %d %d %zx\n",
+                    count, entry1.type, entry1.size, static_cast<size_t>(entry1.addr),
+                    entry2.type, entry2.size, static_cast<size_t>(entry2.addr));
+            return false;
+        }
+    }
+    CHECK(reader2 == end2, "second trace has extra records");
+    CHECK(count > 0, "no records read");
+    return true;
+}
+#endif
+
+#ifdef UNIX
+// Concatenates the zipfile's chunks into a single uncompressed file, dropping
+// the chunk footers and the ordinal, timestamp, and cpu markers that open each
+// subsequent chunk.
+bool
+convert_zip_to_flat(const std::string &zip_path, const std::string &flat_path)
+{
+    unzFile zip = unzOpen(zip_path.c_str());
+    CHECK(zip != nullptr, "failed to open zipfile");
+    std::ofstream out(flat_path, std::ofstream::binary);
+    CHECK(out, "failed to create flat file");
+    bool in_chunk_header = false;
+    for (int res = unzGoToFirstFile(zip); res == UNZ_OK; res = unzGoToNextFile(zip)) {
+        CHECK(unzOpenCurrentFile(zip) == UNZ_OK, "failed to open component");
+        trace_entry_t entry;
+        int len;
+        while ((len = unzReadCurrentFile(zip, &entry, sizeof(entry))) ==
+               static_cast<int>(sizeof(entry))) {
+            if (entry.type == TRACE_TYPE_MARKER) {
+                if (entry.size == TRACE_MARKER_TYPE_CHUNK_FOOTER) {
+                    in_chunk_header = true;
+                    continue;
+                }
+                if (in_chunk_header) {
+                    if (entry.size == TRACE_MARKER_TYPE_CPU_ID)
+                        in_chunk_header = false;
+                    continue;
+                }
+            }
+            out.write(reinterpret_cast<char *>(&entry), sizeof(entry));
+        }
+        CHECK(len == 0 && unzCloseCurrentFile(zip) == UNZ_OK,
+              "failed to read component");
+    }
+    unzClose(zip);
+    CHECK(out, "failed to write flat file");
+    return true;
+}
+#endif
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -170,8 +288,38 @@ test_main(int argc, const char *argv[])
         FATAL_ERROR("Usage error: %s\nUsage:\n%s", parse_err.c_str(),
                     droption_parser_t::usage_short(DROPTION_SCOPE_ALL).c_str());
     }
-    if (!test_skip_initial())
+    if (!test_skip_initial<zipfile_file_reader_t>(op_trace_file.get_value()))
+        return 1;
+    {
+        // Chunks already decompressed ahead must be skipped over the same way.
+        read_ahead_pool_t pool(/*num_threads=*/2, /*max_blocks=*/2);
+        if (!test_skip_initial<zipfile_file_reader_t>(op_trace_file.get_value(), &pool))
+            return 1;
+    }
+#ifdef HAS_ZSTD
+    // The same chunks in a zstd archive must skip identically.
+    const std::string zstd_path = "tmp_test_skip.trace.zst";
+    if (!convert_zip_to_zstd(op_trace_file.get_value(), zstd_path) ||
+        !test_skip_initial<zstd_file_reader_t>(zstd_path))
         return 1;
+    // An instruction table must decode back to exactly the original records.
+    const std::string itable_path = "tmp_test_skip_itable.trace.zst";
+    if (!convert_zip_to_zstd(op_trace_file.get_value(), itable_path,
+                             /*instr_table=*/true) ||
+        !test_same_records<zipfile_record_file_reader_t, zstd_record_file_reader_t>(
+            op_trace_file.get_value(), itable_path) ||
+        !test_skip_initial<zstd_file_reader_t>(itable_path))
+        return 1;
+#endif
+#ifdef UNIX
+    // The same records in one uncompressed file are mapped and must also skip
+    // identically, without a chunk index to seek with.
+    const std::string flat_path = "tmp_test_skip.trace";
+    if (!convert_zip_to_flat(op_trace_file.get_value(), flat_path) ||
+        !is_mmap_trace_file(flat_path) ||
+        !test_skip_initial<mmap_file_reader_t>(flat_path))
+        return 1;
+#endif
     // TODO i#5538: Add tests that skip from the middle once we have full support
     // for duplicating the timestamp,cpu in that scenario.
     fprintf(stderr, "Success\n");
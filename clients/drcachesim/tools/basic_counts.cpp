@@ -244,6 +244,26 @@ basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
     return true;
 }
 
+bool
+basic_counts_t::parallel_shard_batch_supported()
+{
+    // We only count records and never query the stream per record.
+    return true;
+}
+
+bool
+basic_counts_t::parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                            size_t num_memrefs)
+{
+    for (size_t i = 0; i < num_memrefs; ++i) {
+        // This must stay a virtual call so that a subclass overriding
+        // parallel_shard_memref() sees every record.
+        if (!parallel_shard_memref(shard_data, memrefs[i]))
+            return false;
+    }
+    return true;
+}
+
 bool
 basic_counts_t::process_memref(const memref_t &memref)
 {
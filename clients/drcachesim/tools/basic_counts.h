@@ -71,6 +71,11 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    bool
+    parallel_shard_batch_supported() override;
+    bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t num_memrefs) override;
     std::string
     parallel_shard_error(void *shard_data) override;
     interval_state_snapshot_t *
@@ -40,8 +40,10 @@
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -59,6 +61,9 @@ namespace drmemtrace {
 
 const std::string reuse_distance_t::TOOL_NAME = "Reuse distance tool";
 
+// Sampling compares a line's hash against a threshold out of this many values.
+static constexpr uint64_t SAMPLE_MODULUS = 1 << 24;
+
 unsigned int reuse_distance_t::knob_verbose;
 
 analysis_tool_t *
@@ -100,11 +105,70 @@ reuse_distance_t::initialize_shard_type(shard_type_t shard_type)
 }
 
 reuse_distance_t::shard_data_t::shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist,
-                                             uint32_t distance_limit, bool verify)
+                                             uint32_t distance_limit, bool verify,
+                                             bool use_tree)
     : distance_limit(distance_limit)
 {
     ref_list = std::unique_ptr<line_ref_list_t>(
-        new line_ref_list_t(reuse_threshold, skip_dist, verify));
+        new line_ref_list_t(reuse_threshold, skip_dist, verify, use_tree));
+}
+
+reuse_distance_t::shard_data_t *
+reuse_distance_t::create_shard_data()
+{
+    // Evicting lines from a fixed-size sample needs removal from the middle of
+    // the list, which only the tree supports.
+    auto shard = new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
+                                  knobs_.distance_limit, knobs_.verify_skip,
+                                  knobs_.use_fenwick_tree || knobs_.sample_max_lines > 0);
+    if (knobs_.sample_rate < 1.0 || knobs_.sample_max_lines > 0) {
+        shard->sampling = true;
+        shard->sample_threshold =
+            static_cast<uint64_t>(std::ceil(knobs_.sample_rate * SAMPLE_MODULUS));
+        shard->sample_rate = static_cast<double>(shard->sample_threshold) /
+            static_cast<double>(SAMPLE_MODULUS);
+    }
+    return shard;
+}
+
+bool
+reuse_distance_t::sample_line(shard_data_t *shard, addr_t tag, uint64_t *hash)
+{
+    // A 64-bit mix (the splitmix64 finalizer) so that nearby lines, which differ
+    // only in their low bits, are sampled independently.
+    uint64_t mix = static_cast<uint64_t>(tag);
+    mix = (mix ^ (mix >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    mix = (mix ^ (mix >> 27)) * 0x94d049bb133111ebULL;
+    mix ^= mix >> 31;
+    *hash = mix % SAMPLE_MODULUS;
+    return *hash < shard->sample_threshold;
+}
+
+void
+reuse_distance_t::shrink_sample(shard_data_t *shard)
+{
+    while (shard->sampled_lines.size() > knobs_.sample_max_lines) {
+        // Drop every line with the largest hash, making that hash the new threshold.
+        uint64_t new_threshold = shard->sampled_lines.rbegin()->first;
+        while (!shard->sampled_lines.empty() &&
+               shard->sampled_lines.rbegin()->first == new_threshold) {
+            auto last = std::prev(shard->sampled_lines.end());
+            auto it = shard->cache_map.find(last->second);
+            if (it != shard->cache_map.end()) {
+                shard->ref_list->remove(it->second);
+                delete it->second;
+                shard->cache_map.erase(it);
+            }
+            shard->sampled_lines.erase(last);
+        }
+        double new_rate =
+            static_cast<double>(new_threshold) / static_cast<double>(SAMPLE_MODULUS);
+        IF_DEBUG_VERBOSE(2,
+                         std::cerr << "Lowering sample rate from " << shard->sample_rate
+                                   << " to " << new_rate << "\n");
+        shard->sample_threshold = new_threshold;
+        shard->sample_rate = new_rate;
+    }
 }
 
 bool
@@ -117,8 +181,7 @@ void *
 reuse_distance_t::parallel_shard_init_stream(int shard_index, void *worker_data,
                                              memtrace_stream_t *stream)
 {
-    auto shard = new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                                  knobs_.distance_limit, knobs_.verify_skip);
+    auto shard = create_shard_data();
     std::lock_guard<std::mutex> guard(shard_map_mutex_);
     shard->core = stream->get_output_cpuid();
     shard->tid = stream->get_tid();
@@ -166,6 +229,12 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
             ++shard->data_refs;
         }
         addr_t tag = memref.data.addr >> line_size_bits_;
+        uint64_t hash = 0;
+        if (shard->sampling) {
+            if (!sample_line(shard, tag, &hash))
+                return true;
+            shard->sampled_refs += 1 / shard->sample_rate;
+        }
         std::unordered_map<addr_t, line_ref_t *>::iterator it =
             shard->cache_map.find(tag);
         if (it == shard->cache_map.end()) {
@@ -174,6 +243,10 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
             shard->cache_map.insert(std::pair<addr_t, line_ref_t *>(tag, ref));
             // insert into the list
             shard->ref_list->add_to_front(ref);
+            if (knobs_.sample_max_lines > 0) {
+                shard->sampled_lines.insert(std::make_pair(hash, tag));
+                shrink_sample(shard);
+            }
             // See if the line we're adding was previously removed.
             if (shard->pruned_addresses.find(tag) != shard->pruned_addresses.end()) {
                 ++shard->pruned_address_hits;
@@ -185,6 +258,11 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
                 ref = shard->ref_list->tail_; // Get a pointer to the line.
                 assert(ref != NULL);
                 addr_t tag_to_remove = ref->tag;
+                if (knobs_.sample_max_lines > 0) {
+                    uint64_t prune_hash;
+                    sample_line(shard, tag_to_remove, &prune_hash);
+                    shard->sampled_lines.erase(std::make_pair(prune_hash, tag_to_remove));
+                }
                 // Move this line from the cache_map to the pruned set.
                 shard->cache_map.erase(tag_to_remove);
                 shard->pruned_addresses.insert(tag_to_remove);
@@ -196,6 +274,10 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
             }
         } else {
             int64_t dist = shard->ref_list->move_to_front(it->second);
+            if (shard->sampling) {
+                dist = static_cast<int64_t>(std::llround(dist / shard->sample_rate));
+                shard->sampled_dist_map[dist] += 1 / shard->sample_rate;
+            }
             auto &dist_map = is_instr_type ? shard->dist_map : shard->dist_map_data;
             distance_histogram_t::iterator dist_it = dist_map.find(dist);
             if (dist_it == dist_map.end())
@@ -215,8 +297,7 @@ reuse_distance_t::process_memref(const memref_t &memref)
     int shard_index = serial_stream_->get_shard_index();
     const auto &lookup = shard_map_.find(shard_index);
     if (lookup == shard_map_.end()) {
-        shard = new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                                 knobs_.distance_limit, knobs_.verify_skip);
+        shard = create_shard_data();
         shard->core = serial_stream_->get_output_cpuid();
         shard->tid = serial_stream_->get_tid();
         shard_map_[shard_index] = shard;
@@ -282,6 +363,12 @@ reuse_distance_t::print_shard_results(const shard_data_t *shard)
     std::cerr << "Distance limit: " << shard->distance_limit << "\n";
     std::cerr << "Pruned addresses: " << shard->pruned_address_count << "\n";
     std::cerr << "Pruned address hits: " << shard->pruned_address_hits << "\n";
+    if (shard->sampling) {
+        // Distances and the curve below are estimates scaled up from this sample.
+        std::cerr << "Sampled cache lines: " << shard->cache_map.size() << "\n";
+        if (shard->sample_rate < 1.0)
+            std::cerr << "Sample rate: " << shard->sample_rate << "\n";
+    }
     std::cerr << "\n";
 
     std::cerr.precision(2);
@@ -320,6 +407,8 @@ reuse_distance_t::print_shard_results(const shard_data_t *shard)
     } else {
         std::cerr << "(Pass -reuse_distance_histogram to see all the data.)\n";
     }
+    if (knobs_.report_miss_ratio_curve || shard->sampling)
+        print_miss_ratio_curve(std::cerr, shard);
 
     std::cerr << "\n";
     std::cerr << "Reuse distance threshold = " << knobs_.distance_threshold
@@ -361,6 +450,54 @@ reuse_distance_t::print_shard_results(const shard_data_t *shard)
     }
 }
 
+std::vector<std::pair<int64_t, double>>
+reuse_distance_t::compute_miss_ratio_curve(const shard_data_t *shard)
+{
+    // A reference hits in a fully associative LRU cache of C lines exactly when its
+    // reuse distance is below C, so one histogram yields the miss ratio at every
+    // size.  References with no prior access (or to pruned lines) miss at all sizes.
+    std::vector<std::pair<int64_t, double>> curve;
+    std::map<int64_t, double> hits;
+    double total = static_cast<double>(shard->total_refs);
+    if (total <= 0)
+        return curve;
+    if (shard->sampling) {
+        for (const auto &entry : shard->sampled_dist_map)
+            hits[entry.first] += entry.second;
+        // Correct for the sample holding more or fewer references than the rate
+        // predicts by crediting the difference to distance 0 ("SHARDS_adj").
+        hits[0] += total - shard->sampled_refs;
+    } else {
+        for (const auto &entry : shard->dist_map)
+            hits[entry.first] += static_cast<double>(entry.second);
+    }
+    int64_t max_distance = hits.empty() ? 0 : hits.rbegin()->first;
+    double hit_sum = 0;
+    auto it = hits.begin();
+    for (int64_t lines = 1;; lines *= 2) {
+        for (; it != hits.end() && it->first < lines; ++it)
+            hit_sum += it->second;
+        curve.emplace_back(lines, std::max(0.0, std::min(1.0, 1.0 - hit_sum / total)));
+        if (lines > max_distance)
+            break;
+    }
+    return curve;
+}
+
+void
+reuse_distance_t::print_miss_ratio_curve(std::ostream &out, const shard_data_t *shard)
+{
+    std::ios_base::fmtflags saved_flags(out.flags());
+    out << "\nMiss ratio curve for a fully associative LRU cache:\n";
+    out << std::setw(20) << "Cache size (bytes)" << std::setw(13) << "Miss ratio"
+        << "\n";
+    for (const auto &point : compute_miss_ratio_curve(shard)) {
+        out << std::setw(20) << point.first * knobs_.line_size << std::setw(12)
+            << point.second * 100. << "%\n";
+    }
+    out.flags(saved_flags);
+}
+
 void
 reuse_distance_t::print_histogram(std::ostream &out, int64_t total_count,
                                   const std::vector<distance_map_pair_t> &sorted,
@@ -451,14 +588,18 @@ reuse_distance_t::get_aggregated_results()
         return aggregated_results_.get();
 
     // Otherwise, aggregate the per-shard data to get whole-trace data.
-    aggregated_results_ = std::unique_ptr<shard_data_t>(
-        new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                         knobs_.distance_limit, knobs_.verify_skip));
+    aggregated_results_ = std::unique_ptr<shard_data_t>(create_shard_data());
+    // The shards may end at different rates, so the aggregate has no single rate.
+    aggregated_results_->sample_threshold = SAMPLE_MODULUS;
+    aggregated_results_->sample_rate = 1.0;
     for (auto &shard : shard_map_) {
         aggregated_results_->total_refs += shard.second->total_refs;
         aggregated_results_->data_refs += shard.second->data_refs;
         aggregated_results_->pruned_address_hits += shard.second->pruned_address_hits;
         aggregated_results_->pruned_address_count += shard.second->pruned_address_count;
+        for (const auto &entry : shard.second->sampled_dist_map)
+            aggregated_results_->sampled_dist_map[entry.first] += entry.second;
+        aggregated_results_->sampled_refs += shard.second->sampled_refs;
         // We simply sum the unique accesses.
         // If the user wants the unique accesses over the merged trace they
         // can create a single shard and invoke the parallel operations.
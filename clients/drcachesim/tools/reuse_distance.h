@@ -43,6 +43,7 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -115,7 +116,7 @@ protected:
     // for computing over different units if for some reason that was desired.
     struct shard_data_t {
         shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist,
-                     unsigned int distance_limit, bool verify);
+                     unsigned int distance_limit, bool verify, bool use_tree);
         std::unordered_map<addr_t, line_ref_t *> cache_map;
         std::unordered_set<addr_t> pruned_addresses;
         // These are our reuse distance histograms: one for all accesses and one
@@ -143,6 +144,22 @@ protected:
         // (pruned_address_hits) from the pruned_addresses set.
         uint64_t pruned_address_count = 0;
         uint64_t pruned_address_hits = 0;
+        // State for sampling, following the SHARDS approach of Waldspurger et al.
+        // (FAST '15): a line is tracked only if its tag's hash is below
+        // sample_threshold, which makes sample_rate the fraction of lines tracked.
+        // Distances among the tracked lines are scaled by 1/sample_rate.
+        bool sampling = false;
+        uint64_t sample_threshold = 0;
+        double sample_rate = 1.0;
+        // For a fixed-size sample: the tracked lines ordered by hash, so that we can
+        // lower the threshold past the largest ones.
+        std::set<std::pair<uint64_t, addr_t>> sampled_lines;
+        // Estimates of the full-trace histogram of distances and of the number of
+        // references to tracked lines: each sampled reference counts 1/sample_rate
+        // at the time it is seen.  This is equivalent to SHARDS's rescaling of the
+        // counts whenever the rate drops, without the cost.
+        std::unordered_map<int64_t, double> sampled_dist_map;
+        double sampled_refs = 0;
     };
 
     void
@@ -153,6 +170,25 @@ protected:
     void
     print_shard_results(const shard_data_t *shard);
 
+    // Returns the miss ratio of a fully associative LRU cache for each power-of-two
+    // number of lines up to the largest reuse distance.
+    std::vector<std::pair<int64_t, double>>
+    compute_miss_ratio_curve(const shard_data_t *shard);
+
+    void
+    print_miss_ratio_curve(std::ostream &out, const shard_data_t *shard);
+
+    shard_data_t *
+    create_shard_data();
+
+    // Returns whether the line with tag should be tracked by shard.
+    bool
+    sample_line(shard_data_t *shard, addr_t tag, uint64_t *hash);
+
+    // Lowers the sample rate to get back under knobs_.sample_max_lines.
+    void
+    shrink_sample(shard_data_t *shard);
+
     // Return a pointer to aggregate results, building them if needed.
     virtual const shard_data_t *
     get_aggregated_results();
@@ -184,6 +220,9 @@ struct line_ref_t {
     struct line_ref_t *next_skip; // the next line_ref in the skip list
     int64_t depth;                // only valid for skip list nodes; -1 for others
 
+    // The 1-based slot in the Fenwick tree when that is used instead of the skip list.
+    uint64_t tree_pos;
+
     line_ref_t(addr_t val)
         : prev(NULL)
         , next(NULL)
@@ -193,6 +232,7 @@ struct line_ref_t {
         , prev_skip(NULL)
         , next_skip(NULL)
         , depth(-1)
+        , tree_pos(0)
     {
     }
 };
@@ -212,6 +252,14 @@ struct line_ref_t {
 // We have a second doubly-linked list, a one-layer skip list, for
 // more efficient computation of the depth.  Each node in the skip
 // list stores its depth from the front.
+//
+// Alternatively, the depth can come from a Fenwick (binary indexed) tree
+// with one slot per access, in access order, which holds a 1 for each slot that
+// is still some line's most recent access.  A line's depth is then the count of
+// set slots after its own, which is O(log n) regardless of how far away the line
+// is, where the skip list is O(n/skip_distance_).  Slots are handed out in
+// increasing order; when they run out we renumber the live lines from the list,
+// which is in access order already, and rebuild the tree in O(n).
 struct line_ref_list_t {
     line_ref_t *head_;       // the most recently accessed cache line
     line_ref_t *gate_;       // the earliest cache line refs within the threshold
@@ -221,8 +269,16 @@ struct line_ref_list_t {
     uint64_t threshold_;     // the reuse distance threshold
     uint64_t skip_distance_; // distance between skip list nodes
     bool verify_skip_;       // check results using brute-force walks
+    bool use_tree_;          // use the Fenwick tree instead of the skip list
+    std::vector<int64_t> tree_; // Fenwick tree; slot 0 is unused
+    uint64_t tree_next_pos_;    // the next free slot
+    uint64_t tree_live_;        // the number of lines in the tree
+
+    // The initial number of Fenwick tree slots.
+    static constexpr uint64_t TREE_INITIAL_SLOTS = 1024;
 
-    line_ref_list_t(uint64_t reuse_threshold_, uint64_t skip_dist, bool verify)
+    line_ref_list_t(uint64_t reuse_threshold_, uint64_t skip_dist, bool verify,
+                    bool use_tree = false)
         : head_(NULL)
         , gate_(NULL)
         , tail_(NULL)
@@ -231,7 +287,12 @@ struct line_ref_list_t {
         , threshold_(reuse_threshold_)
         , skip_distance_(skip_dist)
         , verify_skip_(verify)
+        , use_tree_(use_tree)
+        , tree_next_pos_(1)
+        , tree_live_(0)
     {
+        if (use_tree_)
+            tree_.resize(TREE_INITIAL_SLOTS + 1, 0);
     }
 
     virtual ~line_ref_list_t()
@@ -246,6 +307,72 @@ struct line_ref_list_t {
         }
     }
 
+    void
+    tree_add(uint64_t pos, int64_t delta)
+    {
+        for (; pos < tree_.size(); pos += pos & (~pos + 1))
+            tree_[pos] += delta;
+    }
+
+    // Returns the number of lines in slots 1 through pos.
+    int64_t
+    tree_prefix_sum(uint64_t pos)
+    {
+        int64_t sum = 0;
+        for (; pos > 0; pos -= pos & (~pos + 1))
+            sum += tree_[pos];
+        return sum;
+    }
+
+    // Renumbers every line in the list into slots 1..n, oldest first, and
+    // rebuilds the tree with room for as many more accesses.
+    void
+    tree_compact()
+    {
+        uint64_t pos = 0;
+        for (line_ref_t *node = tail_; node != NULL; node = node->prev)
+            node->tree_pos = ++pos;
+        IF_DEBUG_VERBOSE(3,
+                         std::cerr << "Compact tree to " << std::dec << pos
+                                   << " lines\n");
+        tree_live_ = pos;
+        tree_next_pos_ = pos + 1;
+        uint64_t slots = 2 * pos;
+        if (slots < TREE_INITIAL_SLOTS)
+            slots = TREE_INITIAL_SLOTS;
+        tree_.assign(slots + 1, 0);
+        // Build in O(n) by pushing each partial sum up to its parent.
+        for (uint64_t i = 1; i < tree_.size(); ++i) {
+            if (i <= pos)
+                ++tree_[i];
+            uint64_t parent = i + (i & (~i + 1));
+            if (parent < tree_.size())
+                tree_[parent] += tree_[i];
+        }
+    }
+
+    // Gives head_, which must not be in the tree, the newest slot.
+    void
+    tree_insert_head()
+    {
+        if (tree_next_pos_ >= tree_.size()) {
+            // Compaction numbers head_ along with everything else.
+            tree_compact();
+            return;
+        }
+        head_->tree_pos = tree_next_pos_++;
+        tree_add(head_->tree_pos, 1);
+        ++tree_live_;
+    }
+
+    void
+    tree_remove(line_ref_t *ref)
+    {
+        tree_add(ref->tree_pos, -1);
+        ref->tree_pos = 0;
+        --tree_live_;
+    }
+
     bool
     ref_is_distant(line_ref_t *ref)
     {
@@ -310,6 +437,12 @@ struct line_ref_list_t {
         unique_lines_++;
         head_->time_stamp = cur_time_++;
 
+        if (use_tree_) {
+            tree_insert_head();
+            IF_DEBUG_VERBOSE(3, print_list());
+            return;
+        }
+
         // Add a new skip node if necessary.
         // We don't bother keeping one right at the front: too much overhead_.
         uint64_t count = 0;
@@ -354,6 +487,9 @@ struct line_ref_list_t {
         line_ref_t *new_tail = tail_->prev;
         new_tail->next = NULL;
 
+        if (use_tree_)
+            tree_remove(tail_);
+
         // If there's a prior skip, remove its ptr to tail.
         if (tail_->depth != -1 && tail_->prev_skip != NULL) {
             tail_->prev_skip->next_skip = NULL;
@@ -368,6 +504,31 @@ struct line_ref_list_t {
         tail_ = new_tail;
     }
 
+    // Remove an arbitrary line from the list.  Only supported with the Fenwick tree,
+    // as removing a line would shift every skip node after it.
+    void
+    remove(line_ref_t *ref)
+    {
+        assert(use_tree_);
+        IF_DEBUG_VERBOSE(3,
+                         std::cerr << "Remove tag 0x" << std::hex << ref->tag << "\n");
+        // Lines beyond the gate now fall within the threshold.
+        if (ref == gate_)
+            gate_ = gate_->next != NULL ? gate_->next : gate_->prev;
+        else if (gate_ != NULL && gate_->next != NULL && !ref_is_distant(ref))
+            gate_ = gate_->next;
+        if (ref->prev != NULL)
+            ref->prev->next = ref->next;
+        else
+            head_ = ref->next;
+        if (ref->next != NULL)
+            ref->next->prev = ref->prev;
+        else
+            tail_ = ref->prev;
+        --unique_lines_;
+        tree_remove(ref);
+    }
+
     // Move a referenced cache line to the front of the list.
     // We need to move the gate_ pointer forward if the referenced cache
     // line is the gate_ cache line or any cache line after.
@@ -396,13 +557,19 @@ struct line_ref_list_t {
 
         // Compute reuse distance.
         int64_t dist = 0;
-        line_ref_t *skip;
-        for (skip = ref; skip != NULL && skip->depth == -1; skip = skip->prev)
-            ++dist;
-        if (skip != NULL)
-            dist += skip->depth;
-        else
-            --dist; // Don't count self.
+        line_ref_t *skip = NULL;
+        if (use_tree_) {
+            // Count the lines accessed since ref, which are those in later slots.
+            dist = static_cast<int64_t>(tree_live_) - tree_prefix_sum(ref->tree_pos);
+            tree_remove(ref);
+        } else {
+            for (skip = ref; skip != NULL && skip->depth == -1; skip = skip->prev)
+                ++dist;
+            if (skip != NULL)
+                dist += skip->depth;
+            else
+                --dist; // Don't count self.
+        }
 
         IF_DEBUG_VERBOSE(
             0, if (verify_skip_) {
@@ -413,8 +580,8 @@ struct line_ref_list_t {
                 for (prev = head_; prev != ref; prev = prev->next)
                     ++brute_dist;
                 if (brute_dist != dist) {
-                    std::cerr << "Mismatch!  Brute=" << std::dec << brute_dist
-                              << " vs skip=" << dist << "\n";
+                    std::cerr << "Mismatch!  Brute=" << std::dec << brute_dist << " vs "
+                              << (use_tree_ ? "tree=" : "skip=") << dist << "\n";
                     print_list();
                     assert(false);
                 }
@@ -444,6 +611,8 @@ struct line_ref_list_t {
         head_->prev = ref;
         head_ = ref;
         head_->time_stamp = cur_time_++;
+        if (use_tree_)
+            tree_insert_head();
 
         IF_DEBUG_VERBOSE(3, print_list());
         // XXX: we should keep a running mean of the distance, and adjust
@@ -59,8 +59,12 @@ struct reuse_distance_knobs_t {
         , skip_list_distance(500)
         , distance_limit(0)
         , verify_skip(false)
+        , use_fenwick_tree(false)
         , verbose(0)
         , histogram_bin_multiplier(1.00)
+        , report_miss_ratio_curve(false)
+        , sample_rate(1.0)
+        , sample_max_lines(0)
     {
     }
     unsigned int line_size;
@@ -70,8 +74,12 @@ struct reuse_distance_knobs_t {
     unsigned int skip_list_distance;
     unsigned int distance_limit;
     bool verify_skip;
+    bool use_fenwick_tree;
     unsigned int verbose;
     double histogram_bin_multiplier;
+    bool report_miss_ratio_curve;
+    double sample_rate;
+    unsigned int sample_max_lines;
 };
 
 /** Creates an analysis tool which computes reuse distance. */
@@ -293,6 +293,39 @@ redirect_free(void *drcontext, void *ptr)
 }
 #endif
 
+#ifdef HAS_ZSTD
+// Unlike snappy and lz4, zstd lets us supply the allocator, so it is safe to use
+// with statically linked clients.
+static void *
+zstd_redirect_malloc(void *opaque, size_t size)
+{
+    size += sizeof(size_t);
+    void *mem = dr_custom_alloc(nullptr, static_cast<dr_alloc_flags_t>(0), size,
+                                DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr);
+    if (mem == nullptr)
+        return nullptr;
+    *((size_t *)mem) = size;
+    return (byte *)mem + sizeof(size_t);
+}
+
+static void
+zstd_redirect_free(void *opaque, void *ptr)
+{
+    if (ptr != nullptr) {
+        byte *mem = (byte *)ptr;
+        mem -= sizeof(size_t);
+        dr_custom_free(nullptr, static_cast<dr_alloc_flags_t>(0), mem, *((size_t *)mem));
+    }
+}
+
+static const ZSTD_customMem zstd_mem = { zstd_redirect_malloc, zstd_redirect_free,
+                                         nullptr };
+
+// Level 1 is zstd's fastest standard level, which still compresses the raw data
+// considerably better than lz4.
+#    define RAW_ZSTD_LEVEL 1
+#endif
+
 int
 append_unit_header(void *drcontext, byte *buf_ptr, thread_id_t tid, ptr_int_t window)
 {
@@ -334,10 +367,409 @@ open_new_window_dir(ptr_int_t window_num)
     NOTIFY(2, "Created new window dir %s\n", windir);
 }
 
+// Compresses if requested and writes to the thread's file.
+static void
+write_thread_file(per_thread_t *data, byte *towrite_start, ssize_t size, thread_id_t tid,
+                  ptr_int_t window)
+{
+    ssize_t wrote;
+#ifdef HAS_SNAPPY
+    if (op_offline.get_value() && snappy_enabled())
+        wrote = data->snappy_writer->compress_and_write(towrite_start, size);
+    else
+#endif
+#ifdef HAS_ZLIB
+        if (op_offline.get_value() &&
+            (op_raw_compress.get_value() == "zlib" ||
+             op_raw_compress.get_value() == "gzip")) {
+        data->zstream.next_in = (Bytef *)towrite_start;
+        data->zstream.avail_in = static_cast<uInt>(size);
+        int res;
+        do {
+            data->zstream.next_out = (Bytef *)data->buf_compressed;
+            data->zstream.avail_out = static_cast<uInt>(max_buf_size);
+            res = deflate(&data->zstream, Z_NO_FLUSH);
+            NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n", res, size,
+                   size, data->zstream.avail_in, data->zstream.avail_out,
+                   max_buf_size - data->zstream.avail_out);
+            DR_ASSERT(res != Z_STREAM_ERROR);
+            wrote = file_ops_func.write_file(data->file, data->buf_compressed,
+                                             max_buf_size - data->zstream.avail_out);
+        } while (data->zstream.avail_out == 0);
+        DR_ASSERT(data->zstream.avail_in == 0);
+        wrote = size;
+    } else
+#endif
+#ifdef HAS_LZ4
+        if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
+        size_t res = LZ4F_compressUpdate(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
+                                         towrite_start, size, nullptr);
+        DR_ASSERT(!LZ4F_isError(res));
+        wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
+        DR_ASSERT(static_cast<size_t>(wrote) == res);
+        wrote = size;
+    } else
+#endif
+#ifdef HAS_ZSTD
+        if (op_offline.get_value() && op_raw_compress.get_value() == "zstd") {
+        ZSTD_inBuffer in = { towrite_start, static_cast<size_t>(size), 0 };
+        do {
+            ZSTD_outBuffer out = { data->buf_zstd, data->buf_zstd_size, 0 };
+            size_t res =
+                ZSTD_compressStream2(data->zstd_cctx, &out, &in, ZSTD_e_continue);
+            DR_ASSERT(!ZSTD_isError(res));
+            wrote = file_ops_func.write_file(data->file, data->buf_zstd, out.pos);
+            DR_ASSERT(static_cast<size_t>(wrote) == out.pos);
+        } while (in.pos < in.size);
+        wrote = size;
+    } else
+#endif
+        wrote = file_ops_func.write_file(data->file, towrite_start, size);
+    if (wrote < size) {
+        FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
+              "of %zd\n",
+              tid, window, wrote, size);
+    }
+}
+
+/***************************************************************************
+ * Asynchronous raw file writing for -raw_async_writers.
+ *
+ * Each writer owns a bounded ring of buffer-sized slots.  Application threads copy
+ * a full trace buffer into a free slot without taking a lock (a Vyukov-style
+ * sequence-numbered ring), and the writer's client thread compresses and writes the
+ * slots in order.  Every traced thread is bound to a single writer, so its buffers
+ * stay in order and its compression state is used by one thread at a time.
+ *
+ * Slots are only consumed while holding the writer's lock.  That lets an
+ * application thread consume slots itself: when its writer's ring is full (this is
+ * the back-pressure) and when it needs all of its own buffers written before
+ * closing its file.  It also means the ring needs no multi-consumer handling.
+ */
+
+struct async_slot_t {
+    std::atomic<size_t> sequence;
+    per_thread_t *data;
+    thread_id_t tid;
+    ptr_int_t window;
+    ssize_t size;
+    byte *buf; // Sized max_buf_size.
+};
+
+struct async_writer_t {
+    async_slot_t *slots;
+    size_t mask;
+    std::atomic<size_t> enqueue_pos;
+    std::atomic<size_t> dequeue_pos;
+    void *lock; // Held while consuming a slot.
+    void *work_event;
+};
+
+static async_writer_t *async_writers;
+static uint num_async_writers;
+static uint async_slot_count;
+static std::atomic<uint> async_next_writer;
+static std::atomic<bool> async_started;
+static std::atomic<bool> async_exiting;
+static std::atomic<bool> async_park_writers;
+static std::atomic<int> async_live_writers;
+// Statistics, reported at exit.
+static std::atomic<uint64> async_buffers;
+static std::atomic<uint64> async_stalls;
+static std::atomic<uint64> async_stall_us;
+static std::atomic<size_t> async_max_depth;
+
+static bool
+async_try_enqueue(async_writer_t *writer, per_thread_t *data, thread_id_t tid,
+                  ptr_int_t window, byte *start, ssize_t size)
+{
+    size_t pos = writer->enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        async_slot_t *slot = &writer->slots[pos & writer->mask];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        ptr_int_t diff = static_cast<ptr_int_t>(seq) - static_cast<ptr_int_t>(pos);
+        if (diff == 0) {
+            if (writer->enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                          std::memory_order_relaxed)) {
+                slot->data = data;
+                slot->tid = tid;
+                slot->window = window;
+                slot->size = size;
+                memcpy(slot->buf, start, size);
+                slot->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // Full.
+        } else
+            pos = writer->enqueue_pos.load(std::memory_order_relaxed);
+    }
+}
+
+// The caller must hold writer->lock.  Returns false if there was nothing to write.
+static bool
+async_write_one(async_writer_t *writer)
+{
+    size_t pos = writer->dequeue_pos.load(std::memory_order_relaxed);
+    async_slot_t *slot = &writer->slots[pos & writer->mask];
+    if (slot->sequence.load(std::memory_order_acquire) != pos + 1)
+        return false; // Empty.
+    writer->dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+    write_thread_file(slot->data, slot->buf, slot->size, slot->tid, slot->window);
+    dr_atomic_add32_return_sum(&slot->data->async_pending, -1);
+    slot->sequence.store(pos + writer->mask + 1, std::memory_order_release);
+    return true;
+}
+
+// Writes one slot on behalf of the writer thread.  If the next slot is still being
+// filled by another application thread we yield to let it finish.
+static void
+async_help_write(async_writer_t *writer)
+{
+    dr_mutex_lock(writer->lock);
+    bool wrote = async_write_one(writer);
+    dr_mutex_unlock(writer->lock);
+    if (!wrote)
+        dr_thread_yield();
+}
+
+static void
+async_writer_thread(void *arg);
+
+// Client threads created during init race with each other in DR's thread
+// initialization, so we create the writers on first use, when the application
+// is already running.
+static void
+async_start_writers()
+{
+    bool expected = false;
+    if (!async_started.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        return;
+    for (uint i = 0; i < num_async_writers; ++i) {
+        async_live_writers.fetch_add(1, std::memory_order_relaxed);
+        if (!dr_create_client_thread(async_writer_thread, &async_writers[i]))
+            FATAL("Fatal error: failed to create -raw_async_writers thread.\n");
+    }
+}
+
+static void
+async_enqueue(per_thread_t *data, thread_id_t tid, ptr_int_t window, byte *start,
+              ssize_t size)
+{
+    async_writer_t *writer = &async_writers[data->async_writer];
+    if (!async_started.load(std::memory_order_acquire))
+        async_start_writers();
+    dr_atomic_add32_return_sum(&data->async_pending, 1);
+    if (!async_try_enqueue(writer, data, tid, window, start, size)) {
+        // The writer is behind: rather than blocking, do its work until we fit.
+        uint64 stall_start = dr_get_microseconds();
+        do {
+            async_help_write(writer);
+        } while (!async_try_enqueue(writer, data, tid, window, start, size));
+        async_stalls.fetch_add(1, std::memory_order_relaxed);
+        async_stall_us.fetch_add(dr_get_microseconds() - stall_start,
+                                 std::memory_order_relaxed);
+    }
+    async_buffers.fetch_add(1, std::memory_order_relaxed);
+    size_t depth = writer->enqueue_pos.load(std::memory_order_relaxed) -
+        writer->dequeue_pos.load(std::memory_order_relaxed);
+    size_t max_depth = async_max_depth.load(std::memory_order_relaxed);
+    while (depth > max_depth &&
+           !async_max_depth.compare_exchange_weak(max_depth, depth,
+                                                  std::memory_order_relaxed)) {
+        // Retry with the updated max_depth.
+    }
+    dr_event_signal(writer->work_event);
+}
+
+// Writes out all of data's queued buffers.  This must be called before anything
+// else touches the thread's file or compression state.
+static void
+async_drain_thread(per_thread_t *data)
+{
+    if (num_async_writers == 0)
+        return;
+    async_writer_t *writer = &async_writers[data->async_writer];
+    while (dr_atomic_load32(&data->async_pending) > 0)
+        async_help_write(writer);
+}
+
+static void
+async_writer_thread(void *arg)
+{
+    async_writer_t *writer = reinterpret_cast<async_writer_t *>(arg);
+    while (!async_exiting.load(std::memory_order_acquire)) {
+        dr_mutex_lock(writer->lock);
+        bool wrote = async_write_one(writer);
+        dr_mutex_unlock(writer->lock);
+        if (!wrote) {
+            dr_event_wait(writer->work_event);
+            dr_event_reset(writer->work_event);
+        }
+    }
+    async_live_writers.fetch_sub(1, std::memory_order_release);
+    // Returning at process exit would have DR clean up this thread concurrently with
+    // its exit-time synch, which loses track of the thread after a fork.  We instead
+    // idle at a synch-safe point until DR terminates us after the exit event.
+    if (async_park_writers.load(std::memory_order_acquire)) {
+        while (true)
+            dr_sleep(1000);
+    }
+}
+
+// Stops the writer threads, which either return or park (see async_writer_thread).
+// Any buffers still queued are written by their own threads' async_drain_thread().
+static void
+async_stop_writers(bool park)
+{
+    if (async_exiting.load(std::memory_order_acquire))
+        return;
+    async_park_writers.store(park, std::memory_order_relaxed);
+    async_exiting.store(true, std::memory_order_release);
+    // Keep a later first enqueue from starting writers.
+    async_started.store(true, std::memory_order_release);
+    for (uint i = 0; i < num_async_writers; ++i)
+        dr_event_signal(async_writers[i].work_event);
+    static constexpr int MAX_EXIT_WAIT_MS = 1000;
+    for (int i = 0;
+         async_live_writers.load(std::memory_order_acquire) > 0 && i < MAX_EXIT_WAIT_MS;
+         ++i)
+        dr_sleep(1);
+}
+
+void
+init_async_io()
+{
+    if (op_raw_async_writers.get_value() == 0)
+        return;
+    if (!op_offline.get_value() || file_ops_func.handoff_buf != NULL) {
+        NOTIFY(0, "-raw_async_writers is ignored for online or handoff traces\n");
+        return;
+    }
+    DR_ASSERT(max_buf_size > 0 && async_writers == nullptr);
+    // The ring cannot tell a full slot from an empty one with a single slot.
+    async_slot_count = 2;
+    while (async_slot_count < op_raw_async_queue_size.get_value())
+        async_slot_count <<= 1;
+    num_async_writers = op_raw_async_writers.get_value();
+    async_started.store(false, std::memory_order_relaxed);
+    async_exiting.store(false, std::memory_order_relaxed);
+    async_park_writers.store(false, std::memory_order_relaxed);
+    async_live_writers.store(0, std::memory_order_relaxed);
+    async_writers = static_cast<async_writer_t *>(
+        dr_global_alloc(num_async_writers * sizeof(async_writer_t)));
+    for (uint i = 0; i < num_async_writers; ++i) {
+        async_writer_t *writer = new (&async_writers[i]) async_writer_t;
+        writer->slots = static_cast<async_slot_t *>(
+            dr_global_alloc(async_slot_count * sizeof(async_slot_t)));
+        writer->mask = async_slot_count - 1;
+        for (uint j = 0; j < async_slot_count; ++j) {
+            async_slot_t *slot = new (&writer->slots[j]) async_slot_t;
+            slot->sequence.store(j, std::memory_order_relaxed);
+            slot->buf = static_cast<byte *>(dr_raw_mem_alloc(
+                max_buf_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+            if (slot->buf == nullptr)
+                FATAL("Fatal error: out of memory for -raw_async_queue_size.\n");
+        }
+        writer->enqueue_pos.store(0, std::memory_order_relaxed);
+        writer->dequeue_pos.store(0, std::memory_order_relaxed);
+        writer->lock = dr_mutex_create();
+        writer->work_event = dr_event_create();
+    }
+}
+
+static void
+exit_async_io()
+{
+    if (num_async_writers == 0)
+        return;
+    // Client threads are only terminated after the exit event, so we can quiesce
+    // ours before freeing what they use.  Every traced thread drained its own
+    // buffers at its exit.
+    async_stop_writers(/*park=*/true);
+    NOTIFY(1,
+           "drmemtrace wrote " UINT64_FORMAT_STRING
+           " buffers asynchronously; max queue depth %zu; " UINT64_FORMAT_STRING
+           " stalls totaling " UINT64_FORMAT_STRING "us.\n",
+           async_buffers.load(), async_max_depth.load(), async_stalls.load(),
+           async_stall_us.load());
+    if (async_live_writers.load(std::memory_order_acquire) > 0) {
+        // Leave everything in place rather than freeing it out from under a writer.
+        NOTIFY(0, "-raw_async_writers threads failed to exit\n");
+        return;
+    }
+    for (uint i = 0; i < num_async_writers; ++i) {
+        async_writer_t *writer = &async_writers[i];
+        DR_ASSERT(writer->enqueue_pos.load(std::memory_order_acquire) ==
+                  writer->dequeue_pos.load(std::memory_order_acquire));
+        for (uint j = 0; j < async_slot_count; ++j) {
+            dr_raw_mem_free(writer->slots[j].buf, max_buf_size);
+            writer->slots[j].~async_slot_t();
+        }
+        dr_global_free(writer->slots, async_slot_count * sizeof(async_slot_t));
+        dr_mutex_destroy(writer->lock);
+        dr_event_destroy(writer->work_event);
+        writer->~async_writer_t();
+    }
+    dr_global_free(async_writers, num_async_writers * sizeof(async_writer_t));
+    async_writers = nullptr;
+    num_async_writers = 0;
+    async_buffers.store(0, std::memory_order_relaxed);
+    async_stalls.store(0, std::memory_order_relaxed);
+    async_stall_us.store(0, std::memory_order_relaxed);
+    async_max_depth.store(0, std::memory_order_relaxed);
+}
+
+void
+detach_async_io()
+{
+    if (num_async_writers == 0)
+        return;
+    // DR only terminates client threads after the exit event, and a writer left
+    // blocked across a detach does not survive to be terminated, which hangs DR's
+    // final synch.  We have the writers exit while they still can.
+    async_stop_writers(/*park=*/false);
+}
+
+void
+fork_init_async_io(void *drcontext)
+{
+    if (num_async_writers == 0)
+        return;
+    // The writer threads do not exist in the child and the queued slots hold the
+    // parent's buffers, which the parent's writers will write.  We drop those
+    // buffers and reset the queues; the child's first enqueue starts new writers.
+    per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    data->async_pending = 0;
+    async_started.store(false, std::memory_order_relaxed);
+    async_exiting.store(false, std::memory_order_relaxed);
+    async_park_writers.store(false, std::memory_order_relaxed);
+    async_live_writers.store(0, std::memory_order_relaxed);
+    async_buffers.store(0, std::memory_order_relaxed);
+    async_stalls.store(0, std::memory_order_relaxed);
+    async_stall_us.store(0, std::memory_order_relaxed);
+    async_max_depth.store(0, std::memory_order_relaxed);
+    for (uint i = 0; i < num_async_writers; ++i) {
+        async_writer_t *writer = &async_writers[i];
+        for (uint j = 0; j < async_slot_count; ++j)
+            writer->slots[j].sequence.store(j, std::memory_order_relaxed);
+        writer->enqueue_pos.store(0, std::memory_order_relaxed);
+        writer->dequeue_pos.store(0, std::memory_order_relaxed);
+        // A parent thread may have held the lock at the fork.  It can never be
+        // released, so we abandon it for a new one.
+        if (dr_mutex_trylock(writer->lock))
+            dr_mutex_unlock(writer->lock);
+        else
+            writer->lock = dr_mutex_create();
+        dr_event_reset(writer->work_event);
+    }
+}
+
 static void
 close_thread_file(void *drcontext)
 {
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    async_drain_thread(data);
 #ifdef HAS_SNAPPY
     if (op_offline.get_value() && snappy_enabled()) {
         data->snappy_writer->~snappy_file_writer_t();
@@ -379,6 +811,21 @@ close_thread_file(void *drcontext)
         res = LZ4F_freeCompressionContext(data->lzcxt);
         DR_ASSERT(!LZ4F_isError(res));
     }
+#endif
+#ifdef HAS_ZSTD
+    if (op_offline.get_value() && op_raw_compress.get_value() == "zstd") {
+        // Flush remaining data and complete the frame.
+        ZSTD_inBuffer in = { nullptr, 0, 0 };
+        size_t remaining;
+        do {
+            ZSTD_outBuffer out = { data->buf_zstd, data->buf_zstd_size, 0 };
+            remaining = ZSTD_compressStream2(data->zstd_cctx, &out, &in, ZSTD_e_end);
+            DR_ASSERT(!ZSTD_isError(remaining));
+            file_ops_func.write_file(data->file, data->buf_zstd, out.pos);
+        } while (remaining > 0 && !ZSTD_isError(remaining));
+        ZSTD_freeCCtx(data->zstd_cctx);
+        data->zstd_cctx = nullptr;
+    }
 #endif
     file_ops_func.close_file(data->file);
     data->file = INVALID_FILE;
@@ -429,6 +876,10 @@ open_new_thread_file(void *drcontext, ptr_int_t window_num)
 #ifdef HAS_LZ4
     if (op_raw_compress.get_value() == "lz4")
         suffix = OUTFILE_SUFFIX_LZ4;
+#endif
+#ifdef HAS_ZSTD
+    if (op_raw_compress.get_value() == "zstd")
+        suffix = OUTFILE_SUFFIX_ZSTD;
 #endif
     for (i = 0; i < NUM_OF_TRIES; i++) {
         drx_open_unique_appid_file(dir, dr_get_thread_id(drcontext), subdir_prefix,
@@ -492,6 +943,16 @@ open_new_thread_file(void *drcontext, ptr_int_t window_num)
             ssize_t wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
             DR_ASSERT(static_cast<size_t>(wrote) == res);
         }
+#endif
+#ifdef HAS_ZSTD
+        if (op_offline.get_value() && op_raw_compress.get_value() == "zstd") {
+            // Each file is one zstd frame: the header is written with the first data.
+            data->zstd_cctx = ZSTD_createCCtx_advanced(zstd_mem);
+            DR_ASSERT(data->zstd_cctx != nullptr);
+            size_t res = ZSTD_CCtx_setParameter(data->zstd_cctx,
+                                                ZSTD_c_compressionLevel, RAW_ZSTD_LEVEL);
+            DR_ASSERT(!ZSTD_isError(res));
+        }
 #endif
         break;
     }
@@ -550,60 +1011,28 @@ write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end,
                                            max_buf_size)) {
                 FATAL("Fatal error: failed to hand off trace\n");
             }
+        } else if (num_async_writers > 0) {
+            async_enqueue(data, dr_get_thread_id(drcontext), window, towrite_start,
+                          size);
         } else {
-            ssize_t wrote;
-#ifdef HAS_SNAPPY
-            if (op_offline.get_value() && snappy_enabled())
-                wrote = data->snappy_writer->compress_and_write(towrite_start, size);
-            else
-#endif
-#ifdef HAS_ZLIB
-                if (op_offline.get_value() &&
-                    (op_raw_compress.get_value() == "zlib" ||
-                     op_raw_compress.get_value() == "gzip")) {
-                data->zstream.next_in = (Bytef *)towrite_start;
-                data->zstream.avail_in = static_cast<uInt>(size);
-                int res;
-                do {
-                    data->zstream.next_out = (Bytef *)data->buf_compressed;
-                    data->zstream.avail_out = static_cast<uInt>(max_buf_size);
-                    res = deflate(&data->zstream, Z_NO_FLUSH);
-                    NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n",
-                           res, size, size, data->zstream.avail_in,
-                           data->zstream.avail_out,
-                           max_buf_size - data->zstream.avail_out);
-                    DR_ASSERT(res != Z_STREAM_ERROR);
-                    wrote =
-                        file_ops_func.write_file(data->file, data->buf_compressed,
-                                                 max_buf_size - data->zstream.avail_out);
-                } while (data->zstream.avail_out == 0);
-                DR_ASSERT(data->zstream.avail_in == 0);
-                wrote = size;
-            } else
-#endif
-#ifdef HAS_LZ4
-                if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
-                size_t res =
-                    LZ4F_compressUpdate(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
-                                        towrite_start, size, nullptr);
-                DR_ASSERT(!LZ4F_isError(res));
-                wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
-                DR_ASSERT(static_cast<size_t>(wrote) == res);
-                wrote = size;
-            } else
-#endif
-                wrote = file_ops_func.write_file(data->file, towrite_start, size);
-            if (wrote < size) {
-                FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
-                      "of %zd\n",
-                      dr_get_thread_id(drcontext), get_local_window(data), wrote, size);
-            }
+            write_thread_file(data, towrite_start, size, dr_get_thread_id(drcontext),
+                              window);
         }
         return towrite_start;
     } else {
 #ifdef HAS_SNAPPY
         // XXX i#5427: Use snappy compression for pipe data as well.  We need to
         // create a reader on the other end first.
+#endif
+#ifdef LINUX
+        if (op_ipc_shm.get_value()) {
+            per_thread_t *data =
+                (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+            if (!ipc_shm.write(data->shm_ring, towrite_start,
+                               towrite_end - towrite_start))
+                FATAL("Fatal error: failed to write to shared memory ring\n");
+            return towrite_start;
+        }
 #endif
         return atomic_pipe_write(drcontext, towrite_start, towrite_end, window);
     }
@@ -664,11 +1093,22 @@ set_local_window(void *drcontext, ptr_int_t value)
     return prepended;
 }
 
+/* Allocates a trace buffer plus its -buffer_guard region, if any. */
+static byte *
+alloc_trace_buffer()
+{
+    byte *buf = (byte *)dr_raw_mem_alloc(max_buf_size + buf_guard_size,
+                                         DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+    if (buf != NULL && buf_guard_size > 0 &&
+        !dr_memory_protect(buf + max_buf_size, buf_guard_size, DR_MEMPROT_NONE))
+        FATAL("Fatal error: failed to protect trace buffer guard region.\n");
+    return buf;
+}
+
 static void
 create_buffer(per_thread_t *data)
 {
-    data->buf_base =
-        (byte *)dr_raw_mem_alloc(max_buf_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+    data->buf_base = alloc_trace_buffer();
     /* For file_ops_func.handoff_buf we have to handle failure as OOM is not unlikely. */
     if (data->buf_base == NULL) {
         /* Switch to "reserve" buffer. */
@@ -692,8 +1132,7 @@ create_buffer(per_thread_t *data)
          * -max_trace_size.  This costs us some memory (not for idle threads: that's
          * why we wait for the 2nd buffer) but we gain simplicity.
          */
-        data->reserve_buf = (byte *)dr_raw_mem_alloc(
-            max_buf_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+        data->reserve_buf = alloc_trace_buffer();
         if (data->reserve_buf != NULL)
             memset(data->reserve_buf + trace_buf_size, -1, redzone_size);
     }
@@ -748,7 +1187,8 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
               size_t header_size)
 {
     byte *pipe_start = buf_base;
-    if (!op_offline.get_value()) {
+    // Shared memory rings take each buffer whole, so only pipes need splitting.
+    if (!op_offline.get_value() && !op_ipc_shm.get_value()) {
         byte *post_header = buf_base + header_size;
         byte *last_ok_to_split_ref = nullptr;
         // Pipe split headers are just the tid.
@@ -812,7 +1252,9 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
                                       instru->get_entry_size(pipe_start + header_size)));
             atomic_pipe_write(drcontext, pipe_start, buf_ptr, get_local_window(data));
         }
-    } else {
+    } else if (op_offline.get_value() ||
+               // As with pipes, skip an online buffer holding only its header.
+               (buf_ptr - pipe_start) > (ssize_t)buf_hdr_slots_size) {
         write_trace_data(drcontext, pipe_start, buf_ptr, get_local_window(data));
     }
     auto span = buf_ptr - buf_base; // Include the header.
@@ -1238,7 +1680,8 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
             output_buffer(drcontext, data, data->buf_base + skip, buf_ptr, header_size);
     }
 
-    if (file_ops_func.handoff_buf == NULL) {
+    // With -buffer_guard the instrumentation never reads the buffer contents.
+    if (file_ops_func.handoff_buf == NULL && buf_guard_size == 0) {
         // Our instrumentation reads from buffer and skips the clean call if the
         // content is 0, so we need set zero in the trace buffer and set non-zero
         // in redzone.
@@ -1297,6 +1740,10 @@ init_thread_io(void *drcontext)
     byte *proc_info;
 
     NOTIFY(2, "T" TIDFMT " in init_thread_io.\n", dr_get_thread_id(drcontext));
+    if (num_async_writers > 0) {
+        data->async_writer =
+            async_next_writer.fetch_add(1, std::memory_order_relaxed) % num_async_writers;
+    }
 #ifdef HAS_ZLIB
     if (op_offline.get_value() &&
         (op_raw_compress.get_value() == "zlib" ||
@@ -1313,6 +1760,14 @@ init_thread_io(void *drcontext)
             data->buf_lz4_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
     }
 #endif
+#ifdef HAS_ZSTD
+    if (op_offline.get_value() && op_raw_compress.get_value() == "zstd") {
+        // Large enough to compress a whole buffer in one step.
+        data->buf_zstd_size = ZSTD_compressBound(max_buf_size);
+        data->buf_zstd = static_cast<byte *>(dr_raw_mem_alloc(
+            data->buf_zstd_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+    }
+#endif
 
     if (op_use_physical.get_value()) {
         if (!data->physaddr.init()) {
@@ -1350,6 +1805,10 @@ init_thread_io(void *drcontext)
         }
 
     } else {
+#ifdef LINUX
+        if (op_ipc_shm.get_value())
+            data->shm_ring = ipc_shm.assign_ring();
+#endif
         /* pass pid and tid to the simulator to register current thread */
         char buf[MAXIMUM_PATH];
         proc_info = (byte *)buf;
@@ -1432,6 +1891,11 @@ exit_thread_io(void *drcontext)
         dr_raw_mem_free(data->buf_lz4, data->buf_lz4_size);
     }
 #endif
+#ifdef HAS_ZSTD
+    if (op_offline.get_value() && op_raw_compress.get_value() == "zstd") {
+        dr_raw_mem_free(data->buf_zstd, data->buf_zstd_size);
+    }
+#endif
 }
 
 void
@@ -1447,6 +1911,9 @@ init_io()
 #endif
 #ifdef HAS_LZ4
         || op_raw_compress.get_value() == "lz4"
+#endif
+#ifdef HAS_ZSTD
+        || op_raw_compress.get_value() == "zstd"
 #endif
     ) {
         // Valid option.
@@ -1484,6 +1951,7 @@ init_io()
 void
 exit_io()
 {
+    exit_async_io();
     notify_beyond_global_max_once = 0;
 }
 
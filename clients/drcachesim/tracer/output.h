@@ -64,6 +64,19 @@ init_io();
 void
 exit_io();
 
+// Sets up the -raw_async_writers queues; the threads start on first use.  Must be
+// called after max_buf_size is set.
+void
+init_async_io();
+
+// Stops the -raw_async_writers threads.  Called from the pre-detach event.
+void
+detach_async_io();
+
+// Called in a fork child.
+void
+fork_init_async_io(void *drcontext);
+
 // Returns true for an empty new (non-initial) buffer for a tracing window
 // with no instructions traced yet in the window.
 inline bool
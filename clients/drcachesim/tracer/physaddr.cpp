@@ -73,20 +73,27 @@ std::atomic<bool> physaddr_t::has_privileges_;
 physaddr_t::physaddr_t()
 #ifdef LINUX
     : page_size_(dr_page_size())
-    , cache_idx_(0)
+    , cache_(nullptr)
+    , cache_mask_(0)
+    , huge_cache_(nullptr)
+    , huge_cache_mask_(0)
+    , pagemap_buf_(nullptr)
     , fd_(-1)
     , v2p_(nullptr)
     , drcontext_(nullptr)
     , count_(0)
     , num_hit_cache_(0)
+    , num_hit_prefetch_(0)
+    , num_hit_huge_(0)
     , num_hit_table_(0)
     , num_miss_(0)
+    , num_pagemap_reads_(0)
+    , prefetch_(true)
+    , window_misses_(0)
+    , window_prefetch_hits_(0)
 #endif
 {
 #ifdef LINUX
-    memset(last_vpage_, static_cast<char>(PAGE_INVALID), sizeof(last_vpage_));
-    memset(last_ppage_, static_cast<char>(PAGE_INVALID), sizeof(last_ppage_));
-
     page_bits_ = 0;
     size_t temp = page_size_;
     while (temp > 1) {
@@ -103,11 +110,18 @@ physaddr_t::~physaddr_t()
     if (num_miss_ > 0) {
         NOTIFY(1,
                "physaddr: hit cache: " UINT64_FORMAT_STRING
-               ", hit table " UINT64_FORMAT_STRING ", miss " UINT64_FORMAT_STRING "\n",
-               num_hit_cache_, num_hit_table_, num_miss_);
+               ", hit prefetch " UINT64_FORMAT_STRING ", hit huge " UINT64_FORMAT_STRING
+               ", hit table " UINT64_FORMAT_STRING ", miss " UINT64_FORMAT_STRING
+               ", pagemap reads " UINT64_FORMAT_STRING "\n",
+               num_hit_cache_, num_hit_prefetch_, num_hit_huge_, num_hit_table_, num_miss_,
+               num_pagemap_reads_);
     }
     if (v2p_ != nullptr)
         dr_hashtable_destroy(drcontext_, v2p_);
+    if (cache_ != nullptr)
+        dr_global_free(cache_, cache_alloc_size());
+    if (pagemap_buf_ != nullptr)
+        dr_global_free(pagemap_buf_, HUGE_RUN * sizeof(*pagemap_buf_));
 #endif
 }
 
@@ -167,6 +181,18 @@ physaddr_t::init()
     drcontext_ = dr_get_current_drcontext();
     v2p_ = dr_hashtable_create(drcontext_, V2P_INITIAL_BITS, 20,
                                /*synch=*/false, nullptr);
+    // We use DR's heap rather than new[] to support static linking.
+    constexpr size_t MIN_CACHE_SIZE = 64;
+    size_t cache_size = MIN_CACHE_SIZE;
+    while (cache_size < op_virt2phys_cache_size.get_value())
+        cache_size <<= 1;
+    cache_mask_ = cache_size - 1;
+    huge_cache_mask_ = cache_size / 8 - 1;
+    cache_ = static_cast<v2p_entry_t *>(dr_global_alloc(cache_alloc_size()));
+    huge_cache_ = cache_ + cache_size;
+    pagemap_buf_ =
+        static_cast<uint64_t *>(dr_global_alloc(HUGE_RUN * sizeof(*pagemap_buf_)));
+    clear_caches();
 
     // We avoid std::ostringstream to avoid malloc use for static linking.
     constexpr int MAX_PAGEMAP_FNAME = 64;
@@ -187,6 +213,139 @@ physaddr_t::init()
 #endif
 }
 
+void
+physaddr_t::get_stats(DR_PARAM_OUT uint64_t *hits, DR_PARAM_OUT uint64_t *misses,
+                      DR_PARAM_OUT uint64_t *pagemap_reads) const
+{
+#ifdef LINUX
+    *hits = num_hit_cache_ + num_hit_prefetch_ + num_hit_huge_ + num_hit_table_;
+    *misses = num_miss_;
+    *pagemap_reads = num_pagemap_reads_;
+#else
+    *hits = 0;
+    *misses = 0;
+    *pagemap_reads = 0;
+#endif
+}
+
+#ifdef LINUX
+void
+physaddr_t::clear_caches()
+{
+    memset(cache_, static_cast<char>(PAGE_INVALID), cache_alloc_size());
+}
+
+void
+physaddr_t::add_new_page(void *drcontext, addr_t vpage, addr_t ppage)
+{
+    // Despite the kernel handing out a 0 PFN for unprivileged reads, 0 is a valid
+    // possible PFN.
+    // Store 0 as a sentinel since 0 means no entry.
+    dr_hashtable_add(drcontext, v2p_, vpage,
+                     reinterpret_cast<void *>(ppage == 0 ? ZERO_ADDR_PAYLOAD : ppage));
+    v2p_entry_t &entry = cache_entry(vpage);
+    entry.vpage = vpage;
+    entry.ppage = ppage;
+}
+
+// Returns whether the first count entries of pagemap_buf_ are valid and map
+// consecutive physical pages, starting at *base_pfn.
+bool
+physaddr_t::is_contiguous_run(int count, DR_PARAM_OUT uint64_t *base_pfn)
+{
+    *base_pfn = pagemap_buf_[0] & PAGEMAP_PFN;
+    for (int i = 0; i < count; ++i) {
+        if (!TESTALL(PAGEMAP_VALID, pagemap_buf_[i]) ||
+            TESTANY(PAGEMAP_SWAP, pagemap_buf_[i]) ||
+            (pagemap_buf_[i] & PAGEMAP_PFN) != *base_pfn + i)
+            return false;
+    }
+    return true;
+}
+
+// Reads the pagemap entries for the PAGEMAP_RUN-aligned run of pages holding
+// vpage with a single syscall.  The other valid pages in the run are prefetched
+// into our cache.  If the run could be part of a huge page we check the whole
+// HUGE_RUN and if so cache it as a unit.
+bool
+physaddr_t::read_pagemap_run(void *drcontext, addr_t vpage, DR_PARAM_OUT addr_t *ppage)
+{
+    // Prefetching costs extra when accesses are scattered, so we measure it over
+    // windows of misses and drop to single-entry reads when it is not paying off,
+    // still sampling a whole run every so often in case that changes.
+    constexpr int PREFETCH_WINDOW = 256;
+    constexpr int PREFETCH_SAMPLE = 16;
+    if (++window_misses_ == PREFETCH_WINDOW) {
+        prefetch_ = window_prefetch_hits_ >= PREFETCH_WINDOW / 4;
+        window_misses_ = 0;
+        window_prefetch_hits_ = 0;
+    }
+    int run = (prefetch_ || window_misses_ % PREFETCH_SAMPLE == 0) ? PAGEMAP_RUN : 1;
+    // The pagemap file contains one 64-bit int per page.
+    // See the docs at https://www.kernel.org/doc/Documentation/vm/pagemap.txt
+    // For huge pages it's the same: there are just N consecutive entries, with
+    // the first marked COMPOUND_HEAD and the rest COMPOUND_TAIL in the flags,
+    // which we ignore here: we look for physical contiguity instead.
+    addr_t run_start = ALIGN_BACKWARD(vpage, page_size_ * run);
+    off64_t offs = run_start / page_size_ * sizeof(*pagemap_buf_);
+    ++num_pagemap_reads_;
+    ssize_t res = pread64(fd_, pagemap_buf_, run * sizeof(*pagemap_buf_), offs);
+    // A run at the top of the address space may be cut short.
+    int index = static_cast<int>((vpage - run_start) / page_size_);
+    if (res < static_cast<ssize_t>((index + 1) * sizeof(*pagemap_buf_))) {
+        NOTIFY(1, "v2p failure: read at " INT64_FORMAT_STRING " failed for %p\n", offs,
+               vpage);
+        return false;
+    }
+    int count = static_cast<int>(res / sizeof(*pagemap_buf_));
+    uint64_t entry = pagemap_buf_[index];
+    NOTIFY(3, "v2p: %p => entry " HEX64_FORMAT_STRING " @ offs " INT64_FORMAT_STRING "\n",
+           vpage, entry, offs + index * sizeof(*pagemap_buf_));
+    if (!TESTALL(PAGEMAP_VALID, entry) || TESTANY(PAGEMAP_SWAP, entry)) {
+        NOTIFY(1, "v2p failure: entry %p is invalid for %p in T%d\n", entry, vpage,
+               dr_get_thread_id(drcontext));
+        return false;
+    }
+    *ppage = (addr_t)((entry & PAGEMAP_PFN) << page_bits_);
+    uint64_t base_pfn;
+    addr_t huge_size = page_size_ * HUGE_RUN;
+    addr_t huge_start = ALIGN_BACKWARD(vpage, huge_size);
+    if (count == PAGEMAP_RUN && is_contiguous_run(count, &base_pfn) &&
+        (base_pfn - (run_start - huge_start) / page_size_) % HUGE_RUN == 0) {
+        offs = huge_start / page_size_ * sizeof(*pagemap_buf_);
+        ++num_pagemap_reads_;
+        res = pread64(fd_, pagemap_buf_, HUGE_RUN * sizeof(*pagemap_buf_), offs);
+        if (res == HUGE_RUN * sizeof(*pagemap_buf_) &&
+            is_contiguous_run(HUGE_RUN, &base_pfn)) {
+            v2p_entry_t &huge = huge_cache_entry(huge_start);
+            huge.vpage = huge_start;
+            huge.ppage = (addr_t)(base_pfn << page_bits_);
+            NOTIFY(2, "v2p: %p is a contiguous run at %p\n", huge_start, huge.ppage);
+            return true;
+        }
+        // Re-read the small run that we just clobbered.
+        offs = run_start / page_size_ * sizeof(*pagemap_buf_);
+        ++num_pagemap_reads_;
+        res = pread64(fd_, pagemap_buf_, PAGEMAP_RUN * sizeof(*pagemap_buf_), offs);
+        count = res < 0 ? 0 : static_cast<int>(res / sizeof(*pagemap_buf_));
+    }
+    for (int i = 0; i < count; ++i) {
+        if (i == index || !TESTALL(PAGEMAP_VALID, pagemap_buf_[i]) ||
+            TESTANY(PAGEMAP_SWAP, pagemap_buf_[i]))
+            continue;
+        addr_t other_vpage = run_start + i * page_size_;
+        v2p_entry_t &other = cache_entry(other_vpage);
+        // Do not demote a returned page to a prefetched one.
+        if (other.vpage == other_vpage)
+            continue;
+        other.vpage = other_vpage;
+        other.ppage =
+            (addr_t)((pagemap_buf_[i] & PAGEMAP_PFN) << page_bits_) | PAGE_PREFETCHED;
+    }
+    return true;
+}
+#endif
+
 bool
 physaddr_t::virtual2physical(void *drcontext, addr_t virt, DR_PARAM_OUT addr_t *phys,
                              DR_PARAM_OUT bool *from_cache)
@@ -203,41 +362,63 @@ physaddr_t::virtual2physical(void *drcontext, addr_t virt, DR_PARAM_OUT addr_t *
         // XXX i#4014: Provide a similar option that doesn't flush and just checks
         // whether mappings have changed?
         use_cache = false;
-        memset(last_vpage_, static_cast<char>(PAGE_INVALID), sizeof(last_vpage_));
-        // We do not bother to clear last_ppage_ as it is only used when
-        // last_vpage_ holds legitimate values.
+        clear_caches();
         dr_hashtable_clear(drcontext, v2p_);
         count_ = 0;
     }
+    addr_t ppage;
     if (use_cache) {
         // Use cached values on the assumption that the kernel hasn't re-mapped
         // this virtual page.
-        for (int i = 0; i < NUM_CACHE; ++i) {
-            if (vpage == last_vpage_[i]) {
+        v2p_entry_t &entry = cache_entry(vpage);
+        if (entry.vpage == vpage) {
+            if (!TESTANY(PAGE_PREFETCHED, entry.ppage)) {
                 if (from_cache != nullptr)
                     *from_cache = true;
-                *phys = last_ppage_[i] + page_offs(virt);
+                *phys = entry.ppage + page_offs(virt);
                 ++num_hit_cache_;
                 return true;
             }
+            // A prefetch may have replaced this page's returned entry, so only
+            // v2p_ knows whether the caller has seen it.
+            ppage = entry.ppage & ~PAGE_PREFETCHED;
+            entry.ppage = ppage;
+            if (dr_hashtable_lookup(drcontext, v2p_, vpage) == nullptr)
+                add_new_page(drcontext, vpage, ppage);
+            else if (from_cache != nullptr)
+                *from_cache = true;
+            *phys = ppage + page_offs(virt);
+            ++num_hit_prefetch_;
+            ++window_prefetch_hits_;
+            return true;
         }
         // XXX i#1703: add (debug-build-only) internal stats here and
         // on cache_t::request() fastpath.
         void *lookup = dr_hashtable_lookup(drcontext, v2p_, vpage);
         if (lookup != nullptr) {
-            addr_t ppage = reinterpret_cast<addr_t>(lookup);
+            ppage = reinterpret_cast<addr_t>(lookup);
             // Restore a 0 payload.
             if (ppage == ZERO_ADDR_PAYLOAD)
                 ppage = 0;
             if (from_cache != nullptr)
                 *from_cache = true;
             *phys = ppage + page_offs(virt);
-            last_vpage_[cache_idx_] = vpage;
-            last_ppage_[cache_idx_] = ppage;
-            cache_idx_ = (cache_idx_ + 1) % NUM_CACHE;
+            entry.vpage = vpage;
+            entry.ppage = ppage;
             ++num_hit_table_;
             return true;
         }
+        addr_t huge_size = page_size_ * HUGE_RUN;
+        addr_t huge_start = ALIGN_BACKWARD(vpage, huge_size);
+        const v2p_entry_t &huge = huge_cache_entry(huge_start);
+        if (huge.vpage == huge_start) {
+            ppage = huge.ppage + (vpage - huge_start);
+            add_new_page(drcontext, vpage, ppage);
+            *phys = ppage + page_offs(virt);
+            ++num_hit_huge_;
+            ++window_prefetch_hits_;
+            return true;
+        }
     }
     ++num_miss_;
     // Not cached, or forced to re-sync, so we have to read from the file.
@@ -245,39 +426,10 @@ physaddr_t::virtual2physical(void *drcontext, addr_t virt, DR_PARAM_OUT addr_t *
         NOTIFY(1, "v2p failure: file descriptor is invalid\n");
         return false;
     }
-    // The pagemap file contains one 64-bit int per page.
-    // See the docs at https://www.kernel.org/doc/Documentation/vm/pagemap.txt
-    // For huge pages it's the same: there are just N consecutive entries, with
-    // the first marked COMPOUND_HEAD and the rest COMPOUND_TAIL in the flags,
-    // which we ignore here.
-    off64_t offs = vpage / page_size_ * 8;
-    if (lseek64(fd_, offs, SEEK_SET) < 0) {
-        NOTIFY(1, "v2p failure: seek to " INT64_FORMAT_STRING " for %p failed\n", offs,
-               vpage);
+    if (!read_pagemap_run(drcontext, vpage, &ppage))
         return false;
-    }
-    uint64_t entry;
-    if (read(fd_, (char *)&entry, sizeof(entry)) != sizeof(entry)) {
-        NOTIFY(1, "v2p failure: read failed for %p\n", vpage);
-        return false;
-    }
-    NOTIFY(3, "v2p: %p => entry " HEX64_FORMAT_STRING " @ offs " INT64_FORMAT_STRING "\n",
-           vpage, entry, offs);
-    if (!TESTALL(PAGEMAP_VALID, entry) || TESTANY(PAGEMAP_SWAP, entry)) {
-        NOTIFY(1, "v2p failure: entry %p is invalid for %p in T%d\n", entry, vpage,
-               dr_get_thread_id(drcontext));
-        return false;
-    }
-    addr_t ppage = (addr_t)((entry & PAGEMAP_PFN) << page_bits_);
-    // Despite the kernel handing out a 0 PFN for unprivileged reads, 0 is a valid
-    // possible PFN.
-    // Store 0 as a sentinel since 0 means no entry.
-    dr_hashtable_add(drcontext, v2p_, vpage,
-                     reinterpret_cast<void *>(ppage == 0 ? ZERO_ADDR_PAYLOAD : ppage));
+    add_new_page(drcontext, vpage, ppage);
     *phys = ppage + page_offs(virt);
-    last_ppage_[cache_idx_] = ppage;
-    last_vpage_[cache_idx_] = vpage;
-    cache_idx_ = (cache_idx_ + 1) % NUM_CACHE;
     NOTIFY(2, "virtual %p => physical %p\n", virt, *phys);
     return true;
 #else
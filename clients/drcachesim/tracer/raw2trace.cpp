@@ -98,6 +98,25 @@ namespace drmemtrace {
 
 static online_instru_t instru(NULL, NULL, NULL);
 
+// Returns the total size of "stream" if it supports seeking, without changing its
+// position; returns 0 otherwise.  Our compressed input streams only seek within
+// their current buffer and so end up here as 0.
+static uint64_t
+get_stream_size(std::istream *stream)
+{
+    if (stream == nullptr || stream->rdbuf() == nullptr)
+        return 0;
+    std::streambuf *buf = stream->rdbuf();
+    std::streampos cur = buf->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+    if (cur == std::streampos(-1))
+        return 0;
+    std::streampos end = buf->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+    if (end == std::streampos(-1))
+        return 0;
+    buf->pubseekpos(cur, std::ios_base::in);
+    return static_cast<uint64_t>(end);
+}
+
 int
 trace_metadata_writer_t::write_thread_exit(byte *buffer, thread_id_t tid)
 {
@@ -1311,7 +1330,7 @@ raw2trace_t::process_next_thread_buffer(raw2trace_thread_data_t *tdata,
                 return false;
             }
             if (flush_decode_cache)
-                decode_cache_[tdata->worker].clear();
+                reset_decode_cache(tdata);
             if ((uint)(buf - buf_base) >= WRITE_BUFFER_SIZE) {
                 tdata->error = "Too many entries";
                 return false;
@@ -1366,7 +1385,7 @@ raw2trace_t::process_next_thread_buffer(raw2trace_thread_data_t *tdata,
         bool success = process_offline_entry(tdata, &entry, tdata->tid, end_of_record,
                                              &last_bb_handled, &flush_decode_cache);
         if (flush_decode_cache)
-            decode_cache_[tdata->worker].clear();
+            reset_decode_cache(tdata);
         if (!success)
             return false;
     }
@@ -1394,7 +1413,7 @@ raw2trace_t::process_thread_file(raw2trace_thread_data_t *tdata)
                     process_offline_entry(tdata, &entry, tdata->tid, &end_of_file,
                                           &last_bb_handled, &flush_decode_cache);
                 if (flush_decode_cache)
-                    decode_cache_[tdata->worker].clear();
+                    reset_decode_cache(tdata);
                 if (!end_of_file) {
                     tdata->error = "Synthetic footer failed";
                     return false;
@@ -1461,22 +1480,40 @@ raw2trace_t::check_kthread_file(std::istream *f)
 #endif
 
 void
-raw2trace_t::process_tasks(std::vector<raw2trace_thread_data_t *> *tasks)
+raw2trace_t::process_tasks(int worker)
 {
-    if (tasks->empty()) {
-        VPRINT(1, "Worker has no tasks\n");
-        return;
-    }
-    VPRINT(1, "Worker %d assigned %zd task(s)\n", (*tasks)[0]->worker, tasks->size());
-    for (raw2trace_thread_data_t *tdata : *tasks) {
-        VPRINT(1, "Worker %d starting on trace thread %d\n", tdata->worker, tdata->index);
+    int count = 0;
+    while (!task_error_.load(std::memory_order_acquire)) {
+        size_t next = next_task_.fetch_add(1, std::memory_order_relaxed);
+        if (next >= tasks_.size())
+            break;
+        raw2trace_thread_data_t *tdata = tasks_[next];
+        tdata->worker = worker;
+        ++count;
+        VPRINT(1,
+               "Worker %d starting on trace thread %d (" UINT64_FORMAT_STRING
+               " bytes)\n",
+               worker, tdata->index, tdata->thread_file_size);
         if (!process_thread_file(tdata)) {
-            VPRINT(1, "Worker %d hit error %s on trace thread %d\n", tdata->worker,
+            VPRINT(1, "Worker %d hit error %s on trace thread %d\n", worker,
                    tdata->error.c_str(), tdata->index);
+            task_error_.store(true, std::memory_order_release);
             break;
         }
-        VPRINT(1, "Worker %d finished trace thread %d\n", tdata->worker, tdata->index);
+        VPRINT(1, "Worker %d finished trace thread %d\n", worker, tdata->index);
+    }
+    VPRINT(1, "Worker %d processed %d task(s)\n", worker, count);
+}
+
+void
+raw2trace_t::set_thread_file_sizes(const std::vector<uint64_t> &sizes)
+{
+    if (sizes.size() != thread_data_.size()) {
+        VPRINT(0, "Thread file size list does not match the input file list\n");
+        return;
     }
+    for (size_t i = 0; i < thread_data_.size(); ++i)
+        thread_data_[i]->thread_file_size = sizes[i];
 }
 
 // XXX i#6495: This assumes that all contents of the file can easily fit into memory.
@@ -1567,14 +1604,27 @@ raw2trace_t::do_conversion()
             syscall_traces_injected_ += thread_data_[i]->syscall_traces_injected;
         }
     } else {
-        // The files can be converted concurrently.
+        // The files can be converted concurrently.  Rather than a static split,
+        // which leaves workers idle when thread lengths are skewed, the workers pull
+        // from a shared queue with the largest files first (the classic
+        // longest-processing-time heuristic).  A stable sort keeps the original order
+        // among files of equal or unknown size.
+        tasks_.clear();
+        for (auto &tdata : thread_data_)
+            tasks_.push_back(tdata.get());
+        std::stable_sort(tasks_.begin(), tasks_.end(),
+                         [](const raw2trace_thread_data_t *l,
+                            const raw2trace_thread_data_t *r) {
+                             return l->thread_file_size > r->thread_file_size;
+                         });
+        next_task_.store(0, std::memory_order_relaxed);
+        task_error_.store(false, std::memory_order_relaxed);
+        int num_workers = std::min(worker_count_, static_cast<int>(tasks_.size()));
         std::vector<std::thread> threads;
-        VPRINT(1, "Creating %d worker threads\n", worker_count_);
-        threads.reserve(worker_count_);
-        for (int i = 0; i < worker_count_; ++i) {
-            threads.push_back(
-                std::thread(&raw2trace_t::process_tasks, this, &worker_tasks_[i]));
-        }
+        VPRINT(1, "Creating %d worker threads\n", num_workers);
+        threads.reserve(num_workers);
+        for (int i = 0; i < num_workers; ++i)
+            threads.push_back(std::thread(&raw2trace_t::process_tasks, this, i));
         for (std::thread &thread : threads)
             thread.join();
         for (auto &tdata : thread_data_) {
@@ -2810,7 +2860,8 @@ raw2trace_t::lookup_block_summary(raw2trace_thread_data_t *tdata, uint64 modidx,
                tdata->last_block_summary, tdata->last_decode_block_start);
         return tdata->last_block_summary;
     }
-    block_summary_t *ret = decode_cache_[tdata->worker].lookup(modidx, modoffs);
+    block_summary_t *ret =
+        decode_cache_.lookup(modidx, modoffs, get_decode_cache_mode(tdata));
     if (ret != nullptr) {
         DEBUG_ASSERT(ret->start_pc == block_start);
         tdata->last_decode_block_start = block_start;
@@ -2858,7 +2909,10 @@ raw2trace_t::create_instr_summary(raw2trace_thread_data_t *tdata, uint64 modidx,
     if (block == nullptr) {
         block = new block_summary_t(block_start, instr_count);
         DEBUG_ASSERT(index >= 0 && index < static_cast<int>(block->instrs.size()));
-        decode_cache_[tdata->worker].add(modidx, modoffs, block);
+        // Other threads may only see the block once it is complete: until then it
+        // is reached only through our last_block_summary.  Any prior incomplete
+        // block (from an interrupted execution) is discarded here.
+        tdata->pending_block_summary.reset(block);
         VPRINT(5,
                "Created new block summary " PFX " for " PFX " modidx=" INT64_FORMAT_STRING
                " modoffs=" HEX64_FORMAT_STRING "\n",
@@ -2886,16 +2940,69 @@ raw2trace_t::get_instr_summary(raw2trace_thread_data_t *tdata, uint64 modidx,
                                int index, DR_PARAM_INOUT app_pc *pc, app_pc orig)
 {
     block_summary_t *block;
-    const instr_summary_t *ret =
+    instr_summary_t *ret =
         lookup_instr_summary(tdata, modidx, modoffs, block_start, index, *pc, &block);
     if (ret == nullptr) {
-        return create_instr_summary(tdata, modidx, modoffs, block, block_start,
-                                    instr_count, index, pc, orig);
-    }
-    *pc = ret->next_pc();
+        ret = create_instr_summary(tdata, modidx, modoffs, block, block_start,
+                                   instr_count, index, pc, orig);
+        if (ret == nullptr)
+            return nullptr;
+    } else
+        *pc = ret->next_pc();
+    // We walk blocks in order, after any out-of-order elision flags were set up
+    // front, so a new block is complete once we reach its final instruction.
+    if (index == instr_count - 1 && tdata->pending_block_summary != nullptr &&
+        tdata->pending_block_summary.get() == tdata->last_block_summary)
+        ret = publish_block_summary(tdata, index);
     return ret;
 }
 
+instr_summary_t *
+raw2trace_t::publish_block_summary(raw2trace_thread_data_t *tdata, int index)
+{
+    block_summary_t *block = tdata->last_block_summary;
+    DEBUG_ASSERT(block != nullptr && block == tdata->pending_block_summary.get());
+    for (const instr_summary_t &instr : block->instrs) {
+        if (instr.pc() == nullptr)
+            return &block->instrs[index];
+    }
+    block = decode_cache_.add(tdata->last_decode_modidx, tdata->last_decode_modoffs,
+                              get_decode_cache_mode(tdata),
+                              tdata->pending_block_summary.release());
+    VPRINT(5, "Published block summary " PFX " for " PFX "\n", block,
+           tdata->last_decode_block_start);
+    tdata->last_block_summary = block;
+    return &block->instrs[index];
+}
+
+uint
+raw2trace_t::get_decode_cache_mode(raw2trace_thread_data_t *tdata)
+{
+    // Filtered traces have a block summary per instruction, which must not be
+    // confused with a whole-block summary after a filter endpoint.
+    uint mode = TESTANY(OFFLINE_FILE_TYPE_FILTERED | OFFLINE_FILE_TYPE_IFILTERED,
+                        get_file_type(tdata))
+        ? 1
+        : 0;
+#ifdef AARCH64
+    // Some SVE instructions decode differently depending on the vector length.
+    mode |= (dr_get_vector_length() / 128) << 1;
+#endif
+    return mode;
+}
+
+void
+raw2trace_t::reset_decode_cache(raw2trace_thread_data_t *tdata)
+{
+    // The shared table keys on the mode, so we only need to drop our own
+    // references to summaries from the prior mode.
+    tdata->last_decode_block_start = nullptr;
+    tdata->last_decode_modidx = 0;
+    tdata->last_decode_modoffs = 0;
+    tdata->last_block_summary = nullptr;
+    tdata->pending_block_summary.reset();
+}
+
 // These flags are difficult to set on construction: because one instr_t may have
 // multiple flags, we'd need get_instr_summary() to take in a vector or sthg.
 // Instead we set after the fact.
@@ -3709,6 +3816,8 @@ raw2trace_t::raw2trace_t(
     : dcontext_(dcontext == nullptr ? dr_standalone_init() : dcontext)
     , passed_dcontext_(dcontext != nullptr)
     , worker_count_(worker_count)
+    , next_task_(0)
+    , task_error_(false)
     , user_process_(nullptr)
     , user_process_data_(nullptr)
     , modmap_bytes_(module_map)
@@ -3743,6 +3852,7 @@ raw2trace_t::raw2trace_t(
             std::unique_ptr<raw2trace_thread_data_t>(new raw2trace_thread_data_t);
         thread_data_[i]->index = static_cast<int>(i);
         thread_data_[i]->thread_file = thread_files[i];
+        thread_data_[i]->thread_file_size = get_stream_size(thread_files[i]);
         if (out_files.empty()) {
             thread_data_[i]->out_archive = out_archives[i];
             // Set out_file too for code that doesn't care which it writes to.
@@ -3753,29 +3863,11 @@ raw2trace_t::raw2trace_t(
             thread_data_[i]->out_file = out_files[i];
         }
     }
-    // Since we know the traced-thread count up front, we use a simple round-robin
-    // static work assignment.  This won't be as load balanced as a dynamic work
-    // queue but it is much simpler.
-    if (worker_count_ < 0) {
+    // Work is handed out dynamically in do_conversion().
+    // The decode cache is shared among the workers, so its size does not grow with
+    // the worker count and we can use every core by default.
+    if (worker_count_ < 0)
         worker_count_ = std::thread::hardware_concurrency();
-        if (worker_count_ > kDefaultJobMax)
-            worker_count_ = kDefaultJobMax;
-    }
-    int cache_count = worker_count_;
-    if (worker_count_ > 0) {
-        worker_tasks_.resize(worker_count_);
-        int worker = 0;
-        for (size_t i = 0; i < thread_data_.size(); ++i) {
-            VPRINT(2, "Worker %d assigned trace thread %zd\n", worker, i);
-            worker_tasks_[worker].push_back(thread_data_[i].get());
-            thread_data_[i]->worker = worker;
-            worker = (worker + 1) % worker_count_;
-        }
-    } else
-        cache_count = 1;
-    decode_cache_.reserve(cache_count);
-    for (int i = 0; i < cache_count; ++i)
-        decode_cache_.emplace_back(cache_count);
 }
 
 raw2trace_t::~raw2trace_t()
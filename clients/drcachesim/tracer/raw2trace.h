@@ -54,6 +54,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <string>
@@ -91,6 +92,10 @@ namespace drmemtrace {
 #    define TRACE_SUFFIX_LZ4 "trace.lz4"
 #endif
 
+#ifdef HAS_ZSTD
+#    define TRACE_SUFFIX_ZSTD "trace.zst"
+#endif
+
 #ifdef HAS_ZIP
 #    define TRACE_SUFFIX_ZIP "trace.zip"
 #endif
@@ -833,6 +838,18 @@ public:
                                                  void *user_data),
                        void *process_cb_user_data, void (*free_cb)(void *data));
 
+    /**
+     * Supplies the size in bytes of each of the thread_files passed to the
+     * constructor, in the same order.  Worker threads pick up the largest remaining
+     * file first, so that one long thread started late does not leave every other
+     * worker idle at the end of do_conversion().  Without this call the sizes are
+     * obtained by seeking the input streams where that is supported (compressed
+     * streams generally do not support it, and are then treated as equal in size).
+     * Must be called prior to do_conversion().
+     */
+    void
+    set_thread_file_sizes(const std::vector<uint64_t> &sizes);
+
     /**
      * Performs the first step of do_conversion() without further action: parses and
      * iterates over the list of modules.  This is provided to give the user a method
@@ -991,6 +1008,8 @@ protected:
         thread_id_t tid;
         int worker;
         std::istream *thread_file;
+        // Used to order the work queue; 0 if unknown.
+        uint64_t thread_file_size = 0;
         archive_ostream_t *out_archive; // May be nullptr.
         std::ostream *out_file;         // Always set; for archive, == "out_archive".
         std::string error;
@@ -1026,6 +1045,9 @@ protected:
         uint64 last_decode_modidx;
         uint64 last_decode_modoffs;
         block_summary_t *last_block_summary;
+        // A block summary still being filled in, which is not yet visible to other
+        // threads.  It is added to the shared decode_cache_ once complete.
+        std::unique_ptr<block_summary_t> pending_block_summary;
         uint64 last_window = 0;
 
         // Statistics on the processing.
@@ -1388,6 +1410,19 @@ private:
     create_instr_summary(raw2trace_thread_data_t *tdata, uint64 modidx, uint64 modoffs,
                          block_summary_t *block, app_pc block_start, int instr_count,
                          int index, DR_PARAM_INOUT app_pc *pc, app_pc orig);
+    // Adds the thread's pending block summary to the shared decode_cache_ if every
+    // instruction in it has been filled in.  Returns the index-th instruction of
+    // the block that ends up in the cache, which may be one added by another thread.
+    instr_summary_t *
+    publish_block_summary(raw2trace_thread_data_t *tdata, int index);
+    // Returns the part of the decode_cache_ key which distinguishes block summaries
+    // that cannot be shared between threads in different states.
+    uint
+    get_decode_cache_mode(raw2trace_thread_data_t *tdata);
+    // Called when the thread's decode state changes such that its prior block
+    // summaries may no longer apply.
+    void
+    reset_decode_cache(raw2trace_thread_data_t *tdata);
 
     // Return the #instr_summary_t representation of the index-th instruction (at *pc)
     // inside the block that begins at block_start_pc and contains instr_count
@@ -1460,7 +1495,7 @@ private:
     process_thread_file(raw2trace_thread_data_t *tdata);
 
     void
-    process_tasks(std::vector<raw2trace_thread_data_t *> *tasks);
+    process_tasks(int worker);
 
     bool
     emit_new_chunk_header(raw2trace_thread_data_t *tdata);
@@ -1511,7 +1546,11 @@ private:
     should_omit_syscall(raw2trace_thread_data_t *tdata);
 
     int worker_count_;
-    std::vector<std::vector<raw2trace_thread_data_t *>> worker_tasks_;
+    // Shared by all workers, sorted largest first, and consumed by incrementing
+    // next_task_.  Once any worker hits an error no further tasks are started.
+    std::vector<raw2trace_thread_data_t *> tasks_;
+    std::atomic<size_t> next_task_;
+    std::atomic<bool> task_error_;
 
     class block_hashtable_t {
         // We use a hashtable to cache decodings.  We compared the performance of
@@ -1523,92 +1562,112 @@ private:
         // the hashtable performance matters much less.
         // Plus, for 32-bit we cannot fit our modidx:modoffs key in the 32-bit-limited
         // hashtable_t key, so we now use std::unordered_map there.
+        //
+        // A single table is shared by all worker threads.  It is split into shards,
+        // each with its own lock, to keep contention low.  Blocks are only added once
+        // complete and are never modified afterward, so the block returned by lookup()
+        // can be used without holding any lock.
     public:
-        explicit block_hashtable_t(int worker_count)
+        block_hashtable_t()
         {
+            for (shard_t &shard : shards_) {
 #ifdef X64
-            // We go ahead and start with a reasonably large capacity.
-            // We do not want the built-in mutex: this is per-worker so it can be
-            // lockless.
-            hashtable_init_ex(&table, 16, HASH_INTPTR, false, false, free_payload,
-                              nullptr, nullptr);
-            // We pay a little memory to get a lower load factor, unless we have
-            // many duplicated tables.
-            hashtable_config_t config = { sizeof(config), true,
-                                          worker_count <= 8
-                                              ? 40U
-                                              : (worker_count <= 16 ? 50U : 60U) };
-            hashtable_configure(&table, &config);
+                // We do not want the built-in mutex as we need our lock to cover
+                // the insert-once check in add().
+                hashtable_init_ex(&shard.table, 12, HASH_INTPTR, false, false,
+                                  free_payload, nullptr, nullptr);
+                // We pay a little memory to get a lower load factor.
+                hashtable_config_t config = { sizeof(config), true, 40U };
+                hashtable_configure(&shard.table, &config);
 #endif
+            }
         }
-#ifdef X64
         ~block_hashtable_t()
         {
-            hashtable_delete(&table);
+#ifdef X64
+            for (shard_t &shard : shards_)
+                hashtable_delete(&shard.table);
+#endif
         }
-#else
-        // Work around a known Visual Studio issue where it complains about deleted copy
-        // constructors for unique_ptr by deleting our copies and defaulting our moves.
         block_hashtable_t(const block_hashtable_t &) = delete;
         block_hashtable_t &
         operator=(const block_hashtable_t &) = delete;
-        block_hashtable_t(block_hashtable_t &&) = default;
-        block_hashtable_t &
-        operator=(block_hashtable_t &&) = default;
-#endif
+
         block_summary_t *
-        lookup(uint64 modidx, uint64 modoffs)
+        lookup(uint64 modidx, uint64 modoffs, uint mode)
         {
+            uint64 key = hash_key(modidx, modoffs, mode);
+            shard_t &shard = get_shard(key);
+            std::lock_guard<std::mutex> guard(shard.lock);
 #ifdef X64
-            return static_cast<block_summary_t *>(hashtable_lookup(
-                &table, reinterpret_cast<void *>(hash_key(modidx, modoffs))));
+            return static_cast<block_summary_t *>(
+                hashtable_lookup(&shard.table, reinterpret_cast<void *>(key)));
 #else
-            return table[hash_key(modidx, modoffs)].get();
+            auto it = shard.table.find(key);
+            return it == shard.table.end() ? nullptr : it->second.get();
 #endif
         }
-        // Takes ownership of "block".
-        void
-        add(uint64 modidx, uint64 modoffs, block_summary_t *block)
+        // Takes ownership of "block".  If another thread already added a block for
+        // this key, "block" is deleted and the existing block is returned instead.
+        block_summary_t *
+        add(uint64 modidx, uint64 modoffs, uint mode, block_summary_t *block)
         {
+            uint64 key = hash_key(modidx, modoffs, mode);
+            shard_t &shard = get_shard(key);
+            std::lock_guard<std::mutex> guard(shard.lock);
 #ifdef X64
-            hashtable_add(&table, reinterpret_cast<void *>(hash_key(modidx, modoffs)),
-                          block);
+            void *existing =
+                hashtable_lookup(&shard.table, reinterpret_cast<void *>(key));
+            if (existing != nullptr) {
+                delete block;
+                return static_cast<block_summary_t *>(existing);
+            }
+            hashtable_add(&shard.table, reinterpret_cast<void *>(key), block);
 #else
-            table[hash_key(modidx, modoffs)].reset(block);
+            auto it = shard.table.find(key);
+            if (it != shard.table.end()) {
+                delete block;
+                return it->second.get();
+            }
+            shard.table[key].reset(block);
 #endif
+            return block;
         }
 
-        void
-        clear()
-        {
+    private:
+        static const int kShardBits = 6;
+        struct shard_t {
+            std::mutex lock;
 #ifdef X64
-            hashtable_clear(&table);
+            hashtable_t table;
 #else
-            table.clear();
+            std::unordered_map<uint64, std::unique_ptr<block_summary_t>> table;
 #endif
-        }
+        };
 
-    private:
         static void
         free_payload(void *ptr)
         {
             delete (static_cast<block_summary_t *>(ptr));
         }
+        // The decode mode goes in the top bits, above modidx:modoffs.
         static inline uint64
-        hash_key(uint64 modidx, uint64 modoffs)
+        hash_key(uint64 modidx, uint64 modoffs, uint mode)
+        {
+            return (static_cast<uint64>(mode) << (PC_MODIDX_BITS + PC_MODOFFS_BITS)) |
+                (modidx << PC_MODOFFS_BITS) | modoffs;
+        }
+        shard_t &
+        get_shard(uint64 key)
         {
-            return (modidx << PC_MODOFFS_BITS) | modoffs;
+            // Nearby blocks share high bits, so we mix before picking a shard.
+            return shards_[(key * 0x9e3779b97f4a7c15ULL) >> (64 - kShardBits)];
         }
 
-#ifdef X64
-        hashtable_t table;
-#else
-        std::unordered_map<uint64, std::unique_ptr<block_summary_t>> table;
-#endif
+        shard_t shards_[1 << kShardBits];
     };
 
-    // We use a per-worker cache to avoid locks.
-    std::vector<block_hashtable_t> decode_cache_;
+    block_hashtable_t decode_cache_;
 
     // Store optional parameters for the module_mapper_t until we need to construct it.
     const char *(*user_parse_)(const char *src, DR_PARAM_OUT void **data) = nullptr;
@@ -1626,10 +1685,6 @@ private:
 
     std::string alt_module_dir_;
 
-    // Our decode_cache duplication will not scale forever on very large code
-    // footprint traces, so we set a cap for the default.
-    static const int kDefaultJobMax = 16;
-
     // Chunking for seeking support in compressed files.
     uint64_t chunk_instr_count_ = 0;
 
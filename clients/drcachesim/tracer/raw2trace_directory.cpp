@@ -76,6 +76,11 @@
 #    include "common/lz4_istream.h"
 #    include "common/lz4_ostream.h"
 #endif
+#ifdef HAS_ZSTD
+#    include "common/zstd_istream.h"
+#    include "common/instr_table_ostream.h"
+#    include "common/zstd_ostream.h"
+#endif
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -143,6 +148,10 @@ raw2trace_directory_t::trace_suffix()
     } else if (compress_type_ == "lz4") {
 #ifdef HAS_LZ4
         return TRACE_SUFFIX_LZ4;
+#endif
+    } else if (compress_type_ == "zstd" || compress_type_ == "zstd_itable") {
+#ifdef HAS_ZSTD
+        return TRACE_SUFFIX_ZSTD;
 #endif
     }
     return TRACE_SUFFIX;
@@ -209,6 +218,19 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
         }
     }
 #endif
+#ifdef HAS_ZSTD
+    bool is_zstd = false;
+    if (strlen(basename) > strlen(OUTFILE_SUFFIX_ZSTD) + 1) {
+        if (basename_pre_suffix == nullptr) {
+            basename_pre_suffix =
+                strstr(basename + strlen(basename) - strlen(OUTFILE_SUFFIX_ZSTD),
+                       OUTFILE_SUFFIX_ZSTD);
+            if (basename_pre_suffix != nullptr) {
+                is_zstd = true;
+            }
+        }
+    }
+#endif
 
     if (basename_pre_suffix == nullptr)
         basename_pre_suffix = strstr(basename_dot, OUTFILE_SUFFIX);
@@ -239,10 +261,26 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
             return "Internal Error in determining input file type.";
         ifile = new lz4_istream_t(path);
     }
+#endif
+#ifdef HAS_ZSTD
+    if (is_zstd) {
+        if (ifile != nullptr)
+            return "Internal Error in determining input file type.";
+        ifile = new zstd_istream_t(path);
+    }
 #endif
     if (ifile == nullptr)
         ifile = new std::ifstream(path, std::ifstream::binary);
     in_files_.push_back(ifile);
+    // The streams do not all support seeking so we query the file itself.
+    uint64 size = 0;
+    file_t size_fd = dr_open_file(path, DR_FILE_READ);
+    if (size_fd != INVALID_FILE) {
+        if (!dr_file_size(size_fd, &size))
+            size = 0;
+        dr_close_file(size_fd);
+    }
+    in_file_sizes_.push_back(size);
     if (!(*in_files_.back()))
         return "Failed to open thread log file " + std::string(path);
     std::string error = raw2trace_t::check_thread_file(in_files_.back());
@@ -274,6 +312,22 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
         VPRINT(1, "Opened output file %s\n", path);
         return "";
 #endif
+    } else if (compress_type_ == "zstd" || compress_type_ == "zstd_itable") {
+#ifdef HAS_ZSTD
+        // Like zip, one frame per chunk, with an index for seeking to a chunk.
+        ofile = new zstd_ostream_t(path);
+        if (compress_type_ == "zstd_itable") {
+            // Each distinct instruction is stored once in a final component and
+            // each fetch becomes a small index into it.
+            ofile = new instr_table_ostream_t(reinterpret_cast<zstd_ostream_t *>(ofile));
+        }
+        out_archives_.push_back(reinterpret_cast<archive_ostream_t *>(ofile));
+        if (!(*out_archives_.back()))
+            return "Failed to open output file " + std::string(path);
+
+        VPRINT(1, "Opened output file %s\n", path);
+        return "";
+#endif
     } else if (compress_type_ == "gzip") {
 #ifdef HAS_ZLIB
         ofile = new gzip_ostream_t(path);
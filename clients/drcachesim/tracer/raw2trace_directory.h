@@ -102,6 +102,8 @@ public:
     char *modfile_bytes_;
     file_t encoding_file_;
     std::vector<std::istream *> in_files_;
+    // On-disk sizes of in_files_, for raw2trace_t::set_thread_file_sizes().
+    std::vector<uint64_t> in_file_sizes_;
     std::vector<std::ostream *> out_files_;
     std::vector<archive_ostream_t *> out_archives_;
     std::ostream *serial_schedule_file_ = nullptr;
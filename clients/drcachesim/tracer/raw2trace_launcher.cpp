@@ -92,11 +92,22 @@ static droption_t<int>
 
 static droption_t<std::string> op_trace_compress(
     DROPTION_SCOPE_FRONTEND, "compress", DEFAULT_TRACE_COMPRESSION_TYPE,
-    "Trace compression: \"zip\",\"gzip\",\"zlib\",\"lz4\",\"none\"",
-    "Specifies the compression type to use for trace files: \"zip\", "
-    "\"gzip\", \"zlib\", \"lz4\", or \"none\". "
+    "Trace compression: \"zip\",\"zstd\",\"zstd_itable\",\"gzip\",\"zlib\",\"lz4\","
+    "\"none\"",
+    "Specifies the compression type to use for trace files: \"zip\", \"zstd\", "
+    "\"zstd_itable\", \"gzip\", \"zlib\", \"lz4\", or \"none\". "
     "In most cases where fast skipping by instruction count is not needed "
     "lz4 compression generally improves performance and is recommended. "
+    "Like zip, zstd stores each chunk (see -chunk_instr_count) separately and so "
+    "supports fast skipping, while compressing better than zip and decompressing "
+    "several times faster. "
+    "\"zstd_itable\" is zstd with each distinct instruction (its address, length, "
+    "type, and encoding) stored once in a table in the archive, with each "
+    "instruction fetch in the trace written as a small delta-encoded index into "
+    "that table, and with each data address written in a separate column as the "
+    "difference from the prior execution of the same instruction.  This usually "
+    "produces much smaller traces than plain zstd and is transparent to trace "
+    "readers. "
     "When it comes to storage types, the impact on overhead varies: "
     "for SSDs, zip and gzip often increase overhead and should only be chosen "
     "if space is limited.");
@@ -145,6 +156,7 @@ _tmain(int argc, const TCHAR *targv[])
                           op_verbose.get_value(), op_jobs.get_value(),
                           op_alt_module_dir.get_value(), op_chunk_instr_count.get_value(),
                           dir.in_kfiles_map_, dir.kcoredir_, dir.kallsymsdir_);
+    raw2trace.set_thread_file_sizes(dir.in_file_sizes_);
     std::string error = raw2trace.do_conversion();
     if (!error.empty())
         FATAL_ERROR("Conversion failed: %s", error.c_str());
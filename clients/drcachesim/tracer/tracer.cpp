@@ -41,6 +41,9 @@
 
 #include <string.h>
 #include <sys/types.h>
+#ifdef UNIX
+#    include <signal.h>
+#endif
 
 #include <atomic>
 #include <cstdarg>
@@ -68,6 +71,9 @@
 #include "output.h"
 #include "physaddr.h"
 #include "raw2trace_shared.h"
+#ifdef LINUX
+#    include "shm_ring.h"
+#endif
 #include "reader.h"
 #include "trace_entry.h"
 #include "utils.h"
@@ -127,6 +133,10 @@ size_t trace_buf_size;
  */
 size_t redzone_size;
 size_t max_buf_size;
+/* With -buffer_guard, an inaccessible guard region of this size follows the
+ * redzone, and a block's final load faults into it once the buffer is full.
+ */
+size_t buf_guard_size;
 
 std::atomic<uint64> attached_timestamp;
 
@@ -148,6 +158,12 @@ typedef struct {
 
 /* For online simulation, we write to a single global pipe */
 named_pipe_t ipc_pipe;
+#ifdef LINUX
+/* ...or with -ipc_shm, to shared memory rings mapped from the reader's file. */
+shm_ring_t ipc_shm;
+static void *ipc_shm_map;
+static size_t ipc_shm_map_size;
+#endif
 
 #define MAX_INSTRU_SIZE 256 /* The max instance size of instru_t or its children. */
 instru_t *instru;
@@ -160,6 +176,9 @@ static uint64 num_refs;      /* keep a global memory reference count */
 static uint64 num_writeouts;
 static uint64 num_v2p_writeouts;
 static uint64 num_phys_markers;
+static uint64 num_v2p_hits;
+static uint64 num_v2p_misses;
+static uint64 num_v2p_pagemap_reads;
 
 static drmgr_priority_t pri_pre_bbdup = { sizeof(drmgr_priority_t),
                                           DRMGR_PRIORITY_NAME_MEMTRACE, NULL, NULL,
@@ -504,6 +523,7 @@ event_post_attach()
 static void
 event_pre_detach()
 {
+    detach_async_io();
     if (align_attach_detach_endpoints()) {
         NOTIFY(1, "Switching to no-tracing mode during detach\n");
         // Keep all final thread output at the detach timestamp.
@@ -811,7 +831,7 @@ instrument_clean_call(void *drcontext, instrlist_t *ilist, instr_t *where,
     DR_ASSERT(reg_ptr == DR_REG_XCX);
     /* i#2049: we use DR_CLEANCALL_ALWAYS_OUT_OF_LINE to ensure our jecxz
      * reaches across the clean call (o/w we need 2 jmps to invert the jecxz).
-     * Long-term we should try a fault instead (xref drx_buf) or a lean
+     * -buffer_guard uses a fault instead (xref drx_buf); we could also try a lean
      * proc to clean call gencode.
      */
     /* i#2147: -prof_pcs adds extra cleancall code that makes jecxz not reach.
@@ -869,6 +889,100 @@ instrument_clean_call(void *drcontext, instrlist_t *ilist, instr_t *where,
                                    app_regs_at_skip_thread);
 }
 
+/* The -buffer_guard replacement for instrument_clean_call(): a load from one
+ * redzone's distance past the buffer pointer, which lands in the guard region
+ * exactly when the pointer has reached the redzone.  The loaded value is
+ * discarded, as reg_ptr is dead here.  The probe is followed by a jump over an
+ * out-of-line clean call that is only reached via handle_buffer_guard_fault().
+ */
+static void
+insert_buffer_guard_probe(void *drcontext, instrlist_t *ilist, instr_t *where,
+                          instr_t *app, reg_id_t reg_ptr, uintptr_t mode)
+{
+#ifdef X86
+    // The filter path reloads the buffer pointer, which is null for filtered threads.
+    reg_id_t reg_tmp = DR_REG_NULL;
+    instr_t *skip_thread = INSTR_CREATE_label(drcontext);
+    reg_id_set_t app_regs_at_skip_thread;
+    bool is_L0I_enabled, is_L0D_enabled;
+    get_L0_filters_enabled(mode, &is_L0I_enabled, &is_L0D_enabled);
+    if ((is_L0I_enabled || is_L0D_enabled) && thread_filtering_enabled) {
+        insert_conditional_skip(drcontext, ilist, where, reg_ptr, &reg_tmp, skip_thread,
+                                true, app_regs_at_skip_thread);
+    }
+    instr_t *probe =
+        XINST_CREATE_load(drcontext, opnd_create_reg(reg_ptr),
+                          OPND_CREATE_MEMPTR(reg_ptr, static_cast<int>(redzone_size)));
+    // The fault handler needs a translation to be able to examine the fault.
+    instr_set_translation(probe, instr_get_app_pc(app));
+    MINSERT(ilist, where, probe);
+    instr_t *skip_call = INSTR_CREATE_label(drcontext);
+    // i#2147: -prof_pcs makes the clean call too long for a short jump.
+    MINSERT(ilist, where,
+            dr_is_tracking_where_am_i()
+                ? XINST_CREATE_jump(drcontext, opnd_create_instr(skip_call))
+                : XINST_CREATE_jump_short(drcontext, opnd_create_instr(skip_call)));
+    dr_insert_clean_call_ex(drcontext, ilist, where, (void *)clean_call,
+                            DR_CLEANCALL_ALWAYS_OUT_OF_LINE, 0);
+    MINSERT(ilist, where, skip_call);
+    insert_conditional_skip_target(drcontext, ilist, where, skip_thread, reg_tmp,
+                                   app_regs_at_skip_thread);
+#else
+    DR_ASSERT_MSG(false, "-buffer_guard is x86-only");
+#endif
+}
+
+/* Handles a fault from insert_buffer_guard_probe() by resuming at the clean
+ * call that the jump after the probe skips.  Like drx_buf we only adjust the
+ * machine context here: the buffer is written out by that clean call, outside
+ * of the signal or exception handler.  Returns false if the fault is not ours.
+ */
+static bool
+handle_buffer_guard_fault(void *drcontext, byte *target, dr_mcontext_t *raw_mcontext)
+{
+    per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    if (data == NULL || data->buf_base == NULL || raw_mcontext->pc == target)
+        return false;
+    byte *guard_start = data->buf_base + max_buf_size;
+    if (target < guard_start || target >= guard_start + buf_guard_size)
+        return false;
+    app_pc jump_pc = decode_next_pc(drcontext, raw_mcontext->pc);
+    if (jump_pc == NULL)
+        return false;
+    instr_t jump;
+    instr_init(drcontext, &jump);
+    app_pc call_pc = decode(drcontext, jump_pc, &jump);
+    bool is_ours = call_pc != NULL && instr_is_ubr(&jump);
+    instr_free(drcontext, &jump);
+    if (!is_ours)
+        return false;
+    raw_mcontext->pc = call_pc;
+    return true;
+}
+
+#ifdef WINDOWS
+static bool
+event_exception(void *drcontext, dr_exception_t *excpt)
+{
+    if (excpt->record->ExceptionCode != STATUS_ACCESS_VIOLATION)
+        return true;
+    // The second entry holds the target address.
+    return !handle_buffer_guard_fault(
+        drcontext, (byte *)excpt->record->ExceptionInformation[1], excpt->raw_mcontext);
+}
+#else
+static dr_signal_action_t
+event_signal(void *drcontext, dr_siginfo_t *info)
+{
+    if (info->sig != SIGSEGV || !info->raw_mcontext_valid)
+        return DR_SIGNAL_DELIVER;
+    return handle_buffer_guard_fault(drcontext, info->access_address,
+                                     info->raw_mcontext)
+        ? DR_SIGNAL_SUPPRESS
+        : DR_SIGNAL_DELIVER;
+}
+#endif
+
 // Called before writing to the trace buffer.
 // reg_ptr is treated as scratch and may be clobbered by this routine.
 // Returns DR_REG_NULL to indicate *not* to insert the instrumentation to
@@ -1378,7 +1492,10 @@ event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst
     if (is_last_instr(drcontext, instr)) {
         if ((is_L0I_enabled || is_L0D_enabled))
             insert_load_buf_ptr(drcontext, bb, where, reg_ptr);
-        instrument_clean_call(drcontext, bb, where, reg_ptr, mode);
+        if (buf_guard_size > 0)
+            insert_buffer_guard_probe(drcontext, bb, where, instr, reg_ptr, mode);
+        else
+            instrument_clean_call(drcontext, bb, where, reg_ptr, mode);
     }
 
     insert_conditional_skip_target(drcontext, bb, where, skip_instru, reg_skip,
@@ -1873,10 +1990,17 @@ event_thread_exit(void *drcontext)
         num_writeouts += data->num_writeouts;
         num_v2p_writeouts += data->num_v2p_writeouts;
         num_phys_markers += data->num_phys_markers;
+        if (op_use_physical.get_value()) {
+            uint64_t hits, misses, pagemap_reads;
+            data->physaddr.get_stats(&hits, &misses, &pagemap_reads);
+            num_v2p_hits += hits;
+            num_v2p_misses += misses;
+            num_v2p_pagemap_reads += pagemap_reads;
+        }
         dr_mutex_unlock(mutex);
-        dr_raw_mem_free(data->buf_base, max_buf_size);
+        dr_raw_mem_free(data->buf_base, max_buf_size + buf_guard_size);
         if (data->reserve_buf != NULL)
-            dr_raw_mem_free(data->reserve_buf, max_buf_size);
+            dr_raw_mem_free(data->reserve_buf, max_buf_size + buf_guard_size);
     }
     data->~per_thread_t();
     dr_thread_free(drcontext, data, sizeof(per_thread_t));
@@ -1915,6 +2039,11 @@ event_exit(void)
                "drmemtrace emitted " UINT64_FORMAT_STRING
                " physical address markers in " UINT64_FORMAT_STRING " writeouts.\n",
                num_phys_markers, num_v2p_writeouts);
+        NOTIFY(1,
+               "drmemtrace physical translations: " UINT64_FORMAT_STRING
+               " hits, " UINT64_FORMAT_STRING " misses, " UINT64_FORMAT_STRING
+               " pagemap reads.\n",
+               num_v2p_hits, num_v2p_misses, num_v2p_pagemap_reads);
     }
     /* we use placement new for better isolation */
     instru->~instru_t();
@@ -1926,6 +2055,12 @@ event_exit(void)
             file_ops_func.close_file(funclist_file);
         if (encoding_file != INVALID_FILE)
             file_ops_func.close_file(encoding_file);
+    } else if (op_ipc_shm.get_value()) {
+#ifdef LINUX
+        // Our threads' final chunks are already in the rings.
+        ipc_shm.detach();
+        dr_unmap_file(ipc_shm_map, ipc_shm_map_size);
+#endif
     } else
         ipc_pipe.close();
 
@@ -1944,6 +2079,16 @@ event_exit(void)
         !drmgr_unregister_thread_exit_event(event_thread_exit) ||
         drreg_exit() != DRREG_SUCCESS)
         DR_ASSERT(false);
+    if (buf_guard_size > 0) {
+#ifdef WINDOWS
+        if (!drmgr_unregister_exception_event(event_exception))
+            DR_ASSERT(false);
+#else
+        if (!drmgr_unregister_signal_event(event_signal))
+            DR_ASSERT(false);
+#endif
+        buf_guard_size = 0;
+    }
     if (op_enable_drstatecmp.get_value()) {
         if (drstatecmp_exit() != DRSTATECMP_SUCCESS) {
             DR_ASSERT(false);
@@ -2058,6 +2203,69 @@ init_offline_dir(void)
             encoding_file != INVALID_FILE);
 }
 
+static void
+init_ipc_pipe()
+{
+    if (!ipc_pipe.set_name(op_ipc_name.get_value().c_str()))
+        DR_ASSERT(false);
+#ifdef UNIX
+    /* we want an isolated fd so we don't use ipc_pipe.open_for_write() */
+    const char *pipe_path = ipc_pipe.get_pipe_path().c_str();
+    if (!dr_file_exists(pipe_path)) {
+        NOTIFY(0,
+               "drmemtrace WARNING: attempting to open write end of pipe at %s "
+               "for online analysis but pipe does not exist. Use \"-offline\" "
+               "mode if you are using drmemtrace without a reader.\n",
+               pipe_path);
+    }
+
+    int fd = dr_open_file(pipe_path, DR_FILE_WRITE_ONLY);
+    DR_ASSERT(fd != INVALID_FILE);
+    if (!ipc_pipe.set_fd(fd))
+        DR_ASSERT(false);
+#else
+    if (!ipc_pipe.open_for_write()) {
+        if (GetLastError() == ERROR_PIPE_BUSY) {
+            // FIXME i#1727: add multi-process support to Windows named_pipe_t.
+            FATAL("Fatal error: multi-process applications not yet supported "
+                  "for drcachesim on Windows\n");
+        } else {
+            FATAL("Fatal error: Failed to open pipe %s.\n",
+                  op_ipc_name.get_value().c_str());
+        }
+    }
+#endif
+    if (!ipc_pipe.maximize_buffer())
+        NOTIFY(1, "Failed to maximize pipe buffer: performance may suffer.\n");
+}
+
+#ifdef LINUX
+static void
+init_ipc_shm()
+{
+    if (!ipc_shm.set_name(op_ipc_name.get_value().c_str()))
+        DR_ASSERT(false);
+    const char *shm_path = ipc_shm.get_path().c_str();
+    if (!dr_file_exists(shm_path)) {
+        FATAL("Fatal error: shared memory file %s for online analysis does not exist. "
+              "Use \"-offline\" mode if you are using drmemtrace without a reader.\n",
+              shm_path);
+    }
+    file_t fd = dr_open_file(shm_path, DR_FILE_READ | DR_FILE_WRITE_APPEND);
+    uint64 file_size;
+    if (fd == INVALID_FILE || !dr_file_size(fd, &file_size))
+        FATAL("Fatal error: failed to open shared memory file %s.\n", shm_path);
+    ipc_shm_map_size = static_cast<size_t>(file_size);
+    ipc_shm_map = dr_map_file(fd, &ipc_shm_map_size, 0, nullptr,
+                              DR_MEMPROT_READ | DR_MEMPROT_WRITE, 0);
+    dr_close_file(fd);
+    if (ipc_shm_map == nullptr ||
+        !ipc_shm.attach(ipc_shm_map, ipc_shm_map_size, dr_get_process_id())) {
+        FATAL("Fatal error: failed to attach to shared memory file %s.\n", shm_path);
+    }
+}
+#endif
+
 #ifdef UNIX
 static void
 fork_init(void *drcontext)
@@ -2082,11 +2290,21 @@ fork_init(void *drcontext)
      */
     data->num_refs = 0;
     if (op_offline.get_value()) {
+        fork_init_async_io(drcontext);
         data->file = INVALID_FILE;
         if (!init_offline_dir()) {
             FATAL("Failed to create a subdir in %s\n", op_outdir.get_value().c_str());
         }
     }
+#    ifdef LINUX
+    else if (op_ipc_shm.get_value()) {
+        // The mapping was inherited; the reader just needs to know to wait for
+        // us.  XXX: If the parent exits before we get here the reader may see
+        // no writers and stop early.
+        if (!ipc_shm.attach(dr_get_process_id()))
+            FATAL("Fatal error: failed to attach to the shared memory rings\n");
+    }
+#    endif
     init_thread_in_process(drcontext);
 }
 #endif
@@ -2341,37 +2559,14 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
         placement = dr_global_alloc(MAX_INSTRU_SIZE);
         instru = new (placement) online_instru_t(
             insert_load_buf_ptr, insert_update_buf_ptr, &scratch_reserve_vec);
-        if (!ipc_pipe.set_name(op_ipc_name.get_value().c_str()))
-            DR_ASSERT(false);
-#ifdef UNIX
-        /* we want an isolated fd so we don't use ipc_pipe.open_for_write() */
-        const char *pipe_path = ipc_pipe.get_pipe_path().c_str();
-        if (!dr_file_exists(pipe_path)) {
-            NOTIFY(0,
-                   "drmemtrace WARNING: attempting to open write end of pipe at %s "
-                   "for online analysis but pipe does not exist. Use \"-offline\" "
-                   "mode if you are using drmemtrace without a reader.\n",
-                   pipe_path);
-        }
-
-        int fd = dr_open_file(pipe_path, DR_FILE_WRITE_ONLY);
-        DR_ASSERT(fd != INVALID_FILE);
-        if (!ipc_pipe.set_fd(fd))
-            DR_ASSERT(false);
+        if (op_ipc_shm.get_value()) {
+#ifdef LINUX
+            init_ipc_shm();
 #else
-        if (!ipc_pipe.open_for_write()) {
-            if (GetLastError() == ERROR_PIPE_BUSY) {
-                // FIXME i#1727: add multi-process support to Windows named_pipe_t.
-                FATAL("Fatal error: multi-process applications not yet supported "
-                      "for drcachesim on Windows\n");
-            } else {
-                FATAL("Fatal error: Failed to open pipe %s.\n",
-                      op_ipc_name.get_value().c_str());
-            }
-        }
+            FATAL("Usage error: -ipc_shm is only supported on Linux\n");
 #endif
-        if (!ipc_pipe.maximize_buffer())
-            NOTIFY(1, "Failed to maximize pipe buffer: performance may suffer.\n");
+        } else
+            init_ipc_pipe();
     }
 
     if (op_offline.get_value() &&
@@ -2437,6 +2632,38 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
     max_buf_size = ALIGN_FORWARD(trace_buf_size + redzone_size, dr_page_size());
     /* Mark any padding as redzone as well */
     redzone_size = max_buf_size - trace_buf_size;
+    if (op_buffer_guard.get_value()) {
+#ifdef X86
+        // A handoff callback frees our buffers without knowing about the guard.
+        if (file_ops_func.handoff_buf != NULL)
+            NOTIFY(0, "-buffer_guard is not supported with buffer handoff: ignoring\n");
+        // These need the end-of-block check to also look for mode changes.
+        else if (has_tracing_windows() || op_L0_filter_until_instrs.get_value() > 0) {
+            NOTIFY(0,
+                   "-buffer_guard is not supported with tracing windows or "
+                   "-L0_filter_until_instrs: ignoring\n");
+        } else
+            buf_guard_size = ALIGN_FORWARD(redzone_size, dr_page_size());
+#else
+        NOTIFY(0, "-buffer_guard is only supported on x86: ignoring\n");
+#endif
+    }
+    if (buf_guard_size > 0) {
+#ifdef WINDOWS
+        if (!drmgr_register_exception_event(event_exception))
+            DR_ASSERT(false);
+#else
+        if (!drmgr_register_signal_event(event_signal))
+            DR_ASSERT(false);
+#endif
+    }
+#ifdef LINUX
+    if (!op_offline.get_value() && op_ipc_shm.get_value() &&
+        max_buf_size > ipc_shm.get_max_chunk_size()) {
+        FATAL("Usage error: -ipc_shm_ring_size is too small for %zu-byte buffers\n",
+              max_buf_size);
+    }
+#endif
     /* Append a throwaway header to get its size. */
     buf_hdr_slots_size = append_unit_header(
         NULL /*no TLS yet*/, buf, 0 /*doesn't matter*/, has_tracing_windows() ? 0 : -1);
@@ -2458,6 +2685,7 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
     dr_log(NULL, DR_LOG_ALL, 1, "drcachesim client initializing\n");
 
     init_io();
+    init_async_io();
 
     if (op_max_global_trace_refs.get_value() > 0) {
         /* We need the same is-buffer-zero checks in the instrumentation. */
@@ -45,6 +45,9 @@
 #include "named_pipe.h"
 #include "options.h"
 #include "physaddr.h"
+#ifdef LINUX
+#    include "shm_ring.h"
+#endif
 #ifdef HAS_SNAPPY
 #    include <snappy.h>
 
@@ -56,6 +59,11 @@
 #ifdef HAS_LZ4
 #    include <lz4frame.h>
 #endif
+#ifdef HAS_ZSTD
+// For ZSTD_createCCtx_advanced() to parameterize the allocator.
+#    define ZSTD_STATIC_LINKING_ONLY
+#    include <zstd.h>
+#endif
 #ifdef BUILD_PT_TRACER
 #    include "syscall_pt_trace.h"
 #endif
@@ -64,13 +72,22 @@ namespace dynamorio {
 namespace drmemtrace {
 
 extern named_pipe_t ipc_pipe;
+#ifdef LINUX
+extern shm_ring_t ipc_shm;
+#    define IPC_SHM_DETACH() ipc_shm.detach()
+#else
+#    define IPC_SHM_DETACH() /* Nothing. */
+#endif
 // A clean exit via dr_exit_process() is not supported from init code, but
-// we do want to at least close the pipe file.
+// we do want to at least close the pipe file (or detach from the shared
+// memory rings so the reader does not wait for us).
 #define FATAL(...)                       \
     do {                                 \
         dr_fprintf(STDERR, __VA_ARGS__); \
-        if (!op_offline.get_value())     \
+        if (!op_offline.get_value()) {   \
             ipc_pipe.close();            \
+            IPC_SHM_DETACH();            \
+        }                                \
         dr_abort();                      \
     } while (0)
 
@@ -85,6 +102,13 @@ typedef struct {
     /* For offline traces */
     file_t file;
     size_t init_header_size;
+    /* For -raw_async_writers: which writer this thread's buffers go to, and how many
+     * of them are queued but not yet written.
+     */
+    uint async_writer;
+    volatile int async_pending;
+    /* For -ipc_shm: the ring this thread's buffers go to. */
+    uint shm_ring;
     /* For file_ops_func.handoff_buf */
     uint num_buffers;
     byte *reserve_buf;
@@ -107,6 +131,11 @@ typedef struct {
     LZ4F_compressionContext_t lzcxt;
     size_t buf_lz4_size;
     byte *buf_lz4;
+#endif
+#ifdef HAS_ZSTD
+    ZSTD_CCtx *zstd_cctx;
+    size_t buf_zstd_size;
+    byte *buf_zstd;
 #endif
     bool has_thread_header;
     // The physaddr_t class is designed to be per-thread.
@@ -240,6 +269,7 @@ extern char subdir_prefix[MAXIMUM_PATH]; /* Holds op_subdir_prefix. */
 extern size_t trace_buf_size;
 extern size_t redzone_size;
 extern size_t max_buf_size;
+extern size_t buf_guard_size;
 extern size_t buf_hdr_slots_size;
 
 #define MAX_NUM_DELAY_INSTRS 32
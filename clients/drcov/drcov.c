@@ -46,6 +46,9 @@
  *                    Uses nudge to notify a child process being terminated
  *                    by its parent, so that the exit event will be called.
  * -logdir <dir>      Sets log directory, which by default is ".".
+ * -hit_counts        Also counts the executions of each basic block
+ * -edge_counts       Also counts the taken edges of conditional branches (x86)
+ * -counters_64       Uses 64-bit counters for -hit_counts and -edge_counts
  */
 
 #include "dr_api.h"
@@ -132,6 +135,12 @@ options_init(client_id_t id, int argc, const char *argv[], drcovlib_options_t *o
             ops->flags |= DRCOVLIB_DUMP_AS_TEXT;
         else if (strcmp(token, "-dump_binary") == 0)
             ops->flags &= ~DRCOVLIB_DUMP_AS_TEXT;
+        else if (strcmp(token, "-hit_counts") == 0)
+            ops->flags |= DRCOVLIB_HIT_COUNTS;
+        else if (strcmp(token, "-edge_counts") == 0)
+            ops->flags |= DRCOVLIB_HIT_COUNTS | DRCOVLIB_EDGE_COUNTS;
+        else if (strcmp(token, "-counters_64") == 0)
+            ops->flags |= DRCOVLIB_COUNTERS_64BIT;
         else if (strcmp(token, "-no_nudge_kills") == 0)
             nudge_kills = false;
         else if (strcmp(token, "-nudge_kills") == 0)
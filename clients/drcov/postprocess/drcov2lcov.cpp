@@ -45,7 +45,14 @@
 #include "drsyms.h"
 #include "hashtable.h"
 #include "dr_frontend.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "../../common/utils.h"
@@ -142,6 +149,21 @@ static droption_t<std::string> op_output(DROPTION_SCOPE_FRONTEND, "output",
                                          DEFAULT_OUTPUT_FILE, "Names the output file",
                                          "Specifies the name for the output file.");
 
+static droption_t<std::string> op_output_drcov(
+    DROPTION_SCOPE_FRONTEND, "output_drcov", "", "Write a merged drcov log to this file",
+    "Requests that the coverage of all inputs be written to the given path as a single "
+    "drcov log file, in addition to the lcov output.  Each module appears once and "
+    "each basic block appears once, with its hit counts summed over the inputs if they "
+    "have counts.  The module filters apply.  The merged log can itself be passed "
+    "back to drcov2lcov.");
+
+static droption_t<unsigned int> op_jobs(
+    DROPTION_SCOPE_FRONTEND, "jobs", 0, "Number of log files to read in parallel",
+    "Specifies the number of threads that read and merge log files.  The default of 0 "
+    "uses one thread per hardware thread.  Identical modules from different log files "
+    "share one table, so the lines of each module are enumerated once regardless of "
+    "the number of logs.  -test_pattern always reads the logs serially.");
+
 static droption_t<std::string> op_test_pattern(
     DROPTION_SCOPE_FRONTEND, "test_pattern", "", "Enable test coverage for this function",
     "Includes test coverage information in the output file (which means that the output "
@@ -212,9 +234,11 @@ static char input_file_buf[MAXIMUM_PATH];
 static char input_dir_buf[MAXIMUM_PATH];
 static char input_list_buf[MAXIMUM_PATH];
 static char output_file_buf[MAXIMUM_PATH];
+static char drcov_file_buf[MAXIMUM_PATH];
 static char set_file_buf[MAXIMUM_PATH];
 
 static file_t set_log = INVALID_FILE;
+static std::mutex set_log_lock;
 
 /****************************************************************************
  * Utility Functions
@@ -282,6 +306,11 @@ static const char *cur_test = NULL;
 static const char *non_test = "<NON-TEST>"; /* for case like initialization code */
 static const char *non_exec = "<NON-EXEC>"; /* not executed code */
 
+/* Whether any input has block hit counts, in which case we report how many
+ * times each line executed rather than just whether it did.
+ */
+static std::atomic<bool> have_counts;
+
 /* Not knowing the source file size, we may allocate several chunks per file,
  * and link them together as a linked-list to avoid realloc and copy overhead.
  */
@@ -294,9 +323,21 @@ struct _line_chunk_t {
         byte *exec;        /* array of the execution info on the line */
         const char **test; /* array of the test name ptr on the line */
     } info;
+    /* With have_counts, the execution count of each line summed over the
+     * module tables enumerated so far, and its count in the module table
+     * being enumerated.  The latter is the maximum over the line's
+     * addresses, so that a line split across blocks is not counted twice.
+     */
+    uint64 *count;
+    uint64 *cur_count;
     line_chunk_t *next;
 };
 
+/* The lines whose cur_count is set, to be folded into count once the current
+ * module table's lines have all been enumerated.
+ */
+static std::vector<std::pair<line_chunk_t *, uint>> counted_lines;
+
 /* A linked-list line table for one source file.
  * The chunk at front holds larger number of lines than all the chunks behind it,
  * which makes the lookup faster by stopping at early chunk.
@@ -325,6 +366,14 @@ line_chunk_alloc(uint num_lines)
         chunk->info.exec = (byte *)line_info;
     }
     ASSERT(line_info != NULL, "Failed to alloc line info array\n");
+    chunk->count = NULL;
+    chunk->cur_count = NULL;
+    if (have_counts && !op_test_pattern.specified()) {
+        chunk->count = (uint64 *)calloc(num_lines, sizeof(chunk->count[0]));
+        chunk->cur_count = (uint64 *)calloc(num_lines, sizeof(chunk->cur_count[0]));
+        ASSERT(chunk->count != NULL && chunk->cur_count != NULL,
+               "Failed to alloc line count array\n");
+    }
     return chunk;
 }
 
@@ -335,6 +384,8 @@ line_chunk_free(line_chunk_t *chunk)
         free((void *)chunk->info.test); /* cast from "const char **" to "void *" */
     else
         free(chunk->info.exec);
+    free(chunk->count);
+    free(chunk->cur_count);
     free(chunk);
 }
 
@@ -363,10 +414,13 @@ line_chunk_print(line_chunk_t *chunk, char *start)
                                                                   : chunk->info.test[i]);
             }
         } else {
-            if (chunk->info.exec[i] != (byte)SOURCE_LINE_STATUS_NONE) {
-                res = dr_snprintf(
-                    start, MAX_CHAR_PER_LINE, "DA:%u,%u\n", line_num,
-                    chunk->info.exec[i] == (byte)SOURCE_LINE_STATUS_SKIP ? 0 : 1);
+            if (chunk->info.exec[i] == (byte)SOURCE_LINE_STATUS_SKIP) {
+                res = dr_snprintf(start, MAX_CHAR_PER_LINE, "DA:%u,0\n", line_num);
+            } else if (chunk->info.exec[i] != (byte)SOURCE_LINE_STATUS_NONE) {
+                /* Executed code from a log without counts still counts once. */
+                uint64 count = chunk->count == NULL ? 0 : chunk->count[i];
+                res = dr_snprintf(start, MAX_CHAR_PER_LINE, "DA:%u,%llu\n", line_num,
+                                  (unsigned long long)(count == 0 ? 1 : count));
             }
         }
         ASSERT(res < MAX_CHAR_PER_LINE && res != -1, "Error on printing\n");
@@ -439,7 +493,8 @@ line_table_delete(void *p)
 }
 
 static inline void
-line_table_add(line_table_t *line_table, uint line, byte status, const char *test_info)
+line_table_add(line_table_t *line_table, uint line, byte status, const char *test_info,
+               uint64 count)
 {
     line_chunk_t *chunk = line_table->chunk;
 
@@ -496,12 +551,31 @@ line_table_add(line_table_t *line_table, uint line, byte status, const char *tes
                     chunk->info.exec[line - chunk->first_num] !=
                         (byte)SOURCE_LINE_STATUS_EXEC)
                     chunk->info.exec[line - chunk->first_num] = status;
+                if (chunk->cur_count != NULL &&
+                    count > chunk->cur_count[line - chunk->first_num]) {
+                    if (chunk->cur_count[line - chunk->first_num] == 0)
+                        counted_lines.emplace_back(chunk, line - chunk->first_num);
+                    chunk->cur_count[line - chunk->first_num] = count;
+                }
             }
             return;
         }
     }
 }
 
+/* Adds the counts of the lines of the module table just enumerated into the
+ * totals of all the module tables.
+ */
+static void
+line_counts_fold(void)
+{
+    for (const auto &entry : counted_lines) {
+        entry.first->count[entry.second] += entry.first->cur_count[entry.second];
+        entry.first->cur_count[entry.second] = 0;
+    }
+    counted_lines.clear();
+}
+
 /****************************************************************************
  * Module Table Data Structure & Functions
  */
@@ -538,34 +612,68 @@ enum {
     BB_TABLE_ENTRY_SET = 1,
 };
 
+/* Module tables are interned: every log file's entry for the same segment of
+ * the same module shares one table, found through module_index.  Each table is
+ * also a shard of the merged coverage, guarded by its own lock so that threads
+ * reading different log files only contend when they add blocks to the same
+ * module at the same time.
+ */
 typedef struct _module_table_t {
     char *path;
     uintptr_t seg_start;
     size_t seg_offs;
     size_t size;
+    /* The table of this segment's containing module, or NULL if this is the
+     * containing module.
+     */
+    struct _module_table_t *containing;
+    /* The module information as recorded in the first log file seen with it,
+     * for -output_drcov.
+     */
+    std::string log_path;
+    uint64 file_offset;
+    app_pc preferred_base;
+#ifdef WINDOWS
+    uint checksum;
+    uint timestamp;
+#endif
     union {
         byte *bitmap;        /* store exec info (bit) for each app byte */
         const char **array;  /* store test info (char *) for each app byte */
     } bb_table;              /* data structure storing which bb is seen */
+    /* The execution count of each app byte, if the log has hit counts.
+     * XXX: like the test info array, this takes 8x the module size.
+     */
+    uint64 *counts;
     hashtable_t test_htable; /* hashtable for test functions found in the module */
+    /* For -output_drcov, the hit count of each distinct block, keyed by
+     * BB_KEY().
+     */
+    std::unordered_map<uint64, uint64> bbs;
+    std::mutex lock;
 } module_table_t;
 
-#define MODULE_HASH_TABLE_BITS 6
+#define BB_KEY(entry) (((uint64)(entry)->start << 16) | (entry)->size)
+
+/* The unique module tables, in the order they were first seen. */
 static std::vector<module_table_t *> module_vec;
+static std::unordered_map<std::string, module_table_t *> module_index;
+static std::mutex module_lock;
 
 static void
 module_vec_delete()
 {
     for (auto *table : module_vec) {
         PRINT(3, "Delete module table " PFX "\n", table);
-        if (table != MODULE_TABLE_IGNORE) {
-            free(table->path);
-            free(table->bb_table.bitmap);
-            if (op_test_pattern.specified())
-                hashtable_delete(&table->test_htable);
-            free(table);
-        }
+        free(table->path);
+        free(table->bb_table.bitmap);
+        free(table->counts);
+        if (op_test_pattern.specified())
+            hashtable_delete(&table->test_htable);
+        delete table;
     }
+    module_vec.clear();
+    module_index.clear();
 }
 
 static inline int
@@ -668,11 +776,35 @@ module_table_bb_lookup(module_table_t *table, uint64 addr_from_abs_base,
         return bb_bitmap_lookup(table, addr);
 }
 
+static uint64
+module_table_count_lookup(module_table_t *table, uint64 addr_from_abs_base)
+{
+    /* module_table_bb_lookup() has already validated the address. */
+    if (table->counts == NULL)
+        return 0;
+    return table->counts[addr_from_abs_base - table->seg_offs];
+}
+
+static void
+module_table_count_add(module_table_t *table, bb_entry_t *entry, uint64 count)
+{
+    uint i;
+    if (count == 0 || table->size <= entry->start + entry->size)
+        return;
+    if (table->counts == NULL) {
+        table->counts = (uint64 *)calloc(table->size, sizeof(table->counts[0]));
+        ASSERT(table->counts != NULL, "Failed to create module count table");
+    }
+    /* Each copy of a block in the code cache has its own counter, so summing
+     * over all the entries for a block gives its total.
+     */
+    for (i = 0; i < entry->size; i++)
+        table->counts[entry->start + i] += count;
+}
+
 static inline bool
 module_table_bb_add(module_table_t *table, bb_entry_t *entry)
 {
-    if (table == MODULE_TABLE_IGNORE)
-        return false;
     if (table->size <= entry->start + entry->size) {
         WARN(3, "Wrong range 0x%x-0x%x or table size 0x%zx for table " PFX "\n",
              entry->start, entry->start + entry->size, table->size, table);
@@ -739,8 +871,7 @@ module_table_create(const char *module, uintptr_t seg_start, size_t seg_offs, si
     module_table_t *table;
     ASSERT(ALIGNED(size, dr_page_size()), "Module size is not aligned");
 
-    table = (module_table_t *)calloc(1, sizeof(*table));
-    ASSERT(table != NULL, "Failed to allocate module table");
+    table = new module_table_t();
     table->path = my_strdup(module);
     table->seg_start = seg_start;
     table->seg_offs = seg_offs;
@@ -773,6 +904,46 @@ module_is_from_tool(const char *path)
             strstr(path, DRCOV_LIB_NAME) != NULL || strstr(path, DRMEM_LIB_NAME) != NULL);
 }
 
+/* Returns the shared table for the module segment described by info, creating
+ * it if this is the first log file to contain that segment.  The segment is
+ * identified by its path, its placement in its file and in its module, and on
+ * Windows by the checksum and timestamp from its headers, but not by its load
+ * address, which can differ from run to run.
+ */
+static module_table_t *
+module_table_intern(const drmodtrack_info_t *info, const char *modpath,
+                    module_table_t *containing, size_t seg_offs)
+{
+    char key[MAXIMUM_PATH + 128];
+#ifdef WINDOWS
+    dr_snprintf(key, BUFFER_SIZE_ELEMENTS(key), "%s|%llx|%zx|%zx|%x|%x", info->path,
+                (unsigned long long)info->offset, seg_offs, info->size, info->checksum,
+                info->timestamp);
+#else
+    dr_snprintf(key, BUFFER_SIZE_ELEMENTS(key), "%s|%llx|%zx|%zx", info->path,
+                (unsigned long long)info->offset, seg_offs, info->size);
+#endif
+    NULL_TERMINATE_BUFFER(key);
+    std::lock_guard<std::mutex> guard(module_lock);
+    auto it = module_index.find(key);
+    if (it != module_index.end())
+        return it->second;
+    module_table_t *table =
+        module_table_create(modpath, (uintptr_t)info->start, seg_offs, info->size);
+    table->containing = containing;
+    table->log_path = info->path;
+    table->file_offset = info->offset;
+    table->preferred_base = info->preferred_base;
+#ifdef WINDOWS
+    table->checksum = info->checksum;
+    table->timestamp = info->timestamp;
+#endif
+    PRINT(4, "Create module table " PFX " for module %s\n", table, modpath);
+    module_vec.push_back(table);
+    module_index.emplace(key, table);
+    return table;
+}
+
 static const char *
 read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
 {
@@ -829,20 +1000,21 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
                     }
                 }
             }
+            module_table_t *containing = NULL;
             size_t seg_offs = 0;
             if (info.containing_index != i) {
+                drmodtrack_info_t containing_info = {
+                    sizeof(containing_info),
+                };
                 ASSERT(info.containing_index <= i, "invalid containing index");
-                seg_offs =
-                    (uintptr_t)info.start - (*tables)[info.containing_index]->seg_start;
+                if (drmodtrack_offline_lookup(handle, info.containing_index,
+                                              &containing_info) != DRCOVLIB_SUCCESS)
+                    ASSERT(false, "Failed to read module table");
+                containing = (*tables)[info.containing_index];
+                seg_offs = (uintptr_t)info.start - (uintptr_t)containing_info.start;
             }
-            mod_table =
-                module_table_create(modpath, (uintptr_t)info.start, seg_offs, info.size);
+            mod_table = module_table_intern(&info, modpath, containing, seg_offs);
         }
-        PRINT(4, "Create module table " PFX " for module %s\n", mod_table, modpath);
-        module_vec.push_back(mod_table);
-        /* XXX: We could just use module_vec in the caller instead of this extra
-         * array, now that module_vec is a vector instead of a hashtable.
-         */
         (*tables)[i] = mod_table;
     }
     if (drmodtrack_offline_exit(handle) != DRCOVLIB_SUCCESS)
@@ -850,27 +1022,115 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
     return buf;
 }
 
+/* Reads the optional hit counts header which follows the bb list.  Returns a
+ * pointer to the counters, or NULL if there are none or they are malformed.
+ */
+static const char *
+read_bb_counts_header(const char *buf, const char *end, uint num_bbs,
+                      uint *counter_size DR_PARAM_OUT, bool *malformed DR_PARAM_OUT)
+{
+    uint version;
+    *malformed = false;
+    if (buf >= end ||
+        dr_sscanf(buf, "BB Hit Counts: version %u, %u-byte counters\n", &version,
+                  counter_size) != 2)
+        return NULL;
+    *malformed = true;
+    if (version != DRCOV_COUNTS_VERSION ||
+        (*counter_size != sizeof(uint) && *counter_size != sizeof(uint64))) {
+        WARN(1, "Unsupported hit counts version %u with %u-byte counters\n", version,
+             *counter_size);
+        return NULL;
+    }
+    buf = move_to_next_line(buf);
+    if ((size_t)(end - buf) < (size_t)num_bbs * *counter_size) {
+        WARN(1, "Truncated hit counts\n");
+        return NULL;
+    }
+    *malformed = false;
+    /* drcov2lcov has no use for the edge table which may follow the counters. */
+    return buf;
+}
+
+static inline uint64
+read_bb_count(const char *counts, uint counter_size, uint i)
+{
+    if (counts == NULL)
+        return 0;
+    /* The counters follow the variable-length header unaligned. */
+    if (counter_size == sizeof(uint64)) {
+        uint64 count;
+        memcpy(&count, counts + i * sizeof(uint64), sizeof(count));
+        return count;
+    }
+    uint count32;
+    memcpy(&count32, counts + i * sizeof(uint), sizeof(count32));
+    return count32;
+}
+
+/* The caller must hold table->lock. */
+static inline bool
+module_table_merge_bb(module_table_t *table, bb_entry_t *entry, uint64 count)
+{
+    bool res = module_table_bb_add(table, entry);
+    module_table_count_add(table, entry, count);
+    if (op_output_drcov.specified() && table->size > entry->start + entry->size)
+        table->bbs[BB_KEY(entry)] += count;
+    return res;
+}
+
+/* Merges the bbs of one log file into the module tables.  Returns whether any of
+ * them was not yet covered.
+ */
 static bool
-read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_bbs)
+read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_bbs,
+             const char *counts, uint counter_size)
 {
     uint i;
     bb_entry_t *entry;
     bool add_new_bb = false;
 
     PRINT(4, "Reading %u basic blocks\n", num_bbs);
+    if (counts != NULL && !op_test_pattern.specified())
+        have_counts = true;
     if (op_test_pattern.specified()) {
         /* i#1465: add unittest case coverage information in drcov:
-         * reset the current test name to be none
+         * reset the current test name to be none.
+         * The current test carries over from one block to the next, so the
+         * blocks must be added in their recorded order.  The logs are read
+         * serially in this mode, so no locking is needed.
          */
         cur_test = non_test;
+        for (i = 0, entry = (bb_entry_t *)buf; i < num_bbs; i++, entry++) {
+            PRINT(6, "BB: 0x%x, %u, %u\n", entry->start, entry->size, entry->mod_id);
+            /* we could have mod id USHRT_MAX for unknown module e.g., [vdso] */
+            if (entry->mod_id < num_mods && tables[entry->mod_id] != MODULE_TABLE_IGNORE) {
+                add_new_bb = module_table_merge_bb(tables[entry->mod_id], entry, 0) ||
+                    add_new_bb;
+            }
+        }
+        return add_new_bb;
     }
+    /* Group the bbs by module so that each module table is locked once per log. */
+    std::vector<std::vector<uint>> by_mod(num_mods);
     for (i = 0, entry = (bb_entry_t *)buf; i < num_bbs; i++, entry++) {
         PRINT(6, "BB: 0x%x, %u, %u\n", entry->start, entry->size, entry->mod_id);
         /* we could have mod id USHRT_MAX for unknown module e.g., [vdso] */
-        if (entry->mod_id < num_mods)
-            add_new_bb = module_table_bb_add(tables[entry->mod_id], entry) || add_new_bb;
+        if (entry->mod_id < num_mods && tables[entry->mod_id] != MODULE_TABLE_IGNORE)
+            by_mod[entry->mod_id].push_back(i);
+    }
+    for (uint mod = 0; mod < num_mods; mod++) {
+        if (by_mod[mod].empty())
+            continue;
+        module_table_t *table = tables[mod];
+        std::lock_guard<std::mutex> guard(table->lock);
+        for (uint idx : by_mod[mod]) {
+            entry = (bb_entry_t *)buf + idx;
+            add_new_bb = module_table_merge_bb(table, entry,
+                                               read_bb_count(counts, counter_size, idx)) ||
+                add_new_bb;
+        }
     }
-    free(tables);
     return add_new_bb;
 }
 
@@ -970,9 +1230,10 @@ read_drcov_file(const char *input)
     file_t log;
     const char *map, *ptr;
     size_t map_size;
+    const char *counts;
     module_table_t **tables;
-    uint num_mods, num_bbs;
-    bool res;
+    uint num_mods, num_bbs, counter_size = 0;
+    bool res, malformed;
 
     PRINT(2, "Reading drcov log file: %s\n", input);
     log = open_input_file(input, &map, &map_size, NULL);
@@ -983,26 +1244,39 @@ read_drcov_file(const char *input)
     ptr = read_file_header(map);
     if (ptr == NULL) {
         WARN(1, "Invalid version or bitwidth in drcov log file %s\n", input);
+        close_input_file(log, map, map_size);
         return false;
     }
 
     ptr = read_module_list(ptr, &tables, &num_mods);
-    if (ptr == NULL)
+    if (ptr == NULL) {
+        close_input_file(log, map, map_size);
         return false;
+    }
 
     if (dr_sscanf(ptr, "BB Table: %u bbs\n", &num_bbs) != 1) {
         WARN(1, "Failed to read bb list from %s\n", input);
+        free(tables);
+        close_input_file(log, map, map_size);
         return false;
     }
     ptr = move_to_next_line(ptr);
-    if (num_bbs * sizeof(bb_entry_t) > map_size) {
+    if ((size_t)num_bbs * sizeof(bb_entry_t) > (size_t)(map + map_size - ptr)) {
         WARN(1, "Wrong number of bbs, corrupt log file %s\n", input);
+        free(tables);
         close_input_file(log, map, map_size);
         return false;
     }
-    res = read_bb_list(ptr, tables, num_mods, num_bbs);
-    if (res && set_log != INVALID_FILE)
+    counts = read_bb_counts_header(ptr + num_bbs * sizeof(bb_entry_t), map + map_size,
+                                   num_bbs, &counter_size, &malformed);
+    if (malformed)
+        WARN(1, "Ignoring the hit counts in %s\n", input);
+    res = read_bb_list(ptr, tables, num_mods, num_bbs, counts, counter_size);
+    free(tables);
+    if (res && set_log != INVALID_FILE) {
+        std::lock_guard<std::mutex> guard(set_log_lock);
         dr_fprintf(set_log, "%s\n", input);
+    }
     close_input_file(log, map, map_size);
     return true;
 }
@@ -1021,7 +1295,7 @@ is_drcov_log_file(const char *fname)
 
 #ifdef UNIX
 static bool
-read_drcov_dir(void)
+read_drcov_dir(std::vector<std::string> *logs)
 {
     DIR *dir;
     struct dirent *ent;
@@ -1039,7 +1313,7 @@ read_drcov_dir(void)
                     WARN(1, "Fail to get full path of log file %s\n", ent->d_name);
                 } else {
                     NULL_TERMINATE_BUFFER(path);
-                    read_drcov_file(path);
+                    logs->push_back(path);
                     found_logs = true;
                 }
             }
@@ -1056,7 +1330,7 @@ read_drcov_dir(void)
 }
 #else
 static bool
-read_drcov_dir(void)
+read_drcov_dir(std::vector<std::string> *logs)
 {
     HANDLE hFind = INVALID_HANDLE_VALUE;
     WIN32_FIND_DATA ffd;
@@ -1086,7 +1360,8 @@ read_drcov_dir(void)
             if (!has_sep)
                 strcat(path, "\\");
             strcat(path, ffd.cFileName);
-            found_logs = read_drcov_file(path) || found_logs;
+            logs->push_back(path);
+            found_logs = true;
         }
     } while (FindNextFile(hFind, &ffd) != 0);
     FindClose(hFind);
@@ -1097,7 +1372,7 @@ read_drcov_dir(void)
 #endif
 
 static bool
-read_drcov_list(void)
+read_drcov_list(std::vector<std::string> *logs)
 {
     file_t list;
     const char *map, *ptr;
@@ -1119,7 +1394,8 @@ read_drcov_list(void)
         NULL_TERMINATE_BUFFER(path);
         ptr = move_to_next_line(ptr);
         null_terminate_path(path);
-        found_logs = read_drcov_file(path) || found_logs;
+        logs->push_back(path);
+        found_logs = true;
     }
     close_input_file(list, map, map_size);
     if (!found_logs)
@@ -1127,16 +1403,56 @@ read_drcov_list(void)
     return found_logs;
 }
 
+static void
+read_drcov_files(const std::vector<std::string> &logs, std::atomic<size_t> *next,
+                 std::vector<char> *read_ok)
+{
+    for (size_t i = (*next)++; i < logs.size(); i = (*next)++)
+        (*read_ok)[i] = read_drcov_file(logs[i].c_str());
+}
+
 static bool
 read_drcov_input(void)
 {
+    std::vector<std::string> logs;
     bool res = true;
     if (op_input.specified())
-        res = read_drcov_file(input_file_buf) && res;
+        logs.push_back(input_file_buf);
     if (op_list.specified())
-        res = read_drcov_list() && res;
+        res = read_drcov_list(&logs) && res;
     if (op_dir.specified())
-        res = read_drcov_dir() && res;
+        res = read_drcov_dir(&logs) && res;
+    if (logs.empty())
+        return false;
+
+    size_t num_jobs = op_jobs.get_value();
+    if (num_jobs == 0)
+        num_jobs = std::max(1u, std::thread::hardware_concurrency());
+    /* The test coverage relies on the order in which blocks are added, and
+     * on drsyms, which is not thread-safe.
+     */
+    if (op_test_pattern.specified())
+        num_jobs = 1;
+    num_jobs = std::min(num_jobs, logs.size());
+    PRINT(2, "Reading %zu log files with %zu threads\n", logs.size(), num_jobs);
+
+    std::atomic<size_t> next(0);
+    std::vector<char> read_ok(logs.size(), false);
+    if (num_jobs == 1)
+        read_drcov_files(logs, &next, &read_ok);
+    else {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < num_jobs; i++)
+            workers.emplace_back(read_drcov_files, std::cref(logs), &next, &read_ok);
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+    if (op_input.specified() && !read_ok[0])
+        res = false;
+    if (std::find(read_ok.begin(), read_ok.end(), true) == read_ok.end())
+        res = false;
+    PRINT(2, "Merged %zu log files into %zu module tables\n",
+          (size_t)std::count(read_ok.begin(), read_ok.end(), true), module_vec.size());
     return res;
 }
 
@@ -1169,11 +1485,11 @@ enum_line_cb(drsym_line_info_t *info, void *data)
     if (status == BB_TABLE_ENTRY_SET) {
         PRINT(5, "exec: ");
         line_table_add(line_table, (uint)info->line, (byte)SOURCE_LINE_STATUS_EXEC,
-                       test_info);
+                       test_info, module_table_count_lookup(table, info->line_addr));
     } else if (status == BB_TABLE_ENTRY_CLEAR) {
         PRINT(5, "skip: ");
         line_table_add(line_table, (uint)info->line, (byte)SOURCE_LINE_STATUS_SKIP,
-                       test_info);
+                       test_info, 0);
     } else {
         WARN(2, "Invalid bb lookup, Table: " PFX ", Addr: " PIFX "\n", table,
              IF_NOT_X64((uint)) info->line);
@@ -1188,8 +1504,6 @@ enumerate_line_info(void)
 {
     /* iterate module table */
     for (const auto *mod_table : module_vec) {
-        if (mod_table == MODULE_TABLE_IGNORE)
-            continue;
         if (strcmp(mod_table->path, "<unknown>") == 0)
             continue;
         bool has_lines = true;
@@ -1200,6 +1514,7 @@ enumerate_line_info(void)
             WARN(1, "Failed to enumerate lines for %s\n", mod_table->path);
             has_lines = false;
         }
+        line_counts_fold();
         res = drsym_free_resources(mod_table->path);
         /* I'm using has_lines to avoid warning on vdso. */
         if (res != DRSYM_SUCCESS && has_lines)
@@ -1274,6 +1589,112 @@ write_lcov_output(void)
     return true;
 }
 
+/* Writes the merged module tables out as one drcov log, with the containing
+ * module of each module segment listed just before its other segments.
+ */
+static bool
+write_drcov_output(void)
+{
+    std::vector<module_table_t *> order;
+    std::unordered_map<module_table_t *, std::vector<module_table_t *>> segments;
+    std::unordered_map<module_table_t *, uint> mod_id;
+    for (auto *table : module_vec) {
+        if (table->containing == NULL)
+            order.push_back(table);
+        else
+            segments[table->containing].push_back(table);
+    }
+    for (size_t i = order.size(); i > 0; i--) {
+        auto it = segments.find(order[i - 1]);
+        if (it != segments.end())
+            order.insert(order.begin() + i, it->second.begin(), it->second.end());
+    }
+    ASSERT(order.size() == module_vec.size(), "Segment without a containing module\n");
+    if (order.empty()) {
+        WARN(1, "No modules to write to %s\n", drcov_file_buf);
+        return false;
+    }
+
+    PRINT(2, "Writing merged drcov file: %s\n", drcov_file_buf);
+    void *handle;
+    if (drmodtrack_offline_create((uint)order.size(), &handle) != DRCOVLIB_SUCCESS)
+        return false;
+    ASSERT(order.size() <= USHRT_MAX, "Too many modules for the drcov format\n");
+    std::vector<bb_entry_t> bbs;
+    std::vector<uint64> counts;
+    for (uint i = 0; i < order.size(); i++) {
+        module_table_t *table = order[i];
+        drmodtrack_info_t info = {
+            sizeof(info),
+        };
+        mod_id[table] = i;
+        info.containing_index = table->containing == NULL ? i : mod_id[table->containing];
+        /* Segments keep their distance from the containing module, which may have
+         * been loaded at a different address in the log that recorded them.
+         */
+        info.start = table->containing == NULL
+            ? (app_pc)table->seg_start
+            : (app_pc)table->containing->seg_start + table->seg_offs;
+        info.size = table->size;
+        info.path = (char *)table->log_path.c_str();
+#ifdef WINDOWS
+        info.checksum = table->checksum;
+        info.timestamp = table->timestamp;
+#endif
+        info.offset = table->file_offset;
+        info.preferred_base = table->preferred_base;
+        if (drmodtrack_offline_set(handle, i, &info) != DRCOVLIB_SUCCESS) {
+            drmodtrack_offline_exit(handle);
+            return false;
+        }
+        size_t first = bbs.size();
+        for (const auto &keyval : table->bbs) {
+            bb_entry_t entry;
+            entry.start = (uint)(keyval.first >> 16);
+            entry.size = (ushort)keyval.first;
+            entry.mod_id = (ushort)i;
+            bbs.push_back(entry);
+        }
+        std::sort(bbs.begin() + first, bbs.end(),
+                  [](const bb_entry_t &a, const bb_entry_t &b) {
+                      return BB_KEY(&a) < BB_KEY(&b);
+                  });
+        for (size_t j = first; j < bbs.size(); j++)
+            counts.push_back(table->bbs[BB_KEY(&bbs[j])]);
+    }
+
+    size_t buf_sz = 64 * 1024, wrote;
+    std::vector<char> buf(buf_sz);
+    drcovlib_status_t res;
+    while ((res = drmodtrack_offline_write(handle, buf.data(), buf.size(), &wrote)) ==
+           DRCOVLIB_ERROR_BUF_TOO_SMALL)
+        buf.resize(buf.size() * 2);
+    drmodtrack_offline_exit(handle);
+    if (res != DRCOVLIB_SUCCESS)
+        return false;
+
+    file_t log =
+        dr_open_file(drcov_file_buf, DR_FILE_WRITE_OVERWRITE | DR_FILE_ALLOW_LARGE);
+    if (log == INVALID_FILE) {
+        WARN(1, "Failed to open output file %s\n", drcov_file_buf);
+        return false;
+    }
+    dr_fprintf(log, "DRCOV VERSION: %d\n", DRCOV_VERSION);
+    dr_fprintf(log, "DRCOV FLAVOR: %s\n", DRCOV_FLAVOR);
+    /* wrote includes the terminating null. */
+    dr_write_file(log, buf.data(), wrote - 1);
+    dr_fprintf(log, "BB Table: %u bbs\n", (uint)bbs.size());
+    dr_write_file(log, bbs.data(), bbs.size() * sizeof(bbs[0]));
+    if (have_counts) {
+        dr_fprintf(log, "BB Hit Counts: version %u, %u-byte counters\n",
+                   DRCOV_COUNTS_VERSION, (uint)sizeof(counts[0]));
+        dr_write_file(log, counts.data(), counts.size() * sizeof(counts[0]));
+    }
+    dr_close_file(log);
+    PRINT(2, "Wrote %zu modules and %zu bbs\n", order.size(), bbs.size());
+    return true;
+}
+
 /****************************************************************************
  * Options Handling
  */
@@ -1360,6 +1781,17 @@ option_init(int argc, const char *argv[])
     NULL_TERMINATE_BUFFER(output_file_buf);
     PRINT(2, "Output file: %s\n", output_file_buf);
 
+    if (op_output_drcov.specified()) {
+        if (drfront_get_absolute_path(op_output_drcov.get_value().c_str(), drcov_file_buf,
+                                      BUFFER_SIZE_ELEMENTS(drcov_file_buf)) !=
+            DRFRONT_SUCCESS) {
+            WARN(1, "Failed to get full path of output_drcov file\n");
+            return false;
+        }
+        NULL_TERMINATE_BUFFER(drcov_file_buf);
+        PRINT(2, "Merged drcov file: %s\n", drcov_file_buf);
+    }
+
     if (op_reduce_set.specified()) {
         if (drfront_get_absolute_path(op_reduce_set.get_value().c_str(), set_file_buf,
                                       BUFFER_SIZE_ELEMENTS(set_file_buf)) !=
@@ -1420,6 +1852,12 @@ main(int argc, const char *argv[])
         return 1;
     }
 
+    if (dynamorio::drcov::op_output_drcov.specified() &&
+        !dynamorio::drcov::write_drcov_output()) {
+        ASSERT(false, "Failed to write merged drcov file\n");
+        return 1;
+    }
+
     dynamorio::drcov::module_vec_delete();
     hashtable_delete(&dynamorio::drcov::line_htable);
     if (drsym_exit() != DRSYM_SUCCESS) {
@@ -36,6 +36,10 @@
 #     should have intra-arg space=@@ and inter-arg space=@ and ;=!
 # * cmp = file containing output to compare app output to, to ensure app ran correctly
 # * postcmd = post processing command to run
+#
+# A test named <app>_<variant>, such as tool.drcov.fib_counts, runs <app> with
+# its logs in the directory <app>_<variant>.logs, which its client options must
+# pass to -logdir, so they do not mix with those of other tests of <app>.
 
 # Intra-arg space=@@ and inter-arg space=@.
 # XXX i#1327: now that we have -c and other option passing improvements we
@@ -44,15 +48,6 @@ string(REGEX REPLACE "@@" " " cmd "${cmd}")
 string(REGEX REPLACE "@" ";" cmd "${cmd}")
 string(REGEX REPLACE "!" "\\\;" cmd "${cmd}")
 
-# run the cmd
-execute_process(COMMAND ${cmd}
-  RESULT_VARIABLE cmd_result
-  ERROR_VARIABLE cmd_err
-  OUTPUT_VARIABLE cmd_out)
-if (cmd_result)
-  message(FATAL_ERROR "*** ${cmd} failed (${cmd_result}): ${cmd_err}***\n")
-endif (cmd_result)
-
 # get the real test name:
 # CMake uses the first '.' to identify the longest extension, so we cannot use
 # get_filename_component to get the real test name directly.
@@ -61,8 +56,27 @@ get_filename_component(test_name "${cmp}" NAME)
 string(REGEX REPLACE "\\.[^.]+$" "" test_name ${test_name})
 # tool.drcov.fib => fib
 string(REGEX REPLACE "^.+\\.([^.]+)$" "\\1" test_name ${test_name})
+if (test_name MATCHES "^([^_]+)_")
+  # fib_counts => fib
+  set(app_name ${CMAKE_MATCH_1})
+  set(log_dir "${test_name}.logs")
+  file(REMOVE_RECURSE ${log_dir})
+  file(MAKE_DIRECTORY ${log_dir})
+else ()
+  set(app_name ${test_name})
+  set(log_dir ".")
+endif ()
 
-FILE(GLOB drcov_logs "drcov.*${test_name}*.log")
+# run the cmd
+execute_process(COMMAND ${cmd}
+  RESULT_VARIABLE cmd_result
+  ERROR_VARIABLE cmd_err
+  OUTPUT_VARIABLE cmd_out)
+if (cmd_result)
+  message(FATAL_ERROR "*** ${cmd} failed (${cmd_result}): ${cmd_err}***\n")
+endif (cmd_result)
+
+FILE(GLOB drcov_logs "${log_dir}/drcov.*${app_name}*.log")
 set(cov_file "coverage.${test_name}")
 
 file(READ ${cmp} expect)
@@ -72,9 +86,9 @@ if (WIN32)
 endif (WIN32)
 
 execute_process(COMMAND ${postcmd}
-  -dir        ./
-  -mod_filter ${test_name}
-  -src_filter ${test_name}
+  -dir        ${log_dir}
+  -mod_filter ${app_name}
+  -src_filter ${app_name}
   -output     ${cov_file}
   RESULT_VARIABLE cmd_result
   ERROR_VARIABLE cmd_err
@@ -89,6 +103,9 @@ file(READ ${cov_file} cov_out)
 foreach(logfile ${drcov_logs})
   file(REMOVE ${logfile})
 endforeach(logfile)
+if (NOT log_dir STREQUAL ".")
+  file(REMOVE_RECURSE ${log_dir})
+endif ()
 file(REMOVE ${cov_file})
 
 if (NOT "${cov_out}" MATCHES "${expect}")
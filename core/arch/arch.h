@@ -1529,6 +1529,8 @@ typedef struct _callee_info_t {
     int num_opmask_used; /* number of mask registers used by callee */
     /* AVX-512 mask register usage. */
     bool opmask_used[MCXT_NUM_OPMASK_SLOTS];
+    /* Only the SIMD and mask usage above is known, from -cleancall_scan_simd. */
+    bool simd_scanned;
 #endif
     bool reg_used[DR_NUM_GPR_REGS];         /* general purpose registers usage */
     int num_callee_save_regs;               /* number of regs callee saved */
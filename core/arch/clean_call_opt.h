@@ -65,6 +65,11 @@ check_callee_instr_level2(dcontext_t *dcontext, callee_info_t *ci, app_pc next_p
 bool
 check_callee_ilist_inline(dcontext_t *dcontext, callee_info_t *ci);
 
+#ifdef X86
+void
+analyze_callee_simd_scan(dcontext_t *dcontext, callee_info_t *ci);
+#endif
+
 void
 analyze_clean_call_aflags(dcontext_t *dcontext, clean_call_info_t *cci, instr_t *where);
 
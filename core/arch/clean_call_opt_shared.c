@@ -499,12 +499,11 @@ analyze_callee_ilist(dcontext_t *dcontext, callee_info_t *ci)
 }
 
 static void
-analyze_clean_call_regs(dcontext_t *dcontext, clean_call_info_t *cci)
+analyze_clean_call_simd(dcontext_t *dcontext, clean_call_info_t *cci)
 {
-    int i, num_regparm;
+    int i;
     callee_info_t *info = cci->callee_info;
 
-    /* 1. xmm registers */
     for (i = 0; i < proc_num_simd_registers(); i++) {
         if (info->simd_used[i]) {
             cci->simd_skip[i] = false;
@@ -529,6 +528,16 @@ analyze_clean_call_regs(dcontext_t *dcontext, clean_call_info_t *cci)
         }
     }
 #endif
+}
+
+static void
+analyze_clean_call_regs(dcontext_t *dcontext, clean_call_info_t *cci)
+{
+    int i, num_regparm;
+    callee_info_t *info = cci->callee_info;
+
+    /* 1. xmm registers */
+    analyze_clean_call_simd(dcontext, cci);
     if (INTERNAL_OPTION(opt_cleancall) > 2 &&
         cci->num_simd_skip != proc_num_simd_registers())
         cci->should_align = false;
@@ -721,6 +730,10 @@ analyze_clean_call(dcontext_t *dcontext, clean_call_info_t *cci, instr_t *where,
             if (ci->bailout) {
                 callee_info_init(ci);
                 ci->start = (app_pc)callee;
+#ifdef X86
+                if (DYNAMO_OPTION(cleancall_scan_simd))
+                    analyze_callee_simd_scan(dcontext, ci);
+#endif
             } else
                 analyze_callee_ilist(dcontext, ci);
             /* 4.4. add info into callee list */
@@ -737,6 +750,14 @@ analyze_clean_call(dcontext_t *dcontext, clean_call_info_t *cci, instr_t *where,
             /* 8. inline optimization analysis */
             should_inline = analyze_clean_call_inline(dcontext, cci);
         }
+#ifdef X86
+        else if (ci->simd_scanned) {
+            /* Only the SIMD registers can be skipped for this callee. */
+            analyze_clean_call_simd(dcontext, cci);
+            if (cci->num_simd_skip == proc_num_simd_registers())
+                STATS_INC(cleancall_simd_skipped);
+        }
+#endif
     }
 
     /* Thresholds for out-of-line calls. The values are based on a guess. The bar
@@ -771,10 +792,18 @@ analyze_clean_call(dcontext_t *dcontext, clean_call_info_t *cci, instr_t *where,
      * For AVX-512, a threshold of 3 mask registers has been added.
      * XXX: This should probably be in arch-specific clean_call_opt.c.
      */
+    bool gpr_out_of_line = (DR_NUM_GPR_REGS - cci->num_regs_skip) > GPR_SAVE_THRESHOLD;
+#    ifdef X86
+    /* For a -cleancall_scan_simd callee every GPR is saved, but pushing them inline
+     * is far cheaper than the out-of-line routine, which saves every SIMD register.
+     */
+    callee_info_t *info = cci->callee_info;
+    if (info->simd_scanned)
+        gpr_out_of_line = false;
+#    endif
     if ((proc_num_simd_registers() - cci->num_simd_skip) > SIMD_SAVE_THRESHOLD ||
         IF_X86((proc_num_opmask_registers() - cci->num_opmask_skip) >
-                   OPMASK_SAVE_THRESHOLD ||)(DR_NUM_GPR_REGS - cci->num_regs_skip) >
-            GPR_SAVE_THRESHOLD ||
+                   OPMASK_SAVE_THRESHOLD ||) gpr_out_of_line ||
         always_out_of_line)
         cci->out_of_line_swap = true;
 #endif
@@ -53,6 +53,52 @@
 #define POST instrlist_meta_postinsert
 #define PRE instrlist_meta_preinsert
 
+/* Returns whether instr modifies SIMD or mask registers it does not list as operands. */
+static bool
+instr_writes_all_simd(instr_t *instr)
+{
+    switch (instr_get_opcode(instr)) {
+    case OP_vzeroupper:
+    case OP_vzeroall:
+    case OP_fxrstor32:
+    case OP_fxrstor64:
+    case OP_xrstor32:
+    case OP_xrstor64:
+    case OP_xrstors32:
+    case OP_xrstors64: return true;
+    default: return false;
+    }
+}
+
+static void
+analyze_callee_instr_simd_usage(dcontext_t *dcontext, callee_info_t *ci, instr_t *instr)
+{
+    bool all = instr_writes_all_simd(instr);
+    int i;
+    for (i = 0; i < proc_num_simd_registers(); i++) {
+        if (!ci->simd_used[i] &&
+            (all || instr_uses_reg(instr, (DR_REG_START_XMM + (reg_id_t)i)) ||
+             instr_uses_reg(instr, (DR_REG_START_YMM + (reg_id_t)i)) ||
+             instr_uses_reg(instr, (DR_REG_START_ZMM + (reg_id_t)i)))) {
+            LOG(THREAD, LOG_CLEANCALL, 2,
+                "CLEANCALL: callee " PFX " uses XMM%d at " PFX "\n", ci->start, i,
+                instr_get_app_pc(instr));
+            ci->simd_used[i] = true;
+            ci->num_simd_used++;
+        }
+    }
+    for (i = 0; i < proc_num_opmask_registers(); i++) {
+        if (!ci->opmask_used[i] &&
+            (all || instr_uses_reg(instr, (DR_REG_START_OPMASK + (reg_id_t)i)))) {
+            LOG(THREAD, LOG_CLEANCALL, 2,
+                "CLEANCALL: callee " PFX " uses k%d at " PFX "\n", ci->start, i,
+                instr_get_app_pc(instr));
+            ci->opmask_used[i] = true;
+            ci->num_opmask_used++;
+        }
+    }
+}
+
 void
 analyze_callee_regs_usage(dcontext_t *dcontext, callee_info_t *ci)
 {
@@ -76,29 +122,8 @@ analyze_callee_regs_usage(dcontext_t *dcontext, callee_info_t *ci)
          * once for each clean call callee, it will have little performance
          * impact unless there are a lot of different clean call callees.
          */
-        /* XMM registers usage */
-        for (i = 0; i < proc_num_simd_registers(); i++) {
-            if (!ci->simd_used[i] &&
-                (instr_uses_reg(instr, (DR_REG_START_XMM + (reg_id_t)i)) ||
-                 instr_uses_reg(instr, (DR_REG_START_YMM + (reg_id_t)i)) ||
-                 instr_uses_reg(instr, (DR_REG_START_ZMM + (reg_id_t)i)))) {
-                LOG(THREAD, LOG_CLEANCALL, 2,
-                    "CLEANCALL: callee " PFX " uses XMM%d at " PFX "\n", ci->start, i,
-                    instr_get_app_pc(instr));
-                ci->simd_used[i] = true;
-                ci->num_simd_used++;
-            }
-        }
-        for (i = 0; i < proc_num_opmask_registers(); i++) {
-            if (!ci->opmask_used[i] &&
-                instr_uses_reg(instr, (DR_REG_START_OPMASK + (reg_id_t)i))) {
-                LOG(THREAD, LOG_CLEANCALL, 2,
-                    "CLEANCALL: callee " PFX " uses k%d at " PFX "\n", ci->start, i,
-                    instr_get_app_pc(instr));
-                ci->opmask_used[i] = true;
-                ci->num_opmask_used++;
-            }
-        }
+        /* XMM and mask registers usage */
+        analyze_callee_instr_simd_usage(dcontext, ci, instr);
         /* General purpose registers */
         for (i = 0; i < DR_NUM_GPR_REGS; i++) {
             reg_id_t reg = DR_REG_XAX + (reg_id_t)i;
@@ -184,6 +209,134 @@ analyze_callee_regs_usage(dcontext_t *dcontext, callee_info_t *ci)
     }
 }
 
+/* Limits on how much code analyze_callee_simd_scan() examines. */
+#define SIMD_SCAN_MAX_INSTRS 2048
+#define SIMD_SCAN_MAX_BLOCKS 64
+
+static app_pc
+simd_scan_decode(dcontext_t *dcontext, callee_info_t *ci, app_pc pc, instr_t *instr)
+{
+    app_pc next_pc = NULL;
+    instr_reset(GLOBAL_DCONTEXT, instr);
+    TRY_EXCEPT(
+        dcontext, { next_pc = decode(GLOBAL_DCONTEXT, pc, instr); },
+        { /* EXCEPT */
+          LOG(THREAD, LOG_CLEANCALL, 2,
+              "CLEANCALL: crash on SIMD scan of callee " PFX " at: " PFX "\n", ci->start,
+              pc);
+          return NULL;
+        });
+    if (next_pc == NULL || !instr_valid(instr))
+        return NULL;
+    instr_set_translation(instr, pc);
+    return next_pc;
+}
+
+/* Code in DR may read or write the saved priv_mcontext_t, whose SIMD slots are
+ * only partially filled in when we skip registers.  The explicit comparisons
+ * cover static DR, where is_in_dynamo_dll() does not identify our code.
+ */
+static bool
+simd_scan_target_is_dr(app_pc tgt)
+{
+    return is_in_dynamo_dll(tgt) || tgt == (app_pc)dr_get_mcontext ||
+        tgt == (app_pc)dr_set_mcontext || tgt == (app_pc)dr_redirect_execution;
+}
+
+/* For a callee whose full analysis bailed out (typically because it makes
+ * calls), walks all code reachable from its entry through direct branches and
+ * direct calls and records which SIMD and mask registers it touches.  On any
+ * indirect branch other than a return, any call into DR, any syscall, or on
+ * exceeding the scan limits, the callee is left with every register marked used.
+ */
+void
+analyze_callee_simd_scan(dcontext_t *dcontext, callee_info_t *ci)
+{
+    app_pc worklist[SIMD_SCAN_MAX_BLOCKS];
+    app_pc block_start[SIMD_SCAN_MAX_BLOCKS], block_end[SIMD_SCAN_MAX_BLOCKS];
+    int num_pending = 0, num_blocks = 0, num_instrs = 0, i;
+    bool ok = true;
+    instr_t instr;
+
+    ASSERT(ci->bailout && ci->ilist == NULL);
+    ci->num_simd_used = 0;
+    ci->num_opmask_used = 0;
+    memset(ci->simd_used, 0, sizeof(bool) * proc_num_simd_registers());
+    memset(ci->opmask_used, 0, sizeof(bool) * MCXT_NUM_OPMASK_SLOTS);
+    instr_init(GLOBAL_DCONTEXT, &instr);
+    worklist[num_pending++] = ci->start;
+    while (ok && num_pending > 0) {
+        app_pc pc = worklist[--num_pending];
+        for (i = 0; i < num_blocks; i++) {
+            if (pc >= block_start[i] && pc < block_end[i])
+                break;
+        }
+        if (i < num_blocks)
+            continue; /* already scanned */
+        if (num_blocks == SIMD_SCAN_MAX_BLOCKS || simd_scan_target_is_dr(pc)) {
+            ok = false;
+            break;
+        }
+        block_start[num_blocks] = pc;
+        block_end[num_blocks] = pc;
+        num_blocks++;
+        while (true) {
+            app_pc next_pc = simd_scan_decode(dcontext, ci, pc, &instr);
+            if (next_pc == NULL || ++num_instrs > SIMD_SCAN_MAX_INSTRS) {
+                ok = false;
+                break;
+            }
+            block_end[num_blocks - 1] = next_pc;
+            analyze_callee_instr_simd_usage(dcontext, ci, &instr);
+            if (instr_is_syscall(&instr) || instr_is_interrupt(&instr)) {
+                ok = false;
+                break;
+            }
+            if (instr_is_cti(&instr)) {
+                if (instr_is_return(&instr))
+                    break;
+                if (instr_is_mbr(&instr) || instr_is_far_cti(&instr)) {
+                    LOG(THREAD, LOG_CLEANCALL, 2,
+                        "CLEANCALL: SIMD scan of callee " PFX
+                        " stops at indirect branch at: " PFX "\n",
+                        ci->start, pc);
+                    ok = false;
+                    break;
+                }
+                if (num_pending + 2 > SIMD_SCAN_MAX_BLOCKS) {
+                    ok = false;
+                    break;
+                }
+                worklist[num_pending++] = opnd_get_pc(instr_get_target(&instr));
+                /* Calls are assumed to return; cbrs fall through. */
+                if (!instr_is_ubr(&instr))
+                    worklist[num_pending++] = next_pc;
+                break;
+            }
+            pc = next_pc;
+        }
+    }
+    instr_free(GLOBAL_DCONTEXT, &instr);
+    if (!ok) {
+        LOG(THREAD, LOG_CLEANCALL, 2,
+            "CLEANCALL: SIMD scan of callee " PFX " failed after %d instrs\n", ci->start,
+            num_instrs);
+        ci->num_simd_used = proc_num_simd_registers();
+        for (i = 0; i < proc_num_simd_registers(); i++)
+            ci->simd_used[i] = true;
+        ci->num_opmask_used = proc_num_opmask_registers();
+        for (i = 0; i < proc_num_opmask_registers(); i++)
+            ci->opmask_used[i] = true;
+        return;
+    }
+    LOG(THREAD, LOG_CLEANCALL, 1,
+        "CLEANCALL: SIMD scan of callee " PFX ": %d instrs, %d SIMD and %d mask regs "
+        "used.\n",
+        ci->start, num_instrs, ci->num_simd_used, ci->num_opmask_used);
+    STATS_INC(cleancall_simd_scanned);
+    ci->simd_scanned = true;
+}
+
 /* We use push/pop pattern to detect callee saved registers,
  * and assume that the code later won't change those saved value
  * on the stack.
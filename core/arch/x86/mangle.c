@@ -1127,6 +1127,25 @@ insert_push_retaddr(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
     }
 }
 
+/* Pushes the return address of a mangled call.  The pointer-sized immediate
+ * is an absolute application pc, so we mark the push and any top-half store
+ * that immediately follows it for coarse-grain relocation.
+ */
+static void
+insert_push_call_retaddr(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
+                         ptr_int_t retaddr, opnd_size_t opsize)
+{
+    if (opsize ==
+        OPSZ_PTR IF_X64(|| (!X64_CACHE_MODE_DC(dcontext) && opsize == OPSZ_4))) {
+        instr_t *push, *mov_hi;
+        insert_push_immed_ptrsz(dcontext, retaddr, ilist, instr, &push, &mov_hi);
+        push->flags |= INSTR_APP_PC_IMMED;
+        if (mov_hi != NULL)
+            mov_hi->flags |= INSTR_APP_PC_IMMED;
+    } else
+        insert_push_retaddr(dcontext, ilist, instr, retaddr, opsize);
+}
+
 /* N.B.: keep in synch with instr_check_xsp_mangling() */
 static void
 insert_mov_ptr_uint_beyond_TOS(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
@@ -1339,7 +1358,7 @@ mangle_direct_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
     }
 
     /* convert a direct call to a push of the return address */
-    insert_push_retaddr(dcontext, ilist, instr, retaddr, pushsz);
+    insert_push_call_retaddr(dcontext, ilist, instr, retaddr, pushsz);
 
     /* remove the call */
     instrlist_remove(ilist, instr);
@@ -1543,7 +1562,7 @@ mangle_indirect_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
      */
     if (TEST(INSTR_IND_CALL_DIRECT, instr->flags)) {
         /* convert the call to a push of the return address */
-        insert_push_retaddr(dcontext, ilist, instr, retaddr, pushsz);
+        insert_push_call_retaddr(dcontext, ilist, instr, retaddr, pushsz);
         /* remove the call */
         instrlist_remove(ilist, instr);
         instr_destroy(dcontext, instr);
@@ -1562,7 +1581,7 @@ mangle_indirect_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
          * though we do go ahead and push cs, we won't pop into cs
          */
     }
-    insert_push_retaddr(dcontext, ilist, next_instr, retaddr, pushsz);
+    insert_push_call_retaddr(dcontext, ilist, next_instr, retaddr, pushsz);
 
     /* save away xcx so that we can use it */
     /* (it's restored in x86.s (indirect_branch_lookup) */
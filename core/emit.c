@@ -51,6 +51,7 @@
 #include "instr_create_shared.h"
 #include "monitor.h"
 #include "translate.h"
+#include "perscache.h"
 
 #ifdef DEBUG
 #    include "decode_fast.h" /* for decode_next_pc for stress_recreate_pc */
@@ -358,6 +359,19 @@ set_linkstub_fields(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist,
         } /* exit cti */
         if (instr_ok_to_emit(inst)) {
             if (emit) {
+                /* A flagged top-half store continues the flagged push before it */
+                if (TEST(INSTR_APP_PC_IMMED, inst->flags) &&
+                    (instr_get_prev(inst) == NULL ||
+                     !TEST(INSTR_APP_PC_IMMED, instr_get_prev(inst)->flags)) &&
+                    TEST(FRAG_COARSE_GRAIN, f->flags) &&
+                    DYNAMO_OPTION(coarse_enable_freeze)) {
+                    instr_t *next = instr_get_next(inst);
+                    coarse_unit_add_reloc(
+                        get_fragment_coarse_info(f), pc,
+                        (next != NULL && TEST(INSTR_APP_PC_IMMED, next->flags))
+                            ? RELOC_PUSH_IMM32_MOV_HI
+                            : RELOC_PUSH_IMM32);
+                }
                 pc = instr_encode_to_copy(dcontext, inst, vmcode_get_writable_addr(pc),
                                           pc);
                 ASSERT(pc != NULL);
@@ -593,6 +593,10 @@ DECLARE_CXTSWPROT_VAR(static mutex_t unit_flush_lock, INIT_LOCK_FREE(unit_flush_
 
 static fcache_t *shared_cache_bb;
 static fcache_t *shared_cache_trace;
+/* For -hot_trace_cache: shared traces that were rebuilt after being deleted. */
+static fcache_t *shared_cache_hot_trace;
+/* For -hot_trace_cache: starts at 1 and is incremented by each reset. */
+static uint cache_generation;
 
 /* To locate the fcache_unit_t corresponding to a fragment or empty slot
  * we use an interval data structure rather than waste space with a
@@ -836,6 +840,12 @@ fcache_check_option_compatibility()
     return ret;
 }
 
+uint
+fcache_cache_generation(void)
+{
+    return cache_generation;
+}
+
 /* thread-shared initialization that should be repeated after a reset */
 static void
 fcache_reset_init(void)
@@ -858,6 +868,15 @@ fcache_reset_init(void)
         ASSERT(shared_cache_trace != NULL);
         LOG(GLOBAL, LOG_CACHE, 1, "Initial shared trace cache is %d KB\n",
             shared_cache_trace->init_unit_size / 1024);
+        if (DYNAMO_OPTION(hot_trace_cache)) {
+            shared_cache_hot_trace =
+                fcache_cache_init(GLOBAL_DCONTEXT, FRAG_SHARED | FRAG_IS_TRACE, true);
+            ASSERT(shared_cache_hot_trace != NULL);
+            DODEBUG({ shared_cache_hot_trace->name = "Hot trace (shared)"; });
+            cache_generation++;
+            LOG(GLOBAL, LOG_CACHE, 1, "Starting cache generation %u\n",
+                cache_generation);
+        }
     }
 }
 
@@ -1009,6 +1028,13 @@ fcache_stats_exit()
             fcache_cache_stats(GLOBAL_DCONTEXT, cache);
             PROTECT_CACHE(cache, unlock);
         }
+        cache = shared_cache_hot_trace;
+        if (cache != NULL) {
+            ASSERT_DO_NOT_OWN_MUTEX(cache->is_shared, &cache->lock);
+            PROTECT_CACHE(cache, lock);
+            fcache_cache_stats(GLOBAL_DCONTEXT, cache);
+            PROTECT_CACHE(cache, unlock);
+        }
     }
 }
 #endif
@@ -1042,6 +1068,10 @@ fcache_reset_free(void)
     if (DYNAMO_OPTION(shared_traces)) {
         fcache_cache_free(GLOBAL_DCONTEXT, shared_cache_trace, true);
         shared_cache_trace = NULL;
+        if (shared_cache_hot_trace != NULL) {
+            fcache_cache_free(GLOBAL_DCONTEXT, shared_cache_hot_trace, true);
+            shared_cache_hot_trace = NULL;
+        }
     }
 
     /* there may be units stranded on the to-flush list.
@@ -1393,6 +1423,15 @@ fcache_create_unit(dcontext_t *dcontext, fcache_t *cache, cache_pc pc, size_t si
              */
             if (commit_size > size)
                 commit_size = size;
+#ifdef LINUX
+            if (DYNAMO_OPTION(vmcode_huge_pages) && cache->is_shared) {
+                /* A partially committed or partially used huge page would be
+                 * split by differing protections, so use whole pages up front.
+                 */
+                size = ALIGN_FORWARD(size, VMCODE_HUGE_PAGE_SIZE);
+                commit_size = size;
+            }
+#endif
             which_vmm_t which = VMM_CACHE | VMM_REACHABLE;
             if (!cache->is_shared && cache->units == NULL) {
                 /* Tradeoff (i#4424): no guard pages on per-thread initial units, to
@@ -3613,9 +3652,14 @@ get_cache_for_new_fragment(dcontext_t *dcontext, fragment_t *f)
             ASSERT(((fcache_t *)info->cache)->coarse_info == info);
             return (fcache_t *)info->cache;
         } else {
-            if (IN_TRACE_CACHE(f->flags))
+            if (IN_TRACE_CACHE(f->flags)) {
+                if (shared_cache_hot_trace != NULL && TEST(FRAG_IS_TRACE, f->flags) &&
+                    monitor_trace_is_hot(dcontext, f->tag)) {
+                    STATS_INC(num_hot_cache_traces);
+                    return shared_cache_hot_trace;
+                }
                 return shared_cache_trace;
-            else
+            } else
                 return shared_cache_bb;
         }
     } else {
@@ -4113,6 +4157,8 @@ fcache_flush_all_caches()
     }
     if (DYNAMO_OPTION(shared_traces)) {
         fcache_mark_units_for_free(dcontext, shared_cache_trace);
+        if (shared_cache_hot_trace != NULL)
+            fcache_mark_units_for_free(dcontext, shared_cache_hot_trace);
     }
     /* FIXME: for thread-private units, should use a trigger in
      * vm_area_flush_fragments() to call a routine here that frees all but
@@ -137,6 +137,11 @@ void
 fcache_reset_all_caches_proactively(uint target);
 bool
 schedule_reset(uint target);
+/* For -hot_trace_cache: the number of cache generations so far, counting the
+ * initial caches as the first.
+ */
+uint
+fcache_cache_generation(void);
 
 void
 fcache_low_on_memory(void);
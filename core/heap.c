@@ -781,10 +781,24 @@ report_w_xor_x_fatal_error_and_exit(void)
     ASSERT_NOT_REACHED();
 }
 
+/* The alignment of vmcode's start_addr.  For -vmcode_huge_pages we align to a huge
+ * page so that huge-page-aligned block indices are huge-page-aligned addresses.
+ */
+static size_t
+vmcode_alignment(void)
+{
+#ifdef LINUX
+    if (DYNAMO_OPTION(vmcode_huge_pages))
+        return MAX(DYNAMO_OPTION(vmm_block_size), VMCODE_HUGE_PAGE_SIZE);
+#endif
+    return DYNAMO_OPTION(vmm_block_size);
+}
+
 static void
 vmm_place_vmcode(vm_heap_t *vmh, /*INOUT*/ size_t *size, heap_error_code_t *error_code)
 {
     ptr_uint_t preferred = 0;
+    size_t align = vmcode_alignment();
 #ifdef X64
     /* -heap_in_lower_4GB takes top priority and has already set heap_allowable_region_*.
      * Next comes -vm_base_near_app.  It will fail for -vm_size=2G, which we document.
@@ -811,8 +825,8 @@ vmm_place_vmcode(vm_heap_t *vmh, /*INOUT*/ size_t *size, heap_error_code_t *erro
             byte *reach_end =
                 MIN(REACHABLE_32BIT_END(app_base, app_end), heap_allowable_region_end);
             if (reach_base < reach_end) {
-                size_t add_for_align = DYNAMO_OPTION(vmm_block_size);
-                if (DYNAMO_OPTION(vmm_block_size) == PAGE_SIZE) {
+                size_t add_for_align = align;
+                if (align == PAGE_SIZE) {
                     /* No need for extra space for alignment. */
                     add_for_align = 0;
                 }
@@ -821,8 +835,8 @@ vmm_place_vmcode(vm_heap_t *vmh, /*INOUT*/ size_t *size, heap_error_code_t *erro
                     (void *)ALIGN_BACKWARD(reach_end, PAGE_SIZE), *size + add_for_align,
                     error_code, true /*+x*/);
                 if (vmh->alloc_start != NULL) {
-                    vmh->start_addr = (heap_pc)ALIGN_FORWARD(
-                        vmh->alloc_start, DYNAMO_OPTION(vmm_block_size));
+                    vmh->alloc_size = *size + add_for_align;
+                    vmh->start_addr = (heap_pc)ALIGN_FORWARD(vmh->alloc_start, align);
                     if (add_for_align == 0) {
                         ASSERT(ALIGNED(vmh->alloc_start, DYNAMO_OPTION(vmm_block_size)));
                         ASSERT(vmh->start_addr == vmh->alloc_start);
@@ -849,7 +863,7 @@ vmm_place_vmcode(vm_heap_t *vmh, /*INOUT*/ size_t *size, heap_error_code_t *erro
                      get_random_offset(DYNAMO_OPTION(vm_max_offset) /
                                        DYNAMO_OPTION(vmm_block_size)) *
                          DYNAMO_OPTION(vmm_block_size));
-        preferred = ALIGN_FORWARD(preferred, OS_ALLOC_GRANULARITY);
+        preferred = ALIGN_FORWARD(preferred, MAX(OS_ALLOC_GRANULARITY, align));
         /* overflow check: w/ vm_base shouldn't happen so debug-only check */
         ASSERT(!POINTER_OVERFLOW_ON_ADD(preferred, *size));
         /* let's assume a single chunk is sufficient to reserve */
@@ -877,19 +891,18 @@ vmm_place_vmcode(vm_heap_t *vmh, /*INOUT*/ size_t *size, heap_error_code_t *erro
          * syslog or assert here
          */
         /* need extra size to ensure alignment */
-        vmh->alloc_size = *size + DYNAMO_OPTION(vmm_block_size);
+        vmh->alloc_size = *size + align;
 #ifdef X64
         /* PR 215395, make sure allocation satisfies heap reachability contraints */
         vmh->alloc_start = os_heap_reserve_in_region(
             (void *)ALIGN_FORWARD(heap_allowable_region_start, PAGE_SIZE),
-            (void *)ALIGN_BACKWARD(heap_allowable_region_end, PAGE_SIZE),
-            *size + DYNAMO_OPTION(vmm_block_size), error_code, true /*+x*/);
+            (void *)ALIGN_BACKWARD(heap_allowable_region_end, PAGE_SIZE), *size + align,
+            error_code, true /*+x*/);
 #else
-        vmh->alloc_start = (heap_pc)os_heap_reserve(
-            NULL, *size + DYNAMO_OPTION(vmm_block_size), error_code, true /*+x*/);
+        vmh->alloc_start =
+            (heap_pc)os_heap_reserve(NULL, *size + align, error_code, true /*+x*/);
 #endif
-        vmh->start_addr =
-            (heap_pc)ALIGN_FORWARD(vmh->alloc_start, DYNAMO_OPTION(vmm_block_size));
+        vmh->start_addr = (heap_pc)ALIGN_FORWARD(vmh->alloc_start, align);
         LOG(GLOBAL, LOG_HEAP, 1,
             "vmm_heap_unit_init unable to allocate at preferred=" PFX
             " letting OS place sz=%dM addr=" PFX "\n",
@@ -932,8 +945,29 @@ vmm_place_vmcode(vm_heap_t *vmh, /*INOUT*/ size_t *size, heap_error_code_t *erro
         request_region_be_heap_reachable(vmh->start_addr, *size);
     }
 #endif
-    ASSERT(ALIGNED(vmh->start_addr, DYNAMO_OPTION(vmm_block_size)));
+    ASSERT(ALIGNED(vmh->start_addr, align));
+}
+
+#ifdef LINUX
+/* Requests huge pages for vmcode, which vmm_place_vmcode() aligned for them.
+ * Under -satisfy_w_xor_x the memfd's pages are allocated through whichever view
+ * faults first, so we mark both views.
+ */
+static void
+vmcode_request_huge_pages(vm_heap_t *vmh, size_t size)
+{
+    heap_error_code_t error_code;
+    bool ok = os_heap_request_huge_pages(vmh->start_addr, size, &error_code);
+    if (ok && DYNAMO_OPTION(satisfy_w_xor_x)) {
+        ok = os_heap_request_huge_pages(heapmgt->vmcode_writable_base, size,
+                                        &error_code);
+    }
+    if (!ok) {
+        SYSLOG_INTERNAL_WARNING("Failed to request huge pages for vmcode: error %d",
+                                error_code);
+    }
 }
+#endif
 
 /* Does not return. */
 static void
@@ -972,7 +1006,13 @@ vmm_heap_unit_init(vm_heap_t *vmh, size_t size, bool is_vmcode, const char *name
          * controlled by runtime options.
          */
         if (DYNAMO_OPTION(satisfy_w_xor_x)) {
-            heapmgt->dual_map_file = os_create_memory_file(MEMORY_FILE_NAME, size);
+            size_t file_size = size;
+#ifdef LINUX
+            /* vmm_place_vmcode() may map the file from below the aligned start. */
+            if (DYNAMO_OPTION(vmcode_huge_pages))
+                file_size += vmcode_alignment();
+#endif
+            heapmgt->dual_map_file = os_create_memory_file(MEMORY_FILE_NAME, file_size);
             if (heapmgt->dual_map_file == INVALID_FILE) {
                 report_w_xor_x_fatal_error_and_exit();
                 ASSERT_NOT_REACHED();
@@ -991,12 +1031,17 @@ vmm_heap_unit_init(vm_heap_t *vmh, size_t size, bool is_vmcode, const char *name
                 report_low_on_memory(VMM_CACHE | VMM_REACHABLE, OOM_INIT, error_code);
                 ASSERT_NOT_REACHED();
             }
-            heapmgt->vmcode_writable_base = (heap_pc)ALIGN_FORWARD(
-                heapmgt->vmcode_writable_alloc, DYNAMO_OPTION(vmm_block_size));
+            /* Both views must be at the same offset into the file. */
+            heapmgt->vmcode_writable_base =
+                heapmgt->vmcode_writable_alloc + (vmh->start_addr - vmh->alloc_start);
             LOG(GLOBAL, LOG_HEAP, 1,
                 "vmm_heap_unit_init vmcode+w reservation: [" PFX "," PFX ")\n",
                 heapmgt->vmcode_writable_base, heapmgt->vmcode_writable_base + size);
         }
+#ifdef LINUX
+        if (DYNAMO_OPTION(vmcode_huge_pages) && vmh->start_addr != NULL)
+            vmcode_request_huge_pages(vmh, size);
+#endif
     } else {
         /* These days every OS provides ASLR, so we do not bother to do our own
          * for this second reservation and rely on the OS.
@@ -1264,6 +1309,11 @@ has_guard_pages(which_vmm_t which)
         return false;
     if (TEST(VMM_PER_THREAD, which) && !DYNAMO_OPTION(per_thread_guard_pages))
         return false;
+#ifdef LINUX
+    /* A guard page would split the unit's huge page. */
+    if (TEST(VMM_CACHE, which) && DYNAMO_OPTION(vmcode_huge_pages))
+        return false;
+#endif
     return true;
 }
 
@@ -1408,6 +1458,7 @@ vmm_heap_reserve_blocks(vm_heap_t *vmh, size_t size_in, byte *base, which_vmm_t
     uint first_block;
     size_t size;
     uint must_start;
+    uint align_blocks = 1;
 
     size = ALIGN_FORWARD(size_in, DYNAMO_OPTION(vmm_block_size));
     ASSERT_TRUNCATE(request, uint, size / DYNAMO_OPTION(vmm_block_size));
@@ -1417,6 +1468,13 @@ vmm_heap_reserve_blocks(vm_heap_t *vmh, size_t size_in, byte *base, which_vmm_t
         must_start = vmm_addr_to_block(vmh, base);
     else
         must_start = UINT_MAX;
+#ifdef LINUX
+    /* Whole-huge-page cache units must start on a huge page to be mapped by one. */
+    if (DYNAMO_OPTION(vmcode_huge_pages) && TEST(VMM_CACHE, which) &&
+        vmh == &heapmgt->vmcode && ALIGNED(size, VMCODE_HUGE_PAGE_SIZE) &&
+        ALIGNED(VMCODE_HUGE_PAGE_SIZE, DYNAMO_OPTION(vmm_block_size)))
+        align_blocks = VMCODE_HUGE_PAGE_SIZE / DYNAMO_OPTION(vmm_block_size);
+#endif
 
     LOG(GLOBAL, LOG_HEAP, 2,
         "vmm_heap_reserve_blocks %s: size=%d => %d in blocks=%d free_blocks=%d\n",
@@ -1428,7 +1486,8 @@ vmm_heap_reserve_blocks(vm_heap_t *vmh, size_t size_in, byte *base, which_vmm_t
         return NULL;
     }
     first_block =
-        bitmap_allocate_blocks(vmh->blocks, vmh->num_blocks, request, must_start);
+        bitmap_allocate_blocks(vmh->blocks, vmh->num_blocks, request, must_start,
+                               align_blocks);
     if (first_block != BITMAP_NOT_FOUND) {
         vmh->num_free_blocks -= request;
     }
@@ -1718,7 +1777,7 @@ vmm_heap_commit(vm_addr_t p, size_t size, uint prot, heap_error_code_t *error_co
              * any cost here.
              */
             size_t map_size = size;
-            size_t map_offs = p - vmh->start_addr;
+            size_t map_offs = p - vmh->alloc_start;
             vm_addr_t map_addr =
                 os_map_file(heapmgt->dual_map_file, &map_size, map_offs, p, prot,
                             MAP_FILE_VMM_COMMIT | MAP_FILE_FIXED);
@@ -2952,7 +3011,7 @@ heap_mmap_ex(size_t reserve_size, size_t commit_size, uint prot, bool guarded,
 #endif
     /* We rely on this for freeing _post_stack in absence of dcontext */
     ASSERT(!DYNAMO_OPTION(vm_reserve) || !DYNAMO_OPTION(stack_shares_gencode) ||
-           (ptr_uint_t)p - (guarded ? (GUARD_PAGE_ADJUSTMENT / 2) : 0) ==
+           (ptr_uint_t)p - ((guarded && has_guard_pages(which)) ? PAGE_SIZE : 0) ==
                ALIGN_BACKWARD(p, DYNAMO_OPTION(vmm_block_size)) ||
            at_reset_at_vmm_limit(vmheap_for_which(which)));
     LOG(GLOBAL, LOG_HEAP, 2, "heap_mmap: %d bytes [/ %d] @ " PFX "\n", commit_size,
@@ -357,6 +357,13 @@ global_unprotected_heap_free(void *p, size_t size HEAPACCT(which_heap_t which));
 
 #define MIN_VMM_BLOCK_SIZE (4U * 1024)
 
+#ifdef LINUX
+/* The PMD-level transparent huge page size targeted by -vmcode_huge_pages.  The
+ * option is only supported with 4K base pages, where this is 2MB.
+ */
+#    define VMCODE_HUGE_PAGE_SIZE (2U * 1024 * 1024)
+#endif
+
 /* special heap of same-sized blocks that avoids global locks */
 void *
 special_heap_init(uint block_size, bool use_lock, bool executable, bool persistent);
@@ -204,6 +204,11 @@ enum {
     INSTR_RIP_REL_VALID = 0x20000000,
     /* PR 267260: distinguish our own mangling from client-added instrs */
     INSTR_OUR_MANGLING = 0x40000000,
+    /* Our mangling materialized an absolute application pc as an immediate
+     * (the pushed return address of a mangled call).  Coarse-grain units
+     * record these so persisted caches can be relocated to a new module base.
+     */
+    INSTR_APP_PC_IMMED = 0x80000000,
 };
 
 #define DR_TUPLE_TYPE_BITS 4
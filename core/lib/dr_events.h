@@ -1713,6 +1713,18 @@ DR_API
 size_t
 dr_persist_size(void *perscxt);
 
+DR_API
+/**
+ * Takes in the \p perscxt opaque parameter passed to various persistence
+ * events and returns the displacement of the current module base from the
+ * base the module had when the file being resurrected was written.  It is
+ * 0 when persisting and when the module loaded at its old base.  Clients
+ * that store absolute application addresses in persisted data or code
+ * should add this value to them in their resurrect callbacks.
+ */
+ptr_int_t
+dr_persist_module_shift(void *perscxt);
+
 DR_API
 /**
  * Takes in the \p perscxt opaque parameter passed to various
@@ -1738,7 +1750,8 @@ DR_API
  *
  * For each callback, the \p perscxt parameter can be passed to the routines
  * dr_persist_start(), dr_persist_size(), and dr_fragment_persistable() to
- * identify the region of code being persisted.
+ * identify the region of code being persisted, and to
+ * dr_persist_module_shift() to relocate resurrected addresses.
  *
  * @param[in] func_size The function to call to determine the size needed for
  *   persisted data.  The \p file_offs parameter indicates the offset from the start
@@ -1810,7 +1823,8 @@ DR_API
  *
  * For each callback, the \p perscxt parameter can be passed to the routines
  * dr_persist_start(), dr_persist_size(), and dr_fragment_persistable() to
- * identify the region of code being persisted.
+ * identify the region of code being persisted, and to
+ * dr_persist_module_shift() to relocate resurrected addresses.
  *
  * @param[in] func_size  The function to call to determine the size needed
  *   for persisted code.  The \p file_offs parameter indicates the offset from the start
@@ -1880,7 +1894,8 @@ DR_API
  *
  * For each callback, the \p perscxt parameter can be passed to the routines
  * dr_persist_start(), dr_persist_size(), and dr_fragment_persistable() to
- * identify the region of code being persisted.
+ * identify the region of code being persisted, and to
+ * dr_persist_module_shift() to relocate resurrected addresses.
  *
  * @param[in] func_size  The function to call to determine the size needed
  *   for persisted data.  The \p file_offs parameter indicates the offset from the start
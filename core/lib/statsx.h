@@ -393,6 +393,7 @@ STATS_DEF("App writes emulated un-successfully", num_emulated_write_failures)
 STATS_DEF("Fragments generated, bb and trace", num_fragments)
 RSTATS_DEF("Basic block fragments generated", num_bbs)
 RSTATS_DEF("Trace fragments generated", num_traces)
+STATS_DEF("Trace fragments placed in the hot trace cache", num_hot_cache_traces)
 #ifdef X64
 STATS_DEF("32-bit basic block fragments generated", num_32bit_bbs)
 STATS_DEF("32-bit trace fragments generated", num_32bit_traces)
@@ -653,6 +654,7 @@ STATS_DEF("Persisted cache load error: version mismatch", perscache_version_mism
 STATS_DEF("Persisted cache load error: md5 mismatch", perscache_md5_mismatch)
 STATS_DEF("Persisted cache load error: modinfo mismatch", perscache_modinfo_mismatch)
 STATS_DEF("Persisted cache load error: modbase mismatch", perscache_base_mismatch)
+STATS_DEF("Persisted cache load error: bad relocation", perscache_reloc_error)
 STATS_DEF("Persisted cache load error: region mismatch", perscache_region_mismatch)
 STATS_DEF("Persisted cache load error: tls offs mismatch", perscache_tls_mismatch)
 STATS_DEF("Persisted cache load error: no trace support", perscache_trace_mismatch)
@@ -664,6 +666,7 @@ STATS_DEF("Persisted cache load error: hotp conflict", perscache_hotp_conflict)
 STATS_DEF("Persisted cache hotp conflict avoided", perscache_hotp_conflict_avoided)
 STATS_DEF("Persisted cache hotp nudge flush avoided", perscache_hotp_flush_avoided)
 #endif
+STATS_DEF("Persisted cache relocations applied", perscache_relocs_applied)
 STATS_DEF("Persisted cache ibl entries prefilled", perscache_ibl_prefill)
 STATS_DEF("Persisted cache stub unprot for link", pcache_unprot_link)
 STATS_DEF("Persisted cache stub unprot for unlink", pcache_unprot_unlink)
@@ -1009,6 +1012,7 @@ STATS_DEF("Interoperability fixups for thread_policy", num_used_thread_policy)
 STATS_DEF("Number of safe reads", num_safe_reads)
 STATS_DEF("Number of safe writes", num_safe_writes)
 STATS_DEF("Number of vmarea vector resize reallocations", num_vmareas_resized)
+STATS_DEF("Vmarea vector lookups satisfied by the last hit", vmarea_last_hit_lookups)
 STATS_DEF("Number of vmarea vector resize synch fixups", num_vmareas_resize_synch)
 STATS_DEF("Peak vmarea vector length", max_vmareas_length)
 STATS_DEF("Peak dynamo areas vector length", max_DRareas_length)
@@ -1237,6 +1241,7 @@ STATS_DEF("Clean Call inlined", cleancall_inlined)
 STATS_DEF("Clean Call [xyz]mm skipped", cleancall_simd_skipped)
 #ifdef X86
 STATS_DEF("Clean Call mask skipped", cleancall_opmask_skipped)
+STATS_DEF("Clean Call callees with SIMD usage from scan", cleancall_simd_scanned)
 #endif
 STATS_DEF("Clean Call aflags save skipped", cleancall_aflags_save_skipped)
 STATS_DEF("Clean Call aflags clear skipped", cleancall_aflags_clear_skipped)
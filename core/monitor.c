@@ -381,11 +381,32 @@ thcounter_add(dcontext_t *dcontext, app_pc tag)
                           sizeof(trace_head_counter_t) HEAPACCT(ACCT_THCOUNTER));
         e->tag = tag;
         e->counter = 0;
+        e->trace_generation = 0;
         generic_hash_add(dcontext, md->thead_table, (ptr_uint_t)tag, e);
     }
     return e;
 }
 
+bool
+monitor_trace_is_hot(dcontext_t *dcontext, app_pc tag)
+{
+    monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
+    trace_head_counter_t *ctr;
+    uint generation;
+    if (md->thead_table == NULL)
+        return false;
+    ctr = thcounter_lookup(dcontext, tag);
+    if (ctr == NULL || ctr->trace_generation == 0)
+        return false;
+    /* The head counter restarts from trace_counter_on_delete once the earlier trace
+     * is gone, so getting here means the head executed trace_threshold more times
+     * since then.  A head whose last trace is older than the previous generation
+     * only recurs now and then, so we leave it with the cold traces.
+     */
+    generation = fcache_cache_generation();
+    return ctr->trace_generation == generation || ctr->trace_generation + 1 == generation;
+}
+
 /* Deletes all trace head entries in [start,end) */
 void
 thcounter_range_remove(dcontext_t *dcontext, app_pc start, app_pc end)
@@ -1479,6 +1500,12 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
         d_r_mutex_unlock(&trace_building_lock);
 
     RSTATS_INC(num_traces);
+    if (DYNAMO_OPTION(hot_trace_cache)) {
+        /* Custom traces may not have a counter. */
+        trace_head_counter_t *ctr = thcounter_lookup(dcontext, tag);
+        if (ctr != NULL)
+            ctr->trace_generation = fcache_cache_generation();
+    }
     DOSTATS(
         { IF_X86_64(if (FRAG_IS_32(trace_f->flags)) { STATS_INC(num_32bit_traces); }) });
     STATS_ADD(num_bbs_in_all_traces, md->num_blks);
@@ -99,6 +99,11 @@ bool
 is_building_trace(dcontext_t *dcontext);
 app_pc
 cur_trace_tag(dcontext_t *dcontext);
+/* For -hot_trace_cache: returns whether a trace being emitted for tag replaces one
+ * this thread built from the same head in this or the previous cache generation.
+ */
+bool
+monitor_trace_is_hot(dcontext_t *dcontext, app_pc tag);
 void *
 cur_trace_vmlist(dcontext_t *dcontext);
 
@@ -135,6 +140,10 @@ mangle_trace_at_end(void);
 typedef struct _trace_head_counter_t {
     app_pc tag;
     uint counter;
+    /* The fcache generation in which this thread last emitted a trace from this
+     * head, or 0 if it never has.  Fits in the padding after counter for 64-bit.
+     */
+    uint trace_generation;
 } trace_head_counter_t;
 
 typedef struct _trace_bb_build_t {
@@ -1877,6 +1877,19 @@ check_option_compatibility_helper(int recurse_count)
         dynamo_options.satisfy_w_xor_x = false;
         changed_options = true;
     }
+#    endif
+    if (DYNAMO_OPTION(hot_trace_cache) && !DYNAMO_OPTION(shared_traces)) {
+        USAGE_ERROR("-hot_trace_cache requires -shared_traces, disabling");
+        dynamo_options.hot_trace_cache = false;
+        changed_options = true;
+    }
+#    ifdef LINUX
+    if (DYNAMO_OPTION(vmcode_huge_pages) &&
+        (!DYNAMO_OPTION(vm_reserve) || PAGE_SIZE != 4096)) {
+        USAGE_ERROR("-vmcode_huge_pages requires -vm_reserve and 4K pages, disabling");
+        dynamo_options.vmcode_huge_pages = false;
+        changed_options = true;
+    }
 #    endif
 #    ifdef WINDOWS
     /* In theory ignore syscalls should work for int system calls, and also for
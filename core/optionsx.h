@@ -568,6 +568,15 @@ OPTION_DEFAULT(bool, cleancall_ignore_eflags, true,
                "skip eflags clear code with assumption that clean call does not rely on "
                "cleared eflags")
 #ifdef X86
+/* When a clean callee is too complex for the analysis above (most commonly
+ * because it makes calls), scan the code reachable from it through direct
+ * branches and calls for SIMD and mask register usage, and save only those
+ * registers.  The scan gives up on indirect branches and on calls into DR.
+ */
+OPTION_DEFAULT(bool, cleancall_scan_simd, false,
+               "save only the SIMD registers reachable code uses for complex clean callees")
+#endif
+#ifdef X86
 /* TLS handling summary:
  * On X86, we use -mangle_app_seg to control if we will steal app's TLS.
  * If -mangle_app_seg is true, DR steals app's TLS and monitors/mangles all
@@ -1422,8 +1431,17 @@ OPTION_DEFAULT(uint_size, cache_shared_trace_unit_max, (56 * 1024),
 OPTION_DEFAULT(uint_size, cache_shared_trace_unit_quadruple,
                (56 * 1024), /* FIXME: should be 32*1024 */
                "shared trace cache units are grown by 4X until this size, in KB or MB")
-/* default size is in Kilobytes, Examples: 4, 4k, 4m, or 0 for unlimited */
+/* A shared trace whose head reaches the trace threshold again after its earlier
+ * trace was deleted, by a flush in the current cache generation or by the reset
+ * that started it, has stayed hot across that deletion.  Such traces are emitted
+ * into a separate cache so that long-lived hot code is laid out contiguously
+ * instead of being interleaved with traces for transient phases.  Combine with
+ * -reset_at_fragment_count or -reset_every_nth_pending to pick the layout point.
+ */
+OPTION_DEFAULT(bool, hot_trace_cache, false,
+               "emit shared traces rebuilt after deletion into a separate hot cache")
 
+/* default size is in Kilobytes, Examples: 4, 4k, 4m, or 0 for unlimited */
 OPTION(uint_size, cache_coarse_bb_max, "max size of coarse bb cache, in KB or MB")
 /* override the default coarse bb fragment cache size */
 /* default size is in Kilobytes, Examples: 4, 4k, 4m, or 0 for unlimited */
@@ -1684,6 +1702,17 @@ OPTION_DEFAULT(bool, reachable_client, IF_STATIC_LIBRARY_ELSE(false, true),
  */
 OPTION_DEFAULT(bool, satisfy_w_xor_x, false,
                "avoids ever allocating memory that is both writable and executable.")
+#ifdef LINUX
+/* The vmcode reservation is placed on a huge page boundary and marked
+ * MADV_HUGEPAGE, and thread-shared cache units are rounded up to whole huge pages
+ * that are committed up front and carry no guard pages, so each unit can be
+ * mapped with a single iTLB entry.  Under -satisfy_w_xor_x the memfd backing
+ * both views only gets huge pages if the kernel's
+ * transparent_hugepage/shmem_enabled setting allows it.
+ */
+OPTION_DEFAULT(bool, vmcode_huge_pages, false,
+               "back the code cache with transparent huge pages")
+#endif
 /* FIXME: the lower 16 bits are ignored - so this here gives us
  * 12bits of randomness.  Could make it larger if we verify as
  * collision free the whole range [vm_base, * vm_base+vm_size+vm_max_offset)
@@ -2526,8 +2555,9 @@ OPTION_DEFAULT(bool, persist_touch_stubs, true,
 /* case 8640: relies on -executable_{if_rx_text,after_load} */
 PC_OPTION_DEFAULT(bool, coarse_merge_iat, true,
                   "merge iat page into coarse unit at +rx transition")
-/* PR 214084: avoid push of abs addr in pcache
- * TODO: should auto-enable (on Linux or Vista+ only?) for -coarse_enable_freeze?
+/* PR 214084: avoid push of abs addr in pcache.  No longer needed for
+ * correctness as such pushes are now relocated when a pcache is loaded at a
+ * different module base.
  */
 PC_OPTION_DEFAULT(bool, coarse_split_calls, false,
                   "make all calls fine-grained and in own bbs")
@@ -2555,8 +2585,7 @@ OPTION_COMMAND(
             options->coarse_freeze_at_exit = true;
             options->coarse_freeze_at_unload = true;
             options->use_persisted = true;
-            /* these two are for correctness */
-            IF_UNIX(options->coarse_split_calls = true;)
+            /* this is for correctness: we only relocate call->push immeds */
             IF_X64(options->coarse_split_riprel = true;)
             /* FIXME: i#660: not compatible w/ Probe API */
             DISABLE_PROBE_API(options);
@@ -3197,9 +3226,9 @@ OPTION_DEFAULT_INTERNAL(
 
 /* for stress testing can use 1 */
 OPTION_DEFAULT_INTERNAL(uint, vmarea_initial_size, 100, "initial vmarea vector size")
-/* FIXME: case 4471 should start smaller and double instead */
+/* Minimum growth; large vectors grow by half their length (case 4471). */
 OPTION_DEFAULT_INTERNAL(uint, vmarea_increment_size, 100,
-                        "incremental vmarea vector size")
+                        "minimum incremental vmarea vector size")
 OPTION_INTERNAL(uint_addr, stress_fake_userva,
                 "pretend system address space starts at this address (case 9022)")
 
@@ -164,6 +164,11 @@ os_heap_commit(void *p, size_t size, uint prot, heap_error_code_t *error_code);
 /* decommit previously committed page, so it is reserved for future reuse */
 void
 os_heap_decommit(void *p, size_t size, heap_error_code_t *error_code);
+#ifdef LINUX
+/* hints that reserved pages be backed by transparent huge pages */
+bool
+os_heap_request_huge_pages(void *p, size_t size, heap_error_code_t *error_code);
+#endif
 /* frees size bytes starting at address p (note - on windows the entire allocation
  * containing p is freed and size is ignored) */
 void
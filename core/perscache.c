@@ -62,6 +62,24 @@
 /* in general we want new data sections aligned to keep hashtable aligned */
 #define CLIENT_ALIGNMENT (sizeof(app_pc))
 
+/* Relocated "call->push immed" manglings: a push imm32, followed for
+ * RELOC_PUSH_IMM32_MOV_HI on x64 by a "mov dword [rsp+4], imm32" holding the
+ * top half.  The opcodes are only used to sanity-check the recorded kind.
+ */
+#define RELOC_PUSH_IMM32_OPCODE 0x68
+#define RELOC_PUSH_IMM32_LENGTH 5
+#define RELOC_MOV_HI_OPCODE 0xc7
+#define RELOC_MOV_HI_LENGTH 8
+#define RELOC_HTABLE_INIT_SIZE 6
+/* Each reloc_vec entry holds a cache offset with its coarse_reloc_kind_t on top */
+#define RELOC_KIND_SHIFT 30
+#define RELOC_OFFS_MASK ((1U << RELOC_KIND_SHIFT) - 1)
+#define RELOC_ENTRY(offs, kind) ((offs) | ((uint)(kind) << RELOC_KIND_SHIFT))
+#define RELOC_ENTRY_OFFS(entry) ((entry)&RELOC_OFFS_MASK)
+#define RELOC_ENTRY_KIND(entry) ((coarse_reloc_kind_t)((entry) >> RELOC_KIND_SHIFT))
+/* pads the persisted reloc array out to CLIENT_ALIGNMENT; never a valid kind */
+#define RELOC_PAD UINT_MAX
+
 /* used while merging */
 typedef struct _jmp_tgt_list_t {
     app_pc tag;
@@ -280,6 +298,10 @@ coarse_unit_reset_free_internal(dcontext_t *dcontext, coarse_info_t *info,
     if (unlink)
         coarse_unit_unlink(dcontext, info);
     fragment_coarse_htable_free(info);
+    if (info->reloc_htable != NULL) {
+        generic_hash_destroy(GLOBAL_DCONTEXT, (generic_table_t *)info->reloc_htable);
+        info->reloc_htable = NULL;
+    }
     coarse_stubs_delete(info);
     fcache_coarse_cache_delete(dcontext, info);
     if (info->in_use && abdicate_primary)
@@ -325,6 +347,11 @@ coarse_unit_reset_free_internal(dcontext_t *dcontext, coarse_info_t *info,
             ASSERT(info->stubs_start_pc != NULL);
             ASSERT(info->mmap_ro_size == 0);
             heap_munmap(info->cache_start_pc, info->mmap_size, VMM_CACHE | VMM_REACHABLE);
+            /* Persisted units point into their mmaps; ours are from DR heap */
+            if (info->reloc_vec != NULL) {
+                HEAP_ARRAY_FREE(GLOBAL_DCONTEXT, info->reloc_vec, uint,
+                                info->reloc_vec_num, ACCT_VMAREAS, PROTECTED);
+            }
             if (info->has_persist_info) {
                 /* Persisted units point at their mmaps for these structures;
                  * non-persisted dynamically allocate them from DR heap.
@@ -374,6 +401,67 @@ coarse_unit_reset_free(dcontext_t *dcontext, coarse_info_t *info, bool have_lock
                                     true /*need_info_lock*/);
 }
 
+void
+coarse_unit_add_reloc(coarse_info_t *info, cache_pc pc, coarse_reloc_kind_t kind)
+{
+    generic_table_t *reloc_htable;
+    ASSERT(info != NULL && !info->frozen);
+    ASSERT(kind == RELOC_PUSH_IMM32 || kind == RELOC_PUSH_IMM32_MOV_HI);
+    IF_NOT_X64(ASSERT(kind != RELOC_PUSH_IMM32_MOV_HI));
+    if (info->reloc_htable == NULL) {
+        /* lazily allocated, like pclookup_last_htable */
+        d_r_mutex_lock(&info->lock);
+        if (info->reloc_htable == NULL) {
+            reloc_htable = generic_hash_create(
+                GLOBAL_DCONTEXT, RELOC_HTABLE_INIT_SIZE, 80 /* load factor */,
+                HASHTABLE_ENTRY_SHARED | HASHTABLE_SHARED |
+                    HASHTABLE_RELAX_CLUSTER_CHECKS,
+                NULL _IF_DEBUG("coarse reloc table"));
+            /* Only when fully initialized can we set it, as we hold no lock for it */
+            info->reloc_htable = (void *)reloc_htable;
+        }
+        d_r_mutex_unlock(&info->lock);
+    }
+    reloc_htable = (generic_table_t *)info->reloc_htable;
+    TABLE_RWLOCK(reloc_htable, write, lock);
+    /* the payload is the kind, which is never 0 (NULL) */
+    generic_hash_add(GLOBAL_DCONTEXT, reloc_htable, (ptr_uint_t)pc,
+                     (void *)(ptr_uint_t)kind);
+    TABLE_RWLOCK(reloc_htable, write, unlock);
+}
+
+/* Allocates room for max relocations in the frozen unit info */
+static void
+coarse_reloc_vec_create(coarse_info_t *info, uint max)
+{
+    ASSERT(info->frozen && info->reloc_vec == NULL);
+    info->reloc_vec_num = 0;
+    if (max > 0) {
+        info->reloc_vec =
+            HEAP_ARRAY_ALLOC(GLOBAL_DCONTEXT, uint, max, ACCT_VMAREAS, PROTECTED);
+    }
+}
+
+/* Shrinks info's relocation array from its allocated size of max elements
+ * down to the number actually used, so it can be freed by count alone.
+ */
+static void
+coarse_reloc_vec_trim(coarse_info_t *info, uint max)
+{
+    uint *vec = info->reloc_vec;
+    ASSERT(info->reloc_vec_num <= max);
+    if (vec == NULL || info->reloc_vec_num == max)
+        return;
+    if (info->reloc_vec_num == 0)
+        info->reloc_vec = NULL;
+    else {
+        info->reloc_vec = HEAP_ARRAY_ALLOC(GLOBAL_DCONTEXT, uint, info->reloc_vec_num,
+                                           ACCT_VMAREAS, PROTECTED);
+        memcpy(info->reloc_vec, vec, info->reloc_vec_num * sizeof(uint));
+    }
+    HEAP_ARRAY_FREE(GLOBAL_DCONTEXT, vec, uint, max, ACCT_VMAREAS, PROTECTED);
+}
+
 /* currently only one such directory expected matching
  * primary user token, see case 8812
  */
@@ -753,6 +841,11 @@ coarse_unit_freeze(dcontext_t *dcontext, coarse_info_t *info, bool in_place)
     IF_X64(ASSERT(CHECK_TRUNCATE_TYPE_int(frozen->mmap_size)));
     /* Same bounds, so same persistence privileges */
     frozen->primary_for_module = info->primary_for_module;
+    if (info->reloc_htable != NULL) {
+        /* an upper bound: fragments may have been replaced since emission */
+        freeze_info->reloc_vec_max = ((generic_table_t *)info->reloc_htable)->entries;
+        coarse_reloc_vec_create(frozen, freeze_info->reloc_vec_max);
+    }
 
     freeze_info->stubs_start_pc = coarse_stubs_create(
         frozen, freeze_info->cache_start_pc + frozen_cache_size, frozen_stub_size);
@@ -787,6 +880,7 @@ coarse_unit_freeze(dcontext_t *dcontext, coarse_info_t *info, bool in_place)
 
     fragment_coarse_unit_freeze(dcontext, freeze_info);
     ASSERT(freeze_info->pending == NULL);
+    coarse_reloc_vec_trim(frozen, freeze_info->reloc_vec_max);
     ASSERT(freeze_info->cache_cur_pc <= freeze_info->cache_start_pc + frozen_cache_size);
     ASSERT(freeze_info->stubs_cur_pc <= freeze_info->stubs_start_pc + frozen_stub_size);
     if (frozen->fcache_return_prefix + frozen_stub_size == freeze_info->stubs_cur_pc)
@@ -858,6 +952,35 @@ coarse_unit_freeze_exit:
  * jump operands are 4 bytes and are at the end of the instruction.
  */
 
+/* If the instr at src_pc in the fragment being transferred from src_body is a
+ * recorded relocation, adds its new location and kind to the frozen unit's array.
+ * Dst offsets only increase as fragments are appended, keeping the array sorted.
+ */
+static void
+transfer_coarse_reloc(coarse_freeze_info_t *freeze_info, cache_pc src_pc,
+                      cache_pc src_body)
+{
+    generic_table_t *reloc_htable =
+        (generic_table_t *)freeze_info->src_info->reloc_htable;
+    coarse_info_t *dst = freeze_info->dst_info;
+    coarse_reloc_kind_t kind;
+    ptr_uint_t offs;
+    if (reloc_htable == NULL)
+        return;
+    TABLE_RWLOCK(reloc_htable, read, lock);
+    kind = (coarse_reloc_kind_t)(ptr_uint_t)generic_hash_lookup(
+        GLOBAL_DCONTEXT, reloc_htable, (ptr_uint_t)src_pc);
+    TABLE_RWLOCK(reloc_htable, read, unlock);
+    if (kind == 0)
+        return;
+    ASSERT(dst->reloc_vec_num < freeze_info->reloc_vec_max);
+    if (dst->reloc_vec_num >= freeze_info->reloc_vec_max)
+        return;
+    offs = freeze_info->cache_cur_pc + (src_pc - src_body) - freeze_info->cache_start_pc;
+    ASSERT(offs <= RELOC_OFFS_MASK);
+    dst->reloc_vec[dst->reloc_vec_num++] = RELOC_ENTRY((uint)offs, kind);
+}
+
 /* Transfers a coarse stub to a new location.
  * If freeze_info->dst_info is non-NULL,
  *   shifts any unlinked stubs to point at the prefixes in freeze_info->dst_info.
@@ -1049,6 +1172,7 @@ transfer_coarse_fragment(dcontext_t *dcontext, coarse_freeze_info_t *freeze_info
         instr_reset(dcontext, instr);
         pc = next_pc;
         ASSERT(pc - body <= MAX_FRAGMENT_SIZE);
+        transfer_coarse_reloc(freeze_info, pc, body);
         next_pc = decode_cti(dcontext, pc, instr);
         /* Case 8711: we can't distinguish exit ctis from others,
          * so we must assume that any cti is an exit cti, although
@@ -1519,6 +1643,35 @@ coarse_merge_update_jmps(dcontext_t *dcontext, coarse_freeze_info_t *freeze_info
     }
 }
 
+/* Adds the relocations in [src_body, src_body+sz) of the frozen src unit to dst,
+ * which is about to receive a copy of that code at freeze_info->cache_cur_pc.
+ * Callers must pass increasing src ranges.
+ */
+static void
+coarse_merge_relocs(coarse_freeze_info_t *freeze_info, cache_pc src_body, size_t sz,
+                    ssize_t cache_offs)
+{
+    coarse_info_t *src = freeze_info->src_info;
+    coarse_info_t *dst = freeze_info->dst_info;
+    uint start = (uint)(src_body - src->cache_start_pc);
+    /* skip relocations in dups */
+    while (freeze_info->reloc_idx < src->reloc_vec_num &&
+           RELOC_ENTRY_OFFS(src->reloc_vec[freeze_info->reloc_idx]) < start)
+        freeze_info->reloc_idx++;
+    for (; freeze_info->reloc_idx < src->reloc_vec_num &&
+         RELOC_ENTRY_OFFS(src->reloc_vec[freeze_info->reloc_idx]) < start + sz;
+         freeze_info->reloc_idx++) {
+        uint entry = src->reloc_vec[freeze_info->reloc_idx];
+        ASSERT(dst->reloc_vec_num < freeze_info->reloc_vec_max);
+        if (dst->reloc_vec_num >= freeze_info->reloc_vec_max)
+            break;
+        dst->reloc_vec[dst->reloc_vec_num++] =
+            RELOC_ENTRY((uint)(freeze_info->cache_cur_pc - freeze_info->cache_start_pc +
+                               cache_offs + (RELOC_ENTRY_OFFS(entry) - start)),
+                        RELOC_ENTRY_KIND(entry));
+    }
+}
+
 /* Assumption: cache to be merged with has already been copied to dst.
  * This routine walks the other src and copies over non-dup fragments,
  * directly linking inter-unit links along the way.
@@ -1689,6 +1842,7 @@ coarse_merge_without_dups(dcontext_t *dcontext, coarse_freeze_info_t *freeze_inf
         if (dst_body == NULL) { /* not a dup */
             /* copy body of fragment, including cti (if not ending @ fall-through) */
             size_t sz = next_pc - src_body;
+            coarse_merge_relocs(freeze_info, src_body, sz, cache_offs);
             memcpy(freeze_info->cache_cur_pc, src_body, sz);
             freeze_info->cache_cur_pc += sz;
         }
@@ -1946,6 +2100,14 @@ coarse_unit_merge(dcontext_t *dcontext, coarse_info_t *info1, coarse_info_t *inf
      * coarse_merge_process_stub() assumes that unlink == !in_place
      */
     freeze_info.unlink = !in_place;
+    /* src_lg's relocations keep their offsets; src_sm's are appended */
+    freeze_info.reloc_vec_max = src_lg->reloc_vec_num + src_sm->reloc_vec_num;
+    coarse_reloc_vec_create(merged, freeze_info.reloc_vec_max);
+    if (src_lg->reloc_vec_num > 0) {
+        memcpy(merged->reloc_vec, src_lg->reloc_vec,
+               src_lg->reloc_vec_num * sizeof(uint));
+        merged->reloc_vec_num = src_lg->reloc_vec_num;
+    }
 
     freeze_info.src_info = src_sm;
     freeze_info.cache_start_pc = merged->cache_start_pc + cachelg_size;
@@ -1954,6 +2116,7 @@ coarse_unit_merge(dcontext_t *dcontext, coarse_info_t *info1, coarse_info_t *inf
                               /* replace for primary unit; add for secondary */
                               freeze_info.src_info == info1);
     merged->cache_end_pc = freeze_info.cache_cur_pc;
+    coarse_reloc_vec_trim(merged, freeze_info.reloc_vec_max);
 
     freeze_info.src_info = src_lg;
     freeze_info.cache_start_pc = merged->cache_start_pc;
@@ -2986,10 +3149,7 @@ coarse_unit_set_persist_data(dcontext_t *dcontext, coarse_info_t *info,
     x_offs += pers->hotp_patch_list_len;
 #endif
 
-    /* FIXME case 9581 NYI: need to add to coarse_unit_calculate_persist_info()
-     * and coarse_unit_merge_persist_info() as well.
-     */
-    pers->reloc_len = 0;
+    pers->reloc_len = ALIGN_FORWARD(sizeof(uint) * info->reloc_vec_num, CLIENT_ALIGNMENT);
     x_offs += pers->reloc_len;
 
 #ifdef RETURN_AFTER_CALL
@@ -3176,6 +3336,16 @@ dr_persist_size(void *perscxt)
     return info->end_pc - info->base_pc;
 }
 
+DR_API
+ptr_int_t
+dr_persist_module_shift(void *perscxt)
+{
+    coarse_info_t *info = (coarse_info_t *)perscxt;
+    CLIENT_ASSERT(perscxt != NULL, "invalid arg: perscxt is NULL");
+    /* mod_shift is persisted base minus current base */
+    return -info->mod_shift;
+}
+
 DR_API
 bool
 dr_fragment_persistable(void *drcontext, void *perscxt, void *tag_in)
@@ -3401,7 +3571,15 @@ coarse_unit_persist(dcontext_t *dcontext, coarse_info_t *info)
     }
 #endif
 
-    /* FIXME case 9581 NYI: write reloc section */
+    if (pers.reloc_len > 0) {
+        static const uint reloc_pad[CLIENT_ALIGNMENT / sizeof(uint)] = { RELOC_PAD };
+        size_t len = sizeof(uint) * info->reloc_vec_num;
+        if (!write_persist_file(dcontext, fd, info->reloc_vec, len))
+            goto coarse_unit_persist_exit; /* logs, stats are in write_persist_file */
+        if (pers.reloc_len > len &&
+            !write_persist_file(dcontext, fd, reloc_pad, pers.reloc_len - len))
+            goto coarse_unit_persist_exit;
+    }
 
 #ifdef RETURN_AFTER_CALL
     if (pers.rac_htable_len > 0) {
@@ -3726,6 +3904,65 @@ persist_get_name_and_open(
     return fd;
 }
 
+/* Re-targets the "call->push immed" manglings of the just-mapped persisted unit
+ * info at the current module base, dispatching on the kind recorded for each
+ * site when it was emitted.  Returns false if any site is not in the expected
+ * form or its new value does not fit that form.
+ */
+static bool
+coarse_unit_apply_relocs(dcontext_t *dcontext, coarse_info_t *info)
+{
+    app_pc lo = info->base_pc + info->mod_shift;
+    app_pc hi = info->end_pc + info->mod_shift;
+    size_t cache_size = info->cache_end_pc - info->cache_start_pc;
+    uint i;
+    ASSERT(info->persisted && info->mod_shift != 0);
+    for (i = 0; i < info->reloc_vec_num; i++) {
+        uint offs = RELOC_ENTRY_OFFS(info->reloc_vec[i]);
+        cache_pc pc = info->cache_start_pc + offs;
+        int *imm_lo = (int *)(pc + 1);
+        ptr_int_t val;
+        if (offs + RELOC_PUSH_IMM32_LENGTH > cache_size ||
+            *pc != RELOC_PUSH_IMM32_OPCODE)
+            return false;
+        switch (RELOC_ENTRY_KIND(info->reloc_vec[i])) {
+        case RELOC_PUSH_IMM32:
+            val = (ptr_int_t)*imm_lo; /* sign-extended, like the push */
+            if ((app_pc)val < lo || (app_pc)val > hi)
+                return false;
+            val -= info->mod_shift;
+            /* without a top-half mov the new value must still sign-extend */
+            if (IF_X64_ELSE(!CHECK_TRUNCATE_TYPE_int(val), false))
+                return false;
+            *imm_lo = (int)val;
+            break;
+#ifdef X64
+        case RELOC_PUSH_IMM32_MOV_HI: {
+            /* mov dword [rsp+4], imm32 */
+            int *imm_hi = (int *)(pc + RELOC_PUSH_IMM32_LENGTH + RELOC_MOV_HI_LENGTH -
+                                  sizeof(int));
+            if (offs + RELOC_PUSH_IMM32_LENGTH + RELOC_MOV_HI_LENGTH > cache_size ||
+                pc[RELOC_PUSH_IMM32_LENGTH] != RELOC_MOV_HI_OPCODE)
+                return false;
+            val = (ptr_int_t)(((ptr_uint_t)(uint)*imm_hi << 32) |
+                              (ptr_uint_t)(uint)*imm_lo);
+            if ((app_pc)val < lo || (app_pc)val > hi)
+                return false;
+            val -= info->mod_shift;
+            *imm_lo = (int)val;
+            *imm_hi = (int)(val >> 32);
+            break;
+        }
+#endif
+        default: return false;
+        }
+    }
+    LOG(THREAD, LOG_CACHE, 2, "  applied %d relocations for shift " SZFMT "\n",
+        info->reloc_vec_num, info->mod_shift);
+    STATS_ADD(perscache_relocs_applied, info->reloc_vec_num);
+    return true;
+}
+
 /* It's up to the caller to do the work of mark_executable_area_coarse_frozen().
  * Caller must hold read lock hotp_get_lock().
  */
@@ -3929,15 +4166,15 @@ coarse_unit_load(dcontext_t *dcontext, app_pc start, app_pc end, bool for_execut
                                      * or sthg and not at_map.
                                      */
                                     for_execution && dynamo_initialized /*at_map*/)) {
+            /* Our own absolute app pcs are relocated below */
             LOG(THREAD, LOG_CACHE, 1,
                 "  module base mismatch " PFX " vs persisted " PFX
                 ", but no text relocs so ok\n",
                 modbase, pers->modinfo.base);
         } else {
 #endif
-            /* FIXME case 9581/9649: Bail out for now since relocs NYI
-             * Once we do support them, make sure to do the right thing when merging:
-             * current code will always apply relocs before merging.
+            /* FIXME case 9581: Bail out since we do not apply app code relocs.
+             * Note that we always apply our own relocs before merging.
              */
             LOG(THREAD, LOG_CACHE, 1,
                 "  module base mismatch " PFX " vs persisted " PFX "\n", modbase,
@@ -3971,7 +4208,9 @@ coarse_unit_load(dcontext_t *dcontext, app_pc start, app_pc end, bool for_execut
          pers->fcache_return_prefix_len);
 
     if (TEST(PERSCACHE_MAP_RW_SEPARATE, pers->flags) &&
-        DYNAMO_OPTION(persist_map_rw_separate)) {
+        DYNAMO_OPTION(persist_map_rw_separate) &&
+        /* We need a copy-on-write cache view to apply relocations */
+        (modbase == pers->modinfo.base || pers->reloc_len == 0)) {
         size_t ro_size;
         map2_size = stubs_and_prefixes_len + sizeof(persisted_footer_t);
         ro_size = (size_t)file_size /*un-aligned*/ - map2_size;
@@ -4210,9 +4449,23 @@ coarse_unit_load(dcontext_t *dcontext, app_pc start, app_pc end, bool for_execut
 #endif
     }
 
-    /* FIXME case 9581 NYI: reloc section */
     if (offsetof(coarse_persisted_info_t, reloc_len) < pers->header_len) {
         pc -= pers->reloc_len;
+        IF_X64(ASSERT_TRUNCATE(info->reloc_vec_num, uint,
+                               pers->reloc_len / sizeof(uint)));
+        info->reloc_vec_num = (uint)pers->reloc_len / sizeof(uint);
+        while (info->reloc_vec_num > 0 &&
+               ((uint *)pc)[info->reloc_vec_num - 1] == RELOC_PAD)
+            info->reloc_vec_num--;
+        if (info->reloc_vec_num > 0)
+            info->reloc_vec = (uint *)pc;
+        /* The cache is still writable: we restrict it below */
+        if (info->mod_shift != 0 && info->reloc_vec_num > 0 &&
+            !coarse_unit_apply_relocs(dcontext, info)) {
+            LOG(THREAD, LOG_CACHE, 1, "  error: unable to apply relocations\n");
+            STATS_INC(perscache_reloc_error);
+            goto coarse_unit_load_exit;
+        }
     }
 
 #ifdef HOT_PATCHING_INTERFACE
@@ -164,6 +164,17 @@ struct _coarse_info_t {
     uint hotp_ppoint_vec_num; /* number of elements in array */
 #endif
 
+    /* Mangled call return-address immediates, which hold absolute app pcs
+     * and must be relocated when a persisted unit is loaded at a new module
+     * base.  Non-frozen units record cache pcs in an opaque htable as the
+     * code is emitted; frozen units use a sorted array of offsets from
+     * cache_start_pc, with the coarse_reloc_kind_t in the top bits of each
+     * entry, which points into the reloc section if persisted.
+     */
+    void *reloc_htable;
+    uint *reloc_vec;
+    uint reloc_vec_num; /* number of elements in array */
+
     /* case 10525: leave stubs as writable if written too many times */
     uint stubs_write_count;
 
@@ -234,6 +245,20 @@ coarse_unit_free(dcontext_t *dcontext, coarse_info_t *info);
 void
 coarse_unit_mark_in_use(coarse_info_t *info);
 
+/* Kinds of mangled app pc immediates recorded for relocation */
+typedef enum {
+    /* push imm32 of a sign-extended app pc */
+    RELOC_PUSH_IMM32 = 1,
+    /* push imm32 followed by "mov dword [rsp+4], imm32" holding the top half */
+    RELOC_PUSH_IMM32_MOV_HI = 2,
+} coarse_reloc_kind_t;
+
+/* Records a mangled app pc immediate of the given kind at pc in the
+ * non-frozen unit info
+ */
+void
+coarse_unit_add_reloc(coarse_info_t *info, cache_pc pc, coarse_reloc_kind_t kind);
+
 /***************************************************************************
  * FROZEN UNITS
  */
@@ -259,6 +284,8 @@ struct _coarse_freeze_info_t {
     cache_pc stubs_cur_pc;
     bool unlink;
     pending_freeze_t *pending;
+    uint reloc_vec_max; /* allocated size of dst_info->reloc_vec */
+    uint reloc_idx;     /* merge cursor into src_info->reloc_vec */
 #ifdef DEBUG
     /* statistics on frozen code expansion from original app code */
     size_t app_code_size;
@@ -316,7 +343,7 @@ coarse_unit_merge(dcontext_t *dcontext, coarse_info_t *info1, coarse_info_t *inf
 
 enum {
     PERSISTENT_CACHE_MAGIC = 0x244f4952, /* RIO$ */
-    PERSISTENT_CACHE_VERSION = 10,
+    PERSISTENT_CACHE_VERSION = 12,
 };
 
 /* Global flags we need to process if present in a persisted cache */
@@ -520,13 +547,13 @@ typedef struct _coarse_persisted_info_t {
 #endif
 
     /* Relocations
-     * FIXME case 9581 NYI: other than app code relocs, all
-     * we add w/ coarse bbs are "call->push immed" manglings.  Once have traces,
-     * also stay-on-trace cmp.  No off-fragment jmps are currently allowed
-     * except for fcache/trace-head return and ibl, which are indirected.
-     * For app relocs we can either store in our own format at freeze time
-     * or do all processing at load time.
-     * FIXME: our non-entry pclookup is slow -- how slow will applying relocs be?
+     * An array of uint offsets from the start of the code cache, in
+     * increasing order, of the "call->push immed" manglings, which are all
+     * we add w/ coarse bbs.  Once have traces, also stay-on-trace cmp.
+     * No off-fragment jmps are currently allowed except for
+     * fcache/trace-head return and ibl, which are indirected.
+     * FIXME case 9581: app code relocs are not handled: we only apply
+     * ours to modules without text relocations.
      * FIXME case 9649: We could make our own call->push manglings
      * PIC using pc-relative addressing on x86-64.
      */
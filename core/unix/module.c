@@ -432,8 +432,15 @@ os_get_module_info(const app_pc pc, uint *checksum, uint *timestamp, size_t *siz
             *code_size = rx_sz;
         }
         if (file_version != NULL) {
+#    ifdef LINUX
+            /* The build id identifies the exact build, which also lets pcaches
+             * reject a rebuilt library that happens to match the other fields.
+             */
+            *file_version = ma->os_data.build_id;
+#    else
             /* FIXME: NYI: make windows-only everywhere if no good linux source */
             *file_version = 0;
+#    endif
         }
     }
 
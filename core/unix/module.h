@@ -91,7 +91,9 @@ typedef struct _os_module_data_t {
     ptr_uint_t gnu_shift;
     ptr_uint_t gnu_bitidx;
     size_t gnu_symbias; /* .dynsym index of first export */
-#else                   /* MACOS */
+    /* Leading bytes of the NT_GNU_BUILD_ID note, if any, for pcache validation */
+    uint64 build_id;
+#else /* MACOS */
     byte *exports;     /* absolute addr of exports trie */
     size_t exports_sz; /* size of exports trie */
     byte *symtab;
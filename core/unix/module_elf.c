@@ -335,6 +335,34 @@ module_fill_os_data(ELF_PROGRAM_HEADER_TYPE *prog_hdr, /* PT_DYNAMIC entry */
     return res;
 }
 
+/* Returns the leading bytes of the NT_GNU_BUILD_ID note in the PT_NOTE
+ * segment prog_hdr, or 0 if there is none within [base, base+view_size).
+ */
+static uint64
+module_get_build_id(ELF_PROGRAM_HEADER_TYPE *prog_hdr, app_pc base, size_t view_size,
+                    ptr_int_t load_delta)
+{
+    app_pc pc = (app_pc)prog_hdr->p_vaddr + load_delta;
+    app_pc end = pc + prog_hdr->p_filesz;
+    uint64 build_id = 0;
+    if (pc < base || end > base + view_size)
+        return 0;
+    while (pc + sizeof(ELF_NOTE_HEADER_TYPE) <= end) {
+        ELF_NOTE_HEADER_TYPE *note = (ELF_NOTE_HEADER_TYPE *)pc;
+        app_pc name = pc + sizeof(*note);
+        app_pc desc = name + ALIGN_FORWARD(note->n_namesz, 4);
+        pc = desc + ALIGN_FORWARD(note->n_descsz, 4);
+        if (pc > end || pc <= name)
+            break;
+        if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == sizeof("GNU") &&
+            memcmp(name, "GNU", sizeof("GNU")) == 0) {
+            memcpy(&build_id, desc, MIN(note->n_descsz, sizeof(build_id)));
+            break;
+        }
+    }
+    return build_id;
+}
+
 /* Identifies the bounds of each segment in the ELF at base.
  * Returned addresses out_base and out_end are relative to the actual
  * loaded module base, so the "base" param should be added to produce
@@ -397,6 +425,11 @@ module_walk_program_headers(app_pc base, size_t view_size, bool at_map, bool dyn
                 }
                 found_load = true;
             }
+            if (out_data != NULL && prog_hdr->p_type == PT_NOTE &&
+                out_data->build_id == 0) {
+                out_data->build_id =
+                    module_get_build_id(prog_hdr, base, view_size, load_delta);
+            }
             if ((out_soname != NULL || out_data != NULL) &&
                 prog_hdr->p_type == PT_DYNAMIC) {
                 module_fill_os_data(prog_hdr, mod_base, max_end, base, view_size, at_map,
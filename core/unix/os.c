@@ -60,6 +60,9 @@
 #ifndef MAP_ANONYMOUS
 #    define MAP_ANONYMOUS MAP_ANON /* MAP_ANON on Mac */
 #endif
+#if defined(LINUX) && !defined(MADV_HUGEPAGE)
+#    define MADV_HUGEPAGE 14
+#endif
 /* for open */
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -3666,6 +3669,29 @@ os_heap_decommit(void *p, size_t size, heap_error_code_t *error_code)
     */
 }
 
+#ifdef LINUX
+/* Marks [p, p+size) as eligible for transparent huge pages.  This is only a hint:
+ * the kernel maps a huge page where an aligned range has uniform protections.
+ */
+bool
+os_heap_request_huge_pages(void *p, size_t size, heap_error_code_t *error_code)
+{
+    long res;
+    ASSERT(ALIGNED(p, PAGE_SIZE) && ALIGNED(size, PAGE_SIZE));
+    ASSERT(error_code != NULL);
+    res = dynamorio_syscall(SYS_madvise, 3, p, size, MADV_HUGEPAGE);
+    if (res != 0) {
+        /* EINVAL if the kernel lacks CONFIG_TRANSPARENT_HUGEPAGE. */
+        *error_code = -res;
+        return false;
+    }
+    *error_code = HEAP_ERROR_SUCCESS;
+    LOG(GLOBAL, LOG_HEAP, 2, "os_heap_request_huge_pages: %d bytes @ " PFX "\n", size,
+        p);
+    return true;
+}
+#endif
+
 bool
 os_heap_systemwide_overcommit(heap_error_code_t last_error_code)
 {
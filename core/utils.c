@@ -1522,6 +1522,26 @@ bitmap_find_set_block_sequence(bitmap_t b, uint bitmap_size, uint requested)
     return BITMAP_NOT_FOUND;
 }
 
+/* Like bitmap_find_set_block_sequence() but only considers sequences whose first
+ * block is a multiple of align.
+ */
+static uint
+bitmap_find_aligned_set_block_sequence(bitmap_t b, uint bitmap_size, uint requested,
+                                       uint align)
+{
+    uint first;
+    for (first = 0; first + requested <= bitmap_size; first += align) {
+        uint hole_size = 0;
+        while (hole_size < requested && bitmap_test(b, first + hole_size))
+            hole_size++;
+        if (hole_size == requested)
+            return first;
+        /* Skip to the first aligned candidate past the clear bit. */
+        first = (uint)ALIGN_BACKWARD(first + hole_size, align);
+    }
+    return BITMAP_NOT_FOUND;
+}
+
 void
 bitmap_initialize_free(bitmap_t b, uint bitmap_size)
 {
@@ -1530,7 +1550,7 @@ bitmap_initialize_free(bitmap_t b, uint bitmap_size)
 
 uint
 bitmap_allocate_blocks(bitmap_t b, uint bitmap_size, uint request_blocks,
-                       uint start_block)
+                       uint start_block, uint align_blocks)
 {
     uint i, res;
     if (start_block != UINT_MAX) {
@@ -1544,6 +1564,9 @@ bitmap_allocate_blocks(bitmap_t b, uint bitmap_size, uint request_blocks,
             res = start_block;
         else
             return BITMAP_NOT_FOUND;
+    } else if (align_blocks > 1) {
+        res = bitmap_find_aligned_set_block_sequence(b, bitmap_size, request_blocks,
+                                                     align_blocks);
     } else if (request_blocks == 1) {
         res = bitmap_find_set_block(b, bitmap_size);
     } else {
@@ -1158,9 +1158,12 @@ bitmap_clear(bitmap_t b, uint i)
 /* bitmap_size is number of bits in the bitmap_t */
 void
 bitmap_initialize_free(bitmap_t b, uint bitmap_size);
+/* If start_block is not UINT_MAX the blocks must start there; otherwise, if
+ * align_blocks is greater than 1, the first block is a multiple of it.
+ */
 uint
 bitmap_allocate_blocks(bitmap_t b, uint bitmap_size, uint request_blocks,
-                       uint start_block);
+                       uint start_block, uint align_blocks);
 void
 bitmap_free_blocks(bitmap_t b, uint bitmap_size, uint first_block, uint num_free);
 
@@ -854,8 +854,12 @@ vm_area_vector_check_size(vm_area_vector_t *v)
             v->buf = (vm_area_t *)global_heap_alloc(
                 v->size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
         } else {
-            /* FIXME: case 4471 we should be doubling size here */
-            int new_size = (INTERNAL_OPTION(vmarea_increment_size) + v->length);
+            /* Grow geometrically (case 4471) so that processes with tens of
+             * thousands of mappings do not realloc the whole array every
+             * vmarea_increment_size additions.
+             */
+            int new_size =
+                v->length + MAX((int)INTERNAL_OPTION(vmarea_increment_size), v->length / 2);
             STATS_INC(num_vmareas_resized);
             v->buf = global_heap_realloc(v->buf, v->size, new_size,
                                          sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
@@ -865,6 +869,34 @@ vm_area_vector_check_size(vm_area_vector_t *v)
     }
 }
 
+/* Returns the index of the first area in v whose end is >= pc, or v->length if
+ * there is none.  No area before that index can overlap or be adjacent to a range
+ * starting at pc.  Since areas do not overlap, their ends are sorted just like
+ * their starts.
+ * Assumes caller holds v->lock, if necessary.
+ */
+static int
+vm_area_first_ending_at_or_after(vm_area_vector_t *v, app_pc pc)
+{
+    int min = 0;
+    int max = v->length;
+    /* Updates often touch the area last found or its neighbor, so try those first. */
+    int hint = v->last_hit;
+    if (hint >= 0 && hint < v->length && v->buf[hint].end < pc)
+        hint++;
+    if (hint >= 0 && hint <= v->length && (hint == v->length || v->buf[hint].end >= pc) &&
+        (hint == 0 || v->buf[hint - 1].end < pc))
+        return hint;
+    while (min < max) {
+        int i = min + (max - min) / 2;
+        if (v->buf[i].end < pc)
+            min = i + 1;
+        else
+            max = i;
+    }
+    return min;
+}
+
 static void
 vm_area_merge_fraglists(vm_area_t *dst, vm_area_t *src)
 {
@@ -931,8 +963,11 @@ add_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, uint vm_flags, uint f
                                       ? " all_memory_areas"
                                       : (v == dynamo_areas ? " dynamo_areas" : ""))),
         start, end, comment);
-    /* N.B.: new area could span multiple existing areas! */
-    for (i = 0; i < v->length; i++) {
+    /* N.B.: new area could span multiple existing areas!
+     * Areas ending before start can neither overlap nor be adjacent, so we
+     * start the scan past them rather than walking the whole vector.
+     */
+    for (i = vm_area_first_ending_at_or_after(v, start); i < v->length; i++) {
         /* look for overlap, or adjacency of same type (including all flags, and never
          * merge adjacent if keeping write counts)
          */
@@ -1160,6 +1195,7 @@ add_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, uint vm_flags, uint f
         for (j = v->length; j > i; j--)
             v->buf[j] = v->buf[j - 1];
         v->buf[i] = new_area;
+        v->last_hit = i;
         /* assumption: no overlaps between areas in list! */
 #ifdef DEBUG
         if (!((i == 0 || v->buf[i - 1].end <= v->buf[i].start) &&
@@ -1262,6 +1298,7 @@ add_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, uint vm_flags, uint f
             v->buf[i] = v->buf[i + diff];
         v->length -= diff;
         i = overlap_start; /* for return value */
+        v->last_hit = i;
         if (TEST(VECTOR_FRAGMENT_LIST, v->flags) && v->buf[i].custom.frags != NULL) {
             dcontext_t *dcontext = get_thread_private_dcontext();
             ASSERT(dcontext != NULL);
@@ -1335,7 +1372,7 @@ remove_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, bool restore_prot)
     ASSERT_VMAREA_VECTOR_PROTECTED(v, WRITE);
     LOG(GLOBAL, LOG_VMAREAS, 4, "in remove_vm_area " PFX " " PFX "\n", start, end);
     /* N.B.: removed area could span multiple areas! */
-    for (i = 0; i < v->length; i++) {
+    for (i = vm_area_first_ending_at_or_after(v, start); i < v->length; i++) {
         /* look for overlap */
         if (start < v->buf[i].end && end > v->buf[i].start) {
             if (overlap_start == -1)
@@ -1455,6 +1492,7 @@ remove_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, bool restore_prot)
         diff = overlap_end - overlap_start;
         for (i = overlap_start; i < v->length - diff; i++)
             v->buf[i] = v->buf[i + diff];
+        v->last_hit = overlap_start;
 #ifdef DEBUG
         memset(v->buf + v->length - diff, 0, diff * sizeof(vm_area_t));
 #endif
@@ -1506,6 +1544,7 @@ binary_search(vm_area_vector_t *v, app_pc start, app_pc end, vm_area_t **area /*
     /* BINARY SEARCH -- assumes the vector is kept sorted by add & remove! */
     int min = 0;
     int max = v->length - 1;
+    int i;
 
     /* We support an empty range start==end in general but we do
      * complain about 0..0 to catch bugs like i#4097.
@@ -1517,9 +1556,24 @@ binary_search(vm_area_vector_t *v, app_pc start, app_pc end, vm_area_t **area /*
     LOG(GLOBAL, LOG_VMAREAS, 7, "Binary search for " PFX "-" PFX " on this vector:\n",
         start, end);
     DOLOG(7, LOG_VMAREAS, { print_vm_areas(v, GLOBAL); });
+    /* Try the last hit first.  We only take it when it is the sole overlapping
+     * area, so that we return the same area as the search would.
+     */
+    i = v->last_hit;
+    if (start != end && i >= 0 && i < v->length && start < v->buf[i].end &&
+        (end == NULL || end > v->buf[i].start) &&
+        (i == 0 || v->buf[i - 1].end <= start) &&
+        (i == v->length - 1 || (end != NULL && end <= v->buf[i + 1].start))) {
+        STATS_INC(vmarea_last_hit_lookups);
+        if (area != NULL)
+            *area = &(v->buf[i]);
+        if (index != NULL)
+            *index = i;
+        return true;
+    }
     /* binary search */
     while (max >= min) {
-        int i = (min + max) / 2;
+        i = (min + max) / 2;
         if (end != NULL && end <= v->buf[i].start)
             max = i - 1;
         else if (start >= v->buf[i].end || start == end)
@@ -1537,6 +1591,7 @@ binary_search(vm_area_vector_t *v, app_pc start, app_pc end, vm_area_t **area /*
                 if (index != NULL)
                     *index = i;
             }
+            v->last_hit = i;
             LOG(GLOBAL, LOG_VMAREAS, 7,
                 "\tfound " PFX "-" PFX " in area " PFX "-" PFX "\n", start, end,
                 v->buf[i].start, v->buf[i].end);
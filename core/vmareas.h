@@ -111,6 +111,11 @@ struct vm_area_vector_t {
      * If non-NULL, the free_payload_func will NOT be called.
      */
     void *(*merge_payload_func)(void *dst, void *src);
+    /* Index of the area most recently found or updated, tried before a binary
+     * search.  It is only a hint: it is updated while holding the lock for
+     * reading, so it is validated against buf before every use.
+     */
+    int last_hit;
 }; /* typedef-ed in globals.h */
 
 /* vm_area_vectors should NOT be declared statically if their locks need to be
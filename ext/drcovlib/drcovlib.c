@@ -52,6 +52,7 @@
 
 #include "dr_api.h"
 #include "drmgr.h"
+#include "drreg.h"
 #include "drx.h"
 #include "drcovlib.h"
 #include "hashtable.h"
@@ -76,8 +77,26 @@ uint verbose;
 static drcovlib_options_t options;
 static char logdir[MAXIMUM_PATH];
 
+/* The counters of the block being instrumented, passed from the analysis
+ * event to the insertion event.
+ */
+typedef struct _bb_counters_t {
+    void *hit;
+    void *edge;
+} bb_counters_t;
+
 typedef struct _per_thread_t {
     void *bb_table;
+    /* The tables below are only used with DRCOVLIB_HIT_COUNTS.  Each counter
+     * table is parallel to its entry table: counter i belongs to entry i.
+     * counter_lock keeps the indices in step when the tables are shared.
+     */
+    void *hit_counters;
+    void *edge_table;
+    void *edge_counters;
+    void *counter_lock;
+    /* Per-thread even when the tables are not. */
+    bb_counters_t cur_counters;
     file_t log;
     char logname[MAXIMUM_PATH];
 } per_thread_t;
@@ -87,6 +106,13 @@ static bool drcov_per_thread = false;
 static volatile bool go_native;
 static int tls_idx = -1;
 static int drcovlib_init_count;
+static bool count_hits;
+static bool count_edges;
+static size_t counter_size;
+/* The target of the counter updates emitted when re-creating a block for
+ * translation, which only need to match the original instructions in size.
+ */
+static uint64 translation_counter;
 
 /****************************************************************************
  * Utility Functions
@@ -157,9 +183,78 @@ bb_table_print(void *drcontext, per_thread_t *data)
 }
 
 static void
+counter_print(file_t log, void *counter)
+{
+    if (counter_size == sizeof(uint64))
+        dr_fprintf(log, UINT64_FORMAT_STRING, *(uint64 *)counter);
+    else
+        dr_fprintf(log, "%u", *(uint *)counter);
+}
+
+static bool
+counter_entry_print(ptr_uint_t idx, void *entry, void *iter_data)
+{
+    per_thread_t *data = iter_data;
+    counter_print(data->log, entry);
+    dr_fprintf(data->log, "\n");
+    return true; /* continue iteration */
+}
+
+static void
+counters_print(void *drcontext, per_thread_t *data)
+{
+    uint num_edges, i;
+    ASSERT(drtable_num_entries(data->hit_counters) ==
+               drtable_num_entries(data->bb_table),
+           "hit counters out of step with bb table");
+    dr_fprintf(data->log, "BB Hit Counts: version %u, %u-byte counters\n",
+               DRCOV_COUNTS_VERSION, (uint)counter_size);
+    if (TEST(DRCOVLIB_DUMP_AS_TEXT, options.flags))
+        drtable_iterate(data->hit_counters, data, counter_entry_print);
+    else
+        drtable_dump_entries(data->hit_counters, data->log);
+    if (count_edges) {
+        num_edges = (uint)drtable_num_entries(data->edge_table);
+        dr_fprintf(data->log, "Edge Table: %u edges\n", num_edges);
+        if (TEST(DRCOVLIB_DUMP_AS_TEXT, options.flags)) {
+            dr_fprintf(data->log, "source, target module id, target start, count:\n");
+            for (i = 0; i < num_edges; i++) {
+                bb_edge_entry_t *edge = drtable_get_entry(data->edge_table, i);
+                dr_fprintf(data->log, "%u, module[%3u]: " PFX ", ", edge->src_index,
+                           edge->target_mod_id, edge->target_start);
+                counter_print(data->log, drtable_get_entry(data->edge_counters, i));
+                dr_fprintf(data->log, "\n");
+            }
+        } else {
+            drtable_dump_entries(data->edge_table, data->log);
+            drtable_dump_entries(data->edge_counters, data->log);
+        }
+    }
+}
+
+static uint
+bb_start_to_offset(void *drcontext, app_pc start, ushort *mod_id_out)
+{
+    uint mod_id;
+    app_pc mod_seg_start;
+    drcovlib_status_t res =
+        drmodtrack_lookup_segment(drcontext, start, &mod_id, &mod_seg_start);
+    if (res == DRCOVLIB_SUCCESS) {
+        ASSERT(mod_id < USHRT_MAX, "module id overflow");
+        *mod_id_out = (ushort)mod_id;
+        ASSERT(start >= mod_seg_start, "wrong module");
+        return (uint)(start - mod_seg_start);
+    }
+    /* See the comment on unknown modules in bb_table_entry_add(). */
+    *mod_id_out = UNKNOWN_MODULE_ID;
+    return (uint)(ptr_uint_t)start;
+}
+
+static ptr_uint_t
 bb_table_entry_add(void *drcontext, per_thread_t *data, app_pc start, uint size)
 {
-    bb_entry_t *bb_entry = drtable_alloc(data->bb_table, 1, NULL);
+    ptr_uint_t idx;
+    bb_entry_t *bb_entry = drtable_alloc(data->bb_table, 1, &idx);
     uint mod_id;
     app_pc mod_seg_start;
     drcovlib_status_t res =
@@ -181,6 +276,49 @@ bb_table_entry_add(void *drcontext, per_thread_t *data, app_pc start, uint size)
         bb_entry->mod_id = UNKNOWN_MODULE_ID;
         bb_entry->start = (uint)(ptr_uint_t)start;
     }
+    return idx;
+}
+
+#ifdef X86
+static bool
+instr_is_counted_cbr(instr_t *instr)
+{
+    /* We count the taken edge with a setcc, which jecxz and loop lack. */
+    int opc = instr_get_opcode(instr);
+    return (opc >= OP_jo_short && opc <= OP_jnle_short) ||
+        (opc >= OP_jo && opc <= OP_jnle);
+}
+
+static int
+cbr_to_setcc_opcode(instr_t *instr)
+{
+    int opc = instr_get_opcode(instr);
+    if (opc >= OP_jo_short && opc <= OP_jnle_short)
+        return OP_seto + (opc - OP_jo_short);
+    return OP_seto + (opc - OP_jo);
+}
+#endif
+
+/* Adds the counters for a new block whose bb_table entry is at bb_idx.
+ * The caller must hold counter_lock if the tables are shared.
+ */
+static void
+counters_add(void *drcontext, per_thread_t *data, ptr_uint_t bb_idx, instr_t *last)
+{
+    ptr_uint_t idx;
+    data->cur_counters.hit = drtable_alloc(data->hit_counters, 1, &idx);
+    ASSERT(idx == bb_idx, "hit counters out of step with bb table");
+    data->cur_counters.edge = NULL;
+#ifdef X86
+    if (count_edges && last != NULL && instr_is_counted_cbr(last)) {
+        bb_edge_entry_t *edge = drtable_alloc(data->edge_table, 1, &idx);
+        edge->src_index = (uint)bb_idx;
+        edge->target_start = bb_start_to_offset(
+            drcontext, instr_get_branch_target_pc(last), &edge->target_mod_id);
+        edge->reserved = 0;
+        data->cur_counters.edge = drtable_alloc(data->edge_counters, 1, NULL);
+    }
+#endif
 }
 
 #define INIT_BB_TABLE_ENTRIES 4096
@@ -191,6 +329,36 @@ bb_table_create(bool synch)
                           NULL);
 }
 
+#define INIT_EDGE_TABLE_ENTRIES 1024
+static void
+counter_tables_create(per_thread_t *data)
+{
+    /* The counters are updated with absolute memory references from the
+     * code cache, so they must be reachable from it.  counter_lock provides
+     * all the synchronization, so the tables themselves do not synch.
+     */
+    data->hit_counters = drtable_create(INIT_BB_TABLE_ENTRIES, counter_size,
+                                        DRTABLE_MEM_REACHABLE, false, NULL);
+    if (count_edges) {
+        data->edge_table = drtable_create(INIT_EDGE_TABLE_ENTRIES,
+                                          sizeof(bb_edge_entry_t), 0, false, NULL);
+        data->edge_counters = drtable_create(INIT_EDGE_TABLE_ENTRIES, counter_size,
+                                             DRTABLE_MEM_REACHABLE, false, NULL);
+    }
+    data->counter_lock = dr_mutex_create();
+}
+
+static void
+counter_tables_destroy(per_thread_t *data)
+{
+    drtable_destroy(data->hit_counters, data);
+    if (count_edges) {
+        drtable_destroy(data->edge_table, data);
+        drtable_destroy(data->edge_counters, data);
+    }
+    dr_mutex_destroy(data->counter_lock);
+}
+
 static void
 bb_table_destroy(void *table, void *data)
 {
@@ -225,7 +393,16 @@ dump_drcov_data(void *drcontext, per_thread_t *data)
     }
     version_print(data->log);
     drmodtrack_dump(data->log);
-    bb_table_print(drcontext, data);
+    if (count_hits) {
+        /* Keep other threads from adding blocks between the two tables. */
+        if (!drcov_per_thread)
+            dr_mutex_lock(data->counter_lock);
+        bb_table_print(drcontext, data);
+        counters_print(drcontext, data);
+        if (!drcov_per_thread)
+            dr_mutex_unlock(data->counter_lock);
+    } else
+        bb_table_print(drcontext, data);
 }
 
 /****************************************************************************
@@ -258,6 +435,8 @@ thread_data_create(void *drcontext)
      * if so, no lock is required for bb_table operation.
      */
     data->bb_table = bb_table_create(drcontext == NULL ? true : false);
+    if (count_hits)
+        counter_tables_create(data);
     log_file_create(drcontext, data);
     return data;
 }
@@ -267,6 +446,8 @@ thread_data_destroy(void *drcontext, per_thread_t *data)
 {
     /* destroy the bb table */
     bb_table_destroy(data->bb_table, data);
+    if (count_hits)
+        counter_tables_destroy(data);
     dr_close_file(data->log);
     /* free thread data */
     if (drcontext == NULL) {
@@ -339,10 +520,15 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
     per_thread_t *data;
     instr_t *instr;
     app_pc tag_pc, start_pc, end_pc;
+    ptr_uint_t bb_idx;
 
-    /* do nothing for translation */
-    if (translating)
+    /* Do nothing for translation, except to tell the insertion event that
+     * there are no counters for it to use.
+     */
+    if (translating) {
+        *user_data = NULL;
         return DR_EMIT_DEFAULT;
+    }
 
     data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
     /* Collect the number of instructions and the basic block size,
@@ -376,7 +562,16 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
      * 4. The duplication can be easily handled in a post-processing step,
      *    which is required anyway.
      */
-    bb_table_entry_add(drcontext, data, tag_pc, (uint)(end_pc - start_pc));
+    if (count_hits) {
+        if (!drcov_per_thread)
+            dr_mutex_lock(data->counter_lock);
+        bb_idx = bb_table_entry_add(drcontext, data, tag_pc, (uint)(end_pc - start_pc));
+        counters_add(drcontext, data, bb_idx, instrlist_last_app(bb));
+        if (!drcov_per_thread)
+            dr_mutex_unlock(data->counter_lock);
+        *user_data = &data->cur_counters;
+    } else
+        bb_table_entry_add(drcontext, data, tag_pc, (uint)(end_pc - start_pc));
 
     if (go_native)
         return DR_EMIT_GO_NATIVE;
@@ -384,6 +579,98 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
         return DR_EMIT_DEFAULT;
 }
 
+#ifdef X86
+/* Adds the value of the branch's condition, i.e., 1 if it is taken, to the
+ * counter.  Computing the condition with a setcc rather than branching
+ * around the update keeps control flow out of the instrumentation.
+ */
+static bool
+insert_taken_edge_update(void *drcontext, instrlist_t *bb, instr_t *where, void *counter)
+{
+    reg_id_t reg;
+    drreg_status_t res;
+    bool is_64 = (counter_size == sizeof(uint64));
+#    ifndef X64
+    drvector_t allowed;
+    /* Only these registers have 8-bit sub-registers. */
+    drreg_init_and_fill_vector(&allowed, false);
+    drreg_set_vector_entry(&allowed, DR_REG_XAX, true);
+    drreg_set_vector_entry(&allowed, DR_REG_XBX, true);
+    drreg_set_vector_entry(&allowed, DR_REG_XCX, true);
+    drreg_set_vector_entry(&allowed, DR_REG_XDX, true);
+    res = drreg_reserve_register(drcontext, bb, where, &allowed, &reg);
+    drvector_delete(&allowed);
+#    else
+    res = drreg_reserve_register(drcontext, bb, where, NULL, &reg);
+#    endif
+    if (res != DRREG_SUCCESS)
+        return false;
+    /* The mov must precede the setcc, as an xor would clobber the flags. */
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_mov_imm(drcontext, opnd_create_reg(reg_resize_to_opsz(reg, OPSZ_4)),
+                             OPND_CREATE_INT32(0)));
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_setcc(drcontext, cbr_to_setcc_opcode(where),
+                           opnd_create_reg(reg_resize_to_opsz(reg, OPSZ_1))));
+    if (drreg_reserve_aflags(drcontext, bb, where) != DRREG_SUCCESS)
+        return false;
+#    ifdef X64
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_add(drcontext,
+                         OPND_CREATE_ABSMEM(counter, is_64 ? OPSZ_8 : OPSZ_4),
+                         opnd_create_reg(is_64 ? reg : reg_resize_to_opsz(reg, OPSZ_4))));
+#    else
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_add(drcontext, OPND_CREATE_ABSMEM(counter, OPSZ_4),
+                         opnd_create_reg(reg)));
+    if (is_64) {
+        instrlist_meta_preinsert(
+            bb, where,
+            INSTR_CREATE_adc(drcontext,
+                             OPND_CREATE_ABSMEM((byte *)counter + 4, OPSZ_4),
+                             OPND_CREATE_INT32(0)));
+    }
+#    endif
+    if (drreg_unreserve_aflags(drcontext, bb, where) != DRREG_SUCCESS ||
+        drreg_unreserve_register(drcontext, bb, where, reg) != DRREG_SUCCESS)
+        return false;
+    return true;
+}
+#endif
+
+static dr_emit_flags_t
+event_basic_block_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                         bool for_trace, bool translating, void *user_data)
+{
+    bb_counters_t *counters = (bb_counters_t *)user_data;
+    void *hit = counters == NULL ? &translation_counter : counters->hit;
+    if (drmgr_is_first_instr(drcontext, instr)) {
+        if (!drx_insert_counter_update(
+                drcontext, bb, instr, SPILL_SLOT_MAX + 1,
+                IF_AARCHXX_OR_RISCV64_(SPILL_SLOT_MAX + 1) hit, 1,
+                counter_size == sizeof(uint64) ? DRX_COUNTER_64BIT : 0))
+            ASSERT(false, "failed to insert hit counter");
+    }
+#ifdef X86
+    if (count_edges && drmgr_is_last_instr(drcontext, instr) &&
+        instr_is_counted_cbr(instr)) {
+        void *edge = counters == NULL ? &translation_counter : counters->edge;
+        if (!insert_taken_edge_update(drcontext, bb, instr, edge))
+            ASSERT(false, "failed to insert edge counter");
+    }
+    return DR_EMIT_DEFAULT;
+#else
+    /* Elsewhere the counter address can affect the instrumentation's size,
+     * so the block cannot be faithfully re-created for translation.
+     */
+    return DR_EMIT_STORE_TRANSLATIONS;
+#endif
+}
+
 static void
 event_thread_exit(void *drcontext)
 {
@@ -452,6 +739,13 @@ event_fork(void *drcontext)
 {
     if (!drcov_per_thread) {
         log_file_create(NULL, global_data);
+    } else if (count_hits) {
+        /* Blocks already in the code cache update the existing counters, so
+         * the tables must be kept.
+         */
+        per_thread_t *data = drmgr_get_tls_field(drcontext, tls_idx);
+        if (data != NULL)
+            log_file_create(drcontext, data);
     } else {
         per_thread_t *data = drmgr_get_tls_field(drcontext, tls_idx);
         if (data != NULL) {
@@ -518,6 +812,10 @@ drcovlib_exit(void)
 
     drmgr_unregister_tls_field(tls_idx);
 
+    if (count_hits)
+        drreg_exit();
+    count_hits = false;
+    count_edges = false;
     drx_exit();
     drmgr_exit();
 
@@ -556,8 +854,18 @@ drcovlib_init(drcovlib_options_t *ops)
 
     if (ops->struct_size != sizeof(options))
         return DRCOVLIB_ERROR_INVALID_PARAMETER;
-    if ((ops->flags & (~(DRCOVLIB_DUMP_AS_TEXT | DRCOVLIB_THREAD_PRIVATE))) != 0)
+    if ((ops->flags &
+         (~(DRCOVLIB_DUMP_AS_TEXT | DRCOVLIB_THREAD_PRIVATE | DRCOVLIB_HIT_COUNTS |
+            DRCOVLIB_EDGE_COUNTS | DRCOVLIB_COUNTERS_64BIT))) != 0)
         return DRCOVLIB_ERROR_INVALID_PARAMETER;
+#ifndef X86
+    if (TEST(DRCOVLIB_EDGE_COUNTS, ops->flags))
+        return DRCOVLIB_ERROR_FEATURE_NOT_AVAILABLE;
+#endif
+#ifdef ARM
+    if (TEST(DRCOVLIB_COUNTERS_64BIT, ops->flags))
+        return DRCOVLIB_ERROR_FEATURE_NOT_AVAILABLE;
+#endif
     if (TEST(DRCOVLIB_THREAD_PRIVATE, ops->flags)) {
         if (!dr_using_all_private_caches())
             return DRCOVLIB_ERROR_INVALID_SETUP;
@@ -574,9 +882,21 @@ drcovlib_init(drcovlib_options_t *ops)
         options.logprefix = "drcov";
     if (options.native_until_thread > 0)
         go_native = true;
+    count_edges = TEST(DRCOVLIB_EDGE_COUNTS, options.flags);
+    count_hits = count_edges || TEST(DRCOVLIB_HIT_COUNTS, options.flags);
+    counter_size =
+        TEST(DRCOVLIB_COUNTERS_64BIT, options.flags) ? sizeof(uint64) : sizeof(uint);
 
     drmgr_init();
     drx_init();
+    if (count_hits) {
+        /* The hit counters need a slot for the flags, and the edge counters
+         * another for a register.
+         */
+        drreg_options_t drreg_ops = { sizeof(drreg_ops), count_edges ? 2 : 1, false };
+        if (drreg_init(&drreg_ops) != DRREG_SUCCESS)
+            return DRCOVLIB_ERROR;
+    }
 
     /* We follow a simple model of the caller requesting the coverage dump,
      * either via calling the exit routine, using its own soft_kills nudge, or
@@ -588,7 +908,8 @@ drcovlib_init(drcovlib_options_t *ops)
 
     drmgr_register_thread_init_event(event_thread_init);
     drmgr_register_thread_exit_event(event_thread_exit);
-    drmgr_register_bb_instrumentation_event(event_basic_block_analysis, NULL, NULL);
+    drmgr_register_bb_instrumentation_event(
+        event_basic_block_analysis, count_hits ? event_basic_block_insert : NULL, NULL);
     dr_register_filter_syscall_event(event_filter_syscall);
     drmgr_register_pre_syscall_event(event_pre_syscall);
 #ifdef UNIX
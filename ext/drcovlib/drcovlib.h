@@ -78,6 +78,31 @@ typedef enum {
      * drcovlib's own thread exit events rather than in drcovlib_exit().
      */
     DRCOVLIB_THREAD_PRIVATE = 0x0002,
+    /**
+     * Requests an execution count for each basic block in addition to the
+     * default record of which blocks were seen.  Each block's instrumentation
+     * increments a counter inline, without a clean call.  Unless
+     * #DRCOVLIB_THREAD_PRIVATE is in effect, counters are shared among threads
+     * and their updates are not atomic, so concurrent executions of the same
+     * block may occasionally be missed.  The counts are appended to the log
+     * file in the format described at #DRCOV_COUNTS_VERSION.
+     */
+    DRCOVLIB_HIT_COUNTS = 0x0004,
+    /**
+     * Requests a count of the taken edge of each basic block ending in a direct
+     * conditional branch.  The not-taken edge's count is the block's hit count
+     * minus the taken count, and the edge out of a block ending in any other
+     * direct transfer is its hit count, so these together with the block hit
+     * counts describe all direct edges.  Implies #DRCOVLIB_HIT_COUNTS.
+     * This is currently only supported on x86.
+     */
+    DRCOVLIB_EDGE_COUNTS = 0x0008,
+    /**
+     * By default, the counters requested by #DRCOVLIB_HIT_COUNTS and
+     * #DRCOVLIB_EDGE_COUNTS are 32 bits wide and wrap around on overflow.
+     * This flag requests 64-bit counters.
+     */
+    DRCOVLIB_COUNTERS_64BIT = 0x0010,
 } drcovlib_flags_t;
 
 /** Specifies the options when initializing drcovlib. */
@@ -150,6 +175,32 @@ typedef struct _bb_entry_t {
     ushort mod_id;
 } bb_entry_t;
 
+/**
+ * The version of the hit and edge counts requested by #DRCOVLIB_HIT_COUNTS and
+ * #DRCOVLIB_EDGE_COUNTS, which follow the BB table in the log file in this format:
+ * \code
+ *   BB Hit Counts: version <version>, <4 or 8>-byte counters
+ *   <one counter for each BB table entry, in the same order>
+ *   Edge Table: <count> edges               (only with DRCOVLIB_EDGE_COUNTS)
+ *   <one bb_edge_entry_t for each edge>
+ *   <one counter for each edge, in the same order>
+ * \endcode
+ * In text mode each counter and edge is instead printed on its own line.  Each
+ * creation of a block has its own entry and counters, so counts must be summed
+ * across duplicate entries.
+ */
+#define DRCOV_COUNTS_VERSION 1
+
+/* An edge taken by a block ending in a direct conditional branch. */
+typedef struct _bb_edge_entry_t {
+    /* The index of the source block in the BB table. */
+    uint src_index;
+    /* The branch target, as a bb_entry_t's start and mod_id. */
+    uint target_start;
+    ushort target_mod_id;
+    ushort reserved;
+} bb_edge_entry_t;
+
 /***************************************************************************
  * Coverage interface
  */
@@ -383,6 +434,30 @@ DR_EXPORT
 drcovlib_status_t
 drmodtrack_offline_lookup(void *handle, uint index, DR_PARAM_OUT drmodtrack_info_t *info);
 
+DR_EXPORT
+/**
+ * Usable from standalone mode.  Creates an empty list of \p num_mods modules,
+ * returning an identifier for it in \p handle.  Each entry should be filled in
+ * with drmodtrack_offline_set() before the list is written out with
+ * drmodtrack_offline_write().  This allows a tool to combine the module lists
+ * of several files into one.  The handle must be freed with
+ * drmodtrack_offline_exit().
+ */
+drcovlib_status_t
+drmodtrack_offline_create(uint num_mods, DR_PARAM_OUT void **handle);
+
+DR_EXPORT
+/**
+ * Sets entry \p index of a module list created by drmodtrack_offline_create() to
+ * the information in \p info.  The caller must initialize the \p size field of
+ * \p info.  The \p info.index field is ignored.  The path is copied, while the
+ * \p info.custom field is stored as-is and is passed to the \p free_cb of
+ * drmodtrack_add_custom_data() by drmodtrack_offline_exit().  The module's entry
+ * point is not part of #drmodtrack_info_t and is written as zero.
+ */
+drcovlib_status_t
+drmodtrack_offline_set(void *handle, uint index, const drmodtrack_info_t *info);
+
 DR_EXPORT
 /**
  * Writes the module information that was read by drmodtrack_offline_read(),
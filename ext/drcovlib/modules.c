@@ -818,6 +818,55 @@ drmodtrack_offline_lookup(void *handle, uint index, DR_PARAM_OUT drmodtrack_info
     return DRCOVLIB_SUCCESS;
 }
 
+drcovlib_status_t
+drmodtrack_offline_create(uint num_mods, DR_PARAM_OUT void **handle)
+{
+    module_read_info_t *info;
+    uint i;
+    if (handle == NULL || num_mods == 0)
+        return DRCOVLIB_ERROR_INVALID_PARAMETER;
+    info = (module_read_info_t *)dr_global_alloc(sizeof(*info));
+    info->map = NULL;
+    info->map_size = 0;
+    info->num_mods = num_mods;
+    info->mod = (module_read_entry_t *)dr_global_alloc(num_mods * sizeof(*info->mod));
+    memset(info->mod, 0, num_mods * sizeof(*info->mod));
+    for (i = 0; i < num_mods; i++) {
+        info->mod[i].path = info->mod[i].path_buf;
+        info->mod[i].offset = (uint64)-1;
+        info->mod[i].preferred_base = (app_pc)-1;
+    }
+    *handle = (void *)info;
+    return DRCOVLIB_SUCCESS;
+}
+
+drcovlib_status_t
+drmodtrack_offline_set(void *handle, uint index, const drmodtrack_info_t *in)
+{
+    module_read_info_t *info = (module_read_info_t *)handle;
+    if (info == NULL || index >= info->num_mods || in == NULL || in->path == NULL ||
+        in->struct_size < offsetof(drmodtrack_info_t, custom) + sizeof(in->custom) ||
+        in->containing_index >= info->num_mods)
+        return DRCOVLIB_ERROR_INVALID_PARAMETER;
+    info->mod[index].containing_id = in->containing_index;
+    info->mod[index].base = in->start;
+    info->mod[index].size = in->size;
+    info->mod[index].path = info->mod[index].path_buf;
+    dr_snprintf(info->mod[index].path_buf,
+                BUFFER_SIZE_ELEMENTS(info->mod[index].path_buf), "%s", in->path);
+    NULL_TERMINATE_BUFFER(info->mod[index].path_buf);
+#ifdef WINDOWS
+    info->mod[index].checksum = in->checksum;
+    info->mod[index].timestamp = in->timestamp;
+#endif
+    info->mod[index].custom = in->custom;
+    if (in->struct_size > offsetof(drmodtrack_info_t, offset))
+        info->mod[index].offset = in->offset;
+    if (in->struct_size > offsetof(drmodtrack_info_t, preferred_base))
+        info->mod[index].preferred_base = in->preferred_base;
+    return DRCOVLIB_SUCCESS;
+}
+
 drcovlib_status_t
 drmodtrack_offline_write(void *handle, DR_PARAM_OUT char *buf_start, size_t size,
                          DR_PARAM_OUT size_t *wrote)
@@ -239,6 +239,35 @@ drsym_error_t
 drsym_lookup_address(const char *modpath, size_t modoffs, drsym_info_t *info /*INOUT*/,
                      uint flags);
 
+DR_EXPORT
+/**
+ * Retrieves symbol information for each of a set of module offsets, as though
+ * drsym_lookup_address() were called on each in turn.  The module is looked up
+ * once for the whole set, and for DWARF line information consecutive lookups
+ * of increasing offsets are cheaper than unrelated ones, so callers
+ * symbolizing many addresses should sort \p modoffs in increasing order.
+ * Unsorted offsets are also supported.
+ *
+ * @param[in] modpath The full path to the module to be queried.
+ * @param[in] count   The number of entries in \p modoffs, \p info, and \p results.
+ * @param[in] modoffs The offsets from the base of the module to be queried.
+ * @param[in,out] info An array of \p count structures, each of which is filled
+ *   in as for drsym_lookup_address() with the information for the
+ *   corresponding entry of \p modoffs.  Each must have its struct_size and
+ *   buffer fields initialized.
+ * @param[out] results An array of \p count values receiving the result that
+ *   drsym_lookup_address() would have returned for each entry.
+ * @param[in]  flags   Options for the operation as a combination of drsym_flags_t
+ *    values, as for drsym_lookup_address().
+ *
+ * \return DRSYM_SUCCESS if the module was loaded, in which case the individual
+ * results are in \p results; otherwise an error code applying to every entry.
+ */
+drsym_error_t
+drsym_lookup_addresses(const char *modpath, size_t count, const size_t *modoffs,
+                       drsym_info_t *info /*INOUT*/, drsym_error_t *results /*OUT*/,
+                       uint flags);
+
 enum {
     DRSYM_TYPE_OTHER,    /**< Unknown type, cannot downcast. */
     DRSYM_TYPE_INT,      /**< Integer, cast to drsym_int_type_t. */
@@ -39,6 +39,9 @@
 #include "drsyms.h"
 #include "drsyms_private.h"
 
+#include <stdlib.h> /* qsort */
+#include <string.h>
+
 void
 pool_init(mempool_t *pool, char *buf, size_t sz)
 {
@@ -62,3 +65,100 @@ pool_alloc(mempool_t *pool, size_t sz)
     }
     return ret;
 }
+
+void
+line_index_init(line_index_t *index)
+{
+    memset(index, 0, sizeof(*index));
+}
+
+void
+line_index_free(line_index_t *index)
+{
+    if (index->entries != NULL)
+        dr_global_free(index->entries, index->capacity * sizeof(*index->entries));
+    line_index_init(index);
+}
+
+void
+line_index_add(line_index_t *index, uint64 addr, const char *file, uint64 line,
+               bool end_sequence)
+{
+    line_entry_t *entry;
+    if (index->num_entries == index->capacity) {
+        size_t new_capacity = index->capacity == 0 ? 1024 : index->capacity * 2;
+        line_entry_t *entries =
+            (line_entry_t *)dr_global_alloc(new_capacity * sizeof(*entries));
+        if (index->entries != NULL) {
+            memcpy(entries, index->entries, index->num_entries * sizeof(*entries));
+            dr_global_free(index->entries, index->capacity * sizeof(*entries));
+        }
+        index->entries = entries;
+        index->capacity = new_capacity;
+    }
+    entry = &index->entries[index->num_entries];
+    entry->addr = addr;
+    entry->file = file;
+    entry->line = (uint)line;
+    /* Lookups take the last of several entries with the same address.  Placing
+     * end-of-sequence entries first prefers the code that starts there, and
+     * otherwise we keep the order in which the line table listed them.
+     */
+    entry->rank =
+        (uint)(index->num_entries & 0x7fffffff) | (end_sequence ? 0 : 0x80000000);
+    index->num_entries++;
+}
+
+static int
+compare_line_entries(const void *a, const void *b)
+{
+    const line_entry_t *entry_a = (const line_entry_t *)a;
+    const line_entry_t *entry_b = (const line_entry_t *)b;
+    if (entry_a->addr != entry_b->addr)
+        return entry_a->addr < entry_b->addr ? -1 : 1;
+    if (entry_a->rank != entry_b->rank)
+        return entry_a->rank < entry_b->rank ? -1 : 1;
+    return 0;
+}
+
+void
+line_index_finish(line_index_t *index)
+{
+    qsort(index->entries, index->num_entries, sizeof(*index->entries),
+          compare_line_entries);
+    index->cursor = 0;
+}
+
+line_entry_t *
+line_index_lookup(line_index_t *index, uint64 addr)
+{
+    line_entry_t *entries = index->entries;
+    /* We look for the first entry above addr in [lo, hi). */
+    size_t lo = 0, hi = index->num_entries;
+    if (hi == 0 || addr < entries[0].addr)
+        return NULL;
+    if (index->cursor < hi && entries[index->cursor].addr <= addr) {
+        /* Gallop forward from the previous match, which is cheap for callers
+         * walking through a sorted set of addresses.
+         */
+        size_t step = 1;
+        lo = index->cursor + 1;
+        while (lo + step - 1 < hi && entries[lo + step - 1].addr <= addr) {
+            lo += step;
+            step *= 2;
+        }
+        if (lo + step - 1 < hi)
+            hi = lo + step - 1;
+    } else
+        hi = index->cursor;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    /* entries[0].addr <= addr so lo >= 1. */
+    index->cursor = lo - 1;
+    return &entries[lo - 1];
+}
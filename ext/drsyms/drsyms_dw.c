@@ -64,18 +64,11 @@ typedef struct _dwarf_module_t {
     size_t num_lines;
     /* Amount to adjust all offsets for __PAGEZERO + PIE (i#1365) */
     ssize_t offs_adjust;
+    /* Lines of all CUs sorted by address, built on the first line lookup. */
+    line_index_t line_index;
+    bool line_index_built;
 } dwarf_module_t;
 
-typedef enum {
-    SEARCH_FOUND = 0,
-    SEARCH_MAYBE = 1,
-    SEARCH_NOT_FOUND = 2,
-} search_result_t;
-
-static search_result_t
-search_addr2line_in_cu(dwarf_module_t *mod, Dwarf_Addr pc, Dwarf_Die *cu_die,
-                       drsym_info_t *sym_info DR_PARAM_OUT);
-
 /******************************************************************************
  * DWARF parsing code.
  */
@@ -103,129 +96,6 @@ next_die_matching_tag(dwarf_lib_handle_t dbg, Dwarf_Tag search_tag)
 }
 #endif
 
-/* Iterate over all the CUs in the module to find the CU containing the given
- * PC.
- */
-static Dwarf_Die *
-find_cu_die_via_iter(dwarf_lib_handle_t dbg, Dwarf_Addr pc, Dwarf_Die *cu_die)
-{
-    Dwarf_Die *res = NULL;
-    Dwarf_Off cu_offset = 0, prev_offset = 0;
-    size_t hsize;
-
-    while (dwarf_nextcu(dbg, cu_offset, &cu_offset, &hsize, NULL, NULL, NULL) == 0) {
-        /* NOCHECK: do we need to "Scan forward in the tag soup for a CU DIE" via
-         * next_die_matching_tag(dbg, DW_TAG_compile_unit) as drsyms_dwarf does?
-         * Wouldn't dwarf_nextcu always find a CU DIE??
-         * Ditto for the other 2 dwarf_nextcu loops below.
-         */
-        if (dwarf_offdie(dbg, prev_offset + hsize, cu_die) != NULL) {
-            /* We found a CU die, now check if it's the one we wanted. */
-            Dwarf_Addr lo_pc, hi_pc;
-            if (dwarf_lowpc(cu_die, &lo_pc) != 0 || dwarf_highpc(cu_die, &hi_pc) != 0) {
-                NOTIFY_DWARF();
-                break;
-            }
-            if (lo_pc <= pc && pc < hi_pc) {
-                res = cu_die;
-                break;
-            }
-        }
-        prev_offset = cu_offset;
-    }
-
-    while (dwarf_nextcu(dbg, cu_offset, &cu_offset, &hsize, NULL, NULL, NULL) == 0) {
-        /* Reset the internal CU header state. */
-    }
-
-    return res;
-}
-
-static Dwarf_Die *
-find_cu_die(dwarf_lib_handle_t dbg, Dwarf_Addr pc, Dwarf_Die *cu_die)
-{
-    Dwarf_Aranges *arlist;
-    size_t arcnt;
-    Dwarf_Arange *ar;
-    Dwarf_Off die_offs;
-    if (dwarf_getaranges(dbg, &arlist, &arcnt) != 0) {
-        NOTIFY_DWARF();
-        return NULL;
-    }
-    ar = dwarf_getarange_addr(arlist, pc);
-    if (ar == NULL || dwarf_getarangeinfo(ar, NULL, NULL, &die_offs) != 0 ||
-        dwarf_offdie(dbg, die_offs, cu_die) == NULL) {
-        NOTIFY_DWARF();
-        /* Try to find it by walking all CU's and looking at their lowpc+highpc
-         * entries, which should work if each has a single contiguous
-         * range.  Note that Cygwin and MinGW gcc don't seen to include
-         * lowpc+highpc in their CU's.
-         */
-        return find_cu_die_via_iter(dbg, pc, cu_die);
-    }
-    return cu_die;
-}
-
-/* Given a function DIE and a PC, fill out sym_info with line information.
- */
-bool
-drsym_dwarf_search_addr2line(void *mod_in, Dwarf_Addr pc,
-                             drsym_info_t *sym_info DR_PARAM_OUT)
-{
-    dwarf_module_t *mod = (dwarf_module_t *)mod_in;
-    Dwarf_Die cu_die;
-    Dwarf_Off cu_offset = 0, prev_offset = 0;
-    size_t hsize;
-    bool success = false;
-    search_result_t res;
-
-    pc += mod->offs_adjust;
-
-    /* On failure, these should be zeroed.
-     */
-    sym_info->file_available_size = 0;
-    if (sym_info->file != NULL)
-        sym_info->file[0] = '\0';
-    sym_info->line = 0;
-    sym_info->line_offs = 0;
-
-    /* First try cutting down the search space by finding the CU (i.e., the .c
-     * file) that this function belongs to.
-     */
-    if (find_cu_die(mod->dbg, pc, &cu_die) == NULL) {
-        NOTIFY("%s: failed to find CU die for " PFX ", searching all CUs\n", __FUNCTION__,
-               (ptr_uint_t)pc);
-    } else {
-        return (search_addr2line_in_cu(mod, pc, &cu_die, sym_info) != SEARCH_NOT_FOUND);
-    }
-
-    /* We failed to find a CU containing this PC.  Some compilers (clang) don't
-     * put lo_pc hi_pc attributes on compilation units.  In this case, we
-     * iterate all the CUs and dig into the dwarf tag soup for all of them.
-     */
-    while (dwarf_nextcu(mod->dbg, cu_offset, &cu_offset, &hsize, NULL, NULL, NULL) == 0) {
-        /* Scan forward in the tag soup for a CU DIE. */
-        if (dwarf_offdie(mod->dbg, prev_offset + hsize, &cu_die) != NULL) {
-            /* We found a CU die, now check if it's the one we wanted. */
-            res = search_addr2line_in_cu(mod, pc, &cu_die, sym_info);
-            if (res == SEARCH_FOUND) {
-                success = true;
-                break;
-            } else if (res == SEARCH_MAYBE) {
-                success = true;
-                /* try to find a better fit: continue searching */
-            }
-        }
-        prev_offset = cu_offset;
-    }
-
-    while (dwarf_nextcu(mod->dbg, cu_offset, &cu_offset, &hsize, NULL, NULL, NULL) == 0) {
-        /* Reset the internal CU header state. */
-    }
-
-    return success;
-}
-
 static size_t
 get_lines_from_cu(dwarf_module_t *mod, Dwarf_Die *cu_die,
                   Dwarf_Lines **lines_out DR_PARAM_OUT)
@@ -248,83 +118,102 @@ get_lines_from_cu(dwarf_module_t *mod, Dwarf_Die *cu_die,
     return mod->num_lines;
 }
 
-static search_result_t
-search_addr2line_in_cu(dwarf_module_t *mod, Dwarf_Addr pc, Dwarf_Die *cu_die,
-                       drsym_info_t *sym_info DR_PARAM_OUT)
+static void
+add_cu_lines_to_index(dwarf_module_t *mod, Dwarf_Die *cu_die)
 {
     Dwarf_Lines *lines = NULL;
-    size_t num_lines;
-    int i;
-    Dwarf_Addr lineaddr, next_lineaddr = 0;
-    Dwarf_Line *dw_line;
-    search_result_t res = SEARCH_NOT_FOUND;
+    size_t num_lines, i;
 
     num_lines = get_lines_from_cu(mod, cu_die, &lines);
-    if (num_lines < 0)
-        return SEARCH_NOT_FOUND;
-
-    if (verbose) {
-        const char *name = dwarf_diename(cu_die);
-        if (name != NULL) {
-            NOTIFY("%s: searching cu %s for pc 0" PFX "\n", __FUNCTION__, name,
-                   (ptr_uint_t)pc);
-        }
-    }
-
-    /* We could binary search this, but we assume dwarf_srclines is the
-     * bottleneck.
-     */
-    dw_line = NULL;
-    for (i = 0; i < num_lines - 1; i++) {
+    if (num_lines == (size_t)-1)
+        return;
+    for (i = 0; i < num_lines; i++) {
         Dwarf_Line *line = dwarf_onesrcline(lines, i);
-        Dwarf_Line *next_line = dwarf_onesrcline(lines, i + 1);
-        if (line == NULL || next_line == NULL || dwarf_lineaddr(line, &lineaddr) != 0 ||
-            dwarf_lineaddr(next_line, &next_lineaddr) != 0) {
+        const char *file;
+        int lineno;
+        Dwarf_Addr lineaddr;
+        bool end_sequence;
+
+        if (line == NULL || dwarf_lineaddr(line, &lineaddr) != 0 ||
+            dwarf_lineno(line, &lineno) != 0) {
             NOTIFY_DWARF();
-            break;
-        }
-        NOTIFY("%s: pc " PFX " vs line " PFX "-" PFX "\n", __FUNCTION__, (ptr_uint_t)pc,
-               (ptr_uint_t)lineaddr, (ptr_uint_t)next_lineaddr);
-        if (lineaddr <= pc && pc < next_lineaddr) {
-            dw_line = line;
-            res = SEARCH_FOUND;
-            break;
+            continue;
         }
+        /* A line without a file is kept so that it still bounds the line
+         * before it, but lookups landing on it fail.
+         */
+        file = dwarf_linesrc(line, NULL, NULL);
+        if (file == NULL)
+            NOTIFY_DWARF();
+        if (dwarf_lineendsequence(line, &end_sequence) != 0)
+            end_sequence = false;
+        line_index_add(&mod->line_index, lineaddr, file, lineno, end_sequence);
     }
-    /* Handle the case when the PC is from the last line of the CU. */
-    if (i == num_lines - 1 && dw_line == NULL && next_lineaddr <= pc) {
-        NOTIFY("%s: pc " PFX " vs last line " PFX "\n", __FUNCTION__, (ptr_uint_t)pc,
-               (ptr_uint_t)next_lineaddr);
-        dw_line = dwarf_onesrcline(lines, num_lines - 1);
-        if (dw_line != NULL)
-            res = SEARCH_MAYBE;
+}
+
+/* Rather than locating the CU for each query and walking its lines, we read
+ * the lines of every CU once and binary search them from then on.  This also
+ * covers CUs without lowpc+highpc or aranges entries (clang; Cygwin and MinGW
+ * gcc), which used to require a scan of every CU per query.
+ */
+static void
+build_line_index(dwarf_module_t *mod)
+{
+    Dwarf_Die cu_die;
+    Dwarf_Off cu_offset = 0, prev_offset = 0;
+    size_t hsize;
+
+    while (dwarf_nextcu(mod->dbg, cu_offset, &cu_offset, &hsize, NULL, NULL, NULL) == 0) {
+        if (dwarf_offdie(mod->dbg, prev_offset + hsize, &cu_die) != NULL)
+            add_cu_lines_to_index(mod, &cu_die);
+        prev_offset = cu_offset;
     }
+    line_index_finish(&mod->line_index);
+    mod->line_index_built = true;
+    NOTIFY("%s: indexed %d lines\n", __FUNCTION__, (int)mod->line_index.num_entries);
+}
 
-    /* If we found dw_line, use it to fill out sym_info. */
-    if (dw_line != NULL) {
-        const char *file;
-        int lineno;
+/* Given a PC, fill out sym_info with line information.
+ */
+bool
+drsym_dwarf_search_addr2line(void *mod_in, Dwarf_Addr pc,
+                             drsym_info_t *sym_info DR_PARAM_OUT)
+{
+    dwarf_module_t *mod = (dwarf_module_t *)mod_in;
+    line_entry_t *entry;
 
-        file = dwarf_linesrc(dw_line, NULL, NULL);
-        if (file == NULL || dwarf_lineno(dw_line, &lineno) != 0 ||
-            dwarf_lineaddr(dw_line, &lineaddr) != 0) {
-            NOTIFY_DWARF();
-            res = SEARCH_NOT_FOUND;
-        } else {
-            /* File comes from .debug_str and therefore lives until
-             * drsym_exit, but caller has provided space that we must copy into.
-             */
-            sym_info->file_available_size = strlen(file);
-            if (sym_info->file != NULL) {
-                strncpy(sym_info->file, file, sym_info->file_size);
-                sym_info->file[sym_info->file_size - 1] = '\0';
-            }
-            sym_info->line = lineno;
-            sym_info->line_offs = (size_t)(pc - lineaddr);
-        }
+    pc += mod->offs_adjust;
+
+    /* On failure, these should be zeroed.
+     */
+    sym_info->file_available_size = 0;
+    if (sym_info->file != NULL)
+        sym_info->file[0] = '\0';
+    sym_info->line = 0;
+    sym_info->line_offs = 0;
+
+    if (!mod->line_index_built)
+        build_line_index(mod);
+    /* As before, a PC past the last line of a CU maps to that last line. */
+    entry = line_index_lookup(&mod->line_index, pc);
+    if (entry == NULL || entry->file == NULL) {
+        NOTIFY("%s: no line found for " PFX "\n", __FUNCTION__, (ptr_uint_t)pc);
+        return false;
     }
+    NOTIFY("%s: pc " PFX " vs line " PFX "\n", __FUNCTION__, (ptr_uint_t)pc,
+           (ptr_uint_t)entry->addr);
 
-    return res;
+    /* File comes from .debug_str and therefore lives until
+     * drsym_exit, but caller has provided space that we must copy into.
+     */
+    sym_info->file_available_size = strlen(entry->file);
+    if (sym_info->file != NULL) {
+        strncpy(sym_info->file, entry->file, sym_info->file_size);
+        sym_info->file[sym_info->file_size - 1] = '\0';
+    }
+    sym_info->line = entry->line;
+    sym_info->line_offs = (size_t)(pc - entry->addr);
+    return true;
 }
 
 /* Return value: 0 means success but break; 1 means success and continue;
@@ -422,6 +311,7 @@ drsym_dwarf_init(dwarf_lib_handle_t dbg)
     dwarf_module_t *mod = (dwarf_module_t *)dr_global_alloc(sizeof(*mod));
     memset(mod, 0, sizeof(*mod));
     mod->dbg = dbg;
+    line_index_init(&mod->line_index);
     return mod;
 }
 
@@ -429,6 +319,7 @@ void
 drsym_dwarf_exit(void *mod_in)
 {
     dwarf_module_t *mod = (dwarf_module_t *)mod_in;
+    line_index_free(&mod->line_index);
     dwarf_end(mod->dbg);
     dr_global_free(mod, sizeof(*mod));
 }
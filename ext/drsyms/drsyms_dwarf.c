@@ -65,18 +65,11 @@ typedef struct _dwarf_module_t {
     Dwarf_Signed num_lines;
     /* Amount to adjust all offsets for __PAGEZERO + PIE (i#1365) */
     ssize_t offs_adjust;
+    /* Lines of all CUs sorted by address, built on the first line lookup. */
+    line_index_t line_index;
+    bool line_index_built;
 } dwarf_module_t;
 
-typedef enum {
-    SEARCH_FOUND = 0,
-    SEARCH_MAYBE = 1,
-    SEARCH_NOT_FOUND = 2,
-} search_result_t;
-
-static search_result_t
-search_addr2line_in_cu(dwarf_module_t *mod, Dwarf_Addr pc, Dwarf_Die cu_die,
-                       drsym_info_t *sym_info DR_PARAM_OUT);
-
 /******************************************************************************
  * DWARF parsing code.
  */
@@ -103,70 +96,6 @@ next_die_matching_tag(dwarf_lib_handle_t dbg, Dwarf_Tag search_tag)
     return die;
 }
 
-/* Iterate over all the CUs in the module to find the CU containing the given
- * PC.
- */
-static Dwarf_Die
-find_cu_die_via_iter(dwarf_lib_handle_t dbg, Dwarf_Addr pc)
-{
-    Dwarf_Die die = NULL;
-    Dwarf_Unsigned cu_offset = 0;
-    Dwarf_Error de; /* expensive to init (DrM#1770) */
-    Dwarf_Die cu_die = NULL;
-
-    while (dwarf_next_cu_header(dbg, NULL, NULL, NULL, NULL, &cu_offset, &de) ==
-           DW_DLV_OK) {
-        /* Scan forward in the tag soup for a CU DIE. */
-        die = next_die_matching_tag(dbg, DW_TAG_compile_unit);
-
-        /* We found a CU die, now check if it's the one we wanted. */
-        if (die != NULL) {
-            Dwarf_Addr lo_pc, hi_pc;
-            if (dwarf_lowpc(die, &lo_pc, &de) != DW_DLV_OK ||
-                dwarf_highpc(die, &hi_pc, &de) != DW_DLV_OK) {
-                NOTIFY_DWARF(de);
-                break;
-            }
-
-            if (lo_pc <= pc && pc < hi_pc) {
-                cu_die = die;
-                break;
-            }
-        }
-    }
-
-    while (dwarf_next_cu_header(dbg, NULL, NULL, NULL, NULL, &cu_offset, &de) ==
-           DW_DLV_OK) {
-        /* Reset the internal CU header state. */
-    }
-
-    return cu_die;
-}
-
-static Dwarf_Die
-find_cu_die(dwarf_lib_handle_t dbg, Dwarf_Addr pc)
-{
-    Dwarf_Error de; /* expensive to init (DrM#1770) */
-    Dwarf_Die cu_die = NULL;
-    Dwarf_Arange *arlist;
-    Dwarf_Signed arcnt;
-    Dwarf_Arange ar;
-    Dwarf_Off die_offs;
-    if (dwarf_get_aranges(dbg, &arlist, &arcnt, &de) != DW_DLV_OK ||
-        dwarf_get_arange(arlist, arcnt, pc, &ar, &de) != DW_DLV_OK ||
-        dwarf_get_cu_die_offset(ar, &die_offs, &de) != DW_DLV_OK ||
-        dwarf_offdie(dbg, die_offs, &cu_die, &de) != DW_DLV_OK) {
-        NOTIFY_DWARF(de);
-        /* Try to find it by walking all CU's and looking at their lowpc+highpc
-         * entries, which should work if each has a single contiguous
-         * range.  Note that Cygwin and MinGW gcc don't seen to include
-         * lowpc+highpc in their CU's.
-         */
-        cu_die = find_cu_die_via_iter(dbg, pc);
-    }
-    return cu_die;
-}
-
 static int
 compare_lines(const void *a_in, const void *b_in)
 {
@@ -184,70 +113,6 @@ compare_lines(const void *a_in, const void *b_in)
     return 0;
 }
 
-/* Given a function DIE and a PC, fill out sym_info with line information.
- */
-bool
-drsym_dwarf_search_addr2line(void *mod_in, Dwarf_Addr pc,
-                             drsym_info_t *sym_info DR_PARAM_OUT)
-{
-    dwarf_module_t *mod = (dwarf_module_t *)mod_in;
-    Dwarf_Error de; /* expensive to init (DrM#1770) */
-    Dwarf_Die cu_die;
-    Dwarf_Unsigned cu_offset = 0;
-    bool success = false;
-    search_result_t res;
-
-    pc += mod->offs_adjust;
-
-    /* On failure, these should be zeroed.
-     */
-    sym_info->file_available_size = 0;
-    if (sym_info->file != NULL)
-        sym_info->file[0] = '\0';
-    sym_info->line = 0;
-    sym_info->line_offs = 0;
-
-    /* First try cutting down the search space by finding the CU (i.e., the .c
-     * file) that this function belongs to.
-     */
-    cu_die = find_cu_die(mod->dbg, pc);
-    if (cu_die == NULL) {
-        NOTIFY("%s: failed to find CU die for " PFX ", searching all CUs\n", __FUNCTION__,
-               (ptr_uint_t)pc);
-    } else {
-        return (search_addr2line_in_cu(mod, pc, cu_die, sym_info) != SEARCH_NOT_FOUND);
-    }
-
-    /* We failed to find a CU containing this PC.  Some compilers (clang) don't
-     * put lo_pc hi_pc attributes on compilation units.  In this case, we
-     * iterate all the CUs and dig into the dwarf tag soup for all of them.
-     */
-    while (dwarf_next_cu_header(mod->dbg, NULL, NULL, NULL, NULL, &cu_offset, &de) ==
-           DW_DLV_OK) {
-        /* Scan forward in the tag soup for a CU DIE. */
-        cu_die = next_die_matching_tag(mod->dbg, DW_TAG_compile_unit);
-
-        /* We found a CU die, now check if it's the one we wanted. */
-        if (cu_die != NULL) {
-            res = search_addr2line_in_cu(mod, pc, cu_die, sym_info);
-            if (res == SEARCH_FOUND) {
-                success = true;
-                break;
-            } else if (res == SEARCH_MAYBE) {
-                success = true;
-                /* try to find a better fit: continue searching */
-            }
-        }
-    }
-
-    while (dwarf_next_cu_header(mod->dbg, NULL, NULL, NULL, NULL, &cu_offset, &de) ==
-           DW_DLV_OK) {
-        /* Reset the internal CU header state. */
-    }
-
-    return success;
-}
-
 static Dwarf_Signed
 get_lines_from_cu(dwarf_module_t *mod, Dwarf_Die cu_die,
                   Dwarf_Line **lines_out DR_PARAM_OUT)
@@ -274,81 +139,103 @@ get_lines_from_cu(dwarf_module_t *mod, Dwarf_Die cu_die,
     return mod->num_lines;
 }
 
-static search_result_t
-search_addr2line_in_cu(dwarf_module_t *mod, Dwarf_Addr pc, Dwarf_Die cu_die,
-                       drsym_info_t *sym_info DR_PARAM_OUT)
+static void
+add_cu_lines_to_index(dwarf_module_t *mod, Dwarf_Die cu_die)
 {
     Dwarf_Line *lines;
-    Dwarf_Signed num_lines;
-    int i;
-    Dwarf_Addr lineaddr, next_lineaddr = 0;
-    Dwarf_Line dw_line;
+    Dwarf_Signed num_lines, i;
     Dwarf_Error de; /* expensive to init (DrM#1770) */
-    search_result_t res = SEARCH_NOT_FOUND;
 
     num_lines = get_lines_from_cu(mod, cu_die, &lines);
-    if (num_lines < 0)
-        return SEARCH_NOT_FOUND;
-
-    if (verbose) {
-        char *name;
-        if (dwarf_diename(cu_die, &name, &de) == DW_DLV_OK) {
-            NOTIFY("%s: searching cu %s for pc 0" PFX "\n", __FUNCTION__, name,
-                   (ptr_uint_t)pc);
-        }
-    }
+    for (i = 0; i < num_lines; i++) {
+        char *file;
+        Dwarf_Unsigned lineno;
+        Dwarf_Addr lineaddr;
+        Dwarf_Bool end_sequence;
 
-    /* We could binary search this, but we assume dwarf_srclines is the
-     * bottleneck.
-     */
-    dw_line = NULL;
-    for (i = 0; i < num_lines - 1; i++) {
         if (dwarf_lineaddr(lines[i], &lineaddr, &de) != DW_DLV_OK ||
-            dwarf_lineaddr(lines[i + 1], &next_lineaddr, &de) != DW_DLV_OK) {
+            dwarf_lineno(lines[i], &lineno, &de) != DW_DLV_OK) {
             NOTIFY_DWARF(de);
-            break;
+            continue;
         }
-        NOTIFY("%s: pc " PFX " vs line " PFX "-" PFX "\n", __FUNCTION__, (ptr_uint_t)pc,
-               (ptr_uint_t)lineaddr, (ptr_uint_t)next_lineaddr);
-        if (lineaddr <= pc && pc < next_lineaddr) {
-            dw_line = lines[i];
-            res = SEARCH_FOUND;
-            break;
+        /* A line without a file is kept so that it still bounds the line
+         * before it, but lookups landing on it fail.
+         */
+        if (dwarf_linesrc(lines[i], &file, &de) != DW_DLV_OK) {
+            NOTIFY_DWARF(de);
+            file = NULL;
         }
+        if (dwarf_lineendsequence(lines[i], &end_sequence, &de) != DW_DLV_OK)
+            end_sequence = false;
+        line_index_add(&mod->line_index, lineaddr, file, lineno, end_sequence);
     }
-    /* Handle the case when the PC is from the last line of the CU. */
-    if (i == num_lines - 1 && dw_line == NULL && next_lineaddr <= pc) {
-        NOTIFY("%s: pc " PFX " vs last line " PFX "\n", __FUNCTION__, (ptr_uint_t)pc,
-               (ptr_uint_t)next_lineaddr);
-        dw_line = lines[num_lines - 1];
-        res = SEARCH_MAYBE;
+}
+
+/* Rather than locating the CU for each query and walking its lines, we read
+ * the lines of every CU once and binary search them from then on.  This also
+ * covers CUs without lowpc+highpc or aranges entries (clang; Cygwin and MinGW
+ * gcc), which used to require a scan of every CU per query.
+ */
+static void
+build_line_index(dwarf_module_t *mod)
+{
+    Dwarf_Error de; /* expensive to init (DrM#1770) */
+    Dwarf_Die cu_die;
+    Dwarf_Unsigned cu_offset = 0;
+
+    while (dwarf_next_cu_header(mod->dbg, NULL, NULL, NULL, NULL, &cu_offset, &de) ==
+           DW_DLV_OK) {
+        /* Scan forward in the tag soup for a CU DIE. */
+        cu_die = next_die_matching_tag(mod->dbg, DW_TAG_compile_unit);
+        if (cu_die != NULL)
+            add_cu_lines_to_index(mod, cu_die);
     }
+    line_index_finish(&mod->line_index);
+    mod->line_index_built = true;
+    NOTIFY("%s: indexed %d lines\n", __FUNCTION__, (int)mod->line_index.num_entries);
+}
 
-    /* If we found dw_line, use it to fill out sym_info. */
-    if (dw_line != NULL) {
-        char *file;
-        Dwarf_Unsigned lineno;
+/* Given a PC, fill out sym_info with line information.
+ */
+bool
+drsym_dwarf_search_addr2line(void *mod_in, Dwarf_Addr pc,
+                             drsym_info_t *sym_info DR_PARAM_OUT)
+{
+    dwarf_module_t *mod = (dwarf_module_t *)mod_in;
+    line_entry_t *entry;
 
-        if (dwarf_linesrc(dw_line, &file, &de) != DW_DLV_OK ||
-            dwarf_lineno(dw_line, &lineno, &de) != DW_DLV_OK ||
-            dwarf_lineaddr(dw_line, &lineaddr, &de) != DW_DLV_OK) {
-            NOTIFY_DWARF(de);
-            res = SEARCH_NOT_FOUND;
-        } else {
-            /* File comes from .debug_str and therefore lives until
-             * drsym_exit, but caller has provided space that we must copy into.
-             */
-            sym_info->file_available_size = strlen(file);
-            if (sym_info->file != NULL) {
-                strncpy(sym_info->file, file, sym_info->file_size);
-                sym_info->file[sym_info->file_size - 1] = '\0';
-            }
-            sym_info->line = lineno;
-            sym_info->line_offs = (size_t)(pc - lineaddr);
-        }
+    pc += mod->offs_adjust;
+
+    /* On failure, these should be zeroed.
+     */
+    sym_info->file_available_size = 0;
+    if (sym_info->file != NULL)
+        sym_info->file[0] = '\0';
+    sym_info->line = 0;
+    sym_info->line_offs = 0;
+
+    if (!mod->line_index_built)
+        build_line_index(mod);
+    /* As before, a PC past the last line of a CU maps to that last line. */
+    entry = line_index_lookup(&mod->line_index, pc);
+    if (entry == NULL || entry->file == NULL) {
+        NOTIFY("%s: no line found for " PFX "\n", __FUNCTION__, (ptr_uint_t)pc);
+        return false;
     }
+    NOTIFY("%s: pc " PFX " vs line " PFX "\n", __FUNCTION__, (ptr_uint_t)pc,
+           (ptr_uint_t)entry->addr);
 
-    return res;
+    /* File comes from .debug_str and therefore lives until
+     * drsym_exit, but caller has provided space that we must copy into.
+     */
+    sym_info->file_available_size = strlen(entry->file);
+    if (sym_info->file != NULL) {
+        strncpy(sym_info->file, entry->file, sym_info->file_size);
+        sym_info->file[sym_info->file_size - 1] = '\0';
+    }
+    sym_info->line = entry->line;
+    sym_info->line_offs = (size_t)(pc - entry->addr);
+    return true;
 }
 
 /* Return value: 0 means success but break; 1 means success and continue;
@@ -450,6 +337,7 @@ drsym_dwarf_init(dwarf_lib_handle_t dbg)
     dwarf_module_t *mod = (dwarf_module_t *)dr_global_alloc(sizeof(*mod));
     memset(mod, 0, sizeof(*mod));
     mod->dbg = dbg;
+    line_index_init(&mod->line_index);
     return mod;
 }
 
@@ -459,6 +347,7 @@ drsym_dwarf_exit(void *mod_in)
     dwarf_module_t *mod = (dwarf_module_t *)mod_in;
     if (mod->lines != NULL)
         dwarf_srclines_dealloc(mod->dbg, mod->lines, mod->num_lines);
+    line_index_free(&mod->line_index);
     dwarf_finish(mod->dbg, NULL);
     dr_global_free(mod, sizeof(*mod));
 }
@@ -80,6 +80,53 @@ pool_alloc(mempool_t *pool, size_t sz);
 #define POOL_ALLOC(pool, type) ((type *)pool_alloc(pool, sizeof(type)))
 #define POOL_ALLOC_SIZE(pool, type, size) ((type *)pool_alloc(pool, (size)))
 
+/***************************************************************************
+ * Address-to-line index
+ * The DWARF backends flatten the line tables of every CU of a module into one
+ * array sorted by address so that each address lookup is a binary search
+ * rather than a linear walk of a CU's lines.
+ */
+
+typedef struct _line_entry_t {
+    uint64 addr;
+    /* Points into the debug info, which outlives the index. */
+    const char *file;
+    uint line;
+    /* Orders entries with the same address: see line_index_add(). */
+    uint rank;
+} line_entry_t;
+
+typedef struct _line_index_t {
+    line_entry_t *entries;
+    size_t num_entries;
+    size_t capacity;
+    /* The most recent match, where the next search starts.  This makes a
+     * sequence of increasing addresses cost O(log distance) per lookup.
+     */
+    size_t cursor;
+} line_index_t;
+
+void
+line_index_init(line_index_t *index);
+
+void
+line_index_free(line_index_t *index);
+
+/* An end-of-sequence entry marks the first address past a run of code.  Where
+ * it coincides with the start of another sequence the other entry wins.
+ */
+void
+line_index_add(line_index_t *index, uint64 addr, const char *file, uint64 line,
+               bool end_sequence);
+
+/* Sorts the entries added so far.  Must be called before line_index_lookup(). */
+void
+line_index_finish(line_index_t *index);
+
+/* Returns the entry with the highest address <= addr, or NULL if there is none. */
+line_entry_t *
+line_index_lookup(line_index_t *index, uint64 addr);
+
 /***************************************************************************
  * Cygwin interface from Unix to Windows
  * For all of these, the caller is responsible for synchronization
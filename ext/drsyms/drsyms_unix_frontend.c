@@ -156,6 +156,38 @@ drsym_lookup_address_local(const char *modpath, size_t modoffs,
     return r;
 }
 
+static drsym_error_t
+drsym_lookup_addresses_local(const char *modpath, size_t count, const size_t *modoffs,
+                             drsym_info_t *out DR_PARAM_INOUT,
+                             drsym_error_t *results DR_PARAM_OUT, uint flags)
+{
+    void *mod;
+    size_t i;
+
+    if (modpath == NULL)
+        return DRSYM_ERROR_INVALID_PARAMETER;
+    if (count > 0 && (modoffs == NULL || out == NULL || results == NULL))
+        return DRSYM_ERROR_INVALID_PARAMETER;
+
+    dr_recurlock_lock(symbol_lock);
+    mod = lookup_or_load(modpath);
+    if (mod == NULL) {
+        dr_recurlock_unlock(symbol_lock);
+        return DRSYM_ERROR_LOAD_FAILED;
+    }
+
+    for (i = 0; i < count; i++) {
+        /* If we add fields in the future we would dispatch on out->struct_size */
+        if (out[i].struct_size != sizeof(out[i]))
+            results[i] = DRSYM_ERROR_INVALID_SIZE;
+        else
+            results[i] = drsym_unix_lookup_address(mod, modoffs[i], &out[i], flags);
+    }
+
+    dr_recurlock_unlock(symbol_lock);
+    return DRSYM_SUCCESS;
+}
+
 static drsym_error_t
 drsym_enumerate_lines_local(const char *modpath, drsym_enumerate_lines_cb callback,
                             void *data)
@@ -245,6 +277,20 @@ drsym_lookup_address(const char *modpath, size_t modoffs,
     }
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_lookup_addresses(const char *modpath, size_t count, const size_t *modoffs,
+                       drsym_info_t *out DR_PARAM_INOUT,
+                       drsym_error_t *results DR_PARAM_OUT, uint flags)
+{
+    if (IS_SIDELINE) {
+        return DRSYM_ERROR_NOT_IMPLEMENTED;
+    } else {
+        return drsym_lookup_addresses_local(modpath, count, modoffs, out, results,
+                                            flags);
+    }
+}
+
 DR_EXPORT
 drsym_error_t
 drsym_lookup_symbol(const char *modpath, const char *symbol, size_t *modoffs DR_PARAM_OUT,
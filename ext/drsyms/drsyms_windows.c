@@ -1021,6 +1021,32 @@ enum_lines_cb(PSRCCODEINFO in, void *data)
         return TRUE;
 }
 
+static drsym_error_t
+drsym_lookup_addresses_local(const char *modpath, size_t count, const size_t *modoffs,
+                             drsym_info_t *out DR_PARAM_INOUT,
+                             drsym_error_t *results DR_PARAM_OUT, uint flags)
+{
+    size_t i;
+
+    if (modpath == NULL)
+        return DRSYM_ERROR_INVALID_PARAMETER;
+    if (count > 0 && (modoffs == NULL || out == NULL || results == NULL))
+        return DRSYM_ERROR_INVALID_PARAMETER;
+
+    /* dbghelp has no batch interface, so we just hold the lock across the
+     * individual lookups.
+     */
+    dr_recurlock_lock(symbol_lock);
+    if (lookup_or_load(modpath, true /*use dbghelp*/) == NULL) {
+        dr_recurlock_unlock(symbol_lock);
+        return DRSYM_ERROR_LOAD_FAILED;
+    }
+    for (i = 0; i < count; i++)
+        results[i] = drsym_lookup_address_local(modpath, modoffs[i], &out[i], flags);
+    dr_recurlock_unlock(symbol_lock);
+    return DRSYM_SUCCESS;
+}
+
 static drsym_error_t
 drsym_enumerate_lines_local(const char *modpath, drsym_enumerate_lines_cb callback,
                             void *data)
@@ -1455,6 +1481,20 @@ drsym_lookup_address(const char *modpath, size_t modoffs,
     }
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_lookup_addresses(const char *modpath, size_t count, const size_t *modoffs,
+                       drsym_info_t *out DR_PARAM_INOUT,
+                       drsym_error_t *results DR_PARAM_OUT, uint flags)
+{
+    if (IS_SIDELINE) {
+        return DRSYM_ERROR_NOT_IMPLEMENTED;
+    } else {
+        return drsym_lookup_addresses_local(modpath, count, modoffs, out, results,
+                                            flags);
+    }
+}
+
 DR_EXPORT
 drsym_error_t
 drsym_lookup_symbol(const char *modpath, const char *symbol, size_t *modoffs DR_PARAM_OUT,
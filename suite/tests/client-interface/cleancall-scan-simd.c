@@ -0,0 +1,175 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "tools.h"
+
+/* Export instrumented functions so we can easily find them in client.  */
+#define EXPORT __attribute__((visibility("default")))
+
+/* List of instrumented functions.  This must match the list in the client. */
+#define FUNCTIONS()             \
+    FUNCTION(empty)             \
+    FUNCTION(inscount)          \
+    FUNCTION(compiler_inscount) \
+    FUNCTION(bbcount)           \
+    FUNCTION(aflags_clobber)    \
+    FUNCTION(simd_clobber)      \
+    FUNCTION(no_simd)           \
+    FUNCTION(rare_simd)         \
+    LAST_FUNCTION()
+
+/* The client's rare_simd callee takes its SIMD-clobbering path on every
+ * RARE_SIMD_PERIOD-th call.
+ */
+#define RARE_SIMD_PERIOD 4
+
+/* Definitions for every function. */
+volatile int val;
+#define FUNCTION(FUNCNAME)              \
+    EXPORT NOINLINE void FUNCNAME(void) \
+    {                                   \
+        val = 4;                        \
+    }
+#define LAST_FUNCTION()
+FUNCTIONS()
+#undef FUNCTION
+#undef LAST_FUNCTION
+
+/* Sets every bit of the SIMD registers, so that any clobber the clean calls fail to
+ * undo shows up in the client's before and after comparison.
+ */
+static NOINLINE void
+fill_simd(void)
+{
+#define FILL_XMM(n) __asm__ __volatile__("pcmpeqd %%xmm" #n ", %%xmm" #n ::: "xmm" #n)
+    FILL_XMM(0);
+    FILL_XMM(1);
+    FILL_XMM(2);
+    FILL_XMM(3);
+    FILL_XMM(4);
+    FILL_XMM(5);
+    FILL_XMM(6);
+    FILL_XMM(7);
+    FILL_XMM(8);
+    FILL_XMM(9);
+    FILL_XMM(10);
+    FILL_XMM(11);
+    FILL_XMM(12);
+    FILL_XMM(13);
+    FILL_XMM(14);
+    FILL_XMM(15);
+#undef FILL_XMM
+#ifdef __AVX512F__
+    /* This also sets the upper ymm and zmm halves, and makes the lazy AVX-512
+     * detection kick in.
+     */
+#    define FILL_ZMM(n)                                                            \
+        __asm__ __volatile__("vpternlogd $0xff, %%zmm" #n ", %%zmm" #n ", %%zmm" #n :: \
+                                 : "xmm" #n)
+    FILL_ZMM(0);
+    FILL_ZMM(1);
+    FILL_ZMM(2);
+    FILL_ZMM(3);
+    FILL_ZMM(4);
+    FILL_ZMM(5);
+    FILL_ZMM(6);
+    FILL_ZMM(7);
+    FILL_ZMM(8);
+    FILL_ZMM(9);
+    FILL_ZMM(10);
+    FILL_ZMM(11);
+    FILL_ZMM(12);
+    FILL_ZMM(13);
+    FILL_ZMM(14);
+    FILL_ZMM(15);
+    FILL_ZMM(16);
+    FILL_ZMM(17);
+    FILL_ZMM(18);
+    FILL_ZMM(19);
+    FILL_ZMM(20);
+    FILL_ZMM(21);
+    FILL_ZMM(22);
+    FILL_ZMM(23);
+    FILL_ZMM(24);
+    FILL_ZMM(25);
+    FILL_ZMM(26);
+    FILL_ZMM(27);
+    FILL_ZMM(28);
+    FILL_ZMM(29);
+    FILL_ZMM(30);
+    FILL_ZMM(31);
+#    undef FILL_ZMM
+#else
+    if (__builtin_cpu_supports("avx")) {
+        /* Set the upper ymm halves too. */
+#    define FILL_YMM(n)                                                             \
+        __asm__ __volatile__("vpcmpeqd %%ymm" #n ", %%ymm" #n ", %%ymm" #n ::: "xmm" #n)
+        FILL_YMM(0);
+        FILL_YMM(1);
+        FILL_YMM(2);
+        FILL_YMM(3);
+        FILL_YMM(4);
+        FILL_YMM(5);
+        FILL_YMM(6);
+        FILL_YMM(7);
+        FILL_YMM(8);
+        FILL_YMM(9);
+        FILL_YMM(10);
+        FILL_YMM(11);
+        FILL_YMM(12);
+        FILL_YMM(13);
+        FILL_YMM(14);
+        FILL_YMM(15);
+#    undef FILL_YMM
+    }
+#endif
+}
+
+int
+main(void)
+{
+    int i;
+    /* Calls to every function. */
+#define FUNCTION(FUNCNAME) \
+    fill_simd();           \
+    FUNCNAME();
+#define LAST_FUNCTION()
+    FUNCTIONS()
+#undef FUNCTION
+#undef LAST_FUNCTION
+    /* Run rare_simd until it has taken its rare path once. */
+    for (i = 1; i < RARE_SIMD_PERIOD; i++) {
+        fill_simd();
+        rare_simd();
+    }
+    return 0;
+}
@@ -0,0 +1,294 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests that -cleancall_scan_simd preserves the application's SIMD registers
+ * around callees that make calls, which the full clean call analysis gives up on.
+ */
+
+#include "dr_api.h"
+
+/* List of instrumentation functions. */
+#define FUNCTIONS()             \
+    FUNCTION(empty)             \
+    FUNCTION(inscount)          \
+    FUNCTION(compiler_inscount) \
+    FUNCTION(bbcount)           \
+    FUNCTION(aflags_clobber)    \
+    FUNCTION(simd_clobber)      \
+    FUNCTION(no_simd)           \
+    FUNCTION(rare_simd)         \
+    LAST_FUNCTION()
+
+/* This must match the application. */
+#define RARE_SIMD_PERIOD 4
+/* The number of SIMD registers written on rare_simd's rare path.  This is kept
+ * under the out-of-line threshold so that the saves show up inline.
+ */
+#define RARE_SIMD_REGS 2
+
+static void
+compiler_inscount(ptr_uint_t count);
+
+static dr_emit_flags_t
+event_basic_block(void *dc, void *tag, instrlist_t *bb, bool for_trace, bool translating);
+#include "cleancall-opt-shared.h"
+
+static uint rare_simd_calls;
+
+/* Checks that the clean call sequence for func_index saves registers inline rather
+ * than calling the out-of-line routine, which saves every SIMD register, and
+ * counts the SIMD registers it stores.  There may be separate save paths for
+ * different vector lengths, so we count each register once.
+ */
+static void
+check_simd_saves(app_pc start, app_pc end, int func_index)
+{
+    void *dc = dr_get_current_drcontext();
+    int expected, count = 0, calls = 0;
+    bool saved[DR_REG_STOP_ZMM - DR_REG_START_ZMM + 1] = { 0 };
+    app_pc pc;
+    instr_t instr;
+
+    switch (func_index) {
+    case FN_no_simd: expected = 0; break;
+    case FN_rare_simd: expected = RARE_SIMD_REGS; break;
+    default: return;
+    }
+    instr_init(dc, &instr);
+    for (pc = start; pc != end;) {
+        int i;
+        pc = decode(dc, pc, &instr);
+        if (instr_is_call(&instr))
+            calls++;
+        if (instr_writes_memory(&instr)) {
+            for (i = 0; i < instr_num_srcs(&instr); i++) {
+                opnd_t src = instr_get_src(&instr, i);
+                if (opnd_is_reg(src) && reg_is_vector_simd(opnd_get_reg(src))) {
+                    reg_id_t zmm = reg_resize_to_opsz(opnd_get_reg(src), OPSZ_64);
+                    if (!saved[zmm - DR_REG_START_ZMM]) {
+                        saved[zmm - DR_REG_START_ZMM] = true;
+                        count++;
+                    }
+                    break;
+                }
+            }
+        }
+        instr_reset(dc, &instr);
+    }
+    if (calls != 1) {
+        dr_fprintf(STDERR, "Expected inline saves for %s but found %d calls\n",
+                   func_names[func_index], calls);
+        dump_cc_code(dc, start, end, func_index);
+    } else if (count != expected) {
+        dr_fprintf(STDERR, "Expected %d SIMD saves for %s but found %d\n", expected,
+                   func_names[func_index], count);
+        dump_cc_code(dc, start, end, func_index);
+    }
+}
+
+static dr_emit_flags_t
+event_basic_block(void *dc, void *tag, instrlist_t *bb, bool for_trace, bool translating)
+{
+    instr_t *entry = instrlist_first(bb);
+    app_pc entry_pc = instr_get_app_pc(entry);
+    int i;
+    instr_t *before_label;
+    instr_t *after_label;
+
+    for (i = 0; i < N_FUNCS; i++) {
+        if (entry_pc == func_app_pcs[i])
+            break;
+    }
+    if (i == N_FUNCS)
+        return DR_EMIT_DEFAULT;
+
+    /* We're inserting a call to a function in this bb. */
+    func_called[i] = 1;
+    dr_insert_clean_call(dc, bb, entry, (void *)before_callee, false, 2,
+                         OPND_CREATE_INTPTR(func_ptrs[i]),
+                         OPND_CREATE_INTPTR(func_names[i]));
+
+    before_label = INSTR_CREATE_label(dc);
+    after_label = INSTR_CREATE_label(dc);
+    PRE(bb, entry, before_label);
+    switch (i) {
+    default: dr_insert_clean_call(dc, bb, entry, func_ptrs[i], false, 0); break;
+    case FN_inscount:
+    case FN_compiler_inscount:
+        dr_insert_clean_call(dc, bb, entry, func_ptrs[i], false, 1,
+                             OPND_CREATE_INT32(0xDEAD));
+        break;
+    }
+    PRE(bb, entry, after_label);
+
+    dr_insert_clean_call_ex(dc, bb, entry, (void *)after_callee,
+                            DR_CLEANCALL_READS_APP_CONTEXT, 6,
+                            opnd_create_instr(before_label),
+                            opnd_create_instr(after_label), OPND_CREATE_INT32(false),
+                            OPND_CREATE_INT32(false), OPND_CREATE_INT32(i),
+                            OPND_CREATE_INTPTR(func_names[i]));
+    dr_insert_clean_call(dc, bb, entry, (void *)check_simd_saves, false, 3,
+                         opnd_create_instr(before_label), opnd_create_instr(after_label),
+                         OPND_CREATE_INT32(i));
+    return DR_EMIT_DEFAULT;
+}
+
+/*****************************************************************************/
+/* Instrumentation function code generation. */
+
+/* Writes the low part of the first num_regs SIMD registers, zeroing the rest of each
+ * register.
+ */
+static void
+codegen_clobber_simd(void *dc, instrlist_t *ilist, int num_regs)
+{
+    int i;
+    for (i = 0; i < num_regs; i++) {
+        reg_id_t reg = DR_REG_XMM0 + (reg_id_t)i;
+#ifdef __AVX512F__
+        APP(ilist,
+            INSTR_ENCODING_HINT(INSTR_CREATE_vmovq(dc, opnd_create_reg(reg),
+                                                   opnd_create_reg(DR_REG_XAX)),
+                                DR_ENCODING_HINT_X86_EVEX));
+#else
+        APP(ilist,
+            INSTR_CREATE_vmovq(dc, opnd_create_reg(reg), opnd_create_reg(DR_REG_XAX)));
+#endif
+    }
+}
+
+/*
+simd_clobber:
+    push REG_XBP
+    mov REG_XBP, REG_XSP
+    call clobber
+    leave
+    ret
+clobber:
+    mov REG_XAX, 0xf1f1
+    vmovq xmm0, REG_XAX
+    ...
+    vmovq xmm<last>, REG_XAX
+    ret
+*/
+static instrlist_t *
+codegen_simd_clobber(void *dc)
+{
+    instrlist_t *ilist = instrlist_create(dc);
+    instr_t *clobber = INSTR_CREATE_label(dc);
+    codegen_prologue(dc, ilist);
+    APP(ilist, INSTR_CREATE_call(dc, opnd_create_instr(clobber)));
+    codegen_epilogue(dc, ilist);
+    APP(ilist, clobber);
+    APP(ilist,
+        INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_XAX), OPND_CREATE_INTPTR(0xf1f1)));
+    codegen_clobber_simd(dc, ilist, proc_num_simd_registers());
+    APP(ilist, INSTR_CREATE_ret(dc));
+    return ilist;
+}
+
+/*
+no_simd:
+    push REG_XBP
+    mov REG_XBP, REG_XSP
+    call modify_gprs
+    leave
+    ret
+modify_gprs:
+    mov REG_XAX, 0xf1f1
+    mov REG_XDX, 0xf1f1
+    ret
+*/
+static instrlist_t *
+codegen_no_simd(void *dc)
+{
+    instrlist_t *ilist = instrlist_create(dc);
+    instr_t *modify_gprs = INSTR_CREATE_label(dc);
+    codegen_prologue(dc, ilist);
+    APP(ilist, INSTR_CREATE_call(dc, opnd_create_instr(modify_gprs)));
+    codegen_epilogue(dc, ilist);
+    APP(ilist, modify_gprs);
+    APP(ilist,
+        INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_XAX), OPND_CREATE_INTPTR(0xf1f1)));
+    APP(ilist,
+        INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_XDX), OPND_CREATE_INTPTR(0xf1f1)));
+    APP(ilist, INSTR_CREATE_ret(dc));
+    return ilist;
+}
+
+/*
+rare_simd:
+    push REG_XBP
+    mov REG_XBP, REG_XSP
+    mov REG_XAX, &rare_simd_calls
+    inc dword [REG_XAX]
+    test dword [REG_XAX], RARE_SIMD_PERIOD - 1
+    jz rare
+    call modify_gprs
+    leave
+    ret
+rare:
+    vmovq xmm0, REG_XAX
+    ...
+    vmovq xmm<RARE_SIMD_REGS - 1>, REG_XAX
+    leave
+    ret
+modify_gprs:
+    mov REG_XDX, 0xf1f1
+    ret
+*/
+static instrlist_t *
+codegen_rare_simd(void *dc)
+{
+    instrlist_t *ilist = instrlist_create(dc);
+    instr_t *rare = INSTR_CREATE_label(dc);
+    instr_t *modify_gprs = INSTR_CREATE_label(dc);
+    codegen_prologue(dc, ilist);
+    APP(ilist,
+        INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_XAX),
+                             OPND_CREATE_INTPTR(&rare_simd_calls)));
+    APP(ilist, INSTR_CREATE_inc(dc, OPND_CREATE_MEM32(DR_REG_XAX, 0)));
+    APP(ilist,
+        INSTR_CREATE_test(dc, OPND_CREATE_MEM32(DR_REG_XAX, 0),
+                          OPND_CREATE_INT32(RARE_SIMD_PERIOD - 1)));
+    APP(ilist, INSTR_CREATE_jcc(dc, OP_jz, opnd_create_instr(rare)));
+    APP(ilist, INSTR_CREATE_call(dc, opnd_create_instr(modify_gprs)));
+    codegen_epilogue(dc, ilist);
+    APP(ilist, rare);
+    codegen_clobber_simd(dc, ilist, RARE_SIMD_REGS);
+    codegen_epilogue(dc, ilist);
+    APP(ilist, modify_gprs);
+    APP(ilist,
+        INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_XDX), OPND_CREATE_INTPTR(0xf1f1)));
+    APP(ilist, INSTR_CREATE_ret(dc));
+    return ilist;
+}
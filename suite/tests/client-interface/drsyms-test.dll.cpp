@@ -79,6 +79,11 @@ static dr_os_version_info_t os_version = {
 
 static bool found_tools_h, found_appdll;
 
+/* Line addresses gathered during line iteration for testing batch lookups. */
+#define MAX_LINE_SAMPLES 64
+static size_t line_samples[MAX_LINE_SAMPLES];
+static size_t num_line_samples;
+
 extern "C" DR_EXPORT void
 dr_init(client_id_t id)
 {
@@ -543,6 +548,8 @@ enum_line_cb(drsym_line_info_t *info, void *data)
         if (!found_tools_h && strstr(info->file, "tools.h") != NULL) {
             found_tools_h = true;
         }
+        if (num_line_samples < MAX_LINE_SAMPLES)
+            line_samples[num_line_samples++] = info->line_addr;
     }
     return true;
 }
@@ -560,6 +567,55 @@ test_line_iteration(const module_data_t *dll_data)
         dr_fprintf(STDERR, "found tools.h\n");
 }
 
+/* Compares drsym_lookup_addresses() against individual lookups. */
+static void
+test_batch_lookup(const module_data_t *dll_data)
+{
+    drsym_info_t batch_info[MAX_LINE_SAMPLES];
+    drsym_error_t batch_res[MAX_LINE_SAMPLES];
+    static char batch_names[MAX_LINE_SAMPLES][MAX_FUNC_LEN];
+    static char batch_files[MAX_LINE_SAMPLES][MAXIMUM_PATH];
+    char name[MAX_FUNC_LEN];
+    char file[MAXIMUM_PATH];
+    drsym_info_t info;
+    drsym_error_t r;
+    size_t i, j;
+
+    /* Sort the samples, as the batch interface prefers. */
+    for (i = 1; i < num_line_samples; i++) {
+        size_t offs = line_samples[i];
+        for (j = i; j > 0 && line_samples[j - 1] > offs; j--)
+            line_samples[j] = line_samples[j - 1];
+        line_samples[j] = offs;
+    }
+    for (i = 0; i < num_line_samples; i++) {
+        batch_info[i].struct_size = sizeof(batch_info[i]);
+        batch_info[i].name = batch_names[i];
+        batch_info[i].name_size = MAX_FUNC_LEN;
+        batch_info[i].file = batch_files[i];
+        batch_info[i].file_size = MAXIMUM_PATH;
+    }
+    r = drsym_lookup_addresses(dll_data->full_path, num_line_samples, line_samples,
+                               batch_info, batch_res, DRSYM_DEFAULT_FLAGS);
+    ASSERT(r == DRSYM_SUCCESS);
+    for (i = 0; i < num_line_samples; i++) {
+        info.struct_size = sizeof(info);
+        info.name = name;
+        info.name_size = MAX_FUNC_LEN;
+        info.file = file;
+        info.file_size = MAXIMUM_PATH;
+        r = drsym_lookup_address(dll_data->full_path, line_samples[i], &info,
+                                 DRSYM_DEFAULT_FLAGS);
+        ASSERT(r == batch_res[i]);
+        if (r != DRSYM_SUCCESS)
+            continue;
+        ASSERT(info.line == batch_info[i].line);
+        ASSERT(info.line_offs == batch_info[i].line_offs);
+        ASSERT(strcmp(info.name, batch_info[i].name) == 0);
+        ASSERT(strcmp(info.file, batch_info[i].file) == 0);
+    }
+}
+
 /* Lookup symbols in the appdll and wrap them. */
 static void
 lookup_dll_syms(void *dc, const module_data_t *dll_data, bool loaded)
@@ -631,6 +687,7 @@ lookup_dll_syms(void *dc, const module_data_t *dll_data, bool loaded)
     check_enumerate_dll_syms(dll_path);
 
     test_line_iteration(dll_data);
+    test_batch_lookup(dll_data);
 
     drsym_free_resources(dll_path);
 }
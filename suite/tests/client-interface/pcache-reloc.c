@@ -0,0 +1,79 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Loads a library whose code makes calls, so that its persisted cache holds
+ * mangled return addresses.  Passing "shift" after the library path reserves
+ * address space first so the library is loaded at a different base than in a
+ * run without it, even when ASLR is disabled.
+ */
+
+#include "tools.h"
+#include <dlfcn.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define RESERVE_SIZE (64 * 1024 * 1024)
+
+int
+main(int argc, char **argv)
+{
+    void *lib;
+    int (*compute)(int);
+    /* We don't have "." on LD_LIBRARY_PATH path so we take in abs path */
+    if (argc < 2) {
+        print("need to pass in lib path\n");
+        return 1;
+    }
+    if (argc > 2 && strcmp(argv[2], "shift") == 0) {
+        if (mmap(NULL, RESERVE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ==
+            MAP_FAILED) {
+            print("failed to reserve address space\n");
+            return 1;
+        }
+    }
+    lib = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+    if (lib == NULL) {
+        print("error loading library %s: %s\n", argv[1], dlerror());
+        return 1;
+    }
+    compute = (int (*)(int))dlsym(lib, "compute");
+    if (compute == NULL) {
+        print("error finding compute: %s\n", dlerror());
+        return 1;
+    }
+    print("compute(100) = %d\n", compute(100));
+    /* We leave the library loaded: its unit is persisted at exit, as the
+     * module is no longer known by the time an unload flush is processed.
+     */
+    return 0;
+}
@@ -0,0 +1,95 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Reports whether the persisted cache of the test library was resurrected at
+ * a base other than the one it was written at.  The app's output then shows
+ * whether its relocated call-return paths ran correctly.
+ */
+
+#include "dr_api.h"
+#include <string.h>
+
+#define LIB_NAME "client.pcache-reloc.appdll"
+
+static bool resurrected_shifted;
+
+static size_t
+event_persist_ro_size(void *drcontext, void *perscxt, size_t file_offs,
+                      void **user_data DR_PARAM_OUT)
+{
+    return 0;
+}
+
+static bool
+event_persist_ro(void *drcontext, void *perscxt, file_t fd, void *user_data)
+{
+    return true;
+}
+
+static bool
+event_resurrect_ro(void *drcontext, void *perscxt, byte **map DR_PARAM_OUT)
+{
+    module_data_t *mod = dr_lookup_module(dr_persist_start(perscxt));
+    if (mod != NULL) {
+        const char *name = dr_module_preferred_name(mod);
+        if (name != NULL && strstr(name, LIB_NAME) != NULL &&
+            dr_persist_module_shift(perscxt) != 0)
+            resurrected_shifted = true;
+        dr_free_module_data(mod);
+    }
+    return true;
+}
+
+static dr_emit_flags_t
+event_bb(void *drcontext, void *tag, instrlist_t *bb, bool for_trace, bool translating)
+{
+    return DR_EMIT_DEFAULT | DR_EMIT_PERSISTABLE;
+}
+
+static void
+event_exit(void)
+{
+    if (resurrected_shifted)
+        dr_fprintf(STDERR, "resurrected the library pcache at a new base\n");
+}
+
+DR_EXPORT
+void
+dr_init(client_id_t id)
+{
+    dr_register_exit_event(event_exit);
+    dr_register_bb_event(event_bb);
+    if (!dr_register_persist_ro(event_persist_ro_size, event_persist_ro,
+                                event_resurrect_ro))
+        dr_fprintf(STDERR, "failed to register ro");
+}
@@ -0,0 +1,87 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Runs the same hot loops over several rounds.  Each round calls freshly
+ * generated code and then unmaps it, which flushes every trace that includes
+ * it, so traces are rebuilt from the same heads in later rounds and, with
+ * -reset_every_nth_pending, in later cache generations.
+ */
+
+#include "tools.h"
+
+#define BUF_LEN 4096
+#define ROUNDS 6
+#define ITERS 100000
+#define DATA_LEN 1024
+
+static int data[DATA_LEN];
+
+static int
+call_loop(char *code)
+{
+    int i, sum = 0;
+    for (i = 0; i < ITERS; i++)
+        sum += test(code, i & 0xff);
+    return sum;
+}
+
+static int
+data_loop(void)
+{
+    int i, j, sum = 0;
+    for (j = 0; j < ITERS / DATA_LEN; j++) {
+        for (i = 0; i < DATA_LEN; i++)
+            sum += data[i] ^ j;
+    }
+    return sum;
+}
+
+int
+main(void)
+{
+    int i, round;
+
+    INIT();
+
+    for (i = 0; i < DATA_LEN; i++)
+        data[i] = i * 7;
+    for (round = 0; round < ROUNDS; round++) {
+        char *buf = allocate_mem(BUF_LEN, ALLOW_READ | ALLOW_WRITE | ALLOW_EXEC);
+        copy_to_buf(buf, BUF_LEN, NULL, (round % 2 == 0) ? CODE_INC : CODE_DEC,
+                    COPY_NORMAL);
+        protect_mem(buf, BUF_LEN, ALLOW_READ | ALLOW_EXEC);
+        print("round %d: %d %d\n", round, call_loop(buf), data_loop());
+        free_mem(buf, BUF_LEN);
+    }
+    print("done\n");
+    return 0;
+}
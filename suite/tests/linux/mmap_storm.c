@@ -0,0 +1,174 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Creates, re-protects, and removes many small non-mergeable mappings to stress
+ * DR's memory-area bookkeeping on mmap, mprotect, and munmap, checking the
+ * resulting mappings after each step.  Usage: mmap_storm [-v] [num_pages].
+ * Pass "-v" to print the elapsed time, for use as a throughput benchmark.
+ */
+
+#include "tools.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DEFAULT_NUM_PAGES 8192
+
+#define ELAPSED_US(start, end) \
+    ((long)(((end).tv_sec - (start).tv_sec) * 1000000 + ((end).tv_usec - (start).tv_usec)))
+
+static int
+page_prot(int i, int flip)
+{
+    /* Alternate protections so that neighboring mappings are never merged,
+     * and make half of them executable so they are tracked as code regions.
+     */
+    return ((i + flip) % 2 == 0) ? (PROT_READ | PROT_EXEC) : PROT_READ;
+}
+
+/* Checks that [base, base + num_pages * page_size) holds exactly one mapping per
+ * page with the protection page_prot(i, flip) if expect_mapped is set, or no
+ * mappings at all otherwise.  Returns the number of mappings found in the range,
+ * or -1 on a mismatch.
+ */
+static int
+check_mappings(char *base, int num_pages, size_t page_size, int flip, bool expect_mapped)
+{
+    char line[512];
+    char perms[8];
+    unsigned long start, end;
+    char *limit = base + num_pages * page_size;
+    int count = 0;
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps == NULL) {
+        print("cannot open /proc/self/maps\n");
+        return -1;
+    }
+    while (fgets(line, sizeof(line), maps) != NULL) {
+        int i, prot;
+        if (sscanf(line, "%lx-%lx %7s", &start, &end, perms) != 3)
+            continue;
+        if ((char *)end <= base || (char *)start >= limit)
+            continue;
+        i = (int)(((char *)start - base) / page_size);
+        prot = (perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) |
+            (perms[2] == 'x' ? PROT_EXEC : 0);
+        if (!expect_mapped || (char *)start < base ||
+            (char *)start != base + i * page_size ||
+            (char *)end != base + (i + 1) * page_size || prot != page_prot(i, flip)) {
+            print("unexpected mapping %d: %s", i, line);
+            count = -1;
+            break;
+        }
+        count++;
+    }
+    fclose(maps);
+    if (count >= 0 && expect_mapped && count != num_pages) {
+        print("found %d mappings, expected %d\n", count, num_pages);
+        count = -1;
+    }
+    return count;
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    bool verbose = false;
+    int num_pages = DEFAULT_NUM_PAGES;
+    struct timeval start, end;
+    long elapsed = 0;
+    char *base;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else
+            num_pages = atoi(argv[i]);
+    }
+    if (num_pages <= 0) {
+        print("invalid page count\n");
+        return 1;
+    }
+
+    /* Reserve one range so the mappings below are adjacent and stay in order. */
+    base = mmap(NULL, num_pages * page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+                -1, 0);
+    if (base == MAP_FAILED) {
+        print("reservation failed\n");
+        return 1;
+    }
+    /* Map from the top down so each new region is inserted before the others. */
+    gettimeofday(&start, NULL);
+    for (i = num_pages - 1; i >= 0; i--) {
+        if (mmap(base + i * page_size, page_size, page_prot(i, 0),
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+            print("mmap %d failed\n", i);
+            return 1;
+        }
+    }
+    gettimeofday(&end, NULL);
+    elapsed += ELAPSED_US(start, end);
+    if (check_mappings(base, num_pages, page_size, 0, true) < 0)
+        return 1;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < num_pages; i++) {
+        if (mprotect(base + i * page_size, page_size, page_prot(i, 1)) != 0) {
+            print("mprotect %d failed\n", i);
+            return 1;
+        }
+    }
+    gettimeofday(&end, NULL);
+    elapsed += ELAPSED_US(start, end);
+    if (check_mappings(base, num_pages, page_size, 1, true) < 0)
+        return 1;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < num_pages; i++) {
+        if (munmap(base + i * page_size, page_size) != 0) {
+            print("munmap %d failed\n", i);
+            return 1;
+        }
+    }
+    gettimeofday(&end, NULL);
+    elapsed += ELAPSED_US(start, end);
+    if (check_mappings(base, num_pages, page_size, 1, false) != 0)
+        return 1;
+
+    if (verbose)
+        print("%d pages: %ld us\n", num_pages, elapsed);
+    print("done\n");
+    return 0;
+}